@@ -0,0 +1,422 @@
+/**********************************************************************************************************************
+File: bleperipheral_bulk.c
+
+Description:
+Chunked bulk upload over the BPEngenuics RX characteristic (POV images, animation tables, config blobs).
+
+The client announces an object with START (ID, size, CRC16 of the whole object) and streams it as write-without-
+response DATA packets of up to U8_BPBULK_CHUNK_SIZE bytes.  Each chunk carries the low byte of its chunk index, so
+the receiver knows exactly where it belongs without a per-packet offset.  The device notifies an ACK with the next
+offset it expects every U8_BPBULK_WINDOW / 2 chunks; the client keeps at most U8_BPBULK_WINDOW chunks
+unacknowledged, so the link stays full without flooding the stack.
+
+A missing or out-of-order chunk, or a sink that cannot keep up, produces one immediate ACK with the current offset
+and the client goes back to it.  If the link drops, the partial transfer is kept: a START with the same ID, size
+and CRC resumes from the last offset received.  The CRC is run over the chunks as they arrive and checked at the end.
+
+The sink's completion callback may parse the whole object, so it runs in a radio gap (radio_sched.c) and the final
+ACK is sent after it; a START that arrives before then is answered BUSY.
+
+Chunks are handed to the object's registered sink, so the size of an object is limited by where the sink stores it,
+not by RAM here.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BPBulkStatsType G_sBPBulkStats;                        /* Bulk upload statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BPBulk_" and be declared as static.
+***********************************************************************************************************************/
+static BPBulkObjectType BPBulk_asObjects[U8_BPBULK_MAX_OBJECTS];   /* Registered upload targets */
+static u8 BPBulk_u8Objects;                                        /* Entries used in BPBulk_asObjects */
+
+static u8 BPBulk_u8Active;                 /* Index of the object being received or U8_BPBULK_NO_OBJECT */
+static u32 BPBulk_u32Size;                 /* Announced object size */
+static u32 BPBulk_u32Offset;               /* Bytes received in order so far */
+static u16 BPBulk_u16CrcExpected;          /* Announced CRC16 */
+static u16 BPBulk_u16Crc;                  /* CRC16 of the bytes received so far */
+static u8 BPBulk_u8SinceAck;               /* Chunks accepted since the last ACK */
+static bool BPBulk_bResyncSent;            /* An ACK for the current gap has gone; stay quiet until back in step */
+static u32 BPBulk_u32StartMs;              /* Time of the first START of this object */
+
+static u8 BPBulk_u8Finishing;              /* Index of the object waiting for its completion callback */
+static u32 BPBulk_u32FinishSize;           /* Size of that object */
+static bool BPBulk_bFinishCrcOk;           /* Its CRC result */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPBulkRegisterObject(u8 u8Id_, u32 u32MaxSize_, BPBulkWriteType pfWrite_, BPBulkDoneType pfDone_)
+@brief Declares an object ID the client may upload.
+
+Requires:
+@param pfWrite_ is called in offset order with each chunk
+@param pfDone_ is called when the last chunk has been written (may be NULL)
+
+Promises:
+- Returns TRUE if the object was added
+- Returns FALSE if the ID is already taken or the table is full
+
+*/
+bool BPBulkRegisterObject(u8 u8Id_, u32 u32MaxSize_, BPBulkWriteType pfWrite_, BPBulkDoneType pfDone_)
+{
+  if( (BPBulk_u8Objects == U8_BPBULK_MAX_OBJECTS) || (pfWrite_ == NULL) )
+  {
+    return FALSE;
+  }
+
+  for(u8 i = 0; i < BPBulk_u8Objects; i++)
+  {
+    if(BPBulk_asObjects[i].u8Id == u8Id_)
+    {
+      return FALSE;
+    }
+  }
+
+  BPBulk_asObjects[BPBulk_u8Objects].u8Id = u8Id_;
+  BPBulk_asObjects[BPBulk_u8Objects].u32MaxSize = u32MaxSize_;
+  BPBulk_asObjects[BPBulk_u8Objects].pfWrite = pfWrite_;
+  BPBulk_asObjects[BPBulk_u8Objects].pfDone = pfDone_;
+  BPBulk_u8Objects++;
+
+  return TRUE;
+
+} /* end BPBulkRegisterObject() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BPBulkInitialize(void)
+@brief Clears any transfer in progress.
+
+Requires:
+- Objects registered before this call are kept
+
+Promises:
+- No transfer is active
+
+*/
+void BPBulkInitialize(void)
+{
+  memset(&G_sBPBulkStats, 0, sizeof(G_sBPBulkStats));
+  BPBulk_u8Active = U8_BPBULK_NO_OBJECT;
+  BPBulk_u8Finishing = U8_BPBULK_NO_OBJECT;
+  BPBulk_bResyncSent = FALSE;
+
+} /* end BPBulkInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPBulkRx(u8* pu8Packet_, u16 u16Length_)
+@brief Handles a write to the RX characteristic if it is a bulk packet.
+
+Requires:
+- Called from the GATTS write handler
+
+Promises:
+- Returns FALSE (and does nothing) if the write is not a bulk packet
+- Returns TRUE once the packet has been processed
+
+*/
+bool BPBulkRx(u8* pu8Packet_, u16 u16Length_)
+{
+  if( (u16Length_ == 0) || ((pu8Packet_[0] & U8_BPBULK_MARKER_MASK) != U8_BPBULK_MARKER) )
+  {
+    return FALSE;
+  }
+
+  switch(pu8Packet_[0] & U8_BPBULK_OPCODE_MASK)
+  {
+    case U8_BPBULK_OP_START:
+    {
+      if(u16Length_ == U8_BPBULK_START_SIZE)
+      {
+        BPBulkStart(pu8Packet_);
+      }
+      break;
+    }
+
+    case U8_BPBULK_OP_DATA:
+    {
+      if(u16Length_ >= U8_BPBULK_DATA_HEADER)
+      {
+        BPBulkData(pu8Packet_, (u8)u16Length_);
+      }
+      break;
+    }
+
+    case U8_BPBULK_OP_ABORT:
+    {
+      BPBulk_u8Active = U8_BPBULK_NO_OBJECT;
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  } /* end switch */
+
+  return TRUE;
+
+} /* end BPBulkRx() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn const BPBulkObjectType* BPBulkFindObject(u8 u8Id_)
+@brief Looks up a registered object so other transports (ANT burst) can deliver to the same sinks.
+
+Promises:
+- Returns the object registered as u8Id_, or NULL if there is none
+
+*/
+const BPBulkObjectType* BPBulkFindObject(u8 u8Id_)
+{
+  for(u8 i = 0; i < BPBulk_u8Objects; i++)
+  {
+    if(BPBulk_asObjects[i].u8Id == u8Id_)
+    {
+      return &BPBulk_asObjects[i];
+    }
+  }
+
+  return NULL;
+
+} /* end BPBulkFindObject() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPBulkStart(u8* pu8Packet_)
+@brief START: begins a new object, or resumes the interrupted one if it is the same object.
+*/
+static void BPBulkStart(u8* pu8Packet_)
+{
+  u8 u8Id = pu8Packet_[1];
+  u32 u32Size = BPBulkReadU32(&pu8Packet_[2]);
+  u16 u16Crc = (u16)(pu8Packet_[6] | (pu8Packet_[7] << 8));
+  u8 u8Index = U8_BPBULK_NO_OBJECT;
+
+  for(u8 i = 0; i < BPBulk_u8Objects; i++)
+  {
+    if(BPBulk_asObjects[i].u8Id == u8Id)
+    {
+      u8Index = i;
+    }
+  }
+
+  if( (u8Index == U8_BPBULK_NO_OBJECT) || (u32Size == 0) || (u32Size > BPBulk_asObjects[u8Index].u32MaxSize) )
+  {
+    G_sBPBulkStats.u32Rejected++;
+    BPBulkAck(u8Id, BPBULK_STATUS_REJECTED);
+    return;
+  }
+
+  /* The last object's sink still has to take it */
+  if(BPBulk_u8Finishing != U8_BPBULK_NO_OBJECT)
+  {
+    G_sBPBulkStats.u32Busy++;
+    BPBulkAck(u8Id, BPBULK_STATUS_BUSY);
+    return;
+  }
+
+  if( (u8Index == BPBulk_u8Active) && (u32Size == BPBulk_u32Size) && (u16Crc == BPBulk_u16CrcExpected) )
+  {
+    G_sBPBulkStats.u32Resumed++;
+  }
+  else
+  {
+    BPBulk_u8Active = u8Index;
+    BPBulk_u32Size = u32Size;
+    BPBulk_u16CrcExpected = u16Crc;
+    BPBulk_u32Offset = 0;
+    BPBulk_u16Crc = U16_CRC16_INIT;
+    BPBulk_u32StartMs = G_u32SystemTime1ms;
+    G_sBPBulkStats.u32Started++;
+  }
+
+  BPBulk_u8SinceAck = 0;
+  BPBulk_bResyncSent = FALSE;
+  BPBulkAck(u8Id, BPBULK_STATUS_OK);
+
+} /* end BPBulkStart() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPBulkData(u8* pu8Packet_, u8 u8Length_)
+@brief DATA: accepts the chunk if it is the next one expected.
+*/
+static void BPBulkData(u8* pu8Packet_, u8 u8Length_)
+{
+  BPBulkObjectType* psObject;
+  u32 u32Remaining;
+  u8 u8Expected;
+  u8 u8DataLength = u8Length_ - U8_BPBULK_DATA_HEADER;
+  u32 u32Elapsed;
+  bool bCrcOk;
+
+  if(BPBulk_u8Active == U8_BPBULK_NO_OBJECT)
+  {
+    G_sBPBulkStats.u32Rejected++;
+    if(!BPBulk_bResyncSent)
+    {
+      BPBulk_bResyncSent = TRUE;
+      BPBulkAck(U8_BPBULK_NO_OBJECT, BPBULK_STATUS_REJECTED);
+    }
+    return;
+  }
+
+  psObject = &BPBulk_asObjects[BPBulk_u8Active];
+  u32Remaining = BPBulk_u32Size - BPBulk_u32Offset;
+  u8Expected = (u32Remaining < U8_BPBULK_CHUNK_SIZE) ? (u8)u32Remaining : U8_BPBULK_CHUNK_SIZE;
+
+  /* Anything but the next chunk means one was lost: say where to go back to, once */
+  if( (pu8Packet_[1] != (u8)(BPBulk_u32Offset / U8_BPBULK_CHUNK_SIZE)) || (u8DataLength != u8Expected) )
+  {
+    G_sBPBulkStats.u32OutOfOrder++;
+    if(!BPBulk_bResyncSent)
+    {
+      BPBulk_bResyncSent = TRUE;
+      BPBulkAck(psObject->u8Id, BPBULK_STATUS_OK);
+    }
+    return;
+  }
+
+  if(!psObject->pfWrite(BPBulk_u32Offset, &pu8Packet_[U8_BPBULK_DATA_HEADER], u8DataLength))
+  {
+    G_sBPBulkStats.u32Busy++;
+    BPBulk_bResyncSent = TRUE;
+    BPBulkAck(psObject->u8Id, BPBULK_STATUS_BUSY);
+    return;
+  }
+
+  BPBulk_u16Crc = Crc16Compute(&pu8Packet_[U8_BPBULK_DATA_HEADER], u8DataLength, BPBulk_u16Crc);
+  BPBulk_u32Offset += u8DataLength;
+  BPBulk_bResyncSent = FALSE;
+  G_sBPBulkStats.u32Bytes += u8DataLength;
+
+  if(BPBulk_u32Offset == BPBulk_u32Size)
+  {
+    bCrcOk = (BPBulk_u16Crc == BPBulk_u16CrcExpected);
+    if(bCrcOk)
+    {
+      G_sBPBulkStats.u32Completed++;
+    }
+    else
+    {
+      G_sBPBulkStats.u32CrcErrors++;
+    }
+
+    u32Elapsed = G_u32SystemTime1ms - BPBulk_u32StartMs;
+    if(u32Elapsed == 0)
+    {
+      u32Elapsed = 1;
+    }
+    G_sBPBulkStats.u32LastDurationMs = u32Elapsed;
+    G_sBPBulkStats.u32LastBytesPerSecond = (u32)(((u64)BPBulk_u32Size * 1000) / u32Elapsed);
+
+    BPBulk_u8Finishing = BPBulk_u8Active;
+    BPBulk_u32FinishSize = BPBulk_u32Size;
+    BPBulk_bFinishCrcOk = bCrcOk;
+    BPBulk_u8Active = U8_BPBULK_NO_OBJECT;
+    if(!RadioSchedSubmit(RADIOSCHED_BULK_DONE, BPBulkFinish, NULL))
+    {
+      BPBulkFinish(NULL);
+    }
+    return;
+  }
+
+  BPBulk_u8SinceAck++;
+  if(BPBulk_u8SinceAck >= (U8_BPBULK_WINDOW / 2))
+  {
+    BPBulk_u8SinceAck = 0;
+    BPBulkAck(psObject->u8Id, BPBULK_STATUS_OK);
+  }
+
+} /* end BPBulkData() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPBulkFinish(void* pvContext_)
+@brief radio_sched job: hands the received object to its sink and sends the final ACK.
+*/
+static void BPBulkFinish(void* pvContext_)
+{
+  BPBulkObjectType* psObject = &BPBulk_asObjects[BPBulk_u8Finishing];
+
+  BPBulk_u8Finishing = U8_BPBULK_NO_OBJECT;
+  if(psObject->pfDone != NULL)
+  {
+    psObject->pfDone(BPBulk_u32FinishSize, BPBulk_bFinishCrcOk);
+  }
+
+  BPBulkAck(psObject->u8Id, BPBulk_bFinishCrcOk ? BPBULK_STATUS_COMPLETE : BPBULK_STATUS_CRC_ERROR);
+
+} /* end BPBulkFinish() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPBulkAck(u8 u8Id_, BPBulkStatusType eStatus_)
+@brief Notifies the client of the status and the next offset expected.
+*/
+static void BPBulkAck(u8 u8Id_, BPBulkStatusType eStatus_)
+{
+  u8 au8Ack[U8_BPBULK_ACK_SIZE];
+
+  au8Ack[0] = U8_BPBULK_MARKER | U8_BPBULK_OP_ACK;
+  au8Ack[1] = u8Id_;
+  au8Ack[2] = (u8)eStatus_;
+  au8Ack[3] = (u8)(BPBulk_u32Offset);
+  au8Ack[4] = (u8)(BPBulk_u32Offset >> 8);
+  au8Ack[5] = (u8)(BPBulk_u32Offset >> 16);
+  au8Ack[6] = (u8)(BPBulk_u32Offset >> 24);
+
+  BPEngenuicsQueueData(BPENGENUICS_TX_CONTROL, au8Ack, U8_BPBULK_ACK_SIZE);
+
+} /* end BPBulkAck() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u32 BPBulkReadU32(u8* pu8Data_)
+@brief Reads a little-endian u32 that may not be aligned.
+*/
+static u32 BPBulkReadU32(u8* pu8Data_)
+{
+  return (u32)pu8Data_[0] | ((u32)pu8Data_[1] << 8) | ((u32)pu8Data_[2] << 16) | ((u32)pu8Data_[3] << 24);
+
+} /* end BPBulkReadU32() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
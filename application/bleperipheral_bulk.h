@@ -0,0 +1,123 @@
+/**********************************************************************************************************************
+File: bleperipheral_bulk.h
+
+Description:
+Header file for bleperipheral_bulk.c
+**********************************************************************************************************************/
+
+#ifndef __BLEPERIPHERALBULK_H
+#define __BLEPERIPHERALBULK_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Byte 0 of every bulk packet is U8_BPBULK_MARKER | opcode */
+#define U8_BPBULK_MARKER               (u8)0xE0   /* High nibble; distinct from framed packets and raw commands */
+#define U8_BPBULK_MARKER_MASK          (u8)0xF0
+#define U8_BPBULK_OPCODE_MASK          (u8)0x0F
+
+/* Client -> device (RX characteristic, write without response) */
+#define U8_BPBULK_OP_START             (u8)0x01   /* [id][size u32][crc u16] begin or resume an object */
+#define U8_BPBULK_OP_DATA              (u8)0x02   /* [chunk u8][data] chunk = (offset / U8_BPBULK_CHUNK_SIZE) & 0xFF */
+#define U8_BPBULK_OP_ABORT             (u8)0x03   /* Forget the current object */
+
+/* Device -> client (TX characteristic, notification) */
+#define U8_BPBULK_OP_ACK               (u8)0x08   /* [id][status][next offset u32] */
+#define U8_BPBULK_ACK_SIZE             (u8)7
+
+#define U8_BPBULK_START_SIZE           (u8)8
+#define U8_BPBULK_DATA_HEADER          (u8)2
+#define U8_BPBULK_CHUNK_SIZE           (u8)(BPENGENUICS_MAX_CHAR_LEN - U8_BPBULK_DATA_HEADER)
+#define U8_BPBULK_WINDOW               (u8)8      /* Chunks the client may send past the last ACK */
+#define U8_BPBULK_MAX_OBJECTS          (u8)2      /* Registered object IDs */
+#define U8_BPBULK_NO_OBJECT            (u8)0xFF
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum BPBulkStatusType
+@brief Status byte of an ACK. */
+typedef enum
+{
+  BPBULK_STATUS_OK = 0,                   /*!< @brief Continue from the ACK offset */
+  BPBULK_STATUS_COMPLETE,                 /*!< @brief Whole object received and the CRC matched */
+  BPBULK_STATUS_CRC_ERROR,                /*!< @brief Whole object received but the CRC did not match */
+  BPBULK_STATUS_REJECTED,                 /*!< @brief Unknown object ID, too large, or no transfer in progress */
+  BPBULK_STATUS_BUSY                      /*!< @brief Receiver could not take the data yet; resend from the offset */
+} BPBulkStatusType;
+
+/* Stores u8Length_ bytes at u32Offset_; return FALSE to have the client send them again later */
+typedef bool(*BPBulkWriteType)(u32 u32Offset_, u8* pu8Data_, u8 u8Length_);
+
+/* Called once the whole object has arrived; bCrcOk_ FALSE means the stored data must not be used */
+typedef void(*BPBulkDoneType)(u32 u32Size_, bool bCrcOk_);
+
+/*!
+@struct BPBulkObjectType
+@brief A registered upload target.
+*/
+typedef struct
+{
+  u8 u8Id;                                /*!< @brief Object ID sent by the client in START */
+  u32 u32MaxSize;                         /*!< @brief Largest object the target can store */
+  BPBulkWriteType pfWrite;                /*!< @brief Chunk sink */
+  BPBulkDoneType pfDone;                  /*!< @brief Completion callback */
+} BPBulkObjectType;
+
+/*!
+@struct BPBulkStatsType
+@brief Bulk upload statistics.
+*/
+typedef struct
+{
+  u32 u32Started;                         /*!< @brief New transfers */
+  u32 u32Resumed;                         /*!< @brief STARTs that continued an interrupted transfer */
+  u32 u32Completed;                       /*!< @brief Transfers received with a good CRC */
+  u32 u32CrcErrors;                       /*!< @brief Transfers received with a bad CRC */
+  u32 u32Rejected;                        /*!< @brief STARTs or chunks refused */
+  u32 u32OutOfOrder;                      /*!< @brief Chunks that were not the next expected one */
+  u32 u32Busy;                            /*!< @brief Chunks the sink could not take, or STARTs before it finished */
+  u32 u32Bytes;                           /*!< @brief Payload bytes accepted */
+  u32 u32LastDurationMs;                  /*!< @brief First START to completion of the last transfer */
+  u32 u32LastBytesPerSecond;              /*!< @brief Sustained rate of the last transfer */
+} BPBulkStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BPBulkRegisterObject(u8 u8Id_, u32 u32MaxSize_, BPBulkWriteType pfWrite_, BPBulkDoneType pfDone_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void BPBulkInitialize(void);
+bool BPBulkRx(u8* pu8Packet_, u16 u16Length_);
+const BPBulkObjectType* BPBulkFindObject(u8 u8Id_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BPBulkStart(u8* pu8Packet_);
+static void BPBulkData(u8* pu8Packet_, u8 u8Length_);
+static void BPBulkFinish(void* pvContext_);
+static void BPBulkAck(u8 u8Id_, BPBulkStatusType eStatus_);
+static u32 BPBulkReadU32(u8* pu8Data_);
+
+
+#endif /* __BLEPERIPHERALBULK_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -3,6 +3,10 @@ File: bleperipheral_engenuics.c
 
 Description:
 BLE Peripheral Service module for the Engenuics BLE Profile.
+
+Notifications are queued by priority class and fed to the stack until it runs out of TX buffers; each
+BLE_EVT_TX_COMPLETE frees buffers and refills them from the queues, CONTROL first, so game ACK/NACKs never wait
+behind a bulk stream and every buffer the stack offers per connection event is used.
 **********************************************************************************************************************/
 
 #include "configuration.h"
@@ -13,6 +17,7 @@ All Global variable names shall start with "G_"
 ***********************************************************************************************************************/
 /* New variables */
 volatile u32 G_u32BPEngenuicsFlags;                       /* Global state flags */
+BPEngenuicsTxStatsType G_sBPEngenuicsTxStats;             /* Notification queue statistics */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -31,8 +36,27 @@ static u8  BPEngenuics_u8UuidType;                       /* UUID Type for BLEEng
 static u16 BPEngenuics_u16ServiceHandle;                 /* Handle for the GATTS Service */
 static ble_gatts_char_handles_t BPEngenuics_eTxHandles;  /* TX Characteristic Handles */
 static ble_gatts_char_handles_t BPEngenuics_eRxHandles;  /* RX Characteristic Handles */          
-static u16 BPEngenuics_u16ConnHandle;                    /* Connection handle indicating if the device is GAP Connected to Client*/
 static bool BPEngenuics_bNotifcationEnabled;             /* Flag to indicate if Notifications have been enabled by the Client */
+static ble_gatts_char_handles_t BPEngenuics_eStateHandles;  /* State Characteristic Handles */
+static bool BPEngenuics_bStateNotifyEnabled;             /* Client enabled notifications on the State Characteristic */
+static bool BPEngenuics_bStateNotifyPending;             /* A committed state is waiting for a free stack TX buffer */
+static u8 BPEngenuics_au8StateBack[U8_BPENGENUICS_STATE_SIZE]; /* State being composed; owned by the application */
+
+#ifdef BPENGENUICS_VLOC_USER
+/* RX and TX attribute values in application RAM.  Only the stack writes these; the application reads them freely. */
+static u8 BPEngenuics_au8RxValue[BPENGENUICS_MAX_CHAR_LEN];
+static u8 BPEngenuics_au8TxValue[BPENGENUICS_MAX_CHAR_LEN];
+#endif /* BPENGENUICS_VLOC_USER */
+
+static BPEngenuicsTxEntryType BPEngenuics_asTxControl[U8_BPENGENUICS_TX_CONTROL_SIZE]; /* CONTROL class ring */
+static BPEngenuicsTxEntryType BPEngenuics_asTxBulk[U8_BPENGENUICS_TX_BULK_SIZE];       /* BULK class ring */
+static BPEngenuicsTxEntryType* const BPEngenuics_apsTxRing[BPENGENUICS_TX_CLASSES] =
+  {BPEngenuics_asTxControl, BPEngenuics_asTxBulk};
+static const u8 BPEngenuics_au8TxSize[BPENGENUICS_TX_CLASSES] =
+  {U8_BPENGENUICS_TX_CONTROL_SIZE, U8_BPENGENUICS_TX_BULK_SIZE};
+static u8 BPEngenuics_au8TxTail[BPENGENUICS_TX_CLASSES];    /* Oldest entry in each ring */
+static u8 BPEngenuics_au8TxCount[BPENGENUICS_TX_CLASSES];   /* Entries waiting in each ring */
+static u8 BPEngenuics_u8TxInFlight;                         /* Notifications accepted by the stack, not yet sent */
 
 
 /**********************************************************************************************************************
@@ -42,28 +66,161 @@ Function Definitions
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Public functions                                                                                                   */
 /*--------------------------------------------------------------------------------------------------------------------*/
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsSendData
+
+Description:
+Sends a notification on the TX Characteristic ahead of any bulk data.
+
+Requires:
+   - buffer holds size bytes, size <= BPENGENUICS_MAX_CHAR_LEN
+   
+Promises:
+  - As BPEngenuicsQueueData() with BPENGENUICS_TX_CONTROL
+*/
 bool BPEngenuicsSendData(u8* buffer, u8 size)
 {
-  ble_gatts_hvx_params_t hvx;   // Indication / Notification structure.
+  return BPEngenuicsQueueData(BPENGENUICS_TX_CONTROL, buffer, size);
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsQueueData
+
+Description:
+Queues a notification on the TX Characteristic and sends as much of the queue as the stack will take.
 
-  if (size > BPENGENUICS_MAX_CHAR_LEN)
+Requires:
+   - pu8Data_ holds u8Length_ bytes, u8Length_ <= BPENGENUICS_MAX_CHAR_LEN
+   
+Promises:
+  - Returns TRUE if the data is queued (it may already have been handed to the stack).
+  - Returns FALSE if not connected with notifications enabled, the data is too long, or the class queue is full
+    (counted in G_sBPEngenuicsTxStats.au32Dropped).
+*/
+bool BPEngenuicsQueueData(BPEngenuicsTxClassType eClass_, u8* pu8Data_, u8 u8Length_)
+{
+  BPEngenuicsTxEntryType* psEntry;
+  u8 u8Index;
+
+  if ((u8Length_ > BPENGENUICS_MAX_CHAR_LEN) || (eClass_ >= BPENGENUICS_TX_CLASSES))
     return false;
   
   // Check that the module is connected AND notifications are enabled.
-  if ((BPEngenuics_u16ConnHandle != BLE_CONN_HANDLE_INVALID) && (BPEngenuics_bNotifcationEnabled))
+  if ((bleperipheralGetConnHandle() == BLE_CONN_HANDLE_INVALID) || (!BPEngenuics_bNotifcationEnabled))
+    return false;
+
+  if (BPEngenuics_au8TxCount[eClass_] == BPEngenuics_au8TxSize[eClass_])
   {
-    memset(&hvx, 0, sizeof(hvx));
-    hvx.handle = BPEngenuics_eTxHandles.value_handle;
-    hvx.p_data = buffer;
-    hvx.p_len = (uint16_t*)&size;
-    hvx.type = BLE_GATT_HVX_NOTIFICATION;
-    
-    return (sd_ble_gatts_hvx(BPEngenuics_u16ConnHandle, &hvx) == NRF_SUCCESS);
+    G_sBPEngenuicsTxStats.au32Dropped[eClass_]++;
+    return false;
   }
-  else
+
+  u8Index = (BPEngenuics_au8TxTail[eClass_] + BPEngenuics_au8TxCount[eClass_]) & (BPEngenuics_au8TxSize[eClass_] - 1);
+  psEntry = &BPEngenuics_apsTxRing[eClass_][u8Index];
+  psEntry->u8Length = u8Length_;
+  memcpy(psEntry->au8Data, pu8Data_, u8Length_);
+  G_sBPEngenuicsTxStats.u32AppBytesCopied += u8Length_;
+
+  BPEngenuics_au8TxCount[eClass_]++;
+  G_sBPEngenuicsTxStats.u32Queued++;
+  BLEConnMgrActivity();
+  if (BPEngenuics_au8TxCount[eClass_] > G_sBPEngenuicsTxStats.au8HighWater[eClass_])
   {
+    G_sBPEngenuicsTxStats.au8HighWater[eClass_] = BPEngenuics_au8TxCount[eClass_];
+  }
+
+  BPEngenuicsTxPump();
+  return true;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsTxFree
+
+Description:
+Reports how many more notifications a class queue will take, so a stream can keep the queue full without being
+counted as dropped.
+
+Requires:
+   - eClass_ is a BPEngenuicsTxClassType
+   
+Promises:
+  - Returns the free entries in the class queue (0 for a bad class)
+*/
+u8 BPEngenuicsTxFree(BPEngenuicsTxClassType eClass_)
+{
+  if (eClass_ >= BPENGENUICS_TX_CLASSES)
+    return 0;
+
+  return (u8)(BPEngenuics_au8TxSize[eClass_] - BPEngenuics_au8TxCount[eClass_]);
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsStateWrite
+
+Description:
+Writes u8Length_ bytes at u8Offset_ of the state being composed.  The State Characteristic is double buffered: the
+application owns this back buffer and the stack owns the attribute value the client reads, so state can be built
+up over several calls and the client only ever sees what BPEngenuicsStateCommit() publishes.
+
+Requires:
+   - u8Offset_ + u8Length_ <= U8_BPENGENUICS_STATE_SIZE
+   
+Promises:
+  - Returns TRUE if the bytes were copied into the back buffer
+  - Returns FALSE if they do not fit
+*/
+bool BPEngenuicsStateWrite(u8 u8Offset_, const u8* pu8Data_, u8 u8Length_)
+{
+  if ((u8Offset_ + u8Length_) > U8_BPENGENUICS_STATE_SIZE)
     return false;
+
+  memcpy(&BPEngenuics_au8StateBack[u8Offset_], pu8Data_, u8Length_);
+  G_sBPEngenuicsTxStats.u32StateWrites++;
+  G_sBPEngenuicsTxStats.u32AppBytesCopied += u8Length_;
+
+  return true;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsStateCommit
+
+Description:
+Publishes the back buffer as the State Characteristic value.  The value is stack-owned (BLE_GATTS_VLOC_STACK) and
+sd_ble_gatts_value_set() replaces all of it in one SoftDevice call, so a client read or a notification sees either
+the old state or the new one, never a mix.  The notification is sent from the attribute value (p_data NULL) and does
+not go through the TX queues; if the stack has no free TX buffer, the latest state is notified once one frees up.
+
+Requires:
+   - None
+   
+Promises:
+  - Returns TRUE if the attribute value was updated (and, with bNotify_, a notification is sent or pending)
+  - Returns FALSE if the stack refused the value
+*/
+bool BPEngenuicsStateCommit(bool bNotify_)
+{
+  u16 u16Length = U8_BPENGENUICS_STATE_SIZE;
+  u32 u32Error;
+
+  u32Error = sd_ble_gatts_value_set(BPEngenuics_eStateHandles.value_handle, 0, &u16Length, BPEngenuics_au8StateBack);
+  if (u32Error != NRF_SUCCESS)
+    return false;
+
+  G_sBPEngenuicsTxStats.u32StateCommits++;
+  G_sBPEngenuicsTxStats.u32StackBytesCopied += U8_BPENGENUICS_STATE_SIZE;
+
+  if (bNotify_ && (bleperipheralGetConnHandle() != BLE_CONN_HANDLE_INVALID) && BPEngenuics_bStateNotifyEnabled)
+  {
+    BPEngenuics_bStateNotifyPending = true;
+    BLEConnMgrActivity();
+    BPEngenuicsTxPump();
   }
+
+  return true;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -88,17 +245,76 @@ bool BPEngenuicsInitialize(void)
   u32 error;
 
   // Initialize.
-  BPEngenuics_u16ConnHandle = BLE_CONN_HANDLE_INVALID;
   BPEngenuics_bNotifcationEnabled = false;
+  BPEngenuics_bStateNotifyEnabled = false;
+  BPEngenuicsTxFlush();
+  memset(&G_sBPEngenuicsTxStats, 0, sizeof(G_sBPEngenuicsTxStats));
 
   // Add the services and characteristics.
   error = BPEngenuicsAddService();
   error |= BPEngenuicsAddRxCharacteristic();
   error |= BPEngenuicsAddTxCharacteristic();
+  error |= BPEngenuicsAddStateCharacteristic();
+
+  // Connection events, TX buffer refills, and every attribute from the service declaration to the State CCCD.
+  if (!BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONNECTED, BPEngenuicsOnConnect) ||
+      !BLEIntegrationRegisterHandler(BLE_GAP_EVT_DISCONNECTED, BPEngenuicsOnDisconnect) ||
+      !BLEIntegrationRegisterHandler(BLE_EVT_TX_COMPLETE, BPEngenuicsOnTxComplete) ||
+      !BLEIntegrationRegisterService(BPEngenuics_u16ServiceHandle, BPEngenuics_eStateHandles.cccd_handle,
+                                     BPEngenuicsOnAttribute))
+  {
+    error |= NRF_ERROR_NO_MEM;
+  }
 
   return (error == NRF_SUCCESS);
 } /* end BPEngenuicsInitialize() */
 
+
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsRefreshCccds
+
+Description:
+Re-reads both CCCDs from the stack.  Called by the bond store after it restores a returning central's system
+attributes, which changes the CCCD values without a write event.
+
+Requires:
+   - Connected
+
+Promises:
+  - Notification flags match the CCCD values; a status change is published
+*/
+void BPEngenuicsRefreshCccds(void)
+{
+  u8 au8Cccd[2];
+  u16 u16Length = sizeof(au8Cccd);
+
+  if (sd_ble_gatts_value_get(BPEngenuics_eTxHandles.cccd_handle, 0, &u16Length, au8Cccd) == NRF_SUCCESS)
+  {
+    BPEngenuics_bNotifcationEnabled = ble_srv_is_notification_enabled(au8Cccd);
+    if (BPEngenuics_bNotifcationEnabled)
+    {
+      G_u32BPEngenuicsFlags |= _BPENGENUICS_SERVICE_ENABLED;
+    }
+    else
+    {
+      G_u32BPEngenuicsFlags &= ~_BPENGENUICS_SERVICE_ENABLED;
+    }
+
+    BPEngenuicsPublishStatus();
+  }
+
+  u16Length = sizeof(au8Cccd);
+  if (sd_ble_gatts_value_get(BPEngenuics_eStateHandles.cccd_handle, 0, &u16Length, au8Cccd) == NRF_SUCCESS)
+  {
+    BPEngenuics_bStateNotifyEnabled = ble_srv_is_notification_enabled(au8Cccd);
+  }
+} /* end BPEngenuicsRefreshCccds() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
 /*--------------------------------------------------------------------------------------------------------------------
 Function: BPEngenuicsOnConnect
 
@@ -111,12 +327,16 @@ Requires:
 
 Promises:
   - On connection sets _BPENGENUICS_CONNECTED to notify the module that it is in the connected state 
+  - Publishes the new state on EVENT_TOPIC_BLE_STATUS
+  - Returns TRUE
 */
-void BPEngenuicsOnConnect(ble_evt_t* peEvent_)
+static bool BPEngenuicsOnConnect(ble_evt_t* peEvent_)
 {
-  // Update the BPEngenuics_u16ConnHandle. Module knows that it is connected to a client.
-  BPEngenuics_u16ConnHandle = peEvent_->evt.gap_evt.conn_handle;
   G_u32BPEngenuicsFlags |= _BPENGENUICS_CONNECTED;
+  BPEngenuics_u8TxInFlight = 0;
+  (void)sd_ble_tx_buffer_count_get(&G_sBPEngenuicsTxStats.u8StackBuffers);
+  BPEngenuicsPublishStatus();
+  return TRUE;
 }
 
 
@@ -131,34 +351,48 @@ Requires:
 
 Promises:
   - Notifies the module that it is in the disconnected state.
+  - Publishes the new state on EVENT_TOPIC_BLE_STATUS
+  - Returns TRUE
 */
-void BPEngenuicsOnDisconnect(void)
+static bool BPEngenuicsOnDisconnect(ble_evt_t* peEvent_)
 {
-  // Invalidate the BPEngenuics_u16ConnHandle. Module knows that it is in a disconnected state
-  BPEngenuics_u16ConnHandle = BLE_CONN_HANDLE_INVALID;
-  G_u32BPEngenuicsFlags &= ~_BPENGENUICS_CONNECTED;
+  G_u32BPEngenuicsFlags &= ~(_BPENGENUICS_CONNECTED | _BPENGENUICS_SERVICE_ENABLED);
+  BPEngenuics_bNotifcationEnabled = false;
+  BPEngenuics_bStateNotifyEnabled = false;
+  BPEngenuics_bStateNotifyPending = false;
+  BPEngenuicsTxFlush();
+  BPEngenuicsPublishStatus();
+  return TRUE;
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------------
-Function: BPEngenuicsOnWrite
+Function: BPEngenuicsOnAttribute
 
 Description:
-Handles the Service enabling/disabling. Handles the Value Char writes from Client.
+Service handler for the BPEngenuics attribute handles.  Handles the Service enabling/disabling and the Value Char
+writes from Client.
 
 Requires:
    - Called after the module has been initialized.
-   - evt is the ble_evt_t* containing the appropriate GATTS Write information
+   - peEvent_ is a GATTS event for one of the service's attribute handles
    
 Promises:
   - Handles Enabling/Disabling on the BPEngenuics TX Value Characteristic.
   - Handles Rx Messages sent from the client on the RX Value Characteristic.
+  - Returns TRUE
 */
-void BPEngenuicsOnWrite(ble_evt_t* peEvent_)
+static bool BPEngenuicsOnAttribute(ble_evt_t* peEvent_)
 {
    // Create our ble_gatts_evt_write_t object.
     ble_gatts_evt_write_t* peEventWrite = &peEvent_->evt.gatts_evt.params.write;
     
+    // Only writes are used; notifications need no confirmation and nothing asks for authorization.
+    if (peEvent_->header.evt_id != BLE_GATTS_EVT_WRITE)
+    {
+      return TRUE;
+    }
+    
     // Check if it is the TX Handle CCCD write event and len is 2.
     if ((peEventWrite->handle == BPEngenuics_eTxHandles.cccd_handle) && (peEventWrite->len == 2))
     {
@@ -172,18 +406,31 @@ void BPEngenuicsOnWrite(ble_evt_t* peEvent_)
       {
         BPEngenuics_bNotifcationEnabled = false;
         G_u32BPEngenuicsFlags &= ~_BPENGENUICS_SERVICE_ENABLED;
+        BPEngenuicsTxFlush();
       }
+      
+      BPEngenuicsPublishStatus();
+    }
+    else if ((peEventWrite->handle == BPEngenuics_eStateHandles.cccd_handle) && (peEventWrite->len == 2))
+    {
+      BPEngenuics_bStateNotifyEnabled = ble_srv_is_notification_enabled(peEventWrite->data);
+      BPEngenuics_bStateNotifyPending = false;
     }
     else if (peEventWrite->handle == BPEngenuics_eRxHandles.value_handle)    
     {
-      CallbackBleperipheralEngenuicsDataRx(peEventWrite->data, peEventWrite->len);
+      BLEConnMgrActivity();
+
+      // Bulk and framed packets are unpacked here; anything else is passed on as it is.
+      if (!BPBulkRx(peEventWrite->data, peEventWrite->len) &&
+          !BPFrameRx(peEventWrite->data, peEventWrite->len))
+      {
+        CallbackBleperipheralEngenuicsDataRx(peEventWrite->data, peEventWrite->len);
+      }
     }    
-}
 
+    return TRUE;
+}
 
-/*--------------------------------------------------------------------------------------------------------------------*/
-/* Private functions                                                                                                  */
-/*--------------------------------------------------------------------------------------------------------------------*/
 
 /*--------------------------------------------------------------------------------------------------------------------
 Function: BPEngenuicsAddService
@@ -249,7 +496,6 @@ static u32 BPEngenuicsAddRxCharacteristic(void)
     memset(&attr_md, 0, sizeof(attr_md));
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.write_perm);
-    attr_md.vloc = BLE_GATTS_VLOC_STACK;
     attr_md.vlen = 1;
 
     // Setup of the Rx Attribute.
@@ -258,6 +504,12 @@ static u32 BPEngenuicsAddRxCharacteristic(void)
     attr_char_value.p_attr_md = &attr_md;
     attr_char_value.init_len  = BPENGENUICS_MAX_CHAR_LEN;
     attr_char_value.max_len   = BPENGENUICS_MAX_CHAR_LEN;
+#ifdef BPENGENUICS_VLOC_USER
+    attr_md.vloc = BLE_GATTS_VLOC_USER;
+    attr_char_value.p_value   = BPEngenuics_au8RxValue;
+#else
+    attr_md.vloc = BLE_GATTS_VLOC_STACK;
+#endif /* BPENGENUICS_VLOC_USER */
 
     return sd_ble_gatts_characteristic_add(BPEngenuics_u16ServiceHandle, &rxchar_metadata, &attr_char_value, &BPEngenuics_eRxHandles);
 }
@@ -303,7 +555,6 @@ static u32 BPEngenuicsAddTxCharacteristic(void)
     memset(&attr_md, 0, sizeof(attr_md));
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.write_perm);
-    attr_md.vloc = BLE_GATTS_VLOC_STACK;
     attr_md.vlen = 1;
 
     // Setup of the Tx Attribute.
@@ -312,11 +563,71 @@ static u32 BPEngenuicsAddTxCharacteristic(void)
     attr_char_value.p_attr_md = &attr_md;
     attr_char_value.init_len  = BPENGENUICS_MAX_CHAR_LEN;
     attr_char_value.max_len   = BPENGENUICS_MAX_CHAR_LEN;
+#ifdef BPENGENUICS_VLOC_USER
+    attr_md.vloc = BLE_GATTS_VLOC_USER;
+    attr_char_value.p_value   = BPEngenuics_au8TxValue;
+#else
+    attr_md.vloc = BLE_GATTS_VLOC_STACK;
+#endif /* BPENGENUICS_VLOC_USER */
 
     return sd_ble_gatts_characteristic_add(BPEngenuics_u16ServiceHandle, &txchar_metadata, &attr_char_value, &BPEngenuics_eTxHandles);
 }
 
 
+/*--------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsAddStateCharacteristic
+
+Description:
+Adds the State Characteristic to the BLE Service.  The client can read it at any time or be notified when the
+application writes a new state.
+
+Requires:
+   - Called during module initialization, after the Tx Characteristic.
+   
+Promises:
+  - Adds the BPEngenuics State Characteristic (read, notify; U8_BPENGENUICS_STATE_SIZE bytes, zeros until written).
+*/
+static u32 BPEngenuicsAddStateCharacteristic(void)
+{
+    ble_gatts_char_md_t statechar_metadata;
+    ble_gatts_attr_md_t cccd_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    // ClientConfigurationDescriptor Metadata.
+    memset(&cccd_md, 0, sizeof(cccd_md));
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    // Metadata for the State Characteristic.
+    memset(&statechar_metadata, 0, sizeof(statechar_metadata));
+    statechar_metadata.char_props.read = 1;
+    statechar_metadata.char_props.notify = 1;
+    statechar_metadata.p_cccd_md = &cccd_md;
+
+    // Load the STATE CHAR UUID.
+    ble_uuid.type = BPEngenuics_u8UuidType;
+    ble_uuid.uuid = BPENGENUICS_STATE_CHAR_UUID;
+
+    // Metadata for the State Attribute: read only for the client.
+    memset(&attr_md, 0, sizeof(attr_md));
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+
+    // Setup of the State Attribute: fixed length and stack-owned, so a commit replaces the whole value at once.
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = U8_BPENGENUICS_STATE_SIZE;
+    attr_char_value.max_len   = U8_BPENGENUICS_STATE_SIZE;
+    attr_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    return sd_ble_gatts_characteristic_add(BPEngenuics_u16ServiceHandle, &statechar_metadata, &attr_char_value, &BPEngenuics_eStateHandles);
+}
+
+
 /*----------------------------------------------------------------------------------------------------------------------
 Function: CallbackBleperipheralEngenuicsDataRx
 
@@ -328,12 +639,181 @@ Requires:
   - len: Length of array
 
 Promises:
-  - Application handling of the message.
+  - The message is published on EVENT_TOPIC_BLE_RX for any interested application.
 */
 static void CallbackBleperipheralEngenuicsDataRx(u8* u8Data_, u8 u8Length_)
 {
-  // Forward handling to ANTTT module.
-  //AntttHandleIncomingMessage(u8Data_, u8Length_);
+  EventBusPublish(EVENT_TOPIC_BLE_RX, u8Data_, u8Length_);
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsPublishStatus
+
+Description:
+Tells subscribers about a change in G_u32BPEngenuicsFlags so they do not need to poll it.
+
+Requires:
+  - G_u32BPEngenuicsFlags is up to date
+
+Promises:
+  - The flags are published as a u32 on EVENT_TOPIC_BLE_STATUS
+*/
+static void BPEngenuicsPublishStatus(void)
+{
+  u32 u32Status = G_u32BPEngenuicsFlags;
+  
+  EventBusPublish(EVENT_TOPIC_BLE_STATUS, (u8*)&u32Status, sizeof(u32Status));
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsTxPump
+
+Description:
+Hands a pending state notification and then the queued notifications to the stack, highest priority class first,
+until the queues are empty or the stack has no free TX buffers.
+
+Requires:
+  - None
+
+Promises:
+  - Each notification the stack accepts is removed from its queue and counted in flight.
+  - A notification refused for any reason other than full buffers is discarded so it cannot block the queue.
+*/
+static void BPEngenuicsTxPump(void)
+{
+  ble_gatts_hvx_params_t hvx;   // Indication / Notification structure.
+  BPEngenuicsTxEntryType* psEntry;
+  u16 u16Length;
+  u32 u32Error;
+
+  if (bleperipheralGetConnHandle() == BLE_CONN_HANDLE_INVALID)
+    return;
+
+  // The latest committed state goes first, straight from the attribute value (p_data NULL: nothing is copied in).
+  if (BPEngenuics_bStateNotifyPending)
+  {
+    u16Length = U8_BPENGENUICS_STATE_SIZE;
+
+    memset(&hvx, 0, sizeof(hvx));
+    hvx.handle = BPEngenuics_eStateHandles.value_handle;
+    hvx.p_data = NULL;
+    hvx.p_len = &u16Length;
+    hvx.type = BLE_GATT_HVX_NOTIFICATION;
+
+    u32Error = sd_ble_gatts_hvx(bleperipheralGetConnHandle(), &hvx);
+    if (u32Error == BLE_ERROR_NO_TX_BUFFERS)
+    {
+      G_sBPEngenuicsTxStats.u32StackFull++;
+      return;
+    }
+
+    BPEngenuics_bStateNotifyPending = false;
+    if (u32Error == NRF_SUCCESS)
+    {
+      G_sBPEngenuicsTxStats.u32StateNotified++;
+      BPEngenuics_u8TxInFlight++;
+      if (BPEngenuics_u8TxInFlight > G_sBPEngenuicsTxStats.u8MaxInFlight)
+      {
+        G_sBPEngenuicsTxStats.u8MaxInFlight = BPEngenuics_u8TxInFlight;
+      }
+    }
+  }
+
+  if (!BPEngenuics_bNotifcationEnabled)
+    return;
+
+  for (u8 i = 0; i < BPENGENUICS_TX_CLASSES; i++)
+  {
+    while (BPEngenuics_au8TxCount[i] != 0)
+    {
+      psEntry = &BPEngenuics_apsTxRing[i][BPEngenuics_au8TxTail[i]];
+      u16Length = psEntry->u8Length;
+
+      memset(&hvx, 0, sizeof(hvx));
+      hvx.handle = BPEngenuics_eTxHandles.value_handle;
+      hvx.p_data = psEntry->au8Data;
+      hvx.p_len = &u16Length;
+      hvx.type = BLE_GATT_HVX_NOTIFICATION;
+
+      u32Error = sd_ble_gatts_hvx(bleperipheralGetConnHandle(), &hvx);
+      if (u32Error == BLE_ERROR_NO_TX_BUFFERS)
+      {
+        // Retried on the next BLE_EVT_TX_COMPLETE.
+        G_sBPEngenuicsTxStats.u32StackFull++;
+        return;
+      }
+
+      if (u32Error == NRF_SUCCESS)
+      {
+        G_sBPEngenuicsTxStats.u32Sent++;
+        G_sBPEngenuicsTxStats.u32StackBytesCopied += psEntry->u8Length;
+        BPEngenuics_u8TxInFlight++;
+        if (BPEngenuics_u8TxInFlight > G_sBPEngenuicsTxStats.u8MaxInFlight)
+        {
+          G_sBPEngenuicsTxStats.u8MaxInFlight = BPEngenuics_u8TxInFlight;
+        }
+      }
+      else
+      {
+        G_sBPEngenuicsTxStats.u32Flushed++;
+      }
+
+      BPEngenuics_au8TxTail[i] = (BPEngenuics_au8TxTail[i] + 1) & (BPEngenuics_au8TxSize[i] - 1);
+      BPEngenuics_au8TxCount[i]--;
+    }
+  }
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsTxFlush
+
+Description:
+Empties every TX queue; used when notifications can no longer be delivered.
+
+Requires:
+  - None
+
+Promises:
+  - All queues are empty; discarded entries are counted in G_sBPEngenuicsTxStats.u32Flushed
+*/
+static void BPEngenuicsTxFlush(void)
+{
+  for (u8 i = 0; i < BPENGENUICS_TX_CLASSES; i++)
+  {
+    G_sBPEngenuicsTxStats.u32Flushed += BPEngenuics_au8TxCount[i];
+    BPEngenuics_au8TxTail[i] = 0;
+    BPEngenuics_au8TxCount[i] = 0;
+  }
+
+  BPEngenuics_u8TxInFlight = 0;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BPEngenuicsOnTxComplete
+
+Description:
+BLE_EVT_TX_COMPLETE handler.  The stack has sent packets and freed their buffers, so refill them.
+
+Requires:
+  - peEvent_ is the current event from the BLE event pump
+
+Promises:
+  - In-flight count reduced by the packets sent and the queues pumped
+  - Returns TRUE
+*/
+static bool BPEngenuicsOnTxComplete(ble_evt_t* peEvent_)
+{
+  u8 u8Count = peEvent_->evt.common_evt.params.tx_complete.count;
+
+  G_sBPEngenuicsTxStats.u32Completed += u8Count;
+  BPEngenuics_u8TxInFlight = (u8Count < BPEngenuics_u8TxInFlight) ? (BPEngenuics_u8TxInFlight - u8Count) : 0;
+
+  BPEngenuicsTxPump();
+  return true;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -10,11 +10,6 @@ Header file for bleperipheral_engenuics.c source.
 
 #include "typedefs.h"
 
-/**********************************************************************************************************************
-Type Definitions
-**********************************************************************************************************************/
-
-
 /**********************************************************************************************************************
 Constants / Definitions
 **********************************************************************************************************************/
@@ -23,6 +18,11 @@ Constants / Definitions
 #define BPENGENUICS_SERVICE_UUID       0xEEEE
 #define BPENGENUICS_TX_CHAR_UUID       0x0001
 #define BPENGENUICS_RX_CHAR_UUID       0x0002
+#define BPENGENUICS_STATE_CHAR_UUID    0x0003     /* Readable/notifiable snapshot of application state */
+#define U8_BPENGENUICS_STATE_SIZE      (u8)8      /* State Characteristic value; laid out by its producer */
+
+#define U8_BPENGENUICS_TX_CONTROL_SIZE (u8)4      /* Control queue entries; must be a power of 2 */
+#define U8_BPENGENUICS_TX_BULK_SIZE    (u8)4      /* Bulk queue entries; must be a power of 2 */
 
 /* G_u32BPEngenuicsFlags */
 #define _BPENGENUICS_CONNECTED         (u32)0x00000001
@@ -73,6 +73,52 @@ Constants / Definitions
 */
 
 
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum BPEngenuicsTxClassType
+@brief Notification priority classes.  Lower values are always sent first. */
+typedef enum
+{
+  BPENGENUICS_TX_CONTROL = 0,             /*!< @brief Short latency-sensitive messages such as game ACK/NACKs */
+  BPENGENUICS_TX_BULK,                    /*!< @brief Streams that can wait for free stack buffers */
+  BPENGENUICS_TX_CLASSES                  /*!< @brief Number of classes; must stay last */
+} BPEngenuicsTxClassType;
+
+/*!
+@struct BPEngenuicsTxEntryType
+@brief One queued notification.
+*/
+typedef struct
+{
+  u8 u8Length;                            /*!< @brief Bytes in au8Data */
+  u8 au8Data[BPENGENUICS_MAX_CHAR_LEN];   /*!< @brief Notification payload */
+} BPEngenuicsTxEntryType;
+
+/*!
+@struct BPEngenuicsTxStatsType
+@brief Notification queue statistics.
+*/
+typedef struct
+{
+  u32 u32Queued;                          /*!< @brief Notifications accepted into a queue */
+  u32 u32Sent;                            /*!< @brief Notifications accepted by the stack */
+  u32 u32Completed;                       /*!< @brief Packets reported sent by BLE_EVT_TX_COMPLETE */
+  u32 au32Dropped[BPENGENUICS_TX_CLASSES];   /*!< @brief Refused because the class queue was full */
+  u32 u32Flushed;                         /*!< @brief Discarded on disconnect, CCCD disable or a stack error */
+  u32 u32StackFull;                       /*!< @brief Pump stopped because the stack had no free TX buffers */
+  u8  au8HighWater[BPENGENUICS_TX_CLASSES];  /*!< @brief Deepest each class queue has been */
+  u8  u8MaxInFlight;                      /*!< @brief Most notifications held by the stack at once */
+  u8  u8StackBuffers;                     /*!< @brief TX buffers the stack reported at connection */
+  u32 u32StateWrites;                     /*!< @brief BPEngenuicsStateWrite() calls accepted */
+  u32 u32StateCommits;                    /*!< @brief BPEngenuicsStateCommit() calls accepted */
+  u32 u32StateNotified;                   /*!< @brief State notifications accepted by the stack */
+  u32 u32AppBytesCopied;                  /*!< @brief Payload bytes this module copied (TX queue, state back buffer) */
+  u32 u32StackBytesCopied;                /*!< @brief Payload bytes handed to the stack to copy (hvx data, value_set) */
+} BPEngenuicsTxStatsType;
+
+
 /**********************************************************************************************************************
 Function Declarations
 **********************************************************************************************************************/
@@ -81,14 +127,16 @@ Function Declarations
 /* Public functions                                                                                                   */
 /*--------------------------------------------------------------------------------------------------------------------*/
 bool BPEngenuicsSendData(u8* buffer, u8 size);
+bool BPEngenuicsQueueData(BPEngenuicsTxClassType eClass_, u8* pu8Data_, u8 u8Length_);
+u8 BPEngenuicsTxFree(BPEngenuicsTxClassType eClass_);
+bool BPEngenuicsStateWrite(u8 u8Offset_, const u8* pu8Data_, u8 u8Length_);
+bool BPEngenuicsStateCommit(bool bNotify_);
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected functions                                                                                                */
 /*--------------------------------------------------------------------------------------------------------------------*/
 bool BPEngenuicsInitialize(void);
-void BPEngenuicsOnConnect(ble_evt_t* evt);
-void BPEngenuicsOnDisconnect(void);
-void BPEngenuicsOnWrite(ble_evt_t* evt);
+void BPEngenuicsRefreshCccds(void);
 void callback_bleperipheral_engenuics_data_rx(u8* data, u8 len);
 
 
@@ -98,8 +146,17 @@ void callback_bleperipheral_engenuics_data_rx(u8* data, u8 len);
 static u32 BPEngenuicsAddService(void);
 static u32 BPEngenuicsAddTxCharacteristic(void);
 static u32 BPEngenuicsAddRxCharacteristic(void);
+static u32 BPEngenuicsAddStateCharacteristic(void);
 
 static void CallbackBleperipheralEngenuicsDataRx(u8* u8Data_, u8 u8Length_);
+static void BPEngenuicsPublishStatus(void);
+
+static void BPEngenuicsTxPump(void);
+static void BPEngenuicsTxFlush(void);
+static bool BPEngenuicsOnTxComplete(ble_evt_t* peEvent_);
+static bool BPEngenuicsOnConnect(ble_evt_t* peEvent_);
+static bool BPEngenuicsOnDisconnect(ble_evt_t* peEvent_);
+static bool BPEngenuicsOnAttribute(ble_evt_t* peEvent_);
 
 
 #endif /* __BLEPERIPHERALENGENUICS_H */
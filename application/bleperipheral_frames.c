@@ -0,0 +1,372 @@
+/**********************************************************************************************************************
+File: bleperipheral_frames.c
+
+Description:
+Message framing on the BPEngenuics RX/TX characteristics.
+
+A raw write or notification carries one message of at most 20 bytes.  Framing packs several typed messages into
+each packet and splits messages longer than a packet across several:
+
+  byte 0         U8_BPFRAME_MARKER | 4-bit packet sequence number
+  byte 1..       records: [type][control][data]
+                 control = data length | _U8_BPFRAME_CONTINUES | _U8_BPFRAME_MORE
+
+Messages are packed into the packet being built; it is sent when it fills, when a caller asks for urgent delivery,
+or when the coalescing delay runs out, so messages produced in the same few milliseconds share one notification.
+Packets go to the CONTROL TX queue so framed traffic keeps its order.
+
+Received packets start with the marker nibble, which no raw POV text does, so framed and raw writes can share the
+RX characteristic: BPFrameRx() returns FALSE for anything that is not framed.  A gap in the sequence numbers
+discards any message being reassembled.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BPFrameStatsType G_sBPFrameStats;                      /* Framing statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BPFrame_" and be declared as static.
+***********************************************************************************************************************/
+static BPFrameHandlerType BPFrame_apfnHandlers[BPFRAME_TYPES];   /* Receive handler per message type */
+
+static u8 BPFrame_au8TxPacket[BPENGENUICS_MAX_CHAR_LEN];         /* Packet being built */
+static u8 BPFrame_u8TxFill;                                      /* Bytes used in BPFrame_au8TxPacket; 0 = empty */
+static u8 BPFrame_u8TxSequence;                                  /* Sequence number of the packet being built */
+static SwTimerType BPFrame_sCoalesceTimer;                       /* Runs while a part-filled packet waits */
+
+static u8 BPFrame_au8RxMessage[U8_BPFRAME_MAX_MESSAGE + 1];      /* Reassembly buffer (+1 for the terminating 0) */
+static u8 BPFrame_u8RxLength;                                    /* Bytes reassembled so far */
+static u8 BPFrame_u8RxType;                                      /* Type of the message being reassembled */
+static bool BPFrame_bRxPartial;                                  /* A message is waiting for more records */
+static u8 BPFrame_u8RxSequence;                                  /* Sequence number of the last packet received */
+static bool BPFrame_bRxSynced;                                   /* BPFrame_u8RxSequence is valid */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPFrameSend(BPFrameTypeType eType_, u8* pu8Data_, u8 u8Length_, bool bUrgent_)
+@brief Adds a message to the outgoing packet stream.
+
+Requires:
+- Called from the main loop
+@param pu8Data_ holds u8Length_ bytes, u8Length_ <= U8_BPFRAME_MAX_MESSAGE
+@param bUrgent_ TRUE sends the packet now instead of waiting up to U32_BPFRAME_COALESCE_MS for more messages
+
+Promises:
+- Returns TRUE if the message was framed; whole packets are handed to the TX queue as they fill
+- Returns FALSE if the message is too long or the type is unknown
+
+*/
+bool BPFrameSend(BPFrameTypeType eType_, u8* pu8Data_, u8 u8Length_, bool bUrgent_)
+{
+  u8 u8Control = 0;
+  u8 u8Chunk;
+  u8 u8Space;
+
+  if( (eType_ >= BPFRAME_TYPES) || (u8Length_ > U8_BPFRAME_MAX_MESSAGE) )
+  {
+    return FALSE;
+  }
+
+  while(1)
+  {
+    if(BPFrame_u8TxFill == 0)
+    {
+      BPFrame_au8TxPacket[0] = U8_BPFRAME_MARKER | BPFrame_u8TxSequence;
+      BPFrame_u8TxFill = U8_BPFRAME_PACKET_HEADER;
+    }
+
+    /* Start a new packet rather than write a record with no data in it */
+    u8Space = BPENGENUICS_MAX_CHAR_LEN - BPFrame_u8TxFill;
+    if( (u8Space < U8_BPFRAME_RECORD_HEADER) ||
+        ((u8Space == U8_BPFRAME_RECORD_HEADER) && (u8Length_ != 0)) )
+    {
+      BPFrameFlush();
+      continue;
+    }
+
+    u8Space -= U8_BPFRAME_RECORD_HEADER;
+    u8Chunk = (u8Length_ < u8Space) ? u8Length_ : u8Space;
+    u8Length_ -= u8Chunk;
+    if(u8Length_ != 0)
+    {
+      u8Control |= _U8_BPFRAME_MORE;
+    }
+
+    BPFrame_au8TxPacket[BPFrame_u8TxFill++] = (u8)eType_;
+    BPFrame_au8TxPacket[BPFrame_u8TxFill++] = u8Control | u8Chunk;
+    memcpy(&BPFrame_au8TxPacket[BPFrame_u8TxFill], pu8Data_, u8Chunk);
+    BPFrame_u8TxFill += u8Chunk;
+    pu8Data_ += u8Chunk;
+    G_sBPFrameStats.u32RecordsTx++;
+
+    if(u8Length_ == 0)
+    {
+      break;
+    }
+
+    BPFrameFlush();
+    u8Control = _U8_BPFRAME_CONTINUES;
+  }
+
+  G_sBPFrameStats.u32MessagesTx++;
+
+  if(bUrgent_)
+  {
+    BPFrameFlush();
+  }
+  else if(!SwTimerIsRunning(&BPFrame_sCoalesceTimer))
+  {
+    SwTimerStart(&BPFrame_sCoalesceTimer, U32_BPFRAME_COALESCE_MS);
+  }
+
+  return TRUE;
+
+} /* end BPFrameSend() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BPFrameFlush(void)
+@brief Sends the packet being built, if it holds anything.
+
+Promises:
+- The packet is handed to the CONTROL TX queue (or counted as dropped) and a new one will be started
+- The sequence number advances either way so the receiver can see a dropped packet
+
+*/
+void BPFrameFlush(void)
+{
+  SwTimerStop(&BPFrame_sCoalesceTimer);
+
+  if(BPFrame_u8TxFill <= U8_BPFRAME_PACKET_HEADER)
+  {
+    return;
+  }
+
+  if(BPEngenuicsQueueData(BPENGENUICS_TX_CONTROL, BPFrame_au8TxPacket, BPFrame_u8TxFill))
+  {
+    G_sBPFrameStats.u32PacketsTx++;
+  }
+  else
+  {
+    G_sBPFrameStats.u32PacketsDropped++;
+  }
+
+  BPFrame_u8TxFill = 0;
+  BPFrame_u8TxSequence = (BPFrame_u8TxSequence + 1) & U8_BPFRAME_SEQUENCE_MASK;
+
+} /* end BPFrameFlush() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPFrameRegisterHandler(BPFrameTypeType eType_, BPFrameHandlerType pfHandler_)
+@brief Sets the receiver for one message type.
+
+Promises:
+- Returns TRUE and pfHandler_ gets every complete eType_ message
+- Returns FALSE if eType_ is not valid
+
+*/
+bool BPFrameRegisterHandler(BPFrameTypeType eType_, BPFrameHandlerType pfHandler_)
+{
+  if(eType_ >= BPFRAME_TYPES)
+  {
+    return FALSE;
+  }
+
+  BPFrame_apfnHandlers[eType_] = pfHandler_;
+  return TRUE;
+
+} /* end BPFrameRegisterHandler() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BPFrameInitialize(void)
+@brief Empties the TX packet and reassembly state.
+
+Requires:
+- SwTimerInitialize() has run
+- Called before modules register handlers; handlers registered earlier are kept
+
+Promises:
+- No packet is waiting to be sent
+
+*/
+void BPFrameInitialize(void)
+{
+  memset(&G_sBPFrameStats, 0, sizeof(G_sBPFrameStats));
+  SwTimerCreate(&BPFrame_sCoalesceTimer, SWTIMER_ONE_SHOT, BPFrameTimerCallback, NULL);
+
+  BPFrame_u8TxFill = 0;
+  BPFrame_u8TxSequence = 0;
+  BPFrame_u8RxLength = 0;
+  BPFrame_bRxPartial = FALSE;
+  BPFrame_bRxSynced = FALSE;
+
+} /* end BPFrameInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPFrameRx(u8* pu8Packet_, u16 u16Length_)
+@brief Unpacks a write to the RX characteristic.
+
+Requires:
+- Called from the GATTS write handler
+
+Promises:
+- Returns FALSE (and does nothing) if the write is not a framed packet
+- Returns TRUE after delivering every message the packet completes to its registered handler
+
+*/
+bool BPFrameRx(u8* pu8Packet_, u16 u16Length_)
+{
+  u8 u8Sequence;
+  u16 u16Index = U8_BPFRAME_PACKET_HEADER;
+  u8 u8DataLength;
+
+  if( (u16Length_ < U8_BPFRAME_PACKET_HEADER) ||
+      ((pu8Packet_[0] & U8_BPFRAME_MARKER_MASK) != U8_BPFRAME_MARKER) )
+  {
+    return FALSE;
+  }
+
+  G_sBPFrameStats.u32PacketsRx++;
+
+  /* A lost packet may have held the middle of a message */
+  u8Sequence = pu8Packet_[0] & U8_BPFRAME_SEQUENCE_MASK;
+  if( BPFrame_bRxSynced && (u8Sequence != ((BPFrame_u8RxSequence + 1) & U8_BPFRAME_SEQUENCE_MASK)) )
+  {
+    G_sBPFrameStats.u32SequenceGaps++;
+    if(BPFrame_bRxPartial)
+    {
+      BPFrame_bRxPartial = FALSE;
+      G_sBPFrameStats.u32RxDiscarded++;
+    }
+  }
+
+  BPFrame_u8RxSequence = u8Sequence;
+  BPFrame_bRxSynced = TRUE;
+
+  while( (u16Index + U8_BPFRAME_RECORD_HEADER) <= u16Length_ )
+  {
+    u8DataLength = pu8Packet_[u16Index + 1] & U8_BPFRAME_LENGTH_MASK;
+    if( (u16Index + U8_BPFRAME_RECORD_HEADER + u8DataLength) > u16Length_ )
+    {
+      BPFrame_bRxPartial = FALSE;
+      G_sBPFrameStats.u32RxDiscarded++;
+      break;
+    }
+
+    BPFrameRxRecord(pu8Packet_[u16Index], pu8Packet_[u16Index + 1], &pu8Packet_[u16Index + U8_BPFRAME_RECORD_HEADER]);
+    u16Index += U8_BPFRAME_RECORD_HEADER + u8DataLength;
+  }
+
+  return TRUE;
+
+} /* end BPFrameRx() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPFrameTimerCallback(void* pvContext_)
+@brief The coalescing delay is over: send what has been packed.
+*/
+static void BPFrameTimerCallback(void* pvContext_)
+{
+  BPFrameFlush();
+
+} /* end BPFrameTimerCallback() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPFrameRxRecord(u8 u8Type_, u8 u8Control_, u8* pu8Data_)
+@brief Adds one record to the reassembly buffer and delivers the message once complete.
+*/
+static void BPFrameRxRecord(u8 u8Type_, u8 u8Control_, u8* pu8Data_)
+{
+  u8 u8DataLength = u8Control_ & U8_BPFRAME_LENGTH_MASK;
+
+  if(u8Control_ & _U8_BPFRAME_CONTINUES)
+  {
+    /* A continuation with nothing to continue lost its start */
+    if( !BPFrame_bRxPartial || (u8Type_ != BPFrame_u8RxType) )
+    {
+      BPFrame_bRxPartial = FALSE;
+      G_sBPFrameStats.u32RxDiscarded++;
+      return;
+    }
+  }
+  else
+  {
+    if(BPFrame_bRxPartial)
+    {
+      G_sBPFrameStats.u32RxDiscarded++;
+    }
+
+    BPFrame_u8RxType = u8Type_;
+    BPFrame_u8RxLength = 0;
+  }
+
+  if( (BPFrame_u8RxLength + u8DataLength) > U8_BPFRAME_MAX_MESSAGE )
+  {
+    BPFrame_bRxPartial = FALSE;
+    G_sBPFrameStats.u32RxDiscarded++;
+    return;
+  }
+
+  memcpy(&BPFrame_au8RxMessage[BPFrame_u8RxLength], pu8Data_, u8DataLength);
+  BPFrame_u8RxLength += u8DataLength;
+
+  BPFrame_bRxPartial = ((u8Control_ & _U8_BPFRAME_MORE) != 0);
+  if(BPFrame_bRxPartial)
+  {
+    return;
+  }
+
+  BPFrame_au8RxMessage[BPFrame_u8RxLength] = 0;
+  if( (u8Type_ < BPFRAME_TYPES) && (BPFrame_apfnHandlers[u8Type_] != NULL) )
+  {
+    BPFrame_apfnHandlers[u8Type_](BPFrame_au8RxMessage, BPFrame_u8RxLength);
+    G_sBPFrameStats.u32MessagesRx++;
+  }
+  else
+  {
+    G_sBPFrameStats.u32RxDiscarded++;
+  }
+
+} /* end BPFrameRxRecord() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
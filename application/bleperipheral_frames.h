@@ -0,0 +1,98 @@
+/**********************************************************************************************************************
+File: bleperipheral_frames.h
+
+Description:
+Header file for bleperipheral_frames.c
+**********************************************************************************************************************/
+
+#ifndef __BLEPERIPHERALFRAMES_H
+#define __BLEPERIPHERALFRAMES_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Packet: [U8_BPFRAME_MARKER | sequence] then records of [type][control][data...] */
+#define U8_BPFRAME_MARKER              (u8)0xF0   /* High nibble of byte 0; never the first byte of a raw command */
+#define U8_BPFRAME_MARKER_MASK         (u8)0xF0
+#define U8_BPFRAME_SEQUENCE_MASK       (u8)0x0F
+#define U8_BPFRAME_PACKET_HEADER       (u8)1
+#define U8_BPFRAME_RECORD_HEADER       (u8)2
+
+/* Record control byte */
+#define U8_BPFRAME_LENGTH_MASK         (u8)0x1F   /* Data bytes in this record */
+#define _U8_BPFRAME_CONTINUES          (u8)0x40   /* Record continues the message of the previous record */
+#define _U8_BPFRAME_MORE               (u8)0x80   /* Message continues in the next record */
+
+#define U8_BPFRAME_MAX_MESSAGE         (u8)40     /* Largest message after reassembly; a setting is up to 33 */
+#define U32_BPFRAME_COALESCE_MS        (u32)5     /* Wait for more messages before a part-filled packet goes */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum BPFrameTypeType
+@brief Message types carried in framed packets. */
+typedef enum
+{
+  BPFRAME_TYPE_POV = 0,                   /*!< @brief POV text */
+  BPFRAME_TYPE_SETTING,                   /*!< @brief Stored setting: [KVStoreKeyType][value] */
+  BPFRAME_TYPE_LOG,                       /*!< @brief Event log access: [RACP opcode][operator][operands] */
+  BPFRAME_TYPE_SCAN,                      /*!< @brief ANT device table access: [U8_BPSCAN_OP_xxx] */
+  BPFRAME_TYPES                           /*!< @brief Number of types; must stay last */
+} BPFrameTypeType;
+
+/* Receives one reassembled message; pu8Data_[u8Length_] is always 0 so text can be used in place */
+typedef void(*BPFrameHandlerType)(u8* pu8Data_, u8 u8Length_);
+
+/*!
+@struct BPFrameStatsType
+@brief Framing statistics.  Records / packets is the packing ratio.
+*/
+typedef struct
+{
+  u32 u32MessagesTx;                      /*!< @brief Messages sent */
+  u32 u32RecordsTx;                       /*!< @brief Records written (one per message per packet it touches) */
+  u32 u32PacketsTx;                       /*!< @brief Packets handed to the TX queue */
+  u32 u32PacketsDropped;                  /*!< @brief Packets the TX queue refused (receiver sees a sequence gap) */
+  u32 u32MessagesRx;                      /*!< @brief Complete messages delivered */
+  u32 u32PacketsRx;                       /*!< @brief Framed packets received */
+  u32 u32SequenceGaps;                    /*!< @brief Received packets that did not follow the previous one */
+  u32 u32RxDiscarded;                     /*!< @brief Malformed, orphaned, oversized or unhandled messages */
+} BPFrameStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BPFrameSend(BPFrameTypeType eType_, u8* pu8Data_, u8 u8Length_, bool bUrgent_);
+void BPFrameFlush(void);
+bool BPFrameRegisterHandler(BPFrameTypeType eType_, BPFrameHandlerType pfHandler_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void BPFrameInitialize(void);
+bool BPFrameRx(u8* pu8Packet_, u16 u16Length_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BPFrameTimerCallback(void* pvContext_);
+static void BPFrameRxRecord(u8 u8Type_, u8 u8Control_, u8* pu8Data_);
+
+
+#endif /* __BLEPERIPHERALFRAMES_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,468 @@
+/**********************************************************************************************************************
+File: bleperipheral_log.c
+
+Description:
+Event log retrieval over BLE, modelled on the Record Access Control Point (ble_racp.h).
+
+Requests and responses are BPFRAME_TYPE_LOG messages using the RACP opcodes, operators and response codes, with
+record indexes (see event_log.c) as the filter operands:
+
+  request    [opcode][operator][u32 index][u32 index]    operands as the operator needs (little endian)
+  number     [RACP_OPCODE_NUM_RECS_RESPONSE][RACP_OPERATOR_NULL][u32 count]
+  response   [RACP_OPCODE_RESPONSE_CODE][RACP_OPERATOR_NULL][request opcode][RACP_RESPONSE_xxx]
+
+Report, delete (all records only) and report-number accept the operators ALL, <=, >=, RANGE (inclusive), FIRST
+and LAST; abort stops a report in progress.
+
+Reported records are streamed as raw notifications on the BULK TX class, U8_BPLOG_RECORDS_PER_PACKET records per
+packet behind a 4-byte header (U8_BPLOG_MARKER | count, then the u24 index of the first record).  The queue is
+topped up on every BLE_EVT_TX_COMPLETE, so the stack always has packets waiting and the report runs at full
+notification throughput without getting ahead of game traffic on the CONTROL class.  The final response code is
+sent only once the BULK queue has drained, so it arrives after the last record.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BPLogStatsType G_sBPLogStats;                          /* Log retrieval statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BPLog_" and be declared as static.
+***********************************************************************************************************************/
+static u32 BPLog_u32First;                 /* First index selected by the last request */
+static u32 BPLog_u32Last;                  /* Last index selected by the last request */
+
+static bool BPLog_bStreaming;              /* A report is in progress */
+static u32 BPLog_u32Next;                  /* Next index to send */
+static u32 BPLog_u32Sent;                  /* Records sent in this report */
+static u32 BPLog_u32StartMs;               /* Time of the report request */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPLogInitialize(void)
+@brief Registers the request handler and the events that drive a report.
+
+Requires:
+- BPFrameInitialize() has run
+
+Promises:
+- Returns TRUE if every handler was registered
+
+*/
+bool BPLogInitialize(void)
+{
+  bool bResult = TRUE;
+
+  memset(&G_sBPLogStats, 0, sizeof(G_sBPLogStats));
+  BPLog_bStreaming = FALSE;
+
+  bResult &= BPFrameRegisterHandler(BPFRAME_TYPE_LOG, BPLogOnRequest);
+  bResult &= BLEIntegrationRegisterHandler(BLE_EVT_TX_COMPLETE, BPLogOnTxComplete);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_DISCONNECTED, BPLogOnDisconnected);
+
+  return bResult;
+
+} /* end BPLogInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPLogOnRequest(u8* pu8Data_, u8 u8Length_)
+@brief BPFRAME_TYPE_LOG receiver: runs one RACP request.
+*/
+static void BPLogOnRequest(u8* pu8Data_, u8 u8Length_)
+{
+  u8 au8Response[U8_BPLOG_NUM_RESPONSE_SIZE];
+  u8 u8Code;
+  u32 u32Count;
+
+  G_sBPLogStats.u32Requests++;
+  if(u8Length_ < U8_BPLOG_REQUEST_HEADER)
+  {
+    BPLogRespond(RACP_OPCODE_RESERVED, RACP_RESPONSE_INVALID_OPERATOR);
+    return;
+  }
+
+  /* Only an abort may interrupt a report */
+  if(BPLog_bStreaming && (pu8Data_[0] != RACP_OPCODE_ABORT_OPERATION))
+  {
+    BPLogRespond(pu8Data_[0], RACP_RESPONSE_PROCEDURE_NOT_DONE);
+    return;
+  }
+
+  switch(pu8Data_[0])
+  {
+    case RACP_OPCODE_REPORT_RECS:
+    {
+      u8Code = BPLogSelect(pu8Data_[1], &pu8Data_[U8_BPLOG_REQUEST_HEADER], u8Length_ - U8_BPLOG_REQUEST_HEADER);
+      if(u8Code != RACP_RESPONSE_SUCCESS)
+      {
+        BPLogRespond(RACP_OPCODE_REPORT_RECS, u8Code);
+        break;
+      }
+
+      BPLog_bStreaming = TRUE;
+      BPLog_u32Next = BPLog_u32First;
+      BPLog_u32Sent = 0;
+      BPLog_u32StartMs = G_u32SystemTime1ms;
+      BPLogPump();
+      break;
+    }
+
+    case RACP_OPCODE_REPORT_NUM_RECS:
+    {
+      u8Code = BPLogSelect(pu8Data_[1], &pu8Data_[U8_BPLOG_REQUEST_HEADER], u8Length_ - U8_BPLOG_REQUEST_HEADER);
+      if( (u8Code != RACP_RESPONSE_SUCCESS) && (u8Code != RACP_RESPONSE_NO_RECORDS_FOUND) )
+      {
+        BPLogRespond(RACP_OPCODE_REPORT_NUM_RECS, u8Code);
+        break;
+      }
+
+      u32Count = (u8Code == RACP_RESPONSE_SUCCESS) ? (BPLog_u32Last - BPLog_u32First + 1) : 0;
+      au8Response[0] = RACP_OPCODE_NUM_RECS_RESPONSE;
+      au8Response[1] = RACP_OPERATOR_NULL;
+      au8Response[2] = (u8)u32Count;
+      au8Response[3] = (u8)(u32Count >> 8);
+      au8Response[4] = (u8)(u32Count >> 16);
+      au8Response[5] = (u8)(u32Count >> 24);
+      (void)BPFrameSend(BPFRAME_TYPE_LOG, au8Response, U8_BPLOG_NUM_RESPONSE_SIZE, FALSE);
+      break;
+    }
+
+    case RACP_OPCODE_DELETE_RECS:
+    {
+      if(pu8Data_[1] != RACP_OPERATOR_ALL)
+      {
+        /* Records are only ever dropped from the old end of the ring */
+        u8Code = ((pu8Data_[1] == RACP_OPERATOR_NULL) || (pu8Data_[1] >= RACP_OPERATOR_RFU_START)) ?
+                 RACP_RESPONSE_INVALID_OPERATOR : RACP_RESPONSE_OPERATOR_UNSUPPORTED;
+      }
+      else
+      {
+        u8Code = EventLogErase() ? RACP_RESPONSE_SUCCESS : RACP_RESPONSE_PROCEDURE_NOT_DONE;
+      }
+      BPLogRespond(RACP_OPCODE_DELETE_RECS, u8Code);
+      break;
+    }
+
+    case RACP_OPCODE_ABORT_OPERATION:
+    {
+      if(pu8Data_[1] != RACP_OPERATOR_NULL)
+      {
+        BPLogRespond(RACP_OPCODE_ABORT_OPERATION, RACP_RESPONSE_INVALID_OPERATOR);
+        break;
+      }
+
+      if(BPLog_bStreaming)
+      {
+        BPLog_bStreaming = FALSE;
+        G_sBPLogStats.u32Aborted++;
+      }
+      BPLogRespond(RACP_OPCODE_ABORT_OPERATION, RACP_RESPONSE_SUCCESS);
+      break;
+    }
+
+    default:
+    {
+      BPLogRespond(pu8Data_[0], RACP_RESPONSE_OPCODE_UNSUPPORTED);
+      break;
+    }
+  } /* end switch */
+
+} /* end BPLogOnRequest() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u8 BPLogSelect(u8 u8Operator_, u8* pu8Operands_, u8 u8Length_)
+@brief Turns an RACP operator and its operands into BPLog_u32First .. BPLog_u32Last, clipped to the stored records.
+
+Promises:
+- Returns RACP_RESPONSE_SUCCESS with the range set
+- Returns RACP_RESPONSE_NO_RECORDS_FOUND if the range holds no stored record
+- Returns the matching RACP error for a bad operator or operand length
+
+*/
+static u8 BPLogSelect(u8 u8Operator_, u8* pu8Operands_, u8 u8Length_)
+{
+  u32 u32Stored = EventLogFirstIndex();
+  u32 u32End = EventLogEndIndex();
+  u32 u32A = 0;
+  u32 u32B = 0;
+
+  if( (u8Operator_ == RACP_OPERATOR_NULL) || (u8Operator_ >= RACP_OPERATOR_RFU_START) )
+  {
+    return RACP_RESPONSE_INVALID_OPERATOR;
+  }
+
+  /* Operand checks: <= and >= take one index, RANGE two, the rest none */
+  if( ((u8Operator_ == RACP_OPERATOR_LESS_OR_EQUAL) || (u8Operator_ == RACP_OPERATOR_GREATER_OR_EQUAL)) )
+  {
+    if(u8Length_ != sizeof(u32))
+    {
+      return RACP_RESPONSE_INVALID_OPERAND;
+    }
+    u32A = pu8Operands_[0] | (pu8Operands_[1] << 8) | (pu8Operands_[2] << 16) | ((u32)pu8Operands_[3] << 24);
+  }
+  else if(u8Operator_ == RACP_OPERATOR_RANGE)
+  {
+    if(u8Length_ != 2 * sizeof(u32))
+    {
+      return RACP_RESPONSE_INVALID_OPERAND;
+    }
+    u32A = pu8Operands_[0] | (pu8Operands_[1] << 8) | (pu8Operands_[2] << 16) | ((u32)pu8Operands_[3] << 24);
+    u32B = pu8Operands_[4] | (pu8Operands_[5] << 8) | (pu8Operands_[6] << 16) | ((u32)pu8Operands_[7] << 24);
+    if(u32A > u32B)
+    {
+      return RACP_RESPONSE_INVALID_OPERAND;
+    }
+  }
+  else if(u8Length_ != 0)
+  {
+    return RACP_RESPONSE_INVALID_OPERAND;
+  }
+
+  if(u32Stored == u32End)
+  {
+    return RACP_RESPONSE_NO_RECORDS_FOUND;
+  }
+
+  BPLog_u32First = u32Stored;
+  BPLog_u32Last = u32End - 1;
+  switch(u8Operator_)
+  {
+    case RACP_OPERATOR_LESS_OR_EQUAL:
+    {
+      if(u32A < BPLog_u32Last)
+      {
+        BPLog_u32Last = u32A;
+      }
+      break;
+    }
+
+    case RACP_OPERATOR_GREATER_OR_EQUAL:
+    {
+      if(u32A > BPLog_u32First)
+      {
+        BPLog_u32First = u32A;
+      }
+      break;
+    }
+
+    case RACP_OPERATOR_RANGE:
+    {
+      if(u32A > BPLog_u32First)
+      {
+        BPLog_u32First = u32A;
+      }
+      if(u32B < BPLog_u32Last)
+      {
+        BPLog_u32Last = u32B;
+      }
+      break;
+    }
+
+    case RACP_OPERATOR_FIRST:
+    {
+      BPLog_u32Last = BPLog_u32First;
+      break;
+    }
+
+    case RACP_OPERATOR_LAST:
+    {
+      BPLog_u32First = BPLog_u32Last;
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  } /* end switch */
+
+  if( (BPLog_u32First > BPLog_u32Last) || (BPLog_u32Last < u32Stored) )
+  {
+    return RACP_RESPONSE_NO_RECORDS_FOUND;
+  }
+
+  return RACP_RESPONSE_SUCCESS;
+
+} /* end BPLogSelect() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPLogPump(void)
+@brief Fills the BULK TX queue with record packets and finishes the report once it has all gone to the stack.
+
+Records that are no longer stored or were cut short are skipped; a packet always holds consecutive indexes.
+*/
+static void BPLogPump(void)
+{
+  u8 au8Packet[BPENGENUICS_MAX_CHAR_LEN];
+  EventLogRecordType sRecord;
+  u32 u32Index;
+  u32 u32Elapsed;
+  u8 u8Count;
+
+  while( BPLog_bStreaming && (BPLog_u32Next <= BPLog_u32Last) && (BPEngenuicsTxFree(BPENGENUICS_TX_BULK) != 0) )
+  {
+    u8Count = 0;
+    u32Index = BPLog_u32Next;
+    while( (u8Count < U8_BPLOG_RECORDS_PER_PACKET) && (BPLog_u32Next <= BPLog_u32Last) )
+    {
+      if(EventLogRead(BPLog_u32Next, &sRecord))
+      {
+        memcpy(&au8Packet[U8_BPLOG_PACKET_HEADER + u8Count * sizeof(EventLogRecordType)], &sRecord,
+               sizeof(EventLogRecordType));
+        u8Count++;
+      }
+      else if(u8Count != 0)
+      {
+        BPLog_u32Next++;
+        break;
+      }
+      else
+      {
+        u32Index++;
+      }
+      BPLog_u32Next++;
+    }
+
+    if(u8Count == 0)
+    {
+      break;
+    }
+
+    au8Packet[0] = U8_BPLOG_MARKER | u8Count;
+    au8Packet[1] = (u8)u32Index;
+    au8Packet[2] = (u8)(u32Index >> 8);
+    au8Packet[3] = (u8)(u32Index >> 16);
+    if(!BPEngenuicsQueueData(BPENGENUICS_TX_BULK, au8Packet,
+                             U8_BPLOG_PACKET_HEADER + u8Count * sizeof(EventLogRecordType)))
+    {
+      /* Notifications were turned off */
+      BPLog_bStreaming = FALSE;
+      G_sBPLogStats.u32Aborted++;
+      return;
+    }
+
+    BPLog_u32Sent += u8Count;
+    G_sBPLogStats.u32Records += u8Count;
+    G_sBPLogStats.u32Packets++;
+  }
+
+  if( BPLog_bStreaming && (BPLog_u32Next > BPLog_u32Last) &&
+      (BPEngenuicsTxFree(BPENGENUICS_TX_BULK) == U8_BPENGENUICS_TX_BULK_SIZE) )
+  {
+    BPLog_bStreaming = FALSE;
+    G_sBPLogStats.u32Streams++;
+
+    u32Elapsed = G_u32SystemTime1ms - BPLog_u32StartMs;
+    if(u32Elapsed == 0)
+    {
+      u32Elapsed = 1;
+    }
+    G_sBPLogStats.u32LastStreamMs = u32Elapsed;
+    G_sBPLogStats.u32LastRecordsPerSecond = (u32)(((u64)BPLog_u32Sent * 1000) / u32Elapsed);
+
+    BPLogRespond(RACP_OPCODE_REPORT_RECS,
+                 (BPLog_u32Sent != 0) ? RACP_RESPONSE_SUCCESS : RACP_RESPONSE_NO_RECORDS_FOUND);
+  }
+
+} /* end BPLogPump() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPLogRespond(u8 u8Opcode_, u8 u8Code_)
+@brief Sends an RACP response code for the request u8Opcode_.
+*/
+static void BPLogRespond(u8 u8Opcode_, u8 u8Code_)
+{
+  u8 au8Response[U8_BPLOG_CODE_RESPONSE_SIZE];
+
+  if(u8Code_ != RACP_RESPONSE_SUCCESS)
+  {
+    G_sBPLogStats.u32Refused++;
+  }
+
+  au8Response[0] = RACP_OPCODE_RESPONSE_CODE;
+  au8Response[1] = RACP_OPERATOR_NULL;
+  au8Response[2] = u8Opcode_;
+  au8Response[3] = u8Code_;
+  (void)BPFrameSend(BPFRAME_TYPE_LOG, au8Response, U8_BPLOG_CODE_RESPONSE_SIZE, FALSE);
+
+} /* end BPLogRespond() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BPLogOnTxComplete(ble_evt_t* p_ble_evt)
+@brief BLE_EVT_TX_COMPLETE: the stack has room again, so keep the report going.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BPLogOnTxComplete(ble_evt_t* p_ble_evt)
+{
+  if(BPLog_bStreaming)
+  {
+    BPLogPump();
+  }
+
+  return TRUE;
+
+} /* end BPLogOnTxComplete() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BPLogOnDisconnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_DISCONNECTED: a report in progress is dropped; the client asks again from the last index it got.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BPLogOnDisconnected(ble_evt_t* p_ble_evt)
+{
+  if(BPLog_bStreaming)
+  {
+    BPLog_bStreaming = FALSE;
+    G_sBPLogStats.u32Aborted++;
+  }
+
+  return TRUE;
+
+} /* end BPLogOnDisconnected() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,79 @@
+/**********************************************************************************************************************
+File: bleperipheral_log.h
+
+Description:
+Header file for bleperipheral_log.c
+**********************************************************************************************************************/
+
+#ifndef __BLEPERIPHERALLOG_H
+#define __BLEPERIPHERALLOG_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Byte 0 of every record packet is U8_BPLOG_MARKER | number of records in it */
+#define U8_BPLOG_MARKER                (u8)0xD0   /* High nibble; distinct from framed and bulk packets */
+#define U8_BPLOG_COUNT_MASK            (u8)0x0F
+
+#define U8_BPLOG_PACKET_HEADER         (u8)4      /* Marker, index of the first record (u24) */
+#define U8_BPLOG_RECORDS_PER_PACKET    (u8)((BPENGENUICS_MAX_CHAR_LEN - U8_BPLOG_PACKET_HEADER) / sizeof(EventLogRecordType))
+
+#define U8_BPLOG_REQUEST_HEADER        (u8)2      /* RACP opcode, operator */
+#define U8_BPLOG_NUM_RESPONSE_SIZE     (u8)6      /* [RACP_OPCODE_NUM_RECS_RESPONSE][RACP_OPERATOR_NULL][count u32] */
+#define U8_BPLOG_CODE_RESPONSE_SIZE    (u8)4      /* [RACP_OPCODE_RESPONSE_CODE][RACP_OPERATOR_NULL][opcode][code] */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@struct BPLogStatsType
+@brief Log retrieval statistics.
+*/
+typedef struct
+{
+  u32 u32Requests;                        /*!< @brief RACP requests received */
+  u32 u32Refused;                         /*!< @brief Requests answered with anything but success */
+  u32 u32Streams;                         /*!< @brief Record reports completed */
+  u32 u32Aborted;                         /*!< @brief Reports stopped by an abort or a disconnect */
+  u32 u32Records;                         /*!< @brief Records sent */
+  u32 u32Packets;                         /*!< @brief Record packets queued */
+  u32 u32LastStreamMs;                    /*!< @brief Request to last record queued, for the last report */
+  u32 u32LastRecordsPerSecond;            /*!< @brief Rate of the last report */
+} BPLogStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BPLogInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BPLogOnRequest(u8* pu8Data_, u8 u8Length_);
+static u8 BPLogSelect(u8 u8Operator_, u8* pu8Operands_, u8 u8Length_);
+static void BPLogPump(void);
+static void BPLogRespond(u8 u8Opcode_, u8 u8Code_);
+static bool BPLogOnTxComplete(ble_evt_t* p_ble_evt);
+static bool BPLogOnDisconnected(ble_evt_t* p_ble_evt);
+
+
+#endif /* __BLEPERIPHERALLOG_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
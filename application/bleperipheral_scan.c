@@ -0,0 +1,262 @@
+/**********************************************************************************************************************
+File: bleperipheral_scan.c
+
+Description:
+Reports the ANT scan device table (ant_scan.c) over BLE.
+
+Requests and responses are BPFRAME_TYPE_SCAN messages:
+
+  request    [opcode]                     U8_BPSCAN_OP_xxx
+  response   [opcode][result][devices]    U8_BPSCAN_RESULT_xxx and the number of devices in the table
+
+A report streams one device per raw notification on the BULK TX class (U8_BPSCAN_MARKER, then the table index and
+the device as laid out in bleperipheral_scan.h).  As with event log reports, the queue is topped up on every
+BLE_EVT_TX_COMPLETE and the final response is only sent once the BULK queue has drained.  The table keeps changing
+while it is reported: an index whose device was replaced meanwhile is sent with the new device.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BPScanStatsType G_sBPScanStats;                        /* Device table reporting statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BPScan_" and be declared as static.
+***********************************************************************************************************************/
+static bool BPScan_bStreaming;             /* A report is in progress */
+static u8 BPScan_u8Next;                   /* Next table index to send */
+static u8 BPScan_u8Sent;                   /* Devices sent in this report */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BPScanInitialize(void)
+@brief Registers the request handler and the events that drive a report.
+
+Requires:
+- BPFrameInitialize() has run
+
+Promises:
+- Returns TRUE if every handler was registered
+
+*/
+bool BPScanInitialize(void)
+{
+  bool bResult = TRUE;
+
+  memset(&G_sBPScanStats, 0, sizeof(G_sBPScanStats));
+  BPScan_bStreaming = FALSE;
+
+  bResult &= BPFrameRegisterHandler(BPFRAME_TYPE_SCAN, BPScanOnRequest);
+  bResult &= BLEIntegrationRegisterHandler(BLE_EVT_TX_COMPLETE, BPScanOnTxComplete);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_DISCONNECTED, BPScanOnDisconnected);
+
+  return bResult;
+
+} /* end BPScanInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPScanOnRequest(u8* pu8Data_, u8 u8Length_)
+@brief BPFRAME_TYPE_SCAN receiver: runs one request.
+*/
+static void BPScanOnRequest(u8* pu8Data_, u8 u8Length_)
+{
+  G_sBPScanStats.u32Requests++;
+  if(u8Length_ == 0)
+  {
+    return;
+  }
+
+  /* Only an abort may interrupt a report */
+  if(BPScan_bStreaming && (pu8Data_[0] != U8_BPSCAN_OP_ABORT))
+  {
+    BPScanRespond(pu8Data_[0], U8_BPSCAN_RESULT_BUSY, AntScanCount());
+    return;
+  }
+
+  switch(pu8Data_[0])
+  {
+    case U8_BPSCAN_OP_REPORT:
+    {
+      if(!AntScanIsRunning())
+      {
+        BPScanRespond(U8_BPSCAN_OP_REPORT, U8_BPSCAN_RESULT_OFF, 0);
+        break;
+      }
+
+      BPScan_bStreaming = TRUE;
+      BPScan_u8Next = 0;
+      BPScan_u8Sent = 0;
+      BPScanPump();
+      break;
+    }
+
+    case U8_BPSCAN_OP_CLEAR:
+    {
+      AntScanClear();
+      BPScanRespond(U8_BPSCAN_OP_CLEAR, U8_BPSCAN_RESULT_OK, 0);
+      break;
+    }
+
+    case U8_BPSCAN_OP_ABORT:
+    {
+      if(BPScan_bStreaming)
+      {
+        BPScan_bStreaming = FALSE;
+        G_sBPScanStats.u32Aborted++;
+      }
+      BPScanRespond(U8_BPSCAN_OP_ABORT, U8_BPSCAN_RESULT_OK, AntScanCount());
+      break;
+    }
+
+    default:
+    {
+      BPScanRespond(pu8Data_[0], U8_BPSCAN_RESULT_UNSUPPORTED, AntScanCount());
+      break;
+    }
+  } /* end switch */
+
+} /* end BPScanOnRequest() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPScanPump(void)
+@brief Fills the BULK TX queue with device packets and finishes the report once it has all gone to the stack.
+*/
+static void BPScanPump(void)
+{
+  u8 au8Packet[U8_BPSCAN_RECORD_SIZE];
+  AntScanDeviceType sDevice;
+  u16 u16Age;
+
+  while( BPScan_bStreaming && (BPEngenuicsTxFree(BPENGENUICS_TX_BULK) != 0) &&
+         AntScanRead(BPScan_u8Next, &sDevice) )
+  {
+    u16Age = (u16)G_u32SystemTime1s - sDevice.u16LastSeenS;
+
+    au8Packet[0] = U8_BPSCAN_MARKER;
+    au8Packet[1] = BPScan_u8Next;
+    au8Packet[2] = (u8)sDevice.u16DeviceNumber;
+    au8Packet[3] = (u8)(sDevice.u16DeviceNumber >> 8);
+    au8Packet[4] = sDevice.u8DeviceType;
+    au8Packet[5] = sDevice.u8TransmissionType;
+    au8Packet[6] = (u8)sDevice.s8Rssi;
+    au8Packet[7] = sDevice.u8Messages;
+    au8Packet[8] = (u8)u16Age;
+    au8Packet[9] = (u8)(u16Age >> 8);
+    memcpy(&au8Packet[10], sDevice.au8Payload, U8_ANTSCAN_PAYLOAD_SIZE);
+
+    if(!BPEngenuicsQueueData(BPENGENUICS_TX_BULK, au8Packet, U8_BPSCAN_RECORD_SIZE))
+    {
+      /* Notifications were turned off */
+      BPScan_bStreaming = FALSE;
+      G_sBPScanStats.u32Aborted++;
+      return;
+    }
+
+    BPScan_u8Next++;
+    BPScan_u8Sent++;
+    G_sBPScanStats.u32Devices++;
+  }
+
+  if( BPScan_bStreaming && (BPScan_u8Next >= AntScanCount()) &&
+      (BPEngenuicsTxFree(BPENGENUICS_TX_BULK) == U8_BPENGENUICS_TX_BULK_SIZE) )
+  {
+    BPScan_bStreaming = FALSE;
+    G_sBPScanStats.u32Reports++;
+    BPScanRespond(U8_BPSCAN_OP_REPORT, U8_BPSCAN_RESULT_OK, BPScan_u8Sent);
+  }
+
+} /* end BPScanPump() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BPScanRespond(u8 u8Opcode_, u8 u8Result_, u8 u8Devices_)
+@brief Sends the response to the request u8Opcode_.
+*/
+static void BPScanRespond(u8 u8Opcode_, u8 u8Result_, u8 u8Devices_)
+{
+  u8 au8Response[U8_BPSCAN_RESPONSE_SIZE];
+
+  au8Response[0] = u8Opcode_;
+  au8Response[1] = u8Result_;
+  au8Response[2] = u8Devices_;
+  (void)BPFrameSend(BPFRAME_TYPE_SCAN, au8Response, U8_BPSCAN_RESPONSE_SIZE, FALSE);
+
+} /* end BPScanRespond() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BPScanOnTxComplete(ble_evt_t* p_ble_evt)
+@brief BLE_EVT_TX_COMPLETE: the stack has room again, so keep the report going.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BPScanOnTxComplete(ble_evt_t* p_ble_evt)
+{
+  if(BPScan_bStreaming)
+  {
+    BPScanPump();
+  }
+
+  return TRUE;
+
+} /* end BPScanOnTxComplete() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BPScanOnDisconnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_DISCONNECTED: a report in progress is dropped.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BPScanOnDisconnected(ble_evt_t* p_ble_evt)
+{
+  if(BPScan_bStreaming)
+  {
+    BPScan_bStreaming = FALSE;
+    G_sBPScanStats.u32Aborted++;
+  }
+
+  return TRUE;
+
+} /* end BPScanOnDisconnected() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
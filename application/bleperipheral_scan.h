@@ -0,0 +1,80 @@
+/**********************************************************************************************************************
+File: bleperipheral_scan.h
+
+Description:
+Header file for bleperipheral_scan.c
+**********************************************************************************************************************/
+
+#ifndef __BLEPERIPHERALSCAN_H
+#define __BLEPERIPHERALSCAN_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Requests (BPFRAME_TYPE_SCAN): [opcode] */
+#define U8_BPSCAN_OP_REPORT            (u8)0x01   /* Stream every device in the table */
+#define U8_BPSCAN_OP_CLEAR             (u8)0x02   /* Empty the table */
+#define U8_BPSCAN_OP_ABORT             (u8)0x03   /* Stop a report in progress */
+
+/* Responses (BPFRAME_TYPE_SCAN): [opcode][result][devices] */
+#define U8_BPSCAN_RESULT_OK            (u8)0x00
+#define U8_BPSCAN_RESULT_BUSY          (u8)0x01   /* A report is in progress */
+#define U8_BPSCAN_RESULT_OFF           (u8)0x02   /* The scanner is not running; the table stays empty */
+#define U8_BPSCAN_RESULT_UNSUPPORTED   (u8)0x03   /* Unknown opcode */
+#define U8_BPSCAN_RESPONSE_SIZE        (u8)3
+
+/* Device packets (BULK class): [U8_BPSCAN_MARKER][index][device number u16][device type][transmission type]
+   [RSSI s8][messages][age s u16][first payload bytes x4]                                           little endian */
+#define U8_BPSCAN_MARKER               (u8)0xC0   /* Distinct from framed, bulk and log packets */
+#define U8_BPSCAN_RECORD_SIZE          (u8)(10 + U8_ANTSCAN_PAYLOAD_SIZE)
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@struct BPScanStatsType
+@brief Device table reporting statistics.
+*/
+typedef struct
+{
+  u32 u32Requests;                        /*!< @brief Requests received */
+  u32 u32Reports;                         /*!< @brief Reports completed */
+  u32 u32Aborted;                         /*!< @brief Reports stopped by an abort or a disconnect */
+  u32 u32Devices;                         /*!< @brief Device packets queued */
+} BPScanStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BPScanInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BPScanOnRequest(u8* pu8Data_, u8 u8Length_);
+static void BPScanPump(void);
+static void BPScanRespond(u8 u8Opcode_, u8 u8Result_, u8 u8Devices_);
+static bool BPScanOnTxComplete(ble_evt_t* p_ble_evt);
+static bool BPScanOnDisconnected(ble_evt_t* p_ble_evt);
+
+
+#endif /* __BLEPERIPHERALSCAN_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -64,21 +64,32 @@ void main(void)
 
   /* Low Level Initialization Modules */
   WatchDogSetup(); 
+  WatchdogInitialize();
+  WorkQueueInitialize();
   GpioSetup();
   ClockSetup();
   InterruptSetup();
   PowerSetup();
   SysTickSetup();
+  SwTimerInitialize();
+  EventBusInitialize();
     
   /* Driver initialization */
   LedInitialize();
   ButtonInitialize();
+  RadioSchedInitialize();
+  FlashInitialize();
+  KVStoreInitialize();
+  EventLogInitialize();
   // I2cInitialize();
 
 #ifdef SOFTDEVICE_ENABLED
   ANTIntegrationInitialize();
   BLEIntegrationInitialize();
   bleperipheralInitialize();
+  AntScanInitialize();
+  AntBeaconInitialize();
+  AntBurstInitialize();
 #endif
   
   /* Application initialization */
@@ -92,7 +103,9 @@ void main(void)
   /* Main loop */  
   while(1)
   {
-    SocIntegrationHandler();
+    WorkQueueRunActiveState();
+    SwTimerRunActiveState();
+    EventBusRunActiveState();
 
     /* Driver and Application State Machines */
     LedRunActiveState();
@@ -103,6 +116,7 @@ void main(void)
     PovRunActiveState();
     UserApp1RunActiveState();
 
+    WatchdogRunActiveState();
     SystemSleep();
     
   } /* end while(1) main super loop */
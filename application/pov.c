@@ -47,11 +47,13 @@ Global variable definitions with scope limited to this local application.
 Variable names shall start with "Pov_<type>" and be declared as static.
 ***********************************************************************************************************************/
 static fnCode_type Pov_pfStateMachine;               /*!< @brief The state machine function pointer */
-static u32 Pov_u32Timer;                             /*!< @brief Timeout counter used across states */
 
-static u32 Pov_u16UpdateRate;  
+static u32 Pov_u32ColumnPeriodUs;                     /*!< @brief Time each pixel column is displayed */
 static PovColorType Pov_sMessageColor;  
 static u8 Pov_au8ScreenBitmap[U8_SCREEN_WIDTH_PX];
+static u8 Pov_au8UploadBitmap[U8_SCREEN_WIDTH_PX];     /*!< @brief Bulk upload lands here until its CRC is checked */
+static u8 Pov_au8PendingMessage[U8_SCREEN_CHARS + 1];  /*!< @brief Received text waiting for a radio gap to render */
+static bool Pov_bRenderPending;                        /*!< @brief Pov_au8PendingMessage is queued in radio_sched */
 
 static u8 Pov_au8DefaultMessage[] = "enGENIUS";
 
@@ -70,18 +72,27 @@ Function Definitions
 @brief Adjusts the main cycle time on which all character display is based.
 
 This function can be hard-coded for a known cycle time, or have a timing input
-based on reed switch, accelerometer, etc.
+based on reed switch, accelerometer, etc.  The stored KVSTORE_KEY_POV_TIMING_MS
+setting is used if there is one.
 
 Requires:
 - 
 
 Promises:
-- Pov_u16UpdateRate updated for the current timing
+- Pov_u32ColumnPeriodUs updated for the current timing
 
 */
 void PovSetTiming(void)
 {
-  Pov_u16UpdateRate = U16_DEFAULT_TIMING_MS / U8_SCREEN_WIDTH_PX;
+  u16 u16TimingMs;
+  
+  if( (KVStoreGet(KVSTORE_KEY_POV_TIMING_MS, &u16TimingMs, sizeof(u16TimingMs)) != sizeof(u16TimingMs)) ||
+      (u16TimingMs == 0) )
+  {
+    u16TimingMs = U16_DEFAULT_TIMING_MS;
+  }
+  
+  Pov_u32ColumnPeriodUs = ((u32)u16TimingMs * 1000) / U8_SCREEN_WIDTH_PX;
   
 } /* end PovSetTiming() */
 
@@ -99,16 +110,19 @@ Requires:
 @param eBlue_ PWM setting for blue color
 
 Promises:
-- Next message will be in specified colors 
+- Next message will be in specified colors; they are stored for the next start-up
 
 */
 void PovSetMessageColorRGB(LedRateType eRed_, 
                         LedRateType eGreen_, 
                         LedRateType eBlue_)
 {
+  u8 au8Color[3] = {(u8)eRed_, (u8)eGreen_, (u8)eBlue_};
+  
   Pov_sMessageColor.eRed = eRed_;
   Pov_sMessageColor.eGreen = eGreen_;
   Pov_sMessageColor.eBlue = eBlue_;
+  (void)KVStoreSet(KVSTORE_KEY_POV_COLOR, au8Color, sizeof(au8Color));
   
 } /* end PovSetMessageColorRGB() */
 
@@ -123,12 +137,14 @@ Requires:
 
 Promises:
 - ASCII chars are converted to pixels and loaded to Pov_aau8ScreenBitmap
+- Chars outside the font (U8_ASCII_PRINTABLES to U8_ASCII_LAST_PRINTABLE) are shown as '?'
 
 */
 void PovQueueMessage(u8* pu8Message_)
 {
   u8 u8CharCounter = 0;
   u8* pu8CurrentChar;
+  u8 u8FontIndex;
   
   u8 u8BitMask = 0x01;
   u8 u8ScreenColumnIndex = 0;
@@ -148,6 +164,14 @@ void PovQueueMessage(u8* pu8Message_)
     /* Start with the left-most column */
     u8BitMask = 0x01;
     
+    /* The font only has the printable chars, so never index it with anything else */
+    u8FontIndex = *pu8CurrentChar;
+    if( (u8FontIndex < U8_ASCII_PRINTABLES) || (u8FontIndex > U8_ASCII_LAST_PRINTABLE) )
+    {
+      u8FontIndex = '?';
+    }
+    u8FontIndex -= U8_ASCII_PRINTABLES;
+    
     /* Load the bitmap column-by-column to Pov_au8ScreenBitmap
     j controls the bitmask to select the letter's bitmap column */
     for(u8 j = 0; j < U8_CHAR_WIDTH_PX; j++)
@@ -156,7 +180,7 @@ void PovQueueMessage(u8* pu8Message_)
       for(u8 k = 0; k < U8_FONT_HEIGHT_PX; k++)
       {
         /* Add the pixel to Pov_au8ScreenBitmap if it is lit in the character bitmap */
-        if(u8BitMask & (G_aau8SmallFonts[(*pu8CurrentChar - U8_ASCII_PRINTABLES)][k][0]) )
+        if(u8BitMask & (G_aau8SmallFonts[u8FontIndex][k][0]) )
         {
           Pov_au8ScreenBitmap[u8ScreenColumnIndex] |= (0x1 << k);
         }
@@ -249,13 +273,40 @@ Promises:
 */
 void PovInitialize(void)
 {
+  u8 au8Stored[U8_KVSTORE_MAX_VALUE + 1];
+  u8 u8Length;
+  
   LedRainbow();
   
+  /* Stored settings replace the defaults */
   Pov_sMessageColor.eRed   = LED_PWM_100; 
   Pov_sMessageColor.eGreen = LED_PWM_0; 
   Pov_sMessageColor.eBlue  = LED_PWM_100; 
+  if( (KVStoreGet(KVSTORE_KEY_POV_COLOR, au8Stored, 3) == 3) &&
+      (au8Stored[0] <= LED_PWM_100) && (au8Stored[1] <= LED_PWM_100) && (au8Stored[2] <= LED_PWM_100) )
+  {
+    Pov_sMessageColor.eRed   = (LedRateType)au8Stored[0]; 
+    Pov_sMessageColor.eGreen = (LedRateType)au8Stored[1]; 
+    Pov_sMessageColor.eBlue  = (LedRateType)au8Stored[2]; 
+  }
+  
+  /* A stored message is only used if it still fits the screen and the font */
+  u8Length = KVStoreGet(KVSTORE_KEY_POV_MESSAGE, au8Stored, U8_KVSTORE_MAX_VALUE);
+  if( (u8Length != 0) && (u8Length <= U8_SCREEN_CHARS) && PovIsPrintable(au8Stored, u8Length) )
+  {
+    au8Stored[u8Length] = '\0';
+    PovQueueMessage(au8Stored);
+  }
+  else
+  {
+    PovQueueMessage(Pov_au8DefaultMessage);
+  }
   
-  PovQueueMessage(Pov_au8DefaultMessage);
+  /* Text written by the BLE client replaces the message */
+  EventBusSubscribe(EVENT_TOPIC_BLE_RX, PovBleRxHandler);
+  BPFrameRegisterHandler(BPFRAME_TYPE_POV, PovFrameHandler);
+  BPBulkRegisterObject(U8_POV_BULK_IMAGE_ID, U8_SCREEN_WIDTH_PX, PovImageWrite, PovImageDone);
+  WatchdogRegisterTask(WATCHDOG_TASK_POV, U32_WATCHDOG_TASK_PERIOD_MS);
 
   /* If good initialization, set state to Idle */
   if( 1 )
@@ -288,6 +339,7 @@ Promises:
 */
 void PovRunActiveState(void)
 {
+  WatchdogCheckIn(WATCHDOG_TASK_POV);
   Pov_pfStateMachine();
 
 } /* end PovRunActiveState */
@@ -297,6 +349,167 @@ void PovRunActiveState(void)
 /*! @privatesection */                                                                                            
 /*--------------------------------------------------------------------------------------------------------------------*/
 
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static void PovBleRxHandler(const EventMessageType* psMessage_)
+
+@brief EVENT_TOPIC_BLE_RX subscriber: shows the received text and keeps it for the next start-up.
+
+The bus terminates every payload so it is used in place.
+
+*/
+static void PovBleRxHandler(const EventMessageType* psMessage_)
+{
+  PovRenderLater((u8*)psMessage_->au8Payload);
+  PovStoreMessage((u8*)psMessage_->au8Payload);
+  
+} /* end PovBleRxHandler() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static void PovFrameHandler(u8* pu8Data_, u8 u8Length_)
+
+@brief BPFRAME_TYPE_POV receiver: shows the received text and keeps it for the next start-up.
+
+Framed text may be longer than one packet; the framing layer terminates it.  Only the first U8_SCREEN_CHARS
+characters are used, and PovRenderLater() replaces any the font does not have.
+
+*/
+static void PovFrameHandler(u8* pu8Data_, u8 u8Length_)
+{
+  PovRenderLater(pu8Data_);
+  PovStoreMessage(pu8Data_);
+  
+} /* end PovFrameHandler() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static void PovRenderLater(u8* pu8Message_)
+
+@brief Renders received text in the next radio gap.  Newer text replaces any still waiting.
+
+Received bytes come straight from the client, so any outside the font are shown as '?'.
+
+*/
+static void PovRenderLater(u8* pu8Message_)
+{
+  u8 u8Length = 0;
+  u8 u8Char;
+  
+  while( (u8Length < U8_SCREEN_CHARS) && (pu8Message_[u8Length] != '\0') )
+  {
+    u8Char = pu8Message_[u8Length];
+    if( (u8Char < U8_ASCII_PRINTABLES) || (u8Char > U8_ASCII_LAST_PRINTABLE) )
+    {
+      u8Char = '?';
+    }
+    Pov_au8PendingMessage[u8Length] = u8Char;
+    u8Length++;
+  }
+  Pov_au8PendingMessage[u8Length] = '\0';
+  
+  if(Pov_bRenderPending)
+  {
+    return;
+  }
+  
+  Pov_bRenderPending = TRUE;
+  if(!RadioSchedSubmit(RADIOSCHED_POV_RENDER, PovRenderJob, NULL))
+  {
+    PovRenderJob(NULL);
+  }
+  
+} /* end PovRenderLater() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static void PovRenderJob(void* pvContext_)
+
+@brief radio_sched job: renders the waiting text into the screen bitmap.
+
+*/
+static void PovRenderJob(void* pvContext_)
+{
+  Pov_bRenderPending = FALSE;
+  PovQueueMessage(Pov_au8PendingMessage);
+  
+} /* end PovRenderJob() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static void PovStoreMessage(u8* pu8Message_)
+
+@brief Stores the part of a null-terminated message that fits on the screen as KVSTORE_KEY_POV_MESSAGE.  Text with
+characters the font does not have is not stored.
+
+*/
+static void PovStoreMessage(u8* pu8Message_)
+{
+  u8 u8Length = 0;
+  
+  while( (u8Length < U8_SCREEN_CHARS) && (pu8Message_[u8Length] != '\0') )
+  {
+    u8Length++;
+  }
+  
+  if( (u8Length != 0) && PovIsPrintable(pu8Message_, u8Length) )
+  {
+    (void)KVStoreSet(KVSTORE_KEY_POV_MESSAGE, pu8Message_, u8Length);
+  }
+  
+} /* end PovStoreMessage() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static bool PovIsPrintable(const u8* pu8Text_, u8 u8Length_)
+
+@brief Checks that every character is in the font (U8_ASCII_PRINTABLES to U8_ASCII_LAST_PRINTABLE).
+
+*/
+static bool PovIsPrintable(const u8* pu8Text_, u8 u8Length_)
+{
+  for(u8 i = 0; i < u8Length_; i++)
+  {
+    if( (pu8Text_[i] < U8_ASCII_PRINTABLES) || (pu8Text_[i] > U8_ASCII_LAST_PRINTABLE) )
+    {
+      return FALSE;
+    }
+  }
+  
+  return TRUE;
+  
+} /* end PovIsPrintable() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static bool PovImageWrite(u32 u32Offset_, u8* pu8Data_, u8 u8Length_)
+
+@brief Bulk upload sink for a raw screen bitmap (one byte per column, bit 0 at the top).
+
+*/
+static bool PovImageWrite(u32 u32Offset_, u8* pu8Data_, u8 u8Length_)
+{
+  memcpy(&Pov_au8UploadBitmap[u32Offset_], pu8Data_, u8Length_);
+  return TRUE;
+  
+} /* end PovImageWrite() */
+
+
+/*!--------------------------------------------------------------------------------------------------------------------
+@fn static void PovImageDone(u32 u32Size_, bool bCrcOk_)
+
+@brief Shows an uploaded bitmap once it has arrived intact; a short image leaves the rest of the screen blank.
+
+*/
+static void PovImageDone(u32 u32Size_, bool bCrcOk_)
+{
+  if(bCrcOk_)
+  {
+    memset(Pov_au8ScreenBitmap, 0, sizeof(Pov_au8ScreenBitmap));
+    memcpy(Pov_au8ScreenBitmap, Pov_au8UploadBitmap, u32Size_);
+  }
+  
+} /* end PovImageDone() */
+
 
 /**********************************************************************************************************************
 State Machine Function Definitions
@@ -333,17 +546,24 @@ static void PovSM_PovDuty(void)
 /* Runs the POV display */
 static void PovSM_Pov(void)
 {
-  static u16 u16UpdateTimer = 0;
+  static u64 u64NextColumnUs = 0;
   static u16 u16BitmapIndex = 0;
+  u64 u64NowUs;
   
   /* Update current timing */
   PovSetTiming();
   
-  /* Check if it's time to switch pixels columns */
-  u16UpdateTimer++;
-  if(u16UpdateTimer >= Pov_u16UpdateRate)
+  /* Check if it's time to switch pixels columns (timed from the timebase, not loop passes) */
+  u64NowUs = TimebaseGetUs();
+  if(u64NowUs >= u64NextColumnUs)
   {
-    u16UpdateTimer = 0;
+    u64NextColumnUs += Pov_u32ColumnPeriodUs;
+    
+    /* Don't try to catch up if the loop was held off for more than a column */
+    if(u64NextColumnUs <= u64NowUs)
+    {
+      u64NextColumnUs = u64NowUs + Pov_u32ColumnPeriodUs;
+    }
     
     /* Loop through each pixel to determine if on or off */
     for(u8 i = 0; i < U8_CHAR_HEIGHT_PX; i++)
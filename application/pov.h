@@ -47,6 +47,14 @@ void PovRunActiveState(void);
 /*------------------------------------------------------------------------------------------------------------------*/
 /*! @privatesection */                                                                                            
 /*--------------------------------------------------------------------------------------------------------------------*/
+static void PovBleRxHandler(const EventMessageType* psMessage_);
+static void PovFrameHandler(u8* pu8Data_, u8 u8Length_);
+static void PovRenderLater(u8* pu8Message_);
+static void PovRenderJob(void* pvContext_);
+static void PovStoreMessage(u8* pu8Message_);
+static bool PovIsPrintable(const u8* pu8Text_, u8 u8Length_);
+static bool PovImageWrite(u32 u32Offset_, u8* pu8Data_, u8 u8Length_);
+static void PovImageDone(u32 u32Size_, bool bCrcOk_);
 
 
 /***********************************************************************************************************************
@@ -64,6 +72,7 @@ static void PovSM_Error(void);
 Constants / Definitions
 **********************************************************************************************************************/
 #define U8_ASCII_PRINTABLES    (u8)32         /*!< @brief First printable ASCII code */
+#define U8_ASCII_LAST_PRINTABLE (u8)126       /*!< @brief Last printable ASCII code ('~') */
 
 
 #define U8_CHAR_HEIGHT_PX      (u8)8         /*!< @brief Number of vertical pixels in char bitmap */
@@ -77,7 +86,9 @@ Constants / Definitions
 #define U8_SCREEN_WIDTH_PX     (u8)( (U8_CHAR_WIDTH_PX + U8_SPACE_WIDTH_PX) * U8_SCREEN_CHARS)     /*!< @brief Number of horizontal pixels of "screen" */
 //#define U8_SCREEN_WIDTH_CHARS  (u8)( (U8_SCREEN_WIDTH_PX / 8) + 1)    /*!< @brief Number of horizontal pixels of "screen" */
 
-#define U16_DEFAULT_TIMING_MS  (u16)250
+#define U16_DEFAULT_TIMING_MS  (u16)250       /*!< @brief Used until KVSTORE_KEY_POV_TIMING_MS is stored */
+
+#define U8_POV_BULK_IMAGE_ID   (u8)0x01       /*!< @brief Bulk upload object ID of a raw screen bitmap */
 
 
 #endif /* __POV_H */
@@ -27,6 +27,7 @@ typedef const long sc32;  /*!< Read Only */
 typedef const short sc16;  /*!< Read Only */
 typedef const char sc8;   /*!< Read Only */
 
+typedef uint64_t  u64;
 typedef uint32_t  u32;
 typedef uint16_t u16;
 typedef uint8_t  u8;
@@ -54,6 +54,8 @@ extern volatile u32 G_u32SystemTime1s;                    /*!< @brief From main.
 extern volatile u32 G_u32SystemFlags;                     /*!< @brief From main.c */
 extern volatile u32 G_u32ApplicationFlags;                /*!< @brief From main.c */
 
+extern BLEAdvStatsType G_sBLEAdvStats;                    /*!< @brief From ble_advertising.c */
+
 
 /***********************************************************************************************************************
 Global variable definitions with scope limited to this local application.
@@ -61,6 +63,8 @@ Variable names shall start with "UserApp1_<type>" and be declared as static.
 ***********************************************************************************************************************/
 static fnCode_type UserApp1_pfStateMachine;               /*!< @brief The state machine function pointer */
 //static u32 UserApp1_u32Timeout;                           /*!< @brief Timeout counter used across states */
+static u32 UserApp1_u32LastStatusS;                       /*!< @brief G_u32SystemTime1s at the last status write */
+static u8 UserApp1_u8AntRxCount;                          /*!< @brief EVENT_TOPIC_ANT_RX messages since the last write */
 
 
 /**********************************************************************************************************************
@@ -84,16 +88,25 @@ Initializes the State Machine and its variables.
 Should only be called once in main init section.
 
 Requires:
-- NONE
+- EventBusInitialize() has run
 
 Promises:
-- NONE
+- Subscribed to EVENT_TOPIC_ANT_RX and EVENT_TOPIC_BLE_STATUS
 
 */
 void UserApp1Initialize(void)
 {
+  bool bResult = TRUE;
+
+  WatchdogRegisterTask(WATCHDOG_TASK_USER_APP1, U32_WATCHDOG_TASK_PERIOD_MS);
+  UserApp1_u32LastStatusS = G_u32SystemTime1s;
+  UserApp1_u8AntRxCount = 0;
+
+  bResult &= EventBusSubscribe(EVENT_TOPIC_ANT_RX, UserApp1OnAntRx);
+  bResult &= EventBusSubscribe(EVENT_TOPIC_BLE_STATUS, UserApp1OnBleStatus);
+
   /* If good initialization, set state to Idle */
-  if( 1 )
+  if(bResult)
   {
     UserApp1_pfStateMachine = UserApp1SM_Idle;
   }
@@ -123,6 +136,7 @@ Promises:
 */
 void UserApp1RunActiveState(void)
 {
+  WatchdogCheckIn(WATCHDOG_TASK_USER_APP1);
   UserApp1_pfStateMachine();
 
 } /* end UserApp1RunActiveState */
@@ -132,14 +146,73 @@ void UserApp1RunActiveState(void)
 /*! @privatesection */                                                                                            
 /*--------------------------------------------------------------------------------------------------------------------*/
 
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void UserApp1OnAntRx(const EventMessageType* psMessage_)
+@brief EVENT_TOPIC_ANT_RX: counts ANT traffic for the next status write.
+*/
+static void UserApp1OnAntRx(const EventMessageType* psMessage_)
+{
+  if(UserApp1_u8AntRxCount != 0xFF)
+  {
+    UserApp1_u8AntRxCount++;
+  }
+
+} /* end UserApp1OnAntRx() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void UserApp1OnBleStatus(const EventMessageType* psMessage_)
+@brief EVENT_TOPIC_BLE_STATUS: a client that has just connected or enabled the service gets the status straight away
+instead of at the next second.
+*/
+static void UserApp1OnBleStatus(const EventMessageType* psMessage_)
+{
+  u32 u32Status;
+
+  memcpy(&u32Status, psMessage_->au8Payload, sizeof(u32Status));
+  if(u32Status & _BPENGENUICS_CONNECTED)
+  {
+    UserApp1_u32LastStatusS = G_u32SystemTime1s - 1;
+  }
+
+} /* end UserApp1OnBleStatus() */
+
+
 
 /**********************************************************************************************************************
 State Machine Function Definitions
 **********************************************************************************************************************/
 /*-------------------------------------------------------------------------------------------------------------------*/
-/* What does this state do? */
+/* Publish the device status through the BLE State Characteristic once per second */
 static void UserApp1SM_Idle(void)
 {
+  u8 au8Uptime[4];
+  u8 u8Byte;
+  u32 u32Uptime = G_u32SystemTime1s;
+
+  if(u32Uptime == UserApp1_u32LastStatusS)
+  {
+    return;
+  }
+  UserApp1_u32LastStatusS = u32Uptime;
+
+  /* Fields are composed one at a time; the client only sees them together once committed */
+  au8Uptime[0] = (u8)u32Uptime;
+  au8Uptime[1] = (u8)(u32Uptime >> 8);
+  au8Uptime[2] = (u8)(u32Uptime >> 16);
+  au8Uptime[3] = (u8)(u32Uptime >> 24);
+  (void)BPEngenuicsStateWrite(U8_USERAPP1_STATUS_UPTIME, au8Uptime, sizeof(au8Uptime));
+
+  u8Byte = AntScanCount();
+  (void)BPEngenuicsStateWrite(U8_USERAPP1_STATUS_DEVICES, &u8Byte, 1);
+  u8Byte = G_sBLEAdvStats.u8Policy;
+  (void)BPEngenuicsStateWrite(U8_USERAPP1_STATUS_POLICY, &u8Byte, 1);
+  u8Byte = (u8)WatchdogGetResetReason();
+  (void)BPEngenuicsStateWrite(U8_USERAPP1_STATUS_RESET, &u8Byte, 1);
+  (void)BPEngenuicsStateWrite(U8_USERAPP1_STATUS_ANT_RX, &UserApp1_u8AntRxCount, 1);
+  UserApp1_u8AntRxCount = 0;
+
+  (void)BPEngenuicsStateCommit(TRUE);
     
 } /* end UserApp1SM_Idle() */
      
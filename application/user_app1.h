@@ -50,11 +50,20 @@ State Machine Declarations
 static void UserApp1SM_Idle(void);    
 static void UserApp1SM_Error(void);         
 
+static void UserApp1OnAntRx(const EventMessageType* psMessage_);
+static void UserApp1OnBleStatus(const EventMessageType* psMessage_);
+
 
 
 /**********************************************************************************************************************
 Constants / Definitions
 **********************************************************************************************************************/
+/* Status published in the BLE State Characteristic (U8_BPENGENUICS_STATE_SIZE bytes, little endian) */
+#define U8_USERAPP1_STATUS_UPTIME      (u8)0      /* Seconds since reset, u32 */
+#define U8_USERAPP1_STATUS_DEVICES     (u8)4      /* Devices in the ANT scan table */
+#define U8_USERAPP1_STATUS_POLICY      (u8)5      /* Current BLEAdvPolicyType */
+#define U8_USERAPP1_STATUS_RESET       (u8)6      /* Low byte of the last RESETREAS */
+#define U8_USERAPP1_STATUS_ANT_RX      (u8)7      /* EVENT_TOPIC_ANT_RX messages in the last second, up to 255 */
 
 
 #endif /* __USER_APP1_H */
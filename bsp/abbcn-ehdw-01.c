@@ -194,26 +194,48 @@ void GpioSetup(void)
 
 
 /*!----------------------------------------------------------------------------------------------------------------------
-@fn void WatchDogSetup(void)
-@brief Configures the watchdog timer.  
+@fn bool WatchDogSetup(void)
+@brief Configures and starts the watchdog timer.  
 
-The dog runs at 32.768kHz from the slow built-in RC clock source which varies 
-over operating conditions from 30kHz to 60kHz.
+The dog runs from the 32.768kHz LFCLK.
 Since the main loop time / sleep time should be 1 ms most of the time, choosing a value
-of 5 seconds should be plenty to avoid watchdog resets.  
+of 5 seconds should be plenty to avoid watchdog resets.  Feeding is done by 
+WatchdogRunActiveState() only while every super loop task is checking in.
 
-Note: the processor allows the MR register to be written just once.
+Note: once started the WDT cannot be stopped or reconfigured until the next reset.
 
 Requires:
-- NONE
+- SoftDevice is enabled
 
 Promises:
-- Watchdog is set for 5 second timeout but not yet enabled
+- Watchdog is running with a U32_WATCHDOG_TIMEOUT_MS timeout, paused while the debugger halts the CPU
+- The TIMEOUT interrupt is enabled so the fault record can be written before the reset
+- Returns TRUE if the interrupt was enabled successfully
 
 */
-void WatchDogSetup(void)
+bool WatchDogSetup(void)
 {
-  /* Currently not configured */
+  u32 u32Result = NRF_SUCCESS;
+
+  /* A previous run may already have started it after a soft reset; configuration is then locked */
+  if(!NRF_WDT->RUNSTATUS)
+  {
+    NRF_WDT->CONFIG = (WDT_CONFIG_SLEEP_Run << WDT_CONFIG_SLEEP_Pos) | (WDT_CONFIG_HALT_Pause << WDT_CONFIG_HALT_Pos);
+    NRF_WDT->CRV = U32_WATCHDOG_CRV;
+    NRF_WDT->RREN = WDT_RREN_RR0_Enabled << WDT_RREN_RR0_Pos;
+    NRF_WDT->INTENSET = WDT_INTENSET_TIMEOUT_Enabled << WDT_INTENSET_TIMEOUT_Pos;
+    NRF_WDT->TASKS_START = 1;
+  }
+
+#ifdef SOFTDEVICE_ENABLED  
+  u32Result |= sd_nvic_SetPriority(WDT_IRQn, NRF_APP_PRIORITY_HIGH);
+  u32Result |= sd_nvic_EnableIRQ(WDT_IRQn);
+#else
+  NVIC_SetPriority(WDT_IRQn, NRF_APP_PRIORITY_HIGH);
+  NVIC_EnableIRQ(WDT_IRQn);
+#endif /* SOFTDEVICE_ENABLED */
+
+  return (u32Result == NRF_SUCCESS);
   
 } /* end WatchDogSetup() */
 
@@ -246,25 +268,34 @@ void PowerSetup(void)
 @fn void SysTickSetup(void)
 @brief Initializes the 1ms System Tick from the RTC1 peripheral.
 
+RTC1 counts the 32.768kHz LFCLK unprescaled.  A 1ms period is not a whole number of counts, so COMPARE0 is
+advanced by timebase.c with fractional accumulation; OVRFLW extends the COUNTER for 64-bit timestamps.
+
 Requires:
 - ClockSetup() to be called prior to ensure that HFCLK and LFCLK are already running.
 - SoftDevice has been enabled.
 
 Promises:
-- RTC1 is active and providing a 1ms interrupt.
+- RTC1 is active and providing a 1ms interrupt locked to the LFCLK.
+- TIMER1 sub-tick is running if TIMEBASE_SUBTICK_ENABLED.
 
 */
 bool SysTickSetup(void)
 {
   u32 u32Result = NRF_SUCCESS;
 
-  /* Configure the RTC to give a 1ms tick */
+  /* Configure the RTC to count at 32.768kHz with COMPARE0 for the ms tick and OVRFLW for the extended count */
   NRF_RTC1->TASKS_STOP = 1;
   NRF_RTC1->PRESCALER = RTC_PRESCALE_INIT;
-  NRF_RTC1->INTENSET = (1 << RTC_INTENSET_TICK_Pos);
+  NRF_RTC1->INTENSET = (1 << RTC_INTENSET_COMPARE0_Pos) | (1 << RTC_INTENSET_OVRFLW_Pos);
+#ifdef TIMEBASE_SUBTICK_ENABLED
+  /* TICK is only routed to PPI for the sub-tick TIMER; it does not interrupt */
+  NRF_RTC1->EVTENSET = (1 << RTC_EVTEN_TICK_Pos);
+#endif
   
-  /* Clear then start the RTC */
+  /* Clear, load the first compare, then start the RTC */
   NRF_RTC1->TASKS_CLEAR = 1;
+  u32Result |= TimebaseInitialize();
   NRF_RTC1->TASKS_START = 1;
 
 #ifdef SOFTDEVICE_ENABLED  
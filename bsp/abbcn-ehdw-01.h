@@ -79,7 +79,7 @@ the development board does not require and other GPIOE events or tasks. */
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected Functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
-void WatchDogSetup(void);
+bool WatchDogSetup(void);
 void PowerSetup(void);
 void GpioSetup(void);
 bool ClockSetup(void);
@@ -106,18 +106,7 @@ $$$$$ PWM setup values
 #define LFCLK_FREQ                (u32)32768
 #define HFCLK_FREQ                (u32)16000000
 
-#define RTC_PRESCALE_INIT         (u32)31         /* Set for ~1ms: (32768Hz / 1000Hz) - 1 = 31 */
-
-
-/* Timer 1
-To get roughly a 1ms tick, set the prescale register value to 0 which results in a prescale value of 1.
-Then we can count up to 33 to get a 1.0071ms tick.  That gives 993 for the value to count to for the 1 second tick. */
-
-#define LFCLK_FREQ               (u32)32768
-#define HFCLK_FREQ               (u32)16000000
-
-#define RTC_COMPARE_PERIOD       (u32)33
-#define RTC_TICK_PER_SECOND      (u32)993
+#define RTC_PRESCALE_INIT         (u32)0          /* Unprescaled 32768Hz; the 1ms tick is made by timebase.c */
 
 /* Watch Dog Values */
 
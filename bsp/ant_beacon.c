@@ -0,0 +1,333 @@
+/**********************************************************************************************************************
+File: ant_beacon.c
+
+Description:
+ANT broadcast beacon: a master channel that runs alongside BLE advertising and broadcasts device status.
+
+Each broadcast carries one 8-byte page: uptime, mode (BLE state, advertising policy, reset cause), or supply and
+temperature.  Pages rotate through AntBeacon_au8Rotation, each held for
+U8_ANTBEACON_PAGE_HOLD messages so a receiver that misses a few still sees every page.
+
+The ANT stack repeats the staged payload every period on its own, so the page for the next message is built on
+each EVENT_TX and only handed to sd_ant_broadcast_message_tx() if it differs from what is already staged.  Most
+messages inside a hold therefore cost no stack call at all.
+
+The period defaults to 4Hz.  AntBeaconSetPeriod() changes it at once and stores it; a BLE client reaches it by
+writing the KVSTORE_KEY_ANT_PERIOD setting (see KVStoreOnSettingFrame()).
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+AntBeaconStatsType G_sAntBeaconStats;                  /* Broadcast activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+extern BLEAdvStatsType G_sBLEAdvStats;                 /*!< @brief From ble_advertising.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "AntBeacon_" and be declared as static.
+***********************************************************************************************************************/
+static const u8 AntBeacon_au8Rotation[U8_ANTBEACON_ROTATION_LENGTH] =
+  {U8_ANTBEACON_PAGE_UPTIME, U8_ANTBEACON_PAGE_MODE, U8_ANTBEACON_PAGE_UPTIME,
+   U8_ANTBEACON_PAGE_BATTERY};
+
+static u8 AntBeacon_u8Slot;                            /* Current position in AntBeacon_au8Rotation */
+static u8 AntBeacon_u8Hold;                            /* Messages sent with the current page */
+static u8 AntBeacon_au8Staged[ANT_STANDARD_DATA_PAYLOAD_SIZE]; /* Payload the stack is repeating */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntBeaconSetPeriod(u16 u16Period_)
+@brief Changes the broadcast period and stores it for the next reset.
+
+Requires:
+- AntBeaconInitialize() has run
+@param u16Period_ is the message period in 1/32768s
+
+Promises:
+- Returns TRUE if the channel now broadcasts every u16Period_
+- Returns FALSE (period unchanged) if u16Period_ is out of range or the stack refused it
+
+*/
+bool AntBeaconSetPeriod(u16 u16Period_)
+{
+  if(u16Period_ < U16_ANTBEACON_PERIOD_MIN)
+  {
+    return FALSE;
+  }
+
+  if(sd_ant_channel_period_set(U8_ANTBEACON_CHANNEL, u16Period_) != NRF_SUCCESS)
+  {
+    G_sAntBeaconStats.u32Errors++;
+    return FALSE;
+  }
+
+  G_sAntBeaconStats.u16Period = u16Period_;
+  (void)KVStoreSet(KVSTORE_KEY_ANT_PERIOD, &u16Period_, sizeof(u16Period_));
+  return TRUE;
+
+} /* end AntBeaconSetPeriod() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntBeaconInitialize(void)
+@brief Sets up and opens the broadcast channel.
+
+Requires:
+- ANTIntegrationInitialize() and KVStoreInitialize() have run
+
+Promises:
+- The channel is open with the stored (or default) period and the first page staged
+- Returns TRUE if every stack call succeeded
+
+*/
+bool AntBeaconInitialize(void)
+{
+  u32 u32Result = NRF_SUCCESS;
+  u16 u16Period;
+  u16 u16DeviceNumber;
+
+  memset(&G_sAntBeaconStats, 0, sizeof(G_sAntBeaconStats));
+  AntBeacon_u8Slot = 0;
+  AntBeacon_u8Hold = 0;
+  memset(AntBeacon_au8Staged, 0, sizeof(AntBeacon_au8Staged));
+
+  if( (KVStoreGet(KVSTORE_KEY_ANT_PERIOD, &u16Period, sizeof(u16Period)) != sizeof(u16Period)) ||
+      (u16Period < U16_ANTBEACON_PERIOD_MIN) )
+  {
+    u16Period = U16_ANTBEACON_PERIOD_DEFAULT;
+  }
+
+  /* Device number from the chip ID; 0 is the search wildcard */
+  u16DeviceNumber = (u16)NRF_FICR->DEVICEID[0];
+  if(u16DeviceNumber == 0)
+  {
+    u16DeviceNumber = 1;
+  }
+
+  if(!ANTIntegrationRegisterHandler(U8_ANTBEACON_CHANNEL, AntBeaconChannelHandler))
+  {
+    return FALSE;
+  }
+
+  u32Result |= sd_ant_channel_assign(U8_ANTBEACON_CHANNEL, CHANNEL_TYPE_MASTER, U8_ANTBEACON_NETWORK, 0);
+  u32Result |= sd_ant_channel_id_set(U8_ANTBEACON_CHANNEL, u16DeviceNumber, U8_ANTBEACON_DEVICE_TYPE,
+                                     U8_ANTBEACON_TRANSMISSION_TYPE);
+  u32Result |= sd_ant_channel_radio_freq_set(U8_ANTBEACON_CHANNEL, U8_ANTBEACON_RF_FREQ);
+  u32Result |= sd_ant_channel_period_set(U8_ANTBEACON_CHANNEL, u16Period);
+  if(u32Result != NRF_SUCCESS)
+  {
+    G_sAntBeaconStats.u32Errors++;
+    return FALSE;
+  }
+
+  G_sAntBeaconStats.u16Period = u16Period;
+  G_sAntBeaconStats.u16DeviceNumber = u16DeviceNumber;
+
+  (void)AntBeaconStage();
+  return (sd_ant_channel_open(U8_ANTBEACON_CHANNEL) == NRF_SUCCESS);
+
+} /* end AntBeaconInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBeaconChannelHandler(u8 u8Channel_)
+@brief Channel events from the ANT pump: each EVENT_TX advances the rotation and stages the next page.
+*/
+static void AntBeaconChannelHandler(u8 u8Channel_)
+{
+  AntEventType sEvent;
+
+  while(ANTIntegrationRead(u8Channel_, &sEvent))
+  {
+    switch(sEvent.u8Event)
+    {
+      case EVENT_TX:
+      {
+        G_sAntBeaconStats.u32Messages++;
+
+        AntBeacon_u8Hold++;
+        if(AntBeacon_u8Hold >= U8_ANTBEACON_PAGE_HOLD)
+        {
+          AntBeacon_u8Hold = 0;
+          AntBeacon_u8Slot++;
+          if(AntBeacon_u8Slot >= U8_ANTBEACON_ROTATION_LENGTH)
+          {
+            AntBeacon_u8Slot = 0;
+          }
+        }
+
+        (void)AntBeaconStage();
+        break;
+      }
+
+      case EVENT_CHANNEL_CLOSED:
+      {
+        /* Nothing here closes the channel, so keep broadcasting */
+        if(sd_ant_channel_open(U8_ANTBEACON_CHANNEL) != NRF_SUCCESS)
+        {
+          G_sAntBeaconStats.u32Errors++;
+        }
+        break;
+      }
+
+      default:
+      {
+        break;
+      }
+    } /* end switch */
+  }
+
+} /* end AntBeaconChannelHandler() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBeaconBuildPage(u8 u8Page_, u8* pu8Page_)
+@brief Fills an 8-byte page with current values.  Multi-byte fields are little endian, as in ANT+ pages.
+*/
+static void AntBeaconBuildPage(u8 u8Page_, u8* pu8Page_)
+{
+  u32 u32Value;
+  s32 s32Temperature = 0;
+
+  memset(pu8Page_, U8_ANTBEACON_RESERVED, ANT_STANDARD_DATA_PAYLOAD_SIZE);
+  pu8Page_[0] = u8Page_;
+
+  switch(u8Page_)
+  {
+    case U8_ANTBEACON_PAGE_UPTIME:
+    {
+      u32Value = G_u32SystemTime1s;
+      pu8Page_[1] = (u8)u32Value;
+      pu8Page_[2] = (u8)(u32Value >> 8);
+      pu8Page_[3] = (u8)(u32Value >> 16);
+      pu8Page_[4] = (u8)(u32Value >> 24);
+      break;
+    }
+
+    case U8_ANTBEACON_PAGE_MODE:
+    {
+      pu8Page_[1] = 0;
+      if(bleperipheralGetConnHandle() != BLE_CONN_HANDLE_INVALID)
+      {
+        pu8Page_[1] |= _ANTBEACON_MODE_BLE_CONNECTED;
+      }
+      if(BLEBeaconIsEnabled())
+      {
+        pu8Page_[1] |= _ANTBEACON_MODE_BLE_BEACON;
+      }
+      pu8Page_[2] = G_sBLEAdvStats.u8Policy;
+      pu8Page_[3] = (u8)WatchdogGetResetReason();
+      break;
+    }
+
+    case U8_ANTBEACON_PAGE_BATTERY:
+    {
+      u32Value = AntBeaconSupplyMv();
+      pu8Page_[1] = (u8)u32Value;
+      pu8Page_[2] = (u8)(u32Value >> 8);
+
+      /* sd_temp_get() is in 0.25C steps */
+      (void)sd_temp_get((int32_t*)&s32Temperature);
+      pu8Page_[3] = (u8)(s8)(s32Temperature / 4);
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  } /* end switch */
+
+} /* end AntBeaconBuildPage() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool AntBeaconStage(void)
+@brief Builds the current page and stages it if it differs from the payload already staged.
+
+Promises:
+- Returns TRUE if the stack holds the current page
+
+*/
+static bool AntBeaconStage(void)
+{
+  u8 au8Page[ANT_STANDARD_DATA_PAYLOAD_SIZE];
+
+  AntBeaconBuildPage(AntBeacon_au8Rotation[AntBeacon_u8Slot], au8Page);
+  if(memcmp(au8Page, AntBeacon_au8Staged, sizeof(au8Page)) == 0)
+  {
+    G_sAntBeaconStats.u32Unchanged++;
+    return TRUE;
+  }
+
+  if(sd_ant_broadcast_message_tx(U8_ANTBEACON_CHANNEL, sizeof(au8Page), au8Page) != NRF_SUCCESS)
+  {
+    G_sAntBeaconStats.u32Errors++;
+    return FALSE;
+  }
+
+  memcpy(AntBeacon_au8Staged, au8Page, sizeof(au8Page));
+  G_sAntBeaconStats.u32Staged++;
+  return TRUE;
+
+} /* end AntBeaconStage() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u16 AntBeaconSupplyMv(void)
+@brief Measures VDD with the ADC: 1/3 prescaled supply against the 1.2V bandgap, 10 bits (about 70us).
+*/
+static u16 AntBeaconSupplyMv(void)
+{
+  u32 u32Result;
+
+  NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
+                    (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                    (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos);
+  NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Enabled;
+  NRF_ADC->EVENTS_END = 0;
+  NRF_ADC->TASKS_START = 1;
+  while(NRF_ADC->EVENTS_END == 0);
+
+  u32Result = NRF_ADC->RESULT;
+  NRF_ADC->EVENTS_END = 0;
+  NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Disabled;
+
+  /* Full scale is 3 x 1200mV */
+  return (u16)((u32Result * 3600) / 1023);
+
+} /* end AntBeaconSupplyMv() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,89 @@
+/**********************************************************************************************************************
+File: ant_beacon.h
+
+Description:
+Header file for ant_beacon.c
+**********************************************************************************************************************/
+
+#ifndef __ANT_BEACON_H
+#define __ANT_BEACON_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Channel: independent master broadcast on the public network at the ANT default frequency */
+#define U8_ANTBEACON_CHANNEL              (u8)2        /* Channel 0 is the scan channel (ant_scan.c) */
+#define U8_ANTBEACON_NETWORK              (u8)0        /* Public network (no key set) */
+#define U8_ANTBEACON_RF_FREQ              (u8)66       /* 2466MHz */
+#define U8_ANTBEACON_DEVICE_TYPE          (u8)0x7A     /* Vendor-specific */
+#define U8_ANTBEACON_TRANSMISSION_TYPE    (u8)0x01     /* Independent channel */
+
+/* Message period in 1/32768s: default 4Hz, limits 30Hz .. 0.5Hz */
+#define U16_ANTBEACON_PERIOD_DEFAULT      (u16)8192
+#define U16_ANTBEACON_PERIOD_MIN          (u16)1092
+
+#define U8_ANTBEACON_PAGE_HOLD            (u8)4        /* Messages each page is broadcast before rotating */
+#define U8_ANTBEACON_ROTATION_LENGTH      (u8)4        /* Pages in one rotation */
+#define U8_ANTBEACON_RESERVED             (u8)0xFF     /* Unused page bytes */
+
+/* Page numbers (byte 0 of every message) */
+#define U8_ANTBEACON_PAGE_UPTIME          (u8)0x01     /* [page][uptime s u32][0xFF x3] */
+#define U8_ANTBEACON_PAGE_MODE            (u8)0x02     /* [page][mode flags][adv policy][RESETREAS low byte][0xFF x4] */
+#define U8_ANTBEACON_PAGE_BATTERY         (u8)0x03     /* [page][supply mV u16][temperature C s8][0xFF x4] */
+
+/* Mode page flags */
+#define _ANTBEACON_MODE_BLE_CONNECTED     (u8)0x01     /* A central is connected */
+#define _ANTBEACON_MODE_BLE_BEACON        (u8)0x02     /* BLE beacon mode owns advertising */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@struct AntBeaconStatsType
+@brief Broadcast activity.
+*/
+typedef struct
+{
+  u32 u32Messages;                        /*!< @brief Broadcasts sent (EVENT_TX) */
+  u32 u32Staged;                          /*!< @brief New payloads handed to the stack */
+  u32 u32Unchanged;                       /*!< @brief Broadcasts that repeated the staged payload */
+  u32 u32Errors;                          /*!< @brief Stack calls that failed */
+  u16 u16Period;                          /*!< @brief Current message period (1/32768s) */
+  u16 u16DeviceNumber;                    /*!< @brief Channel device number */
+} AntBeaconStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool AntBeaconSetPeriod(u16 u16Period_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool AntBeaconInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void AntBeaconChannelHandler(u8 u8Channel_);
+static void AntBeaconBuildPage(u8 u8Page_, u8* pu8Page_);
+static bool AntBeaconStage(void);
+static u16 AntBeaconSupplyMv(void);
+
+
+#endif /* __ANT_BEACON_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
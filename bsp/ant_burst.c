@@ -0,0 +1,846 @@
+/**********************************************************************************************************************
+File: ant_burst.c
+
+Description:
+ANT burst transfer engine: moves bulk objects over a master channel with burst (or advanced burst) transfers.
+
+Sending: AntBurstSend() streams an object as one burst of a header packet, the data padded to whole 8-byte packets,
+and a trailer packet holding the CRC16 of the data.  The data is pulled from the caller in U16_ANTBURST_SEGMENT_SIZE
+pieces into two chained buffers: while the stack sends one, the other is already filled, and each
+EVENT_TRANSFER_NEXT_DATA_BLOCK hands the filled buffer over and refills the one just released.  A burst that fails
+(EVENT_TRANSFER_TX_FAILED) is resent from the start up to U8_ANTBURST_MAX_RETRIES times.
+
+Receiving: a collector bursts objects to the same channel in the same format.  The header names a target registered
+with BPBulkRegisterObject(), so anything that can be uploaded over BLE can be uploaded over ANT into the same sink.
+A header with a non-zero offset resumes an object where the last good burst ended.  Data is written to the sink as
+it arrives and only counts once the burst's CRC matches; otherwise the next offset falls back to the last good one.
+
+Between bursts the channel broadcasts U8_ANTBURST_PAGE_STATUS so the collector can see how far its object got.
+A collector asks for an object with U8_ANTBURST_PAGE_REQUEST; U8_ANTBURST_OBJECT_EVENTLOG sends the event log as
+EventLogRecordType records, oldest first.
+
+G_sAntBurstStats.u32TxLastBytesPerSecond and u32RxLastBytesPerSecond are measured the same way as
+G_sBPBulkStats.u32LastBytesPerSecond so the two transports can be compared on target.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+AntBurstStatsType G_sAntBurstStats;                    /* Transfer activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+extern AntBeaconStatsType G_sAntBeaconStats;           /*!< @brief From ant_beacon.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "AntBurst_" and be declared as static.
+***********************************************************************************************************************/
+static u8 AntBurst_au8Staged[ANT_STANDARD_DATA_PAYLOAD_SIZE]; /* Status page the stack is repeating */
+
+/* Sending */
+static bool AntBurst_bTxBusy;                          /* A send is in progress */
+static u8 AntBurst_u8TxId;                             /* Object being sent */
+static u32 AntBurst_u32TxSize;                         /* Its size */
+static AntBurstReadType AntBurst_pfTxRead;             /* Its data source */
+static AntBurstDoneType AntBurst_pfTxDone;             /* Its completion callback */
+static u8 AntBurst_u8TxRetries;                        /* Bursts resent for this object */
+static u32 AntBurst_u32TxStartMs;                      /* Time of the first burst request */
+static u32 AntBurst_u32TxStreamSize;                   /* Header, padded data and trailer */
+static u32 AntBurst_u32TxPosition;                     /* Stream bytes filled so far (header, data, padding, trailer) */
+static u16 AntBurst_u16TxCrc;                          /* CRC16 of the data filled so far */
+static u8 AntBurst_au8TxSegments[U8_ANTBURST_SEGMENTS][U16_ANTBURST_SEGMENT_SIZE];
+static u16 AntBurst_u16TxPrefilled;                    /* Bytes waiting in the next segment */
+static u8 AntBurst_u8TxNext;                           /* Filled segment not yet requested, or NO_SEGMENT */
+
+/* Receiving */
+static bool AntBurst_bRxActive;                        /* A burst is being received */
+static const BPBulkObjectType* AntBurst_psRxObject;    /* Its target, NULL when there is nothing to resume */
+static u8 AntBurst_u8RxId;                             /* ID from the last good header */
+static u32 AntBurst_u32RxSize;                         /* Announced object size */
+static u32 AntBurst_u32RxNext;                         /* Offset of the next data byte */
+static u32 AntBurst_u32RxVerified;                     /* Data confirmed by burst CRCs */
+static u16 AntBurst_u16RxCrc;                          /* CRC16 of this burst's data so far */
+static u16 AntBurst_u16RxCrcExpected;                  /* CRC16 from the trailer */
+static bool AntBurst_bRxTrailer;                       /* The trailer has arrived */
+static BPBulkStatusType AntBurst_eRxStatus;            /* Result reported on the status page */
+static u32 AntBurst_u32RxStartMs;                      /* Time of the header at offset 0 */
+static u8 AntBurst_au8RxBuffer[U8_ANTBURST_RX_BUFFER_SIZE]; /* Data waiting for the sink */
+static u8 AntBurst_u8RxFill;                           /* Bytes in AntBurst_au8RxBuffer */
+static const BPBulkObjectType* AntBurst_psRxFinishing; /* Object waiting for its completion callback */
+static u32 AntBurst_u32RxFinishSize;                   /* Size of that object */
+
+/* Requested objects */
+static u32 AntBurst_u32LogFirst;                       /* Event log index at offset 0 of the log being sent */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntBurstSend(u8 u8Id_, u32 u32Size_, AntBurstReadType pfRead_, AntBurstDoneType pfDone_)
+@brief Starts sending an object to the collector on the burst channel.
+
+Requires:
+- AntBurstInitialize() has run
+@param u8Id_ identifies the object to the collector
+@param u32Size_ is the object size, 1 to U32_ANTBURST_MAX_SIZE bytes
+@param pfRead_ supplies the data; it is called from the ANT event handler as each segment is filled
+@param pfDone_ is called once the object is delivered or given up; may be NULL
+
+Promises:
+- Returns TRUE if the first burst is queued with the stack
+- Returns FALSE if a send is already running, the arguments are invalid or the stack refused the burst
+
+*/
+bool AntBurstSend(u8 u8Id_, u32 u32Size_, AntBurstReadType pfRead_, AntBurstDoneType pfDone_)
+{
+  if( AntBurst_bTxBusy || (pfRead_ == NULL) || (u32Size_ == 0) || (u32Size_ > U32_ANTBURST_MAX_SIZE) )
+  {
+    return FALSE;
+  }
+
+  AntBurst_u8TxId = u8Id_;
+  AntBurst_u32TxSize = u32Size_;
+  AntBurst_pfTxRead = pfRead_;
+  AntBurst_pfTxDone = pfDone_;
+  AntBurst_u8TxRetries = 0;
+  AntBurst_u32TxStartMs = G_u32SystemTime1ms;
+  AntBurst_u32TxStreamSize = U8_ANTBURST_HEADER_SIZE + U8_ANTBURST_TRAILER_SIZE +
+                             ((u32Size_ + U8_ANTBURST_PACKET_SIZE - 1) & ~(u32)(U8_ANTBURST_PACKET_SIZE - 1));
+
+  if(!AntBurstTxStart())
+  {
+    return FALSE;
+  }
+
+  AntBurst_bTxBusy = TRUE;
+  G_sAntBurstStats.u32TxStarted++;
+  return TRUE;
+
+} /* end AntBurstSend() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntBurstIsBusy(void)
+@brief Reports whether AntBurstSend() would refuse a new object.
+*/
+bool AntBurstIsBusy(void)
+{
+  return AntBurst_bTxBusy;
+
+} /* end AntBurstIsBusy() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntBurstInitialize(void)
+@brief Enables advanced burst and opens the burst channel.
+
+Requires:
+- AntBeaconInitialize() has run (the channel shares the beacon's device number)
+
+Promises:
+- The channel is open and broadcasting the status page
+- Advanced burst is offered if the stack accepts the configuration; standard burst is used otherwise
+- Returns TRUE if the channel opened
+
+*/
+bool AntBurstInitialize(void)
+{
+  u8 au8AdvConfig[U8_ANTBURST_ADV_CONFIG_SIZE] = ANTBURST_ADV_CONFIG;
+  u32 u32Result = NRF_SUCCESS;
+
+  memset(&G_sAntBurstStats, 0, sizeof(G_sAntBurstStats));
+  memset(AntBurst_au8Staged, 0, sizeof(AntBurst_au8Staged));
+  AntBurst_bTxBusy = FALSE;
+  AntBurst_u8TxNext = U8_ANTBURST_NO_SEGMENT;
+  AntBurst_bRxActive = FALSE;
+  AntBurst_psRxObject = NULL;
+  AntBurst_u8RxId = U8_BPBULK_NO_OBJECT;
+  AntBurst_psRxFinishing = NULL;
+  AntBurst_eRxStatus = BPBULK_STATUS_OK;
+
+  if(!ANTIntegrationRegisterHandler(U8_ANTBURST_CHANNEL, AntBurstChannelHandler))
+  {
+    return FALSE;
+  }
+
+  /* Advanced burst is negotiated per transfer, so a peer without it still gets standard bursts */
+  (void)sd_ant_adv_burst_config_set(au8AdvConfig, sizeof(au8AdvConfig));
+
+  u32Result |= sd_ant_channel_assign(U8_ANTBURST_CHANNEL, CHANNEL_TYPE_MASTER, U8_ANTBURST_NETWORK, 0);
+  u32Result |= sd_ant_channel_id_set(U8_ANTBURST_CHANNEL, G_sAntBeaconStats.u16DeviceNumber,
+                                     U8_ANTBURST_DEVICE_TYPE, U8_ANTBURST_TRANSMISSION_TYPE);
+  u32Result |= sd_ant_channel_radio_freq_set(U8_ANTBURST_CHANNEL, U8_ANTBURST_RF_FREQ);
+  u32Result |= sd_ant_channel_period_set(U8_ANTBURST_CHANNEL, U16_ANTBURST_PERIOD);
+  if(u32Result != NRF_SUCCESS)
+  {
+    return FALSE;
+  }
+
+  AntBurstStageStatus();
+  return (sd_ant_channel_open(U8_ANTBURST_CHANNEL) == NRF_SUCCESS);
+
+} /* end AntBurstInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstChannelHandler(u8 u8Channel_)
+@brief Channel events from the ANT pump.
+*/
+static void AntBurstChannelHandler(u8 u8Channel_)
+{
+  AntEventType sEvent;
+
+  while(ANTIntegrationRead(u8Channel_, &sEvent))
+  {
+    switch(sEvent.u8Event)
+    {
+      case EVENT_RX:
+      {
+        if( ((sEvent.u8MesgId == MESG_BROADCAST_DATA_ID) || (sEvent.u8MesgId == MESG_ACKNOWLEDGED_DATA_ID)) &&
+            (sEvent.au8Payload[0] == U8_ANTBURST_PAGE_REQUEST) )
+        {
+          AntBurstOnRequest(sEvent.au8Payload[1]);
+          break;
+        }
+
+        if( (sEvent.u8MesgId != MESG_BURST_DATA_ID) && (sEvent.u8MesgId != MESG_ADV_BURST_DATA_ID) )
+        {
+          break;
+        }
+
+        /* Sequence 0 opens a burst; anything else continues one */
+        if((sEvent.u8Sequence & SEQUENCE_NUMBER_ROLLOVER) == SEQUENCE_FIRST_MESSAGE)
+        {
+          AntBurstRxHeader(sEvent.au8Payload);
+        }
+        else if( AntBurst_bRxActive && (sEvent.u8Length == U8_ANTBURST_PACKET_SIZE) )
+        {
+          AntBurstRxPacket(sEvent.au8Payload);
+        }
+
+        if(sEvent.u8Sequence & SEQUENCE_LAST_MESSAGE)
+        {
+          AntBurstRxEnd(TRUE);
+        }
+        break;
+      }
+
+      case EVENT_TRANSFER_RX_FAILED:
+      {
+        AntBurstRxEnd(FALSE);
+        break;
+      }
+
+      case EVENT_TRANSFER_NEXT_DATA_BLOCK:
+      {
+        AntBurstTxNextSegment();
+        break;
+      }
+
+      case EVENT_TRANSFER_TX_COMPLETED:
+      {
+        if(AntBurst_bTxBusy)
+        {
+          AntBurstTxEnd(TRUE);
+        }
+        break;
+      }
+
+      case EVENT_TRANSFER_TX_FAILED:
+      {
+        if(!AntBurst_bTxBusy)
+        {
+          break;
+        }
+
+        if(AntBurst_u8TxRetries < U8_ANTBURST_MAX_RETRIES)
+        {
+          AntBurst_u8TxRetries++;
+          G_sAntBurstStats.u32TxRetries++;
+          if(AntBurstTxStart())
+          {
+            break;
+          }
+        }
+
+        AntBurstTxEnd(FALSE);
+        break;
+      }
+
+      case EVENT_TX:
+      {
+        AntBurstStageStatus();
+        break;
+      }
+
+      case EVENT_CHANNEL_CLOSED:
+      {
+        /* Nothing here closes the channel, so keep it open */
+        (void)sd_ant_channel_open(U8_ANTBURST_CHANNEL);
+        break;
+      }
+
+      default:
+      {
+        break;
+      }
+    } /* end switch */
+  }
+
+} /* end AntBurstChannelHandler() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool AntBurstTxStart(void)
+@brief Starts (or restarts) the burst for the current object: fills and requests the first segment, then prefills
+the second.
+
+Promises:
+- Returns TRUE if the stack accepted the first segment
+- Returns FALSE if the source refused the data or the stack refused the burst
+
+*/
+static bool AntBurstTxStart(void)
+{
+  u16 u16Length;
+  u8 u8Segment = BURST_SEGMENT_START;
+
+  AntBurst_u32TxPosition = 0;
+  AntBurst_u16TxCrc = U16_CRC16_INIT;
+  AntBurst_u8TxNext = U8_ANTBURST_NO_SEGMENT;
+
+  u16Length = AntBurstTxFill(AntBurst_au8TxSegments[0]);
+  if(u16Length == 0)
+  {
+    return FALSE;
+  }
+
+  if(AntBurst_u32TxPosition == AntBurst_u32TxStreamSize)
+  {
+    u8Segment |= BURST_SEGMENT_END;
+  }
+
+  if(sd_ant_burst_handler_request(U8_ANTBURST_CHANNEL, u16Length, AntBurst_au8TxSegments[0], u8Segment) != NRF_SUCCESS)
+  {
+    return FALSE;
+  }
+
+  if( !(u8Segment & BURST_SEGMENT_END) )
+  {
+    AntBurst_u16TxPrefilled = AntBurstTxFill(AntBurst_au8TxSegments[1]);
+    AntBurst_u8TxNext = 1;
+  }
+
+  return TRUE;
+
+} /* end AntBurstTxStart() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u16 AntBurstTxFill(u8* pu8Segment_)
+@brief Fills a segment with the next part of the stream: header, data, 0xFF padding and trailer.
+
+Promises:
+- Returns the bytes filled, always a multiple of 8
+- Returns 0 if the source refused to supply data
+
+*/
+static u16 AntBurstTxFill(u8* pu8Segment_)
+{
+  u16 u16Filled = 0;
+  u16 u16Chunk;
+  u32 u32DataEnd = U8_ANTBURST_HEADER_SIZE + AntBurst_u32TxSize;
+  u32 u32PadEnd = AntBurst_u32TxStreamSize - U8_ANTBURST_TRAILER_SIZE;
+
+  while( (u16Filled < U16_ANTBURST_SEGMENT_SIZE) && (AntBurst_u32TxPosition < AntBurst_u32TxStreamSize) )
+  {
+    if(AntBurst_u32TxPosition == 0)
+    {
+      /* Header; the whole object goes in one burst so the offset is always 0 */
+      memset(pu8Segment_, 0, U8_ANTBURST_HEADER_SIZE);
+      pu8Segment_[0] = U8_ANTBURST_MARKER;
+      pu8Segment_[1] = AntBurst_u8TxId;
+      pu8Segment_[2] = (u8)AntBurst_u32TxSize;
+      pu8Segment_[3] = (u8)(AntBurst_u32TxSize >> 8);
+      pu8Segment_[4] = (u8)(AntBurst_u32TxSize >> 16);
+      u16Chunk = U8_ANTBURST_HEADER_SIZE;
+    }
+    else if(AntBurst_u32TxPosition < u32DataEnd)
+    {
+      u16Chunk = U16_ANTBURST_SEGMENT_SIZE - u16Filled;
+      if(u16Chunk > (u32DataEnd - AntBurst_u32TxPosition))
+      {
+        u16Chunk = (u16)(u32DataEnd - AntBurst_u32TxPosition);
+      }
+
+      if(!AntBurst_pfTxRead(AntBurst_u32TxPosition - U8_ANTBURST_HEADER_SIZE, &pu8Segment_[u16Filled], u16Chunk))
+      {
+        return 0;
+      }
+      AntBurst_u16TxCrc = Crc16Compute(&pu8Segment_[u16Filled], u16Chunk, AntBurst_u16TxCrc);
+    }
+    else if(AntBurst_u32TxPosition < u32PadEnd)
+    {
+      u16Chunk = (u16)(u32PadEnd - AntBurst_u32TxPosition);
+      memset(&pu8Segment_[u16Filled], 0xFF, u16Chunk);
+    }
+    else
+    {
+      memset(&pu8Segment_[u16Filled], 0xFF, U8_ANTBURST_TRAILER_SIZE);
+      pu8Segment_[u16Filled] = (u8)AntBurst_u16TxCrc;
+      pu8Segment_[u16Filled + 1] = (u8)(AntBurst_u16TxCrc >> 8);
+      u16Chunk = U8_ANTBURST_TRAILER_SIZE;
+    }
+
+    u16Filled += u16Chunk;
+    AntBurst_u32TxPosition += u16Chunk;
+  }
+
+  return u16Filled;
+
+} /* end AntBurstTxFill() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstTxNextSegment(void)
+@brief EVENT_TRANSFER_NEXT_DATA_BLOCK: the stack has released a segment.  Hands over the prefilled one and refills
+the released one.
+*/
+static void AntBurstTxNextSegment(void)
+{
+  u8 u8Segment = BURST_SEGMENT_CONTINUE;
+  u8 u8Released;
+
+  if( !AntBurst_bTxBusy || (AntBurst_u8TxNext == U8_ANTBURST_NO_SEGMENT) )
+  {
+    return;
+  }
+
+  /* An empty prefill means the source refused */
+  if(AntBurst_u16TxPrefilled == 0)
+  {
+    (void)sd_ant_transfer_stop();
+    AntBurstTxEnd(FALSE);
+    return;
+  }
+
+  if(AntBurst_u32TxPosition == AntBurst_u32TxStreamSize)
+  {
+    u8Segment = BURST_SEGMENT_END;
+  }
+
+  if(sd_ant_burst_handler_request(U8_ANTBURST_CHANNEL, AntBurst_u16TxPrefilled,
+                                  AntBurst_au8TxSegments[AntBurst_u8TxNext], u8Segment) != NRF_SUCCESS)
+  {
+    /* The stack ends the burst with EVENT_TRANSFER_TX_FAILED, which retries it */
+    AntBurst_u8TxNext = U8_ANTBURST_NO_SEGMENT;
+    return;
+  }
+
+  u8Released = AntBurst_u8TxNext ^ 1;
+  AntBurst_u8TxNext = U8_ANTBURST_NO_SEGMENT;
+  if(u8Segment == BURST_SEGMENT_CONTINUE)
+  {
+    AntBurst_u16TxPrefilled = AntBurstTxFill(AntBurst_au8TxSegments[u8Released]);
+    AntBurst_u8TxNext = u8Released;
+  }
+
+} /* end AntBurstTxNextSegment() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstTxEnd(bool bSuccess_)
+@brief Finishes a send: updates the statistics and tells the caller.
+*/
+static void AntBurstTxEnd(bool bSuccess_)
+{
+  u32 u32Elapsed;
+
+  AntBurst_bTxBusy = FALSE;
+  AntBurst_u8TxNext = U8_ANTBURST_NO_SEGMENT;
+
+  if(bSuccess_)
+  {
+    u32Elapsed = G_u32SystemTime1ms - AntBurst_u32TxStartMs;
+    if(u32Elapsed == 0)
+    {
+      u32Elapsed = 1;
+    }
+
+    G_sAntBurstStats.u32TxCompleted++;
+    G_sAntBurstStats.u32TxBytes += AntBurst_u32TxSize;
+    G_sAntBurstStats.u32TxLastBytesPerSecond = (u32)(((u64)AntBurst_u32TxSize * 1000) / u32Elapsed);
+  }
+  else
+  {
+    G_sAntBurstStats.u32TxFailed++;
+  }
+
+  /* The burst replaced the broadcast payload, so stage the status page again */
+  memset(AntBurst_au8Staged, 0, sizeof(AntBurst_au8Staged));
+  AntBurstStageStatus();
+
+  if(AntBurst_pfTxDone != NULL)
+  {
+    AntBurst_pfTxDone(AntBurst_u8TxId, bSuccess_);
+  }
+
+} /* end AntBurstTxEnd() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstRxHeader(u8* pu8Packet_)
+@brief First packet of a received burst: checks the header against the registered objects.
+
+A header at offset 0 starts the object over.  A non-zero offset must match the last good burst of the same object,
+which is how the collector resumes after a failed burst without resending everything.
+*/
+static void AntBurstRxHeader(u8* pu8Packet_)
+{
+  const BPBulkObjectType* psObject;
+  u32 u32Size;
+  u32 u32Offset;
+
+  /* A new burst while one is open means the old one was cut short */
+  if(AntBurst_bRxActive)
+  {
+    AntBurstRxEnd(FALSE);
+  }
+
+  if(pu8Packet_[0] != U8_ANTBURST_MARKER)
+  {
+    return;
+  }
+
+  psObject = BPBulkFindObject(pu8Packet_[1]);
+  u32Size = pu8Packet_[2] | ((u32)pu8Packet_[3] << 8) | ((u32)pu8Packet_[4] << 16);
+  u32Offset = pu8Packet_[5] | ((u32)pu8Packet_[6] << 8) | ((u32)pu8Packet_[7] << 16);
+
+  if( (psObject == NULL) || (u32Size == 0) || (u32Size > psObject->u32MaxSize) || (u32Offset >= u32Size) )
+  {
+    AntBurst_eRxStatus = BPBULK_STATUS_REJECTED;
+    G_sAntBurstStats.u32RxErrors++;
+    AntBurstStageStatus();
+    return;
+  }
+
+  if(u32Offset == 0)
+  {
+    AntBurst_u32RxVerified = 0;
+    AntBurst_u32RxStartMs = G_u32SystemTime1ms;
+  }
+  else if( (psObject != AntBurst_psRxObject) || (u32Size != AntBurst_u32RxSize) ||
+           (u32Offset != AntBurst_u32RxVerified) )
+  {
+    AntBurst_eRxStatus = BPBULK_STATUS_REJECTED;
+    G_sAntBurstStats.u32RxErrors++;
+    AntBurstStageStatus();
+    return;
+  }
+
+  AntBurst_psRxObject = psObject;
+  AntBurst_u8RxId = psObject->u8Id;
+  AntBurst_u32RxSize = u32Size;
+  AntBurst_u32RxNext = u32Offset;
+  AntBurst_u16RxCrc = U16_CRC16_INIT;
+  AntBurst_bRxTrailer = FALSE;
+  AntBurst_u8RxFill = 0;
+  AntBurst_eRxStatus = BPBULK_STATUS_OK;
+  AntBurst_bRxActive = TRUE;
+
+} /* end AntBurstRxHeader() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstRxPacket(u8* pu8Packet_)
+@brief A data or trailer packet of the current burst.  Data goes to the sink in U8_ANTBURST_RX_BUFFER_SIZE pieces.
+*/
+static void AntBurstRxPacket(u8* pu8Packet_)
+{
+  u8 u8Length;
+
+  /* Anything after the trailer does not belong to this format */
+  if(AntBurst_bRxTrailer)
+  {
+    AntBurst_bRxTrailer = FALSE;
+    AntBurstRxEnd(FALSE);
+    return;
+  }
+
+  if(AntBurst_u32RxNext == AntBurst_u32RxSize)
+  {
+    AntBurst_u16RxCrcExpected = pu8Packet_[0] | (pu8Packet_[1] << 8);
+    AntBurst_bRxTrailer = TRUE;
+    return;
+  }
+
+  /* The last data packet may end in padding */
+  u8Length = U8_ANTBURST_PACKET_SIZE;
+  if((AntBurst_u32RxSize - AntBurst_u32RxNext) < U8_ANTBURST_PACKET_SIZE)
+  {
+    u8Length = (u8)(AntBurst_u32RxSize - AntBurst_u32RxNext);
+  }
+
+  if( ((AntBurst_u8RxFill + u8Length) > U8_ANTBURST_RX_BUFFER_SIZE) && !AntBurstRxFlush() )
+  {
+    AntBurst_eRxStatus = BPBULK_STATUS_BUSY;
+    AntBurst_bRxActive = FALSE;
+    AntBurst_u32RxNext = AntBurst_u32RxVerified;
+    G_sAntBurstStats.u32RxErrors++;
+    AntBurstStageStatus();
+    return;
+  }
+
+  memcpy(&AntBurst_au8RxBuffer[AntBurst_u8RxFill], pu8Packet_, u8Length);
+  AntBurst_u8RxFill += u8Length;
+  AntBurst_u16RxCrc = Crc16Compute(pu8Packet_, u8Length, AntBurst_u16RxCrc);
+  AntBurst_u32RxNext += u8Length;
+
+} /* end AntBurstRxPacket() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstRxEnd(bool bComplete_)
+@brief Closes the current burst.  A complete burst with a matching trailer CRC moves the verified offset on; any
+other ending falls back to the last verified offset so the collector resends from there.
+*/
+static void AntBurstRxEnd(bool bComplete_)
+{
+  u32 u32Elapsed;
+
+  if(!AntBurst_bRxActive)
+  {
+    return;
+  }
+  AntBurst_bRxActive = FALSE;
+
+  if( !bComplete_ || !AntBurst_bRxTrailer || (AntBurst_u16RxCrc != AntBurst_u16RxCrcExpected) )
+  {
+    AntBurst_eRxStatus = bComplete_ ? BPBULK_STATUS_CRC_ERROR : BPBULK_STATUS_OK;
+    AntBurst_u32RxNext = AntBurst_u32RxVerified;
+    G_sAntBurstStats.u32RxErrors++;
+    AntBurstStageStatus();
+    return;
+  }
+
+  if(!AntBurstRxFlush())
+  {
+    AntBurst_eRxStatus = BPBULK_STATUS_BUSY;
+    AntBurst_u32RxNext = AntBurst_u32RxVerified;
+    G_sAntBurstStats.u32RxErrors++;
+    AntBurstStageStatus();
+    return;
+  }
+
+  G_sAntBurstStats.u32RxBursts++;
+  G_sAntBurstStats.u32RxBytes += AntBurst_u32RxNext - AntBurst_u32RxVerified;
+  AntBurst_u32RxVerified = AntBurst_u32RxNext;
+  AntBurst_eRxStatus = BPBULK_STATUS_OK;
+
+  if(AntBurst_u32RxVerified == AntBurst_u32RxSize)
+  {
+    u32Elapsed = G_u32SystemTime1ms - AntBurst_u32RxStartMs;
+    if(u32Elapsed == 0)
+    {
+      u32Elapsed = 1;
+    }
+
+    G_sAntBurstStats.u32RxCompleted++;
+    G_sAntBurstStats.u32RxLastBytesPerSecond = (u32)(((u64)AntBurst_u32RxSize * 1000) / u32Elapsed);
+    AntBurst_eRxStatus = BPBULK_STATUS_COMPLETE;
+
+    AntBurst_psRxFinishing = AntBurst_psRxObject;
+    AntBurst_u32RxFinishSize = AntBurst_u32RxSize;
+    AntBurst_psRxObject = NULL;
+    if(!RadioSchedSubmit(RADIOSCHED_BULK_DONE, AntBurstRxFinish, NULL))
+    {
+      AntBurstRxFinish(NULL);
+    }
+  }
+
+  AntBurstStageStatus();
+
+} /* end AntBurstRxEnd() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool AntBurstRxFlush(void)
+@brief Writes the buffered data to the sink.
+
+Promises:
+- Returns TRUE if the buffer is now empty
+- Returns FALSE if the sink could not take the data
+
+*/
+static bool AntBurstRxFlush(void)
+{
+  if(AntBurst_u8RxFill == 0)
+  {
+    return TRUE;
+  }
+
+  if(!AntBurst_psRxObject->pfWrite(AntBurst_u32RxNext - AntBurst_u8RxFill, AntBurst_au8RxBuffer, AntBurst_u8RxFill))
+  {
+    return FALSE;
+  }
+
+  AntBurst_u8RxFill = 0;
+  return TRUE;
+
+} /* end AntBurstRxFlush() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstRxFinish(void* pvContext_)
+@brief radio_sched job: hands the received object to its sink.  Every burst was CRC-checked on the way in.
+*/
+static void AntBurstRxFinish(void* pvContext_)
+{
+  const BPBulkObjectType* psObject = AntBurst_psRxFinishing;
+
+  AntBurst_psRxFinishing = NULL;
+  if( (psObject != NULL) && (psObject->pfDone != NULL) )
+  {
+    psObject->pfDone(AntBurst_u32RxFinishSize, TRUE);
+  }
+
+} /* end AntBurstRxFinish() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstStageStatus(void)
+@brief Builds the status page and stages it if it differs from the payload already staged.  Skipped while a
+send owns the channel.
+*/
+static void AntBurstStageStatus(void)
+{
+  u8 au8Page[ANT_STANDARD_DATA_PAYLOAD_SIZE];
+
+  if(AntBurst_bTxBusy)
+  {
+    return;
+  }
+
+  au8Page[0] = U8_ANTBURST_PAGE_STATUS;
+  au8Page[1] = AntBurst_u8RxId;
+  au8Page[2] = (u8)AntBurst_eRxStatus;
+  au8Page[3] = (u8)AntBurst_u32RxVerified;
+  au8Page[4] = (u8)(AntBurst_u32RxVerified >> 8);
+  au8Page[5] = (u8)(AntBurst_u32RxVerified >> 16);
+  au8Page[6] = 0xFF;
+  au8Page[7] = 0xFF;
+
+  if(memcmp(au8Page, AntBurst_au8Staged, sizeof(au8Page)) == 0)
+  {
+    return;
+  }
+
+  if(sd_ant_broadcast_message_tx(U8_ANTBURST_CHANNEL, sizeof(au8Page), au8Page) == NRF_SUCCESS)
+  {
+    memcpy(AntBurst_au8Staged, au8Page, sizeof(au8Page));
+  }
+
+} /* end AntBurstStageStatus() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntBurstOnRequest(u8 u8Id_)
+@brief U8_ANTBURST_PAGE_REQUEST from the collector: starts sending the object asked for.  A request that arrives
+while a send is running, or for an empty or unknown object, is ignored; the collector repeats it.
+*/
+static void AntBurstOnRequest(u8 u8Id_)
+{
+  u32 u32Records;
+
+  if(AntBurst_bTxBusy)
+  {
+    return;
+  }
+
+  switch(u8Id_)
+  {
+    case U8_ANTBURST_OBJECT_EVENTLOG:
+    {
+      AntBurst_u32LogFirst = EventLogFirstIndex();
+      u32Records = EventLogEndIndex() - AntBurst_u32LogFirst;
+      if(u32Records != 0)
+      {
+        (void)AntBurstSend(u8Id_, u32Records * sizeof(EventLogRecordType), AntBurstReadEventLog, NULL);
+      }
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  } /* end switch */
+
+} /* end AntBurstOnRequest() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool AntBurstReadEventLog(u32 u32Offset_, u8* pu8Data_, u16 u16Length_)
+@brief AntBurstReadType source for U8_ANTBURST_OBJECT_EVENTLOG: copies records from the log snapshot taken when the
+send started.  Fails (and the send is given up) if the oldest records have been overwritten since.
+*/
+static bool AntBurstReadEventLog(u32 u32Offset_, u8* pu8Data_, u16 u16Length_)
+{
+  EventLogRecordType sRecord;
+  u8 u8Skip;
+  u8 u8Chunk;
+
+  while(u16Length_ != 0)
+  {
+    if(!EventLogRead(AntBurst_u32LogFirst + (u32Offset_ / sizeof(EventLogRecordType)), &sRecord))
+    {
+      return FALSE;
+    }
+
+    /* Segments need not start on a record boundary */
+    u8Skip = (u8)(u32Offset_ % sizeof(EventLogRecordType));
+    u8Chunk = sizeof(EventLogRecordType) - u8Skip;
+    if(u8Chunk > u16Length_)
+    {
+      u8Chunk = (u8)u16Length_;
+    }
+
+    memcpy(pu8Data_, (u8*)&sRecord + u8Skip, u8Chunk);
+    pu8Data_ += u8Chunk;
+    u32Offset_ += u8Chunk;
+    u16Length_ -= u8Chunk;
+  }
+
+  return TRUE;
+
+} /* end AntBurstReadEventLog() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
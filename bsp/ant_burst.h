@@ -0,0 +1,127 @@
+/**********************************************************************************************************************
+File: ant_burst.h
+
+Description:
+Header file for ant_burst.c
+**********************************************************************************************************************/
+
+#ifndef __ANT_BURST_H
+#define __ANT_BURST_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Channel: independent master on the public network; a collector pairs with it to exchange bursts */
+#define U8_ANTBURST_CHANNEL               (u8)1
+#define U8_ANTBURST_NETWORK               (u8)0
+#define U8_ANTBURST_RF_FREQ               (u8)66       /* 2466MHz */
+#define U8_ANTBURST_DEVICE_TYPE           (u8)0x7B     /* Vendor-specific */
+#define U8_ANTBURST_TRANSMISSION_TYPE     (u8)0x01     /* Independent channel */
+#define U16_ANTBURST_PERIOD               (u16)8192    /* 4Hz; a burst starts in the next channel slot */
+
+/* Burst stream: [header][data][0xFF padding to 8 bytes][trailer], all in 8-byte packets
+   header   [U8_ANTBURST_MARKER][object id][object size u24][offset of the first data byte u24]
+   trailer  [CRC16 of the data in this burst][0xFF x6]                                                little endian */
+#define U8_ANTBURST_MARKER                (u8)0xB0
+#define U8_ANTBURST_PACKET_SIZE           (u8)8
+#define U8_ANTBURST_HEADER_SIZE           (u8)8
+#define U8_ANTBURST_TRAILER_SIZE          (u8)8
+#define U32_ANTBURST_MAX_SIZE             (u32)0x00FFFFFF
+
+/* Transmit buffers: two segments chained so one is refilled while the stack sends the other.  A multiple of 24 so
+   advanced burst packets are never split across segments. */
+#define U16_ANTBURST_SEGMENT_SIZE         (u16)24
+#define U8_ANTBURST_SEGMENTS              (u8)2
+#define U8_ANTBURST_NO_SEGMENT            (u8)0xFF
+#define U8_ANTBURST_MAX_RETRIES           (u8)3        /* Failed bursts resent from the start before giving up */
+
+#define U8_ANTBURST_RX_BUFFER_SIZE        (u8)24       /* Received data collected before each sink write */
+
+/* Status page broadcast between bursts: [page][rx id][rx BPBulkStatusType][rx next offset u24][0xFF x2] */
+#define U8_ANTBURST_PAGE_STATUS           (u8)0x10
+
+/* Request page from the collector (broadcast or acknowledged): [page][object id][0xFF x6] */
+#define U8_ANTBURST_PAGE_REQUEST          (u8)0x11
+
+/* Objects a collector can request */
+#define U8_ANTBURST_OBJECT_EVENTLOG       (u8)0x80     /* Every stored event log record, oldest first */
+
+/* Advanced burst: offer 24-byte packets; frequency hopping is optional */
+#define ANTBURST_ADV_CONFIG               {ADV_BURST_MODE_ENABLE, ADV_BURST_MODES_SIZE_24_BYTES, 0, 0, 0, \
+                                           ADV_BURST_MODES_FREQ_HOP, 0, 0}
+#define U8_ANTBURST_ADV_CONFIG_SIZE       (u8)8
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/* Fills pu8Data_ with u16Length_ bytes of the object from u32Offset_; return FALSE to abort the send */
+typedef bool(*AntBurstReadType)(u32 u32Offset_, u8* pu8Data_, u16 u16Length_);
+
+/* Called when a send has finished; bSuccess_ FALSE after the last retry failed or the source refused */
+typedef void(*AntBurstDoneType)(u8 u8Id_, bool bSuccess_);
+
+/*!
+@struct AntBurstStatsType
+@brief Burst activity.  The rates are directly comparable with G_sBPBulkStats.u32LastBytesPerSecond for the
+BLE bulk path.
+*/
+typedef struct
+{
+  u32 u32TxStarted;                       /*!< @brief Sends accepted */
+  u32 u32TxCompleted;                     /*!< @brief Sends delivered */
+  u32 u32TxRetries;                       /*!< @brief Bursts resent after EVENT_TRANSFER_TX_FAILED */
+  u32 u32TxFailed;                        /*!< @brief Sends given up */
+  u32 u32TxBytes;                         /*!< @brief Object bytes delivered */
+  u32 u32TxLastBytesPerSecond;            /*!< @brief Object bytes / time from the first request to completion */
+  u32 u32RxBursts;                        /*!< @brief Bursts received to the end */
+  u32 u32RxCompleted;                     /*!< @brief Objects received whole with good CRCs */
+  u32 u32RxErrors;                        /*!< @brief Bursts dropped: rejected header, CRC, sink busy or RF failure */
+  u32 u32RxBytes;                         /*!< @brief Data bytes accepted */
+  u32 u32RxLastBytesPerSecond;            /*!< @brief Rate of the last object received */
+} AntBurstStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool AntBurstSend(u8 u8Id_, u32 u32Size_, AntBurstReadType pfRead_, AntBurstDoneType pfDone_);
+bool AntBurstIsBusy(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool AntBurstInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void AntBurstChannelHandler(u8 u8Channel_);
+static bool AntBurstTxStart(void);
+static u16 AntBurstTxFill(u8* pu8Segment_);
+static void AntBurstTxNextSegment(void);
+static void AntBurstTxEnd(bool bSuccess_);
+static void AntBurstRxHeader(u8* pu8Packet_);
+static void AntBurstRxPacket(u8* pu8Packet_);
+static void AntBurstRxEnd(bool bComplete_);
+static bool AntBurstRxFlush(void);
+static void AntBurstRxFinish(void* pvContext_);
+static void AntBurstStageStatus(void);
+static void AntBurstOnRequest(u8 u8Id_);
+static bool AntBurstReadEventLog(u32 u32Offset_, u8* pu8Data_, u16 u16Length_);
+
+
+#endif /* __ANT_BURST_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -3,6 +3,15 @@ File: ant_integration.c
 
 Description:
 This is a ant_integration .c file new source code
+
+ANT events are pulled from the SoftDevice in one pass per SD event and sorted by channel into small per-channel
+rings.  The module that owns a channel registers a handler with ANTIntegrationRegisterHandler(); it is called
+once the pass has drained the SoftDevice (or as soon as its ring fills during the pass) and takes its events with
+ANTIntegrationRead().  A busy channel therefore never holds up the SoftDevice queue or another channel, and BLE
+events are handled straight after without waiting for ANT processing to catch up.
+
+The first data message each channel receives in a pass is also published on EVENT_TOPIC_ANT_RX for modules that
+only want to watch the traffic.  Limiting it to one per channel keeps a busy scan from filling the event bus.
 **********************************************************************************************************************/
 
 #include "configuration.h"
@@ -13,6 +22,7 @@ All Global variable names shall start with "G_"
 ***********************************************************************************************************************/
 /* New variables */
 volatile u32 G_u32ANTIntegrationFlags;                 /* Global state flags */
+AntIntegrationStatsType G_sANTIntegrationStats;        /* ANT event pump statistics */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -27,6 +37,9 @@ Global variable definitions with scope limited to this local application.
 Variable names shall start with "SocInt_" and be declared as static.
 ***********************************************************************************************************************/
 //static u32 ANTInt_u32Timeout;                      /* Timeout counter used across states */
+static ANT_MESSAGE ANTInt_sMessage;                                     /* Message buffer for sd_ant_event_get() */
+static AntChannelRingType ANTInt_asRings[U8_ANTINT_CHANNELS];           /* Buffered events by channel */
+static AntChannelHandlerType ANTInt_apfnHandlers[U8_ANTINT_CHANNELS];   /* Channel owners */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -40,21 +53,343 @@ Function Definitions
 /* Public functions                                                                                                   */
 /*--------------------------------------------------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationRegisterHandler
+
+Description:
+Claims a channel.  Its events are buffered from now on and pfHandler_ is called whenever some are waiting.
+
+Requires:
+  - ANTIntegrationInitialize() has run
+
+Promises:
+  - Returns TRUE if pfHandler_ now owns u8Channel_
+  - Returns FALSE if the channel is not served or already has an owner
+*/
+bool ANTIntegrationRegisterHandler(u8 u8Channel_, AntChannelHandlerType pfHandler_)
+{
+  if( (u8Channel_ >= U8_ANTINT_CHANNELS) || (pfHandler_ == NULL) ||
+      (ANTInt_apfnHandlers[u8Channel_] != NULL) )
+  {
+    return FALSE;
+  }
+
+  ANTInt_apfnHandlers[u8Channel_] = pfHandler_;
+  return TRUE;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationRead
+
+Description:
+Takes the oldest buffered event for a channel.
+
+Requires:
+  - Called from the main loop (normally from the channel's handler)
+
+Promises:
+  - Returns TRUE and copies the event to psEvent_ if one was waiting
+  - Returns FALSE if the ring is empty
+*/
+bool ANTIntegrationRead(u8 u8Channel_, AntEventType* psEvent_)
+{
+  AntChannelRingType* psRing;
+
+  if(u8Channel_ >= U8_ANTINT_CHANNELS)
+  {
+    return FALSE;
+  }
+
+  psRing = &ANTInt_asRings[u8Channel_];
+  if(psRing->u8Head == psRing->u8Tail)
+  {
+    return FALSE;
+  }
+
+  *psEvent_ = psRing->asEvents[psRing->u8Tail & U8_ANTINT_RING_MASK];
+  psRing->u8Tail++;
+  return TRUE;
+}
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected functions                                                                                                */
 /*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationInitialize
+
+Description:
+Resets the ANT stack and empties the channel table.
+
+Requires:
+  - SoftDevice is enabled
+  - Called before any module registers a channel handler
+
+Promises:
+  - No channel has an owner or buffered events and statistics are cleared
+  - Returns TRUE if the ANT stack was reset
+*/
 bool ANTIntegrationInitialize(void)
 {
+  memset(ANTInt_asRings, 0, sizeof(ANTInt_asRings));
+  memset(ANTInt_apfnHandlers, 0, sizeof(ANTInt_apfnHandlers));
+  memset(&G_sANTIntegrationStats, 0, sizeof(G_sANTIntegrationStats));
+
   return sd_ant_stack_reset() == NRF_SUCCESS;
 }
 
-/**
-*   Handle the Stack Event to determine if ANT message. If 
-*   ANT Message, then set event.                       
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationHandler
+
+Description:
+ANT event pump.  Drains every event the SoftDevice holds, counts it against its channel and buffers it for the
+channel's owner, then calls the owners of the channels that have events waiting.
+
+Requires:
+  - Called from SocIntegrationHandler()
+
+Promises:
+  - The SoftDevice ANT event queue is empty
+  - Every channel handler with buffered events has been called
+  - The first data message of each served channel is published on EVENT_TOPIC_ANT_RX
+*/
+void ANTIntegrationHandler(void)
+{
+  u8 u8Channel;
+  u8 u8Event;
+  u8 u8Published = 0;
+  u32 u32Count = 0;
+
+  while(sd_ant_event_get(&u8Channel, &u8Event, ANTInt_sMessage.ANT_MESSAGE_aucMessage) == NRF_SUCCESS)
+  {
+    u32Count++;
+
+    if(u8Event == EVENT_QUE_OVERFLOW)
+    {
+      G_sANTIntegrationStats.u32StackOverflows++;
+    }
+
+    if( (u8Event == EVENT_BLOCKED) || (u8Channel >= U8_ANTINT_CHANNELS) ||
+        (ANTInt_apfnHandlers[u8Channel] == NULL) )
+    {
+      G_sANTIntegrationStats.u32Unhandled++;
+      continue;
+    }
+
+    ANTIntegrationCount(u8Channel, u8Event);
+    ANTIntegrationBuffer(u8Channel, u8Event);
+
+    if( (u8Event == EVENT_RX) && !(u8Published & (1 << u8Channel)) )
+    {
+      u8Published |= (1 << u8Channel);
+      ANTIntegrationPublish(u8Channel);
+    }
+  }
+
+  G_sANTIntegrationStats.u32Events += u32Count;
+  if(u32Count > G_sANTIntegrationStats.u32MaxEventsPerPass)
+  {
+    G_sANTIntegrationStats.u32MaxEventsPerPass = u32Count;
+  }
+
+  for(u8 i = 0; i < U8_ANTINT_CHANNELS; i++)
+  {
+    ANTIntegrationDispatch(i);
+  }
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationBuffer
+
+Description:
+Copies the event in ANTInt_sMessage into the channel's ring.
+
+An advanced burst packet (16 or 24 bytes) is split into U8_ANTINT_PAYLOAD_SIZE entries so the ring stays sized
+for standard messages.  The first entry keeps the packet's sequence bits without the last-packet flag, the others
+carry SEQUENCE_NUMBER_INC and the final one gets the flag back, so the receiver sees an ordinary burst stream.
+
+Requires:
+  - u8Channel_ is served and has a handler
+
+Promises:
+  - The event is the newest in the channel's ring
+  - Extended data (device ID, RSSI) of a standard data message is unpacked into the entry
+*/
+static void ANTIntegrationBuffer(u8 u8Channel_, u8 u8Event_)
+{
+  AntChannelRingType* psRing = &ANTInt_asRings[u8Channel_];
+  AntEventType* psEntry;
+  u8* pu8Ext;
+  u8 u8Size;
+  u8 u8Sequence = ANTInt_sMessage.ANT_MESSAGE_ucChannel & SEQUENCE_NUMBER_MASK;
+
+  /* ucSize counts the channel byte, the payload and any extended data */
+  u8Size = ANTInt_sMessage.ANT_MESSAGE_ucSize;
+
+  if( (u8Event_ == EVENT_RX) && (ANTInt_sMessage.ANT_MESSAGE_ucMesgID == MESG_ADV_BURST_DATA_ID) &&
+      (u8Size > (MESG_CHANNEL_NUM_SIZE + U8_ANTINT_PAYLOAD_SIZE)) )
+  {
+    u8Size -= MESG_CHANNEL_NUM_SIZE;
+    for(u8 u8Offset = 0; u8Offset < u8Size; u8Offset += U8_ANTINT_PAYLOAD_SIZE)
+    {
+      psEntry = ANTIntegrationNextEntry(u8Channel_);
+      psEntry->u8Event = u8Event_;
+      psEntry->u8MesgId = MESG_ADV_BURST_DATA_ID;
+      psEntry->u8Length = ((u8Size - u8Offset) < U8_ANTINT_PAYLOAD_SIZE) ? (u8Size - u8Offset) : U8_ANTINT_PAYLOAD_SIZE;
+      psEntry->u8ExtFlags = 0;
+      memcpy(psEntry->au8Payload, &ANTInt_sMessage.ANT_MESSAGE_aucPayload[u8Offset], psEntry->u8Length);
+
+      psEntry->u8Sequence = (u8Offset == 0) ? (u8Sequence & ~SEQUENCE_LAST_MESSAGE) : SEQUENCE_NUMBER_INC;
+      if((u8Offset + U8_ANTINT_PAYLOAD_SIZE) >= u8Size)
+      {
+        psEntry->u8Sequence |= (u8Sequence & SEQUENCE_LAST_MESSAGE);
+      }
+      psRing->u8Head++;
+    }
+    return;
+  }
+
+  psEntry = ANTIntegrationNextEntry(u8Channel_);
+  psEntry->u8Event = u8Event_;
+  psEntry->u8MesgId = ANTInt_sMessage.ANT_MESSAGE_ucMesgID;
+  psEntry->u8Sequence = u8Sequence;
+  psEntry->u8ExtFlags = 0;
+
+  psEntry->u8Length = (u8Size > MESG_CHANNEL_NUM_SIZE) ? (u8Size - MESG_CHANNEL_NUM_SIZE) : 0;
+  if(psEntry->u8Length > U8_ANTINT_PAYLOAD_SIZE)
+  {
+    psEntry->u8Length = U8_ANTINT_PAYLOAD_SIZE;
+  }
+  memcpy(psEntry->au8Payload, ANTInt_sMessage.ANT_MESSAGE_aucPayload, U8_ANTINT_PAYLOAD_SIZE);
+
+  if( (u8Event_ == EVENT_RX) &&
+      (u8Size > (MESG_CHANNEL_NUM_SIZE + ANT_STANDARD_DATA_PAYLOAD_SIZE)) &&
+      ((psEntry->u8MesgId == MESG_BROADCAST_DATA_ID) || (psEntry->u8MesgId == MESG_ACKNOWLEDGED_DATA_ID) ||
+       (psEntry->u8MesgId == MESG_BURST_DATA_ID)) )
+  {
+    /* Extended fields follow the flag byte in the order device ID, RSSI, time stamp */
+    psEntry->u8ExtFlags = ANTInt_sMessage.ANT_MESSAGE_ucExtMesgBF;
+    pu8Ext = ANTInt_sMessage.ANT_MESSAGE_aucExtData;
+    if(psEntry->u8ExtFlags & ANT_EXT_MESG_BITFIELD_DEVICE_ID)
+    {
+      psEntry->u16DeviceNumber = pu8Ext[0] | (pu8Ext[1] << 8);
+      psEntry->u8DeviceType = pu8Ext[2];
+      psEntry->u8TransmissionType = pu8Ext[3];
+      pu8Ext += ANT_EXT_MESG_DEVICE_ID_FIELD_SIZE;
+    }
+
+    /* RSSI field: measurement type, value, threshold */
+    if(psEntry->u8ExtFlags & ANT_EXT_MESG_BITFIELD_RSSI)
+    {
+      psEntry->s8Rssi = (s8)pu8Ext[1];
+    }
+  }
+
+  psRing->u8Head++;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationNextEntry
+
+Description:
+Finds the ring entry for the next event.  A full ring is first offered to its handler; if that does not make room
+the oldest event is overwritten, since fresh data is worth more than stale.
+
+Promises:
+  - Returns the entry at the ring head; the caller fills it and advances u8Head
+*/
+static AntEventType* ANTIntegrationNextEntry(u8 u8Channel_)
+{
+  AntChannelRingType* psRing = &ANTInt_asRings[u8Channel_];
+
+  if((u8)(psRing->u8Head - psRing->u8Tail) == U8_ANTINT_RING_SIZE)
+  {
+    ANTIntegrationDispatch(u8Channel_);
+    if((u8)(psRing->u8Head - psRing->u8Tail) == U8_ANTINT_RING_SIZE)
+    {
+      G_sANTIntegrationStats.asChannels[u8Channel_].u32Overflow++;
+      psRing->u8Tail++;
+    }
+  }
+
+  return &psRing->asEvents[psRing->u8Head & U8_ANTINT_RING_MASK];
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationCount
+
+Description:
+Adds an event to its channel's traffic counters.
+*/
+static void ANTIntegrationCount(u8 u8Channel_, u8 u8Event_)
+{
+  AntChannelStatsType* psStats = &G_sANTIntegrationStats.asChannels[u8Channel_];
+
+  switch(u8Event_)
+  {
+    case EVENT_RX:
+      psStats->u32Rx++;
+      break;
+
+    case EVENT_TX:
+    case EVENT_TRANSFER_TX_COMPLETED:
+      psStats->u32Tx++;
+      break;
+
+    case EVENT_RX_FAIL:
+    case EVENT_RX_FAIL_GO_TO_SEARCH:
+    case EVENT_TRANSFER_RX_FAILED:
+    case EVENT_TRANSFER_TX_FAILED:
+    case EVENT_CHANNEL_COLLISION:
+      psStats->u32Fail++;
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationPublish
+
+Description:
+Publishes the data message in ANTInt_sMessage on EVENT_TOPIC_ANT_RX as [channel][MESG_xxx_ID][payload].
+*/
+static void ANTIntegrationPublish(u8 u8Channel_)
+{
+  u8 au8Message[2 + ANT_STANDARD_DATA_PAYLOAD_SIZE];
+
+  au8Message[0] = u8Channel_;
+  au8Message[1] = ANTInt_sMessage.ANT_MESSAGE_ucMesgID;
+  memcpy(&au8Message[2], ANTInt_sMessage.ANT_MESSAGE_aucPayload, ANT_STANDARD_DATA_PAYLOAD_SIZE);
+  (void)EventBusPublish(EVENT_TOPIC_ANT_RX, au8Message, sizeof(au8Message));
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ANTIntegrationDispatch
+
+Description:
+Calls a channel's handler if it has events waiting.
 */
-void ANTIntegrationHandler()
+static void ANTIntegrationDispatch(u8 u8Channel_)
 {
-    
+  if( (ANTInt_apfnHandlers[u8Channel_] != NULL) &&
+      (ANTInt_asRings[u8Channel_].u8Head != ANTInt_asRings[u8Channel_].u8Tail) )
+  {
+    ANTInt_apfnHandlers[u8Channel_](u8Channel_);
+  }
 }
 
 
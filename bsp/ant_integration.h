@@ -8,15 +8,17 @@ Header file for ant_integration.c
 #ifndef __ANTINT_H
 #define __ANTINT_H
 
-/**********************************************************************************************************************
-Type Definitions
-**********************************************************************************************************************/
-
+#include "typedefs.h"
 
 /**********************************************************************************************************************
 Constants / Definitions
 **********************************************************************************************************************/
 #define ANTINT_INIT (u32)0x00
+
+#define U8_ANTINT_CHANNELS              (u8)3             /* Scan, burst, beacon; higher channels are dropped */
+#define U8_ANTINT_RING_SIZE             (u8)2             /* Events buffered per channel; must be a power of 2 */
+#define U8_ANTINT_RING_MASK             (u8)(U8_ANTINT_RING_SIZE - 1)
+#define U8_ANTINT_PAYLOAD_SIZE          ANT_STANDARD_DATA_PAYLOAD_SIZE
 /*
     31 [0] 
     30 [0] 
@@ -60,6 +62,68 @@ Constants / Definitions
 */
 
 
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@struct AntEventType
+@brief One ANT event as buffered for its channel.  Only data messages (u8Event EVENT_RX) carry a payload; the
+extended fields are valid when the matching ANT_EXT_MESG_BITFIELD_ bit is set in u8ExtFlags.
+*/
+typedef struct
+{
+  u8 u8Event;                             /*!< @brief EVENT_xxx code from ant_parameters.h */
+  u8 u8MesgId;                            /*!< @brief MESG_xxx_ID of the message that carried the event */
+  u8 u8Length;                            /*!< @brief Payload bytes */
+  u8 u8Sequence;                          /*!< @brief Burst sequence bits (SEQUENCE_NUMBER_MASK) */
+  u8 au8Payload[U8_ANTINT_PAYLOAD_SIZE];  /*!< @brief Data payload, or the response/event bytes */
+  u8 u8ExtFlags;                          /*!< @brief ANT_EXT_MESG_BITFIELD_xxx present in the message */
+  s8 s8Rssi;                              /*!< @brief Received signal strength in dBm */
+  u16 u16DeviceNumber;                    /*!< @brief Transmitter's device number */
+  u8 u8DeviceType;                        /*!< @brief Transmitter's device type */
+  u8 u8TransmissionType;                  /*!< @brief Transmitter's transmission type */
+} AntEventType;
+
+/* Called once the pump has buffered events for a channel; the handler takes them with ANTIntegrationRead() */
+typedef void(*AntChannelHandlerType)(u8 u8Channel_);
+
+/*!
+@struct AntChannelRingType
+@brief Events waiting for one channel's handler.  Head and tail run freely and are masked on use.
+*/
+typedef struct
+{
+  AntEventType asEvents[U8_ANTINT_RING_SIZE]; /*!< @brief Buffered events */
+  u8 u8Head;                              /*!< @brief Count of events written */
+  u8 u8Tail;                              /*!< @brief Count of events read */
+} AntChannelRingType;
+
+/*!
+@struct AntChannelStatsType
+@brief Traffic on one channel.
+*/
+typedef struct
+{
+  u32 u32Rx;                              /*!< @brief Data messages received */
+  u32 u32Tx;                              /*!< @brief Transmissions and completed transfers */
+  u32 u32Fail;                            /*!< @brief Missed messages and failed transfers */
+  u32 u32Overflow;                        /*!< @brief Events lost because the handler had not emptied the ring */
+} AntChannelStatsType;
+
+/*!
+@struct AntIntegrationStatsType
+@brief ANT event pump statistics.
+*/
+typedef struct
+{
+  u32 u32Events;                          /*!< @brief Events pulled from the SoftDevice */
+  u32 u32Unhandled;                       /*!< @brief Events for a channel with no handler */
+  u32 u32StackOverflows;                  /*!< @brief EVENT_QUE_OVERFLOW reports (the SoftDevice lost events) */
+  u32 u32MaxEventsPerPass;                /*!< @brief Most events drained by one call of the pump */
+  AntChannelStatsType asChannels[U8_ANTINT_CHANNELS]; /*!< @brief Per-channel traffic */
+} AntIntegrationStatsType;
+
+
 /**********************************************************************************************************************
 Function Declarations
 **********************************************************************************************************************/
@@ -67,6 +131,8 @@ Function Declarations
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Public functions                                                                                                   */
 /*--------------------------------------------------------------------------------------------------------------------*/
+bool ANTIntegrationRegisterHandler(u8 u8Channel_, AntChannelHandlerType pfHandler_);
+bool ANTIntegrationRead(u8 u8Channel_, AntEventType* psEvent_);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -80,6 +146,11 @@ void ANTIntegrationHandler(void);
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private functions                                                                                                  */
 /*--------------------------------------------------------------------------------------------------------------------*/
+static void ANTIntegrationBuffer(u8 u8Channel_, u8 u8Event_);
+static AntEventType* ANTIntegrationNextEntry(u8 u8Channel_);
+static void ANTIntegrationCount(u8 u8Channel_, u8 u8Event_);
+static void ANTIntegrationPublish(u8 u8Channel_);
+static void ANTIntegrationDispatch(u8 u8Channel_);
 
 
 
@@ -0,0 +1,431 @@
+/**********************************************************************************************************************
+File: ant_scan.c
+
+Description:
+ANT scan-mode collector: receives every ANT master in range and keeps a table of the devices heard.
+
+sd_ant_rx_scan_mode_start() turns channel 0 into a continuous receiver that takes any channel ID, and the library
+is set to append the device ID and RSSI to each message so the sender can be told apart.  The beacon and burst
+masters keep transmitting on their own channels alongside.  The stack will only enter scan mode while every other
+channel is closed, so AntScanInitialize() must run before the masters are opened.
+
+The table holds U8_ANTSCAN_DEVICES small entries (channel ID, RSSI, last-seen second and the first
+U8_ANTSCAN_PAYLOAD_SIZE payload bytes) in a fixed array: nothing is allocated per message.  Devices are found
+through a hash of the channel ID with chaining inside the array, so a message costs one bucket walk no matter how
+full the table is.  Entries are also linked in order of last message; when a new device arrives and the table is
+full, the one heard least recently is replaced.  A busy area with hundreds of broadcasts per second therefore keeps
+the nearest and most active devices.
+
+The collector is on by default; storing 0 under KVSTORE_KEY_ANT_SCAN turns it off from the next reset, which saves
+the receive current of continuous scanning.  bleperipheral_scan.c reports the table over BLE.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+AntScanStatsType G_sAntScanStats;                      /* Scanner activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "AntScan_" and be declared as static.
+***********************************************************************************************************************/
+static AntScanEntryType AntScan_asTable[U8_ANTSCAN_DEVICES]; /* Device table; slots 0 .. AntScan_u8Used - 1 in use */
+static u8 AntScan_au8Buckets[U8_ANTSCAN_BUCKETS];      /* First slot of each hash chain */
+static u8 AntScan_u8Used;                              /* Slots filled */
+static u8 AntScan_u8Newest;                            /* Slot heard most recently */
+static u8 AntScan_u8Oldest;                            /* Slot heard least recently; replaced first */
+
+static u32 AntScan_u32WindowStartMs;                   /* Start of the current rate window */
+static u32 AntScan_u32WindowMessages;                  /* Messages in the current rate window */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntScanIsRunning(void)
+@brief Reports whether the scanner is receiving.
+*/
+bool AntScanIsRunning(void)
+{
+  return G_sAntScanStats.bRunning;
+
+} /* end AntScanIsRunning() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u8 AntScanCount(void)
+@brief Returns the number of devices in the table.
+*/
+u8 AntScanCount(void)
+{
+  return AntScan_u8Used;
+
+} /* end AntScanCount() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntScanRead(u8 u8Index_, AntScanDeviceType* psDevice_)
+@brief Copies out one table entry.
+
+Entries are read by slot, so a device keeps its index until it is replaced and a reader walking 0 .. AntScanCount()
+sees each device at most once.
+
+Promises:
+- Returns TRUE with *psDevice_ filled if u8Index_ is below AntScanCount()
+- Returns FALSE otherwise
+
+*/
+bool AntScanRead(u8 u8Index_, AntScanDeviceType* psDevice_)
+{
+  if(u8Index_ >= AntScan_u8Used)
+  {
+    return FALSE;
+  }
+
+  memcpy(psDevice_, &AntScan_asTable[u8Index_].sDevice, sizeof(AntScanDeviceType));
+  return TRUE;
+
+} /* end AntScanRead() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void AntScanClear(void)
+@brief Empties the device table.  Scanning carries on.
+*/
+void AntScanClear(void)
+{
+  AntScan_u8Used = 0;
+  AntScan_u8Newest = U8_ANTSCAN_NONE;
+  AntScan_u8Oldest = U8_ANTSCAN_NONE;
+  memset(AntScan_au8Buckets, U8_ANTSCAN_NONE, sizeof(AntScan_au8Buckets));
+
+} /* end AntScanClear() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool AntScanInitialize(void)
+@brief Sets up channel 0 as a wildcard receiver and starts scan mode.
+
+Requires:
+- ANTIntegrationInitialize() and KVStoreInitialize() have run
+- No other ANT channel is open yet
+
+Promises:
+- Returns TRUE if scanning started or is turned off by KVSTORE_KEY_ANT_SCAN
+- Returns FALSE if the stack refused
+
+*/
+bool AntScanInitialize(void)
+{
+  u32 u32Result = NRF_SUCCESS;
+  u8 u8Enable;
+
+  memset(&G_sAntScanStats, 0, sizeof(G_sAntScanStats));
+  AntScanClear();
+  AntScan_u32WindowStartMs = G_u32SystemTime1ms;
+  AntScan_u32WindowMessages = 0;
+
+  if( (KVStoreGet(KVSTORE_KEY_ANT_SCAN, &u8Enable, sizeof(u8Enable)) == sizeof(u8Enable)) && (u8Enable == 0) )
+  {
+    return TRUE;
+  }
+
+  if(!ANTIntegrationRegisterHandler(U8_ANTSCAN_CHANNEL, AntScanChannelHandler))
+  {
+    return FALSE;
+  }
+
+  /* Extended data is a library-wide setting; the pump unpacks it on every channel */
+  u32Result |= sd_ant_lib_config_set(U8_ANTSCAN_EXT_CONFIG);
+  u32Result |= sd_ant_channel_assign(U8_ANTSCAN_CHANNEL, CHANNEL_TYPE_SLAVE, U8_ANTSCAN_NETWORK, 0);
+  u32Result |= sd_ant_channel_id_set(U8_ANTSCAN_CHANNEL, 0, 0, 0);
+  u32Result |= sd_ant_channel_radio_freq_set(U8_ANTSCAN_CHANNEL, U8_ANTSCAN_RF_FREQ);
+  u32Result |= sd_ant_rx_scan_mode_start(0);
+  if(u32Result != NRF_SUCCESS)
+  {
+    return FALSE;
+  }
+
+  G_sAntScanStats.bRunning = TRUE;
+  return TRUE;
+
+} /* end AntScanInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntScanChannelHandler(u8 u8Channel_)
+@brief Channel events from the ANT pump: every data message updates the table.
+*/
+static void AntScanChannelHandler(u8 u8Channel_)
+{
+  AntEventType sEvent;
+  u32 u32Elapsed;
+
+  while(ANTIntegrationRead(u8Channel_, &sEvent))
+  {
+    switch(sEvent.u8Event)
+    {
+      case EVENT_RX:
+      {
+        AntScanRecord(&sEvent);
+        break;
+      }
+
+      case EVENT_CHANNEL_CLOSED:
+      {
+        /* Leaving scan mode only happens if the stack drops it */
+        G_sAntScanStats.bRunning = FALSE;
+        break;
+      }
+
+      default:
+      {
+        break;
+      }
+    } /* end switch */
+  }
+
+  u32Elapsed = G_u32SystemTime1ms - AntScan_u32WindowStartMs;
+  if(u32Elapsed >= U32_ANTSCAN_RATE_WINDOW_MS)
+  {
+    G_sAntScanStats.u32MessagesPerSecond = (AntScan_u32WindowMessages * 1000) / u32Elapsed;
+    if(G_sAntScanStats.u32MessagesPerSecond > G_sAntScanStats.u32PeakPerSecond)
+    {
+      G_sAntScanStats.u32PeakPerSecond = G_sAntScanStats.u32MessagesPerSecond;
+    }
+    AntScan_u32WindowStartMs = G_u32SystemTime1ms;
+    AntScan_u32WindowMessages = 0;
+  }
+
+} /* end AntScanChannelHandler() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntScanRecord(AntEventType* psEvent_)
+@brief Updates (or adds) the table entry of the message's sender and makes it the most recent.
+*/
+static void AntScanRecord(AntEventType* psEvent_)
+{
+  AntScanDeviceType* psDevice;
+  u8 u8Bucket;
+  u8 u8Slot;
+
+  G_sAntScanStats.u32Messages++;
+  AntScan_u32WindowMessages++;
+
+  if( !(psEvent_->u8ExtFlags & ANT_EXT_MESG_BITFIELD_DEVICE_ID) )
+  {
+    G_sAntScanStats.u32NoId++;
+    return;
+  }
+
+  u8Bucket = AntScanHash(psEvent_->u16DeviceNumber, psEvent_->u8DeviceType, psEvent_->u8TransmissionType);
+  u8Slot = AntScanFind(psEvent_, u8Bucket);
+  if(u8Slot == U8_ANTSCAN_NONE)
+  {
+    u8Slot = AntScanInsert(psEvent_, u8Bucket);
+  }
+  else
+  {
+    G_sAntScanStats.u32Updates++;
+    if(u8Slot != AntScan_u8Newest)
+    {
+      AntScanUnlink(u8Slot);
+      AntScanLinkNewest(u8Slot);
+    }
+  }
+
+  psDevice = &AntScan_asTable[u8Slot].sDevice;
+  psDevice->u16LastSeenS = (u16)G_u32SystemTime1s;
+  if(psDevice->u8Messages != 0xFF)
+  {
+    psDevice->u8Messages++;
+  }
+  if(psEvent_->u8ExtFlags & ANT_EXT_MESG_BITFIELD_RSSI)
+  {
+    psDevice->s8Rssi = psEvent_->s8Rssi;
+  }
+  memcpy(psDevice->au8Payload, psEvent_->au8Payload, U8_ANTSCAN_PAYLOAD_SIZE);
+
+} /* end AntScanRecord() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u8 AntScanHash(u16 u16DeviceNumber_, u8 u8DeviceType_, u8 u8TransmissionType_)
+@brief Folds a channel ID into a bucket number.  Device numbers usually differ in their low bits, so those carry
+most of the weight.
+*/
+static u8 AntScanHash(u16 u16DeviceNumber_, u8 u8DeviceType_, u8 u8TransmissionType_)
+{
+  u16 u16Hash = u16DeviceNumber_ ^ ((u16)u8DeviceType_ << 5) ^ u8TransmissionType_;
+
+  u16Hash ^= u16Hash >> 8;
+  u16Hash ^= u16Hash >> 4;
+  return (u8)(u16Hash & U8_ANTSCAN_BUCKET_MASK);
+
+} /* end AntScanHash() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u8 AntScanFind(AntEventType* psEvent_, u8 u8Bucket_)
+@brief Looks for the sender of psEvent_ in its hash chain.
+
+Promises:
+- Returns the slot, or U8_ANTSCAN_NONE if the device is not in the table
+
+*/
+static u8 AntScanFind(AntEventType* psEvent_, u8 u8Bucket_)
+{
+  AntScanDeviceType* psDevice;
+
+  for(u8 u8Slot = AntScan_au8Buckets[u8Bucket_]; u8Slot != U8_ANTSCAN_NONE;
+      u8Slot = AntScan_asTable[u8Slot].u8HashNext)
+  {
+    psDevice = &AntScan_asTable[u8Slot].sDevice;
+    if( (psDevice->u16DeviceNumber == psEvent_->u16DeviceNumber) &&
+        (psDevice->u8DeviceType == psEvent_->u8DeviceType) &&
+        (psDevice->u8TransmissionType == psEvent_->u8TransmissionType) )
+    {
+      return u8Slot;
+    }
+  }
+
+  return U8_ANTSCAN_NONE;
+
+} /* end AntScanFind() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u8 AntScanInsert(AntEventType* psEvent_, u8 u8Bucket_)
+@brief Adds the sender of psEvent_ to the table, replacing the least recently heard device if it is full.
+
+Promises:
+- Returns the slot, linked into bucket u8Bucket_ and as the newest entry, with the channel ID set and the rest
+  cleared
+
+*/
+static u8 AntScanInsert(AntEventType* psEvent_, u8 u8Bucket_)
+{
+  AntScanDeviceType* psDevice;
+  u8 u8Slot;
+  u8* pu8Link;
+
+  if(AntScan_u8Used < U8_ANTSCAN_DEVICES)
+  {
+    u8Slot = AntScan_u8Used;
+    AntScan_u8Used++;
+  }
+  else
+  {
+    /* Take the oldest entry out of its hash chain and the LRU list */
+    u8Slot = AntScan_u8Oldest;
+    psDevice = &AntScan_asTable[u8Slot].sDevice;
+    pu8Link = &AntScan_au8Buckets[AntScanHash(psDevice->u16DeviceNumber, psDevice->u8DeviceType,
+                                              psDevice->u8TransmissionType)];
+    while(*pu8Link != u8Slot)
+    {
+      pu8Link = &AntScan_asTable[*pu8Link].u8HashNext;
+    }
+    *pu8Link = AntScan_asTable[u8Slot].u8HashNext;
+
+    AntScanUnlink(u8Slot);
+    G_sAntScanStats.u32Evictions++;
+  }
+
+  psDevice = &AntScan_asTable[u8Slot].sDevice;
+  memset(psDevice, 0, sizeof(AntScanDeviceType));
+  psDevice->u16DeviceNumber = psEvent_->u16DeviceNumber;
+  psDevice->u8DeviceType = psEvent_->u8DeviceType;
+  psDevice->u8TransmissionType = psEvent_->u8TransmissionType;
+
+  AntScan_asTable[u8Slot].u8HashNext = AntScan_au8Buckets[u8Bucket_];
+  AntScan_au8Buckets[u8Bucket_] = u8Slot;
+  AntScanLinkNewest(u8Slot);
+
+  G_sAntScanStats.u32NewDevices++;
+  return u8Slot;
+
+} /* end AntScanInsert() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntScanUnlink(u8 u8Slot_)
+@brief Takes a slot out of the LRU list.
+*/
+static void AntScanUnlink(u8 u8Slot_)
+{
+  AntScanEntryType* psEntry = &AntScan_asTable[u8Slot_];
+
+  if(psEntry->u8Older != U8_ANTSCAN_NONE)
+  {
+    AntScan_asTable[psEntry->u8Older].u8Newer = psEntry->u8Newer;
+  }
+  else
+  {
+    AntScan_u8Oldest = psEntry->u8Newer;
+  }
+
+  if(psEntry->u8Newer != U8_ANTSCAN_NONE)
+  {
+    AntScan_asTable[psEntry->u8Newer].u8Older = psEntry->u8Older;
+  }
+  else
+  {
+    AntScan_u8Newest = psEntry->u8Older;
+  }
+
+} /* end AntScanUnlink() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void AntScanLinkNewest(u8 u8Slot_)
+@brief Puts a slot at the most recent end of the LRU list.
+*/
+static void AntScanLinkNewest(u8 u8Slot_)
+{
+  AntScanEntryType* psEntry = &AntScan_asTable[u8Slot_];
+
+  psEntry->u8Older = AntScan_u8Newest;
+  psEntry->u8Newer = U8_ANTSCAN_NONE;
+  if(AntScan_u8Newest != U8_ANTSCAN_NONE)
+  {
+    AntScan_asTable[AntScan_u8Newest].u8Newer = u8Slot_;
+  }
+  else
+  {
+    AntScan_u8Oldest = u8Slot_;
+  }
+  AntScan_u8Newest = u8Slot_;
+
+} /* end AntScanLinkNewest() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,115 @@
+/**********************************************************************************************************************
+File: ant_scan.h
+
+Description:
+Header file for ant_scan.c
+**********************************************************************************************************************/
+
+#ifndef __ANT_SCAN_H
+#define __ANT_SCAN_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Scan mode always receives on channel 0, as a wildcard slave on the public network */
+#define U8_ANTSCAN_CHANNEL                (u8)0
+#define U8_ANTSCAN_NETWORK                (u8)0
+#define U8_ANTSCAN_RF_FREQ                (u8)66       /* 2466MHz */
+#define U8_ANTSCAN_EXT_CONFIG             (u8)(ANT_LIB_CONFIG_MESG_OUT_INC_DEVICE_ID | ANT_LIB_CONFIG_MESG_OUT_INC_RSSI)
+
+/* Device table */
+#define U8_ANTSCAN_DEVICES                (u8)8        /* Devices remembered; the least recently heard is replaced */
+#define U8_ANTSCAN_BUCKETS                (u8)8        /* Hash buckets; must be a power of 2 */
+#define U8_ANTSCAN_BUCKET_MASK            (u8)(U8_ANTSCAN_BUCKETS - 1)
+#define U8_ANTSCAN_NONE                   (u8)0xFF     /* End of a hash chain or the LRU list */
+#define U8_ANTSCAN_PAYLOAD_SIZE           (u8)4        /* Leading payload bytes kept (page number and 3 data bytes) */
+
+#define U32_ANTSCAN_RATE_WINDOW_MS        (u32)1000    /* Messages per second are counted over this window */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@struct AntScanDeviceType
+@brief One master heard by the scanner.  The first three fields are the ANT channel ID and identify the device.
+*/
+typedef struct
+{
+  u16 u16DeviceNumber;                    /*!< @brief Channel ID: device number */
+  u8 u8DeviceType;                        /*!< @brief Channel ID: device type */
+  u8 u8TransmissionType;                  /*!< @brief Channel ID: transmission type */
+  s8 s8Rssi;                              /*!< @brief Signal strength of the last message in dBm */
+  u8 u8Messages;                          /*!< @brief Messages heard, saturating at 0xFF */
+  u16 u16LastSeenS;                       /*!< @brief Low 16 bits of G_u32SystemTime1s at the last message */
+  u8 au8Payload[U8_ANTSCAN_PAYLOAD_SIZE]; /*!< @brief Start of the last payload */
+} AntScanDeviceType;
+
+/*!
+@struct AntScanEntryType
+@brief A device table slot with its hash chain and LRU links (slot indexes).
+*/
+typedef struct
+{
+  AntScanDeviceType sDevice;              /*!< @brief The device */
+  u8 u8HashNext;                          /*!< @brief Next slot in the same bucket */
+  u8 u8Newer;                             /*!< @brief Slot heard more recently */
+  u8 u8Older;                             /*!< @brief Slot heard less recently */
+} AntScanEntryType;
+
+/*!
+@struct AntScanStatsType
+@brief Scanner activity.
+*/
+typedef struct
+{
+  u32 u32Messages;                        /*!< @brief Data messages received */
+  u32 u32NoId;                            /*!< @brief Messages without the device ID extension (not tabled) */
+  u32 u32Updates;                         /*!< @brief Messages from a device already in the table */
+  u32 u32NewDevices;                      /*!< @brief Devices added to the table */
+  u32 u32Evictions;                       /*!< @brief Devices replaced because the table was full */
+  u32 u32MessagesPerSecond;               /*!< @brief Rate over the last complete window */
+  u32 u32PeakPerSecond;                   /*!< @brief Highest rate seen */
+  bool bRunning;                          /*!< @brief Scan mode is on */
+} AntScanStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool AntScanIsRunning(void);
+u8 AntScanCount(void);
+bool AntScanRead(u8 u8Index_, AntScanDeviceType* psDevice_);
+void AntScanClear(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool AntScanInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void AntScanChannelHandler(u8 u8Channel_);
+static void AntScanRecord(AntEventType* psEvent_);
+static u8 AntScanHash(u16 u16DeviceNumber_, u8 u8DeviceType_, u8 u8TransmissionType_);
+static u8 AntScanFind(AntEventType* psEvent_, u8 u8Bucket_);
+static u8 AntScanInsert(AntEventType* psEvent_, u8 u8Bucket_);
+static void AntScanUnlink(u8 u8Slot_);
+static void AntScanLinkNewest(u8 u8Slot_);
+
+
+#endif /* __ANT_SCAN_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,773 @@
+/**********************************************************************************************************************
+File: ble_advertising.c
+
+Description:
+Advertising payload built once into a cached byte image.
+
+ble_advdata_set() re-runs the SDK's TLV encoder (name, appearance, flags, UUID lists) every time it is called, so
+any change to the advertised data would pay for the whole encode again.  Here the payload is encoded once by
+BLEAdvEncode() and the location of each dynamic field inside the image is remembered.  Changing a dynamic field is
+then BLEAdvPatch() (a few bytes copied into the image) and BLEAdvCommit() (sd_ble_gap_adv_data_set()).  Several
+patches can share one commit.  The manufacturer data is refreshed this way every U32_BLEADV_STATUS_PERIOD_MS with
+the uptime and reset cause, so a scanner can spot a unit that reset without connecting.
+
+BLEAdvRebuild() is still there for changes to the static fields.  Both paths are timed in G_sBLEAdvStats.
+
+Fields are split between the primary packet and the scan response by priority (BLEAdvPriorityType).  The primary
+packet, sent on every channel of every advertising event, only carries the flags, the service UUIDs scanners filter
+on and the dynamic manufacturer data.  The name and appearance are only sent when a central actively scans.  The
+bytes on air per event and per scan are kept in G_sBLEAdvStats.
+
+Connectable advertising follows an interval policy: fast right after boot, a disconnect or a button press
+(BLEAdvBoost()), then stepping back to slower intervals.  Advertising at 25ms forever would otherwise dominate the
+radio energy budget.  The s310 cannot change the interval of a running advertiser, so each step is a stop and a
+start.  The estimated radio-on time in the hour after a boost is kept for every policy in G_sBLEAdvStats.  A BLE
+client changes the policy by writing the KVSTORE_KEY_ADV_POLICY setting, which goes through BLEAdvSetPolicy().
+
+Received or built payloads are parsed with the AD iterator (BLEAdvIteratorInit/Next/Find, BLEAdvValidate()).
+Unlike ble_advdata_parser_field_find() it never reads past the payload, stops at a zero length byte (the start of
+the non-significant part), and can be called again to find every field of a type.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BLEAdvStatsType G_sBLEAdvStats;                        /* Patch versus encode cost */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BLEAdv_" and be declared as static.
+***********************************************************************************************************************/
+static BLEAdvImageType BLEAdv_sAdvImage;               /* Advertising payload */
+static BLEAdvImageType BLEAdv_sScanRspImage;           /* Scan response payload */
+static BLEAdvFieldLocationType BLEAdv_asFields[BLEADV_FIELDS]; /* Dynamic fields inside the images */
+static u8 BLEAdv_au8MfgData[U8_BLEADV_MFG_DATA_SIZE];  /* Current manufacturer data, kept for rebuilds */
+
+static const BLEAdvStepType BLEAdv_aasPolicies[BLEADV_POLICIES][U8_BLEADV_MAX_STEPS] =
+{
+  /* BLEADV_POLICY_ALWAYS_FAST */
+  { {APP_ADV_INTERVAL, U32_BLEADV_STEP_FOREVER}, {0, 0}, {0, 0} },
+  /* BLEADV_POLICY_BALANCED */
+  { {40, 30000}, {244, 60000}, {1636, U32_BLEADV_STEP_FOREVER} },
+  /* BLEADV_POLICY_LOW_POWER */
+  { {160, 10000}, {3200, U32_BLEADV_STEP_FOREVER}, {0, 0} }
+};
+
+static SwTimerType BLEAdv_sStepTimer;                  /* End of the current policy step */
+static SwTimerType BLEAdv_sStatusTimer;                /* Manufacturer data refresh */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvPatch(BLEAdvFieldType eField_, u8 u8Offset_, const u8* pu8Data_, u8 u8Length_)
+@brief Overwrites bytes of a dynamic field in the cached image.  Nothing is sent until BLEAdvCommit().
+
+Requires:
+- BLEAdvInitialize() has run
+- pu8Data_ holds u8Length_ bytes
+
+Promises:
+- Returns TRUE if bytes u8Offset_ to u8Offset_ + u8Length_ - 1 of the field now hold pu8Data_
+- Returns FALSE if the field is not in the image or the bytes do not fit in it
+
+*/
+bool BLEAdvPatch(BLEAdvFieldType eField_, u8 u8Offset_, const u8* pu8Data_, u8 u8Length_)
+{
+  BLEAdvFieldLocationType* psField;
+
+  if(eField_ >= BLEADV_FIELDS)
+  {
+    G_sBLEAdvStats.u32Errors++;
+    return FALSE;
+  }
+
+  psField = &BLEAdv_asFields[eField_];
+  if( (psField->u8Offset == U8_BLEADV_NO_FIELD) || (u8Offset_ + u8Length_ > psField->u8Length) )
+  {
+    G_sBLEAdvStats.u32Errors++;
+    return FALSE;
+  }
+
+  memcpy(&psField->psImage->au8Data[psField->u8Offset + u8Offset_], pu8Data_, u8Length_);
+  if(eField_ == BLEADV_FIELD_MFG_DATA)
+  {
+    memcpy(&BLEAdv_au8MfgData[u8Offset_], pu8Data_, u8Length_);
+  }
+
+  G_sBLEAdvStats.u32Patches++;
+  return TRUE;
+
+} /* end BLEAdvPatch() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvCommit(void)
+@brief Hands the cached images to the stack; the next advertising event carries them.
+
+Promises:
+- Returns TRUE if the stack accepted the images
+- The time taken is recorded in G_sBLEAdvStats
+
+*/
+bool BLEAdvCommit(void)
+{
+  u64 u64StartUs = TimebaseGetUs();
+  u32 u32ElapsedUs;
+  bool bResult;
+
+  bResult = BLEAdvSet();
+
+  u32ElapsedUs = (u32)(TimebaseGetUs() - u64StartUs);
+  G_sBLEAdvStats.u32Commits++;
+  G_sBLEAdvStats.u32LastCommitUs = u32ElapsedUs;
+  if(u32ElapsedUs > G_sBLEAdvStats.u32MaxCommitUs)
+  {
+    G_sBLEAdvStats.u32MaxCommitUs = u32ElapsedUs;
+  }
+
+  return bResult;
+
+} /* end BLEAdvCommit() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvRebuild(void)
+@brief Encodes the images from scratch and hands them to the stack.  Only needed if a static field changes;
+dynamic fields keep their current values.
+
+Promises:
+- Field locations are updated
+- Returns TRUE if the stack accepted the images
+- The time taken is recorded in G_sBLEAdvStats
+
+*/
+bool BLEAdvRebuild(void)
+{
+  u64 u64StartUs = TimebaseGetUs();
+  bool bResult;
+
+  BLEAdvEncode();
+  bResult = BLEAdvSet();
+
+  G_sBLEAdvStats.u32Encodes++;
+  G_sBLEAdvStats.u32LastEncodeUs = (u32)(TimebaseGetUs() - u64StartUs);
+
+  return bResult;
+
+} /* end BLEAdvRebuild() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvSetPolicy(BLEAdvPolicyType ePolicy_)
+@brief Selects and stores the advertising interval policy.  If advertising now, it restarts at the new policy's first step.
+
+Promises:
+- Advertising restarts (through BLEAdvBoost()) unless it is already at step 0 of ePolicy_, the only case where the
+  interval on air and the step schedule stay the same
+- Returns TRUE if ePolicy_ is valid
+
+*/
+bool BLEAdvSetPolicy(BLEAdvPolicyType ePolicy_)
+{
+  bool bRestart;
+
+  if(ePolicy_ >= BLEADV_POLICIES)
+  {
+    return FALSE;
+  }
+
+  bRestart = (ePolicy_ != G_sBLEAdvStats.u8Policy) || (G_sBLEAdvStats.u8Step != 0);
+  G_sBLEAdvStats.u8Policy = ePolicy_;
+  (void)KVStoreSet(KVSTORE_KEY_ADV_POLICY, &G_sBLEAdvStats.u8Policy, 1);
+  if(bRestart)
+  {
+    BLEAdvBoost();
+  }
+
+  return TRUE;
+
+} /* end BLEAdvSetPolicy() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BLEAdvBoost(void)
+@brief Something happened that makes a connection likely: go back to the fastest step of the policy.
+
+Promises:
+- If connectable advertising is running under the policy, it restarts at step 0
+- Does nothing while connected or while beacon mode owns advertising
+
+*/
+void BLEAdvBoost(void)
+{
+  if( (bleperipheralGetConnHandle() != BLE_CONN_HANDLE_INVALID) || BLEBeaconIsEnabled() )
+  {
+    return;
+  }
+
+  G_sBLEAdvStats.u32Boosts++;
+  BLEAdvStop();
+  (void)BLEAdvStart();
+
+} /* end BLEAdvBoost() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BLEAdvIteratorInit(BLEAdvIteratorType* psIterator_, const u8* pu8Payload_, u8 u8Length_)
+@brief Prepares an iterator over the AD structures of a payload.
+
+Promises:
+- The next BLEAdvIteratorNext() returns the first AD structure
+
+*/
+void BLEAdvIteratorInit(BLEAdvIteratorType* psIterator_, const u8* pu8Payload_, u8 u8Length_)
+{
+  psIterator_->pu8Payload = pu8Payload_;
+  psIterator_->u8Length   = u8Length_;
+  psIterator_->u8Index    = 0;
+  psIterator_->bMalformed = FALSE;
+
+} /* end BLEAdvIteratorInit() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvIteratorNext(BLEAdvIteratorType* psIterator_, BLEAdvAdStructType* psAdStruct_)
+@brief Returns the next AD structure.
+
+Promises:
+- Returns TRUE with psAdStruct_ filled if a complete AD structure was found
+- Returns FALSE at the end of the payload or at a zero length byte
+- Returns FALSE and sets bMalformed if the structure would run past the payload; the iterator stays at the end
+
+*/
+bool BLEAdvIteratorNext(BLEAdvIteratorType* psIterator_, BLEAdvAdStructType* psAdStruct_)
+{
+  u8 u8Index = psIterator_->u8Index;
+  u8 u8Remaining = psIterator_->u8Length - u8Index;
+  u8 u8FieldLength;
+
+  /* End of payload or start of the zero padding */
+  if( (u8Index >= psIterator_->u8Length) || (psIterator_->pu8Payload[u8Index] == 0) )
+  {
+    psIterator_->u8Index = psIterator_->u8Length;
+    return FALSE;
+  }
+
+  /* The length byte counts the type and data: all of it must be inside the payload */
+  u8FieldLength = psIterator_->pu8Payload[u8Index];
+  if(u8FieldLength >= u8Remaining)
+  {
+    psIterator_->u8Index = psIterator_->u8Length;
+    psIterator_->bMalformed = TRUE;
+    return FALSE;
+  }
+
+  psAdStruct_->u8Type   = psIterator_->pu8Payload[u8Index + 1];
+  psAdStruct_->u8Length = u8FieldLength - 1;
+  psAdStruct_->pu8Data  = &psIterator_->pu8Payload[u8Index + 2];
+  psIterator_->u8Index  = u8Index + u8FieldLength + 1;
+
+  return TRUE;
+
+} /* end BLEAdvIteratorNext() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvIteratorFind(BLEAdvIteratorType* psIterator_, u8 u8Type_, BLEAdvAdStructType* psAdStruct_)
+@brief Returns the next AD structure of type u8Type_.  Call again to find the following ones.
+
+Promises:
+- Returns TRUE with psAdStruct_ filled if one was found before the end of the payload
+- Returns FALSE otherwise (check bMalformed to tell a bad payload from a missing field)
+
+*/
+bool BLEAdvIteratorFind(BLEAdvIteratorType* psIterator_, u8 u8Type_, BLEAdvAdStructType* psAdStruct_)
+{
+  while(BLEAdvIteratorNext(psIterator_, psAdStruct_))
+  {
+    if(psAdStruct_->u8Type == u8Type_)
+    {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+
+} /* end BLEAdvIteratorFind() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvValidate(const u8* pu8Payload_, u8 u8Length_)
+@brief Checks a whole payload.
+
+Promises:
+- Returns TRUE if the payload fits in BLE_GAP_ADV_MAX_SIZE, every AD structure lies inside it and anything after
+  a zero length byte is zero padding
+
+*/
+bool BLEAdvValidate(const u8* pu8Payload_, u8 u8Length_)
+{
+  BLEAdvIteratorType sIterator;
+  BLEAdvAdStructType sAdStruct;
+
+  if(u8Length_ > BLE_GAP_ADV_MAX_SIZE)
+  {
+    return FALSE;
+  }
+
+  BLEAdvIteratorInit(&sIterator, pu8Payload_, u8Length_);
+  while(BLEAdvIteratorNext(&sIterator, &sAdStruct))
+  {
+  }
+
+  if(sIterator.bMalformed)
+  {
+    return FALSE;
+  }
+
+  /* Stopped early at a zero length byte: the rest must be padding */
+  for(u8 i = 0; i < u8Length_; i++)
+  {
+    if( (i >= sIterator.u8Index) && (pu8Payload_[i] != 0) )
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+
+} /* end BLEAdvValidate() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvInitialize(void)
+@brief Builds the advertising image and hands it to the stack.  Advertising itself starts with BLEAdvStart().
+
+Requires:
+- The SoftDevice is enabled and the GAP device name and appearance are set
+- BLEIntegrationInitialize(), EventBusInitialize() and SwTimerInitialize() have run
+
+Promises:
+- The manufacturer data holds the uptime and reset cause and is refreshed every U32_BLEADV_STATUS_PERIOD_MS
+- The policy is the stored KVSTORE_KEY_ADV_POLICY, or BLEADV_POLICY_BALANCED
+- Radio-on estimates are calculated for every policy
+- Returns TRUE if the stack accepted the images and the handlers were registered
+
+*/
+bool BLEAdvInitialize(void)
+{
+  bool bResult;
+  u8 u8Policy;
+
+  memset(&G_sBLEAdvStats, 0, sizeof(G_sBLEAdvStats));
+  memset(BLEAdv_au8MfgData, 0, sizeof(BLEAdv_au8MfgData));
+  G_sBLEAdvStats.u8Policy = BLEADV_POLICY_BALANCED;
+  if( (KVStoreGet(KVSTORE_KEY_ADV_POLICY, &u8Policy, 1) == 1) && (u8Policy < BLEADV_POLICIES) )
+  {
+    G_sBLEAdvStats.u8Policy = u8Policy;
+  }
+
+  SwTimerCreate(&BLEAdv_sStepTimer, SWTIMER_ONE_SHOT, BLEAdvStepCallback, NULL);
+  SwTimerCreate(&BLEAdv_sStatusTimer, SWTIMER_PERIODIC, BLEAdvStatusCallback, NULL);
+  bResult = BLEAdvRebuild();
+  BLEAdvStatusCallback(NULL);
+  SwTimerStart(&BLEAdv_sStatusTimer, U32_BLEADV_STATUS_PERIOD_MS);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONNECTED, BLEAdvOnConnected);
+  bResult &= EventBusSubscribe(EVENT_TOPIC_BUTTON, BLEAdvOnButton);
+
+  for(u8 i = 0; i < BLEADV_POLICIES; i++)
+  {
+    G_sBLEAdvStats.au32RadioMsPerHour[i] = BLEAdvEstimateRadioMsPerHour((BLEAdvPolicyType)i);
+  }
+
+  return bResult;
+
+} /* end BLEAdvInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEAdvStart(void)
+@brief Starts connectable advertising at the first step of the current policy.
+
+Requires:
+- Not connected and not already advertising
+
+Promises:
+- Returns TRUE if advertising started
+
+*/
+bool BLEAdvStart(void)
+{
+  G_sBLEAdvStats.u8Step = 0;
+  return BLEAdvStartStep();
+
+} /* end BLEAdvStart() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BLEAdvStop(void)
+@brief Stops connectable advertising and the policy; used before another module takes over advertising.
+
+Promises:
+- Advertising is stopped (if it was running) and no step change is pending
+
+*/
+void BLEAdvStop(void)
+{
+  SwTimerStop(&BLEAdv_sStepTimer);
+  (void)sd_ble_gap_adv_stop();
+
+} /* end BLEAdvStop() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u8 BLEAdvAddField(BLEAdvImageType* psImage_, u8 u8Type_, const u8* pu8Data_, u8 u8Length_)
+@brief Appends one AD structure to an image.  Also used to build images kept by other advertising modules.
+
+Promises:
+- Returns the index of the field's first data byte in the image
+- Returns U8_BLEADV_NO_FIELD and leaves the image alone if the field does not fit
+
+*/
+u8 BLEAdvAddField(BLEAdvImageType* psImage_, u8 u8Type_, const u8* pu8Data_, u8 u8Length_)
+{
+  u8 u8Offset;
+
+  if(psImage_->u8Length + U8_BLEADV_FIELD_HEADER + u8Length_ > BLE_GAP_ADV_MAX_SIZE)
+  {
+    return U8_BLEADV_NO_FIELD;
+  }
+
+  psImage_->au8Data[psImage_->u8Length++] = u8Length_ + 1;
+  psImage_->au8Data[psImage_->u8Length++] = u8Type_;
+  u8Offset = psImage_->u8Length;
+  memcpy(&psImage_->au8Data[u8Offset], pu8Data_, u8Length_);
+  psImage_->u8Length += u8Length_;
+
+  return u8Offset;
+
+} /* end BLEAdvAddField() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEAdvEncode(void)
+@brief Encodes the fields bleperipheral used to build with ble_advdata_set(), plus the manufacturer data, split
+between the primary packet and the scan response.
+
+Promises:
+- BLEAdv_sAdvImage and BLEAdv_sScanRspImage hold the encoded payloads
+- BLEAdv_asFields holds the location of every dynamic field that fit
+- Payload lengths and bytes on air are updated in G_sBLEAdvStats
+
+*/
+static void BLEAdvEncode(void)
+{
+  u8 au8Buffer[U8_BLEADV_MFG_DATA_SIZE + 2];
+  u8 au8Name[U8_KVSTORE_MAX_VALUE];
+  u8 u8Offset;
+
+  memset(&BLEAdv_sAdvImage, 0, sizeof(BLEAdv_sAdvImage));
+  memset(&BLEAdv_sScanRspImage, 0, sizeof(BLEAdv_sScanRspImage));
+
+  /* Flags */
+  au8Buffer[0] = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+  (void)BLEAdvPlaceField(BLEADV_PRIORITY_REQUIRED, BLE_GAP_AD_TYPE_FLAGS, au8Buffer, 1, NULL);
+
+  /* Complete list of 16-bit service UUIDs: passive scanners and OS filters need these without a scan request */
+  au8Buffer[0] = (u8)(BLE_UUID_HEART_RATE_SERVICE & 0xFF);
+  au8Buffer[1] = (u8)(BLE_UUID_HEART_RATE_SERVICE >> 8);
+  au8Buffer[2] = (u8)(BLE_UUID_DEVICE_INFORMATION_SERVICE & 0xFF);
+  au8Buffer[3] = (u8)(BLE_UUID_DEVICE_INFORMATION_SERVICE >> 8);
+  (void)BLEAdvPlaceField(BLEADV_PRIORITY_PRIMARY, BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE, au8Buffer, 4, NULL);
+
+  /* Manufacturer specific data: the dynamic part starts after the company ID */
+  au8Buffer[0] = (u8)(U16_BLEADV_COMPANY_ID & 0xFF);
+  au8Buffer[1] = (u8)(U16_BLEADV_COMPANY_ID >> 8);
+  memcpy(&au8Buffer[2], BLEAdv_au8MfgData, U8_BLEADV_MFG_DATA_SIZE);
+  u8Offset = BLEAdvPlaceField(BLEADV_PRIORITY_PRIMARY, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA,
+                              au8Buffer, sizeof(au8Buffer), &BLEAdv_asFields[BLEADV_FIELD_MFG_DATA].psImage);
+
+  BLEAdv_asFields[BLEADV_FIELD_MFG_DATA].u8Offset = (u8Offset == U8_BLEADV_NO_FIELD) ? U8_BLEADV_NO_FIELD : (u8Offset + 2);
+  BLEAdv_asFields[BLEADV_FIELD_MFG_DATA].u8Length = U8_BLEADV_MFG_DATA_SIZE;
+
+  /* Complete local name */
+  (void)BLEAdvPlaceField(BLEADV_PRIORITY_SCAN_RESPONSE, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME,
+                         au8Name, bleperipheralGetDeviceName(au8Name, sizeof(au8Name)), NULL);
+
+  /* Appearance */
+  au8Buffer[0] = (u8)(BLEPERIPHERAL_DEVICE_APPEARANCE & 0xFF);
+  au8Buffer[1] = (u8)(BLEPERIPHERAL_DEVICE_APPEARANCE >> 8);
+  (void)BLEAdvPlaceField(BLEADV_PRIORITY_SCAN_RESPONSE, BLE_GAP_AD_TYPE_APPEARANCE, au8Buffer, 2, NULL);
+
+  /* Every event sends the primary PDU on each channel; a scan adds a SCAN_REQ and a SCAN_RSP on one channel */
+  G_sBLEAdvStats.u8AdvLength      = BLEAdv_sAdvImage.u8Length;
+  G_sBLEAdvStats.u8ScanRspLength  = BLEAdv_sScanRspImage.u8Length;
+  G_sBLEAdvStats.u16BytesPerEvent = U8_BLEADV_CHANNELS * (U8_BLEADV_PDU_OVERHEAD + BLEAdv_sAdvImage.u8Length);
+  G_sBLEAdvStats.u16BytesPerScan  = U8_BLEADV_SCAN_REQ_BYTES + U8_BLEADV_PDU_OVERHEAD + BLEAdv_sScanRspImage.u8Length;
+
+  /* Catch encoder mistakes before the stack (or a scanner) has to */
+  if( !BLEAdvValidate(BLEAdv_sAdvImage.au8Data, BLEAdv_sAdvImage.u8Length) ||
+      !BLEAdvValidate(BLEAdv_sScanRspImage.au8Data, BLEAdv_sScanRspImage.u8Length) )
+  {
+    G_sBLEAdvStats.u32InvalidImages++;
+  }
+
+} /* end BLEAdvEncode() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u8 BLEAdvPlaceField(BLEAdvPriorityType ePriority_, u8 u8Type_, const u8* pu8Data_, u8 u8Length_,
+                               BLEAdvImageType** ppsImage_)
+@brief Appends a field to the image its priority prefers, or to the other image if it does not fit there.
+
+Promises:
+- Returns the index of the field's first data byte and, if ppsImage_ is not NULL, the image it went into
+- Returns U8_BLEADV_NO_FIELD if it fit nowhere; the drop is counted
+
+*/
+static u8 BLEAdvPlaceField(BLEAdvPriorityType ePriority_, u8 u8Type_, const u8* pu8Data_, u8 u8Length_,
+                           BLEAdvImageType** ppsImage_)
+{
+  BLEAdvImageType* psFirst = &BLEAdv_sAdvImage;
+  BLEAdvImageType* psSecond = &BLEAdv_sScanRspImage;
+  u8 u8Offset;
+
+  if(ePriority_ == BLEADV_PRIORITY_SCAN_RESPONSE)
+  {
+    psFirst = &BLEAdv_sScanRspImage;
+    psSecond = &BLEAdv_sAdvImage;
+  }
+
+  u8Offset = BLEAdvAddField(psFirst, u8Type_, pu8Data_, u8Length_);
+  if( (u8Offset == U8_BLEADV_NO_FIELD) && (ePriority_ != BLEADV_PRIORITY_REQUIRED) )
+  {
+    u8Offset = BLEAdvAddField(psSecond, u8Type_, pu8Data_, u8Length_);
+    psFirst = psSecond;
+  }
+
+  if(u8Offset == U8_BLEADV_NO_FIELD)
+  {
+    G_sBLEAdvStats.u32DroppedFields++;
+  }
+
+  if(ppsImage_ != NULL)
+  {
+    *ppsImage_ = psFirst;
+  }
+
+  return u8Offset;
+
+} /* end BLEAdvPlaceField() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEAdvSet(void)
+@brief Passes the cached images to the stack.
+
+Promises:
+- Returns TRUE if sd_ble_gap_adv_data_set() accepted them; failures are counted
+
+*/
+static bool BLEAdvSet(void)
+{
+  u32 u32Result;
+
+  u32Result = sd_ble_gap_adv_data_set(BLEAdv_sAdvImage.au8Data, BLEAdv_sAdvImage.u8Length,
+                                      (BLEAdv_sScanRspImage.u8Length != 0) ? BLEAdv_sScanRspImage.au8Data : NULL,
+                                      BLEAdv_sScanRspImage.u8Length);
+  if(u32Result != NRF_SUCCESS)
+  {
+    G_sBLEAdvStats.u32Errors++;
+    return FALSE;
+  }
+
+  return TRUE;
+
+} /* end BLEAdvSet() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEAdvStartStep(void)
+@brief Starts connectable advertising with the interval of the current step and arms the step timer.
+
+Promises:
+- Returns TRUE if advertising started
+
+*/
+static bool BLEAdvStartStep(void)
+{
+  const BLEAdvStepType* psStep = &BLEAdv_aasPolicies[G_sBLEAdvStats.u8Policy][G_sBLEAdvStats.u8Step];
+  ble_gap_adv_params_t sParams;
+
+  memset(&sParams, 0, sizeof(sParams));
+  sParams.type     = BLE_GAP_ADV_TYPE_ADV_IND;
+  sParams.fp       = BLE_GAP_ADV_FP_ANY;
+  sParams.interval = psStep->u16Interval;
+  sParams.timeout  = APP_ADV_TIMEOUT_IN_SECONDS;
+
+  G_sBLEAdvStats.u16Interval = psStep->u16Interval;
+  if(psStep->u32DurationMs != U32_BLEADV_STEP_FOREVER)
+  {
+    SwTimerStart(&BLEAdv_sStepTimer, psStep->u32DurationMs);
+  }
+
+  return (sd_ble_gap_adv_start(&sParams) == NRF_SUCCESS);
+
+} /* end BLEAdvStartStep() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEAdvStepCallback(void* pvContext_)
+@brief The current step has run its time: back off to the next one.
+
+Promises:
+- Advertising restarts at the next step's interval, unless a connection or beacon mode has taken over
+
+*/
+static void BLEAdvStepCallback(void* pvContext_)
+{
+  u8 u8Next = G_sBLEAdvStats.u8Step + 1;
+
+  if( (bleperipheralGetConnHandle() != BLE_CONN_HANDLE_INVALID) || BLEBeaconIsEnabled() ||
+      (u8Next == U8_BLEADV_MAX_STEPS) || (BLEAdv_aasPolicies[G_sBLEAdvStats.u8Policy][u8Next].u16Interval == 0) )
+  {
+    return;
+  }
+
+  (void)sd_ble_gap_adv_stop();
+  G_sBLEAdvStats.u8Step = u8Next;
+  (void)BLEAdvStartStep();
+
+} /* end BLEAdvStepCallback() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u32 BLEAdvEstimateRadioMsPerHour(BLEAdvPolicyType ePolicy_)
+@brief Estimates how long the radio is on in the first hour after a boost, for the current advertising payload.
+
+Each event is U8_BLEADV_CHANNELS packets of ramp-up, PDU and receive window; events are spaced by the interval
+plus the mean random advDelay.  Scan responses and connection attempts are not counted.
+
+Promises:
+- Returns the estimate in ms
+
+*/
+static u32 BLEAdvEstimateRadioMsPerHour(BLEAdvPolicyType ePolicy_)
+{
+  const BLEAdvStepType* psStep;
+  u32 u32EventUs;
+  u32 u32RemainingMs = 3600000;
+  u32 u32SpanMs;
+  u32 u32RadioUs = 0;
+
+  u32EventUs = U8_BLEADV_CHANNELS *
+               (U16_BLEADV_RAMP_US + (U8_BLEADV_PDU_OVERHEAD + BLEAdv_sAdvImage.u8Length) * 8 + U16_BLEADV_RX_WINDOW_US);
+
+  for(u8 i = 0; (i < U8_BLEADV_MAX_STEPS) && (u32RemainingMs != 0); i++)
+  {
+    psStep = &BLEAdv_aasPolicies[ePolicy_][i];
+    if(psStep->u16Interval == 0)
+    {
+      break;
+    }
+
+    u32SpanMs = u32RemainingMs;
+    if( (psStep->u32DurationMs != U32_BLEADV_STEP_FOREVER) && (psStep->u32DurationMs < u32RemainingMs) )
+    {
+      u32SpanMs = psStep->u32DurationMs;
+    }
+
+    u32RadioUs += (u32SpanMs / ((psStep->u16Interval * 5 / 8) + U8_BLEADV_DELAY_MEAN_MS)) * u32EventUs;
+    u32RemainingMs -= u32SpanMs;
+  }
+
+  return u32RadioUs / 1000;
+
+} /* end BLEAdvEstimateRadioMsPerHour() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEAdvOnConnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_CONNECTED: the stack stopped advertising, so stop stepping too.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BLEAdvOnConnected(ble_evt_t* p_ble_evt)
+{
+  SwTimerStop(&BLEAdv_sStepTimer);
+  return TRUE;
+
+} /* end BLEAdvOnConnected() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEAdvOnButton(const EventMessageType* psMessage_)
+@brief EVENT_TOPIC_BUTTON: a user is interacting with the device, so advertise fast again.
+
+*/
+static void BLEAdvOnButton(const EventMessageType* psMessage_)
+{
+  BLEAdvBoost();
+
+} /* end BLEAdvOnButton() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEAdvStatusCallback(void* pvContext_)
+@brief Status timer: patches the uptime and reset cause into the manufacturer data.  While BLE beacon mode owns
+advertising only the image is patched; the beacon commits it when it hands advertising back.
+*/
+static void BLEAdvStatusCallback(void* pvContext_)
+{
+  u8 au8Status[U8_BLEADV_MFG_DATA_SIZE];
+  u32 u32Minutes = G_u32SystemTime1s / 60;
+
+  if(u32Minutes > 0xFFFF)
+  {
+    u32Minutes = 0xFFFF;
+  }
+
+  au8Status[0] = (u8)u32Minutes;
+  au8Status[1] = (u8)(u32Minutes >> 8);
+  au8Status[2] = (u8)WatchdogGetResetReason();
+  if( BLEAdvPatch(BLEADV_FIELD_MFG_DATA, 0, au8Status, sizeof(au8Status)) && !BLEBeaconIsEnabled() )
+  {
+    (void)BLEAdvCommit();
+  }
+
+} /* end BLEAdvStatusCallback() */
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
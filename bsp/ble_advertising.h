@@ -0,0 +1,202 @@
+/**********************************************************************************************************************
+File: ble_advertising.h
+
+Description:
+Header file for ble_advertising.c
+**********************************************************************************************************************/
+
+#ifndef __BLE_ADVERTISING_H
+#define __BLE_ADVERTISING_H
+
+#include "typedefs.h"
+#include "ble.h"
+#include "event_bus.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U8_BLEADV_FIELD_HEADER         (u8)2        /* [length][AD type] ahead of every field's data */
+#define U8_BLEADV_NO_FIELD             (u8)0xFF     /* Field is not in the image */
+
+/* Manufacturer specific data: [company ID (2 bytes, little endian)][U8_BLEADV_MFG_DATA_SIZE dynamic bytes]
+   dynamic bytes  [uptime minutes u16][RESETREAS low byte]                                          little endian */
+#define U16_BLEADV_COMPANY_ID          (u16)0xFFFF  /* Bluetooth SIG "no company" value for development */
+#define U8_BLEADV_MFG_DATA_SIZE        (u8)3
+#define U32_BLEADV_STATUS_PERIOD_MS    (u32)60000   /* Manufacturer data refresh */
+
+/* Advertising policies: up to U8_BLEADV_MAX_STEPS intervals (0.625ms units), each held for a time after a boost */
+#define U8_BLEADV_MAX_STEPS            (u8)3
+#define U32_BLEADV_STEP_FOREVER        (u32)0       /* Step lasts until the next boost */
+
+/* Radio-on estimate for one connectable advertising event */
+#define U8_BLEADV_CHANNELS             (u8)3        /* Channels 37, 38 and 39 */
+#define U16_BLEADV_RAMP_US             (u16)140     /* Radio ramp-up before each packet */
+#define U8_BLEADV_PDU_OVERHEAD         (u8)16       /* Preamble, access address, header, AdvA and CRC bytes */
+#define U8_BLEADV_SCAN_REQ_BYTES       (u8)22       /* Preamble, access address, header, ScanA, AdvA and CRC */
+#define U16_BLEADV_RX_WINDOW_US        (u16)200     /* Listening for SCAN_REQ / CONNECT_REQ after each packet */
+#define U8_BLEADV_DELAY_MEAN_MS        (u8)5        /* Mean of the 0-10ms random advDelay added to each interval */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum BLEAdvFieldType
+@brief Advertising fields that can change after the image is built. */
+typedef enum
+{
+  BLEADV_FIELD_MFG_DATA = 0,              /*!< @brief Manufacturer data after the company ID */
+  BLEADV_FIELDS                           /*!< @brief Number of dynamic fields; must stay last */
+} BLEAdvFieldType;
+
+/*!
+@enum BLEAdvPriorityType
+@brief Where BLEAdvPlaceField() puts a field.  Fields are placed in call order within each image. */
+typedef enum
+{
+  BLEADV_PRIORITY_REQUIRED = 0,           /*!< @brief Primary packet only (flags) */
+  BLEADV_PRIORITY_PRIMARY,                /*!< @brief Primary packet, scan response if it does not fit */
+  BLEADV_PRIORITY_SCAN_RESPONSE           /*!< @brief Scan response, primary packet if it does not fit */
+} BLEAdvPriorityType;
+
+/*!
+@enum BLEAdvPolicyType
+@brief Advertising interval schedules selectable at runtime. */
+typedef enum
+{
+  BLEADV_POLICY_ALWAYS_FAST = 0,          /*!< @brief APP_ADV_INTERVAL forever (the original behaviour) */
+  BLEADV_POLICY_BALANCED,                 /*!< @brief 25ms for 30s, 152.5ms for 60s, then 1022.5ms */
+  BLEADV_POLICY_LOW_POWER,                /*!< @brief 100ms for 10s, then 2s */
+  BLEADV_POLICIES                         /*!< @brief Number of policies; must stay last */
+} BLEAdvPolicyType;
+
+/*!
+@struct BLEAdvStepType
+@brief One step of an advertising policy.
+*/
+typedef struct
+{
+  u16 u16Interval;                        /*!< @brief Advertising interval (0.625ms units); 0 marks an unused step */
+  u32 u32DurationMs;                      /*!< @brief Time in this step, or U32_BLEADV_STEP_FOREVER */
+} BLEAdvStepType;
+
+/*!
+@struct BLEAdvImageType
+@brief An encoded advertising or scan response payload.
+*/
+typedef struct
+{
+  u8 u8Length;                            /*!< @brief Bytes used in au8Data */
+  u8 au8Data[BLE_GAP_ADV_MAX_SIZE];       /*!< @brief AD structures exactly as sent over the air */
+} BLEAdvImageType;
+
+/*!
+@struct BLEAdvAdStructType
+@brief One AD structure found by the iterator.  pu8Data points into the payload being parsed.
+*/
+typedef struct
+{
+  u8 u8Type;                              /*!< @brief AD type */
+  u8 u8Length;                            /*!< @brief Data bytes after the type */
+  const u8* pu8Data;                      /*!< @brief First data byte */
+} BLEAdvAdStructType;
+
+/*!
+@struct BLEAdvIteratorType
+@brief Position in an advertising payload.  Set up with BLEAdvIteratorInit().
+*/
+typedef struct
+{
+  const u8* pu8Payload;                   /*!< @brief Payload being parsed */
+  u8 u8Length;                            /*!< @brief Payload bytes */
+  u8 u8Index;                             /*!< @brief Length byte of the next AD structure */
+  bool bMalformed;                        /*!< @brief An AD structure ran past the end of the payload */
+} BLEAdvIteratorType;
+
+/*!
+@struct BLEAdvFieldLocationType
+@brief Where a dynamic field's data sits.
+*/
+typedef struct
+{
+  BLEAdvImageType* psImage;               /*!< @brief Image holding the field */
+  u8 u8Offset;                            /*!< @brief Index of the first data byte, or U8_BLEADV_NO_FIELD */
+  u8 u8Length;                            /*!< @brief Data bytes that may be patched */
+} BLEAdvFieldLocationType;
+
+/*!
+@struct BLEAdvStatsType
+@brief Cost of patching the cached image versus encoding it from scratch.  1000000 / Us is updates per second.
+*/
+typedef struct
+{
+  u32 u32Encodes;                         /*!< @brief Full image builds */
+  u32 u32Patches;                         /*!< @brief BLEAdvPatch() calls accepted */
+  u32 u32Commits;                         /*!< @brief Images handed to the stack */
+  u32 u32Errors;                          /*!< @brief Patches refused or images the stack rejected */
+  u32 u32LastEncodeUs;                    /*!< @brief Build and set of the last full encode */
+  u32 u32LastCommitUs;                    /*!< @brief Set of the last patched image */
+  u32 u32MaxCommitUs;                     /*!< @brief Slowest commit */
+  u32 u32Boosts;                          /*!< @brief Restarts from the first (fastest) step */
+  u8  u8Policy;                           /*!< @brief Current BLEAdvPolicyType */
+  u8  u8Step;                             /*!< @brief Current step of the policy */
+  u16 u16Interval;                        /*!< @brief Interval advertising was last started with */
+  u32 au32RadioMsPerHour[BLEADV_POLICIES];   /*!< @brief Estimated radio-on time in the hour after a boost */
+  u32 u32InvalidImages;                   /*!< @brief Built images that failed BLEAdvValidate() */
+  u32 u32DroppedFields;                   /*!< @brief Fields that fit in neither image */
+  u8  u8AdvLength;                        /*!< @brief Primary payload bytes */
+  u8  u8ScanRspLength;                    /*!< @brief Scan response payload bytes */
+  u16 u16BytesPerEvent;                   /*!< @brief Bytes on air per advertising event (all channels, no scans) */
+  u16 u16BytesPerScan;                    /*!< @brief Extra bytes on air when a central scans (SCAN_REQ + SCAN_RSP) */
+} BLEAdvStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEAdvPatch(BLEAdvFieldType eField_, u8 u8Offset_, const u8* pu8Data_, u8 u8Length_);
+bool BLEAdvCommit(void);
+bool BLEAdvRebuild(void);
+bool BLEAdvSetPolicy(BLEAdvPolicyType ePolicy_);
+void BLEAdvBoost(void);
+
+void BLEAdvIteratorInit(BLEAdvIteratorType* psIterator_, const u8* pu8Payload_, u8 u8Length_);
+bool BLEAdvIteratorNext(BLEAdvIteratorType* psIterator_, BLEAdvAdStructType* psAdStruct_);
+bool BLEAdvIteratorFind(BLEAdvIteratorType* psIterator_, u8 u8Type_, BLEAdvAdStructType* psAdStruct_);
+bool BLEAdvValidate(const u8* pu8Payload_, u8 u8Length_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEAdvInitialize(void);
+u8 BLEAdvAddField(BLEAdvImageType* psImage_, u8 u8Type_, const u8* pu8Data_, u8 u8Length_);
+bool BLEAdvStart(void);
+void BLEAdvStop(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BLEAdvEncode(void);
+static u8 BLEAdvPlaceField(BLEAdvPriorityType ePriority_, u8 u8Type_, const u8* pu8Data_, u8 u8Length_,
+                           BLEAdvImageType** ppsImage_);
+static bool BLEAdvSet(void);
+static bool BLEAdvStartStep(void);
+static void BLEAdvStepCallback(void* pvContext_);
+static u32 BLEAdvEstimateRadioMsPerHour(BLEAdvPolicyType ePolicy_);
+static bool BLEAdvOnConnected(ble_evt_t* p_ble_evt);
+static void BLEAdvOnButton(const EventMessageType* psMessage_);
+static void BLEAdvStatusCallback(void* pvContext_);
+
+
+#endif /* __BLE_ADVERTISING_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
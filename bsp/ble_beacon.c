@@ -0,0 +1,460 @@
+/**********************************************************************************************************************
+File: ble_beacon.c
+
+Description:
+Beacon mode: non-connectable advertising that rotates between precomputed frames.
+
+Three frames are encoded once by BLEBeaconBuildFrames(): a UID frame (namespace + device address), a URL frame
+and a telemetry (TLM) frame.  Switching frames is a single sd_ble_gap_adv_data_set() from the radio notification
+ISR (SWI1, configured by radio_sched.c), which fires as soon as the radio goes inactive after an event, so the next
+advertising event already carries the next frame in BLEBeacon_au8Schedule.  Only the TLM frame changes after it is built; its fields are
+patched once per U32_BLEBEACON_TLM_PERIOD_MS from the main loop.
+
+Radio notifications also fire for ANT and connection events, so a notification less than
+U8_BLEBEACON_ROTATION_GUARD_PCT of the advertising interval after the last switch is ignored.
+
+Every U32_BLEBEACON_CONNECTABLE_PERIOD_MS the beacon opens a connectable slot with the normal payload from
+ble_advertising so a central can still connect to configure the device.  If nothing connects, rotation resumes
+when the slot ends; otherwise it resumes after the disconnect (bleperipheral calls BLEBeaconResume()).
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BLEBeaconStatsType G_sBLEBeaconStats;                  /* Beacon activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BLEBeacon_" and be declared as static.
+***********************************************************************************************************************/
+static const u8 BLEBeacon_au8Schedule[U8_BLEBEACON_SCHEDULE_LENGTH] =
+  {BLEBEACON_UID, BLEBEACON_URL, BLEBEACON_UID, BLEBEACON_TLM};
+
+static const ble_gap_adv_params_t BLEBeacon_sConnectableParams =
+  {BLE_GAP_ADV_TYPE_ADV_IND, NULL, BLE_GAP_ADV_FP_ANY, NULL, APP_ADV_INTERVAL, APP_ADV_TIMEOUT_IN_SECONDS};
+
+static BLEAdvImageType BLEBeacon_asFrames[BLEBEACON_FRAMES]; /* Precomputed payloads */
+static u8 BLEBeacon_u8TlmOffset;                       /* Index of the TLM frame type byte in its image */
+
+static volatile BLEBeaconStateType BLEBeacon_eState;   /* Shared with the radio notification ISR */
+static volatile u8 BLEBeacon_u8Slot;                   /* Current position in BLEBeacon_au8Schedule */
+static u32 BLEBeacon_u32LastRotationMs;                /* Time of the last switch (ISR only) */
+
+static SwTimerType BLEBeacon_sTlmTimer;                /* Telemetry refresh */
+static SwTimerType BLEBeacon_sSlotTimer;               /* Next connectable slot, or the end of the current one */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBeaconEnable(bool bEnable_)
+@brief Switches beacon mode on or off.
+
+Requires:
+- BLEBeaconInitialize() has run
+
+Promises:
+- bEnable_ TRUE: beaconing starts now, or after the current connection ends
+- bEnable_ FALSE: connectable advertising with the normal payload resumes (if not connected)
+- Returns TRUE if the stack accepted the change
+
+*/
+bool BLEBeaconEnable(bool bEnable_)
+{
+  u32 u32Result = NRF_SUCCESS;
+
+  if(bEnable_ == BLEBeaconIsEnabled())
+  {
+    return TRUE;
+  }
+
+  if(bEnable_)
+  {
+    SwTimerStart(&BLEBeacon_sTlmTimer, U32_BLEBEACON_TLM_PERIOD_MS);
+
+    if(bleperipheralGetConnHandle() != BLE_CONN_HANDLE_INVALID)
+    {
+      BLEBeacon_eState = BLEBEACON_CONNECTED;
+      return TRUE;
+    }
+
+    BLEAdvStop();
+    return BLEBeaconStartNonConnectable();
+  }
+
+  /* Disable */
+  BLEBeacon_eState = BLEBEACON_OFF;
+  SwTimerStop(&BLEBeacon_sTlmTimer);
+  SwTimerStop(&BLEBeacon_sSlotTimer);
+
+  if(bleperipheralGetConnHandle() == BLE_CONN_HANDLE_INVALID)
+  {
+    (void)sd_ble_gap_adv_stop();
+    (void)BLEAdvCommit();
+    if(!BLEAdvStart())
+    {
+      u32Result |= NRF_ERROR_INVALID_STATE;
+    }
+  }
+
+  return (u32Result == NRF_SUCCESS);
+
+} /* end BLEBeaconEnable() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBeaconIsEnabled(void)
+@brief Reports whether beacon mode owns advertising.
+
+Promises:
+- Returns TRUE if beacon mode is enabled, whatever it is doing right now
+
+*/
+bool BLEBeaconIsEnabled(void)
+{
+  return (BLEBeacon_eState != BLEBEACON_OFF);
+
+} /* end BLEBeaconIsEnabled() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBeaconInitialize(void)
+@brief Builds the beacon frames.  Beacon mode starts disabled.
+
+Requires:
+- The SoftDevice is enabled; BLEIntegrationInitialize() and SwTimerInitialize() have run
+
+Promises:
+- Returns TRUE if the connection handler was registered
+
+*/
+bool BLEBeaconInitialize(void)
+{
+  memset(&G_sBLEBeaconStats, 0, sizeof(G_sBLEBeaconStats));
+  BLEBeacon_eState = BLEBEACON_OFF;
+
+  BLEBeaconBuildFrames();
+  SwTimerCreate(&BLEBeacon_sTlmTimer, SWTIMER_PERIODIC, BLEBeaconUpdateTelemetry, NULL);
+  SwTimerCreate(&BLEBeacon_sSlotTimer, SWTIMER_ONE_SHOT, BLEBeaconSlotCallback, NULL);
+
+  return BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONNECTED, BLEBeaconOnConnected);
+
+} /* end BLEBeaconInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBeaconResume(void)
+@brief Restarts beaconing after a connection ends.  Called by bleperipheral in place of its own advertising start.
+
+Requires:
+- BLEBeaconIsEnabled()
+
+Promises:
+- Returns TRUE if non-connectable advertising started
+
+*/
+bool BLEBeaconResume(void)
+{
+  return BLEBeaconStartNonConnectable();
+
+} /* end BLEBeaconResume() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BLEBeaconRadioHandler(void)
+@brief Radio notification (radio just went inactive): switch to the next frame.
+
+Requires:
+- Called only from RadioSchedRadioHandler() on the inactive edge, at NRF_APP_PRIORITY_LOW
+
+Promises:
+- If beaconing and at least the guard time has passed, the next scheduled frame is handed to the stack
+
+*/
+void BLEBeaconRadioHandler(void)
+{
+  u8 u8Frame;
+
+  G_sBLEBeaconStats.u32RadioEvents++;
+
+  if(BLEBeacon_eState != BLEBEACON_BEACONING)
+  {
+    return;
+  }
+
+  /* ANT and connection events also end here; only switch once per advertising interval */
+  if( (G_u32SystemTime1ms - BLEBeacon_u32LastRotationMs) <
+      ((U16_BLEBEACON_INTERVAL * 5 / 8) * U8_BLEBEACON_ROTATION_GUARD_PCT / 100) )
+  {
+    return;
+  }
+
+  BLEBeacon_u32LastRotationMs = G_u32SystemTime1ms;
+  BLEBeacon_u8Slot++;
+  if(BLEBeacon_u8Slot == U8_BLEBEACON_SCHEDULE_LENGTH)
+  {
+    BLEBeacon_u8Slot = 0;
+  }
+
+  u8Frame = BLEBeacon_au8Schedule[BLEBeacon_u8Slot];
+  if(sd_ble_gap_adv_data_set(BLEBeacon_asFrames[u8Frame].au8Data, BLEBeacon_asFrames[u8Frame].u8Length,
+                             NULL, 0) == NRF_SUCCESS)
+  {
+    G_sBLEBeaconStats.u32Rotations++;
+    G_sBLEBeaconStats.au32FramesSent[u8Frame]++;
+  }
+  else
+  {
+    G_sBLEBeaconStats.u32SetErrors++;
+  }
+
+} /* end BLEBeaconRadioHandler() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEBeaconBuildFrames(void)
+@brief Encodes every frame: flags, the 0xFEAA UUID list and the frame as 0xFEAA service data.
+
+Promises:
+- BLEBeacon_asFrames holds the payloads; TLM fields start as zeros
+- BLEBeacon_u8TlmOffset locates the TLM frame type byte
+
+*/
+static void BLEBeaconBuildFrames(void)
+{
+  static const u8 au8Namespace[] = BLEBEACON_UID_NAMESPACE;
+  u8 au8Buffer[22];
+  u8 u8Length;
+  u8 u8Offset;
+  ble_gap_addr_t sAddress;
+
+  (void)sd_ble_gap_address_get(&sAddress);
+
+  for(u8 i = 0; i < BLEBEACON_FRAMES; i++)
+  {
+    memset(&BLEBeacon_asFrames[i], 0, sizeof(BLEAdvImageType));
+
+    au8Buffer[0] = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    (void)BLEAdvAddField(&BLEBeacon_asFrames[i], BLE_GAP_AD_TYPE_FLAGS, au8Buffer, 1);
+
+    au8Buffer[0] = (u8)(U16_BLEBEACON_SERVICE_UUID & 0xFF);
+    au8Buffer[1] = (u8)(U16_BLEBEACON_SERVICE_UUID >> 8);
+    (void)BLEAdvAddField(&BLEBeacon_asFrames[i], BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE, au8Buffer, 2);
+
+    /* Service data: the UUID again, then the frame */
+    memset(&au8Buffer[2], 0, sizeof(au8Buffer) - 2);
+    u8Length = 2;
+    switch(i)
+    {
+      case BLEBEACON_UID:
+        /* [type][tx power][namespace 10][instance 6][reserved 2]; instance is the device address, MSB first */
+        au8Buffer[u8Length++] = U8_BLEBEACON_FRAME_UID;
+        au8Buffer[u8Length++] = (u8)S8_BLEBEACON_TX_POWER_0M;
+        memcpy(&au8Buffer[u8Length], au8Namespace, sizeof(au8Namespace));
+        u8Length += sizeof(au8Namespace);
+        for(u8 j = 0; j < BLE_GAP_ADDR_LEN; j++)
+        {
+          au8Buffer[u8Length++] = sAddress.addr[BLE_GAP_ADDR_LEN - 1 - j];
+        }
+        u8Length += 2;
+        break;
+
+      case BLEBEACON_URL:
+        /* [type][tx power][scheme][url][suffix] */
+        au8Buffer[u8Length++] = U8_BLEBEACON_FRAME_URL;
+        au8Buffer[u8Length++] = (u8)S8_BLEBEACON_TX_POWER_0M;
+        au8Buffer[u8Length++] = U8_BLEBEACON_URL_SCHEME;
+        memcpy(&au8Buffer[u8Length], BLEBEACON_URL_TEXT, sizeof(BLEBEACON_URL_TEXT) - 1);
+        u8Length += sizeof(BLEBEACON_URL_TEXT) - 1;
+        au8Buffer[u8Length++] = U8_BLEBEACON_URL_SUFFIX;
+        break;
+
+      case BLEBEACON_TLM:
+        /* [type][version][battery mV 2][temperature 8.8 2][advertising count 4][uptime 0.1s 4], big endian */
+        au8Buffer[u8Length++] = U8_BLEBEACON_FRAME_TLM;
+        u8Length += 13;
+        break;
+    }
+
+    u8Offset = BLEAdvAddField(&BLEBeacon_asFrames[i], BLE_GAP_AD_TYPE_SERVICE_DATA, au8Buffer, u8Length);
+    if(i == BLEBEACON_TLM)
+    {
+      BLEBeacon_u8TlmOffset = u8Offset + 2;
+    }
+
+    if(!BLEAdvValidate(BLEBeacon_asFrames[i].au8Data, BLEBeacon_asFrames[i].u8Length))
+    {
+      G_sBLEBeaconStats.u32InvalidFrames++;
+    }
+  }
+
+} /* end BLEBeaconBuildFrames() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBeaconStartNonConnectable(void)
+@brief Starts beaconing from the first scheduled frame and arms the next connectable slot.
+
+Promises:
+- Returns TRUE if advertising started
+
+*/
+static bool BLEBeaconStartNonConnectable(void)
+{
+  ble_gap_adv_params_t sParams;
+  u8 u8Frame = BLEBeacon_au8Schedule[0];
+
+  memset(&sParams, 0, sizeof(sParams));
+  sParams.type     = BLE_GAP_ADV_TYPE_ADV_NONCONN_IND;
+  sParams.fp       = BLE_GAP_ADV_FP_ANY;
+  sParams.interval = U16_BLEBEACON_INTERVAL;
+  sParams.timeout  = 0;
+
+  BLEBeacon_u8Slot = 0;
+  if(sd_ble_gap_adv_data_set(BLEBeacon_asFrames[u8Frame].au8Data, BLEBeacon_asFrames[u8Frame].u8Length,
+                             NULL, 0) != NRF_SUCCESS)
+  {
+    G_sBLEBeaconStats.u32SetErrors++;
+  }
+
+  BLEBeacon_eState = BLEBEACON_BEACONING;
+  if(U32_BLEBEACON_CONNECTABLE_PERIOD_MS != 0)
+  {
+    SwTimerStart(&BLEBeacon_sSlotTimer, U32_BLEBEACON_CONNECTABLE_PERIOD_MS);
+  }
+
+  return (sd_ble_gap_adv_start(&sParams) == NRF_SUCCESS);
+
+} /* end BLEBeaconStartNonConnectable() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEBeaconUpdateTelemetry(void* pvContext_)
+@brief Periodic timer: patches the TLM frame with current values.
+
+Promises:
+- Temperature (sd_temp_get, 0.25C -> 8.8 fixed point), advertising count and uptime are written into the TLM frame
+- Battery voltage stays 0 (not measured on this board)
+
+*/
+static void BLEBeaconUpdateTelemetry(void* pvContext_)
+{
+  u8 au8Tlm[12];
+  s32 s32Temperature = 0;
+  u32 u32Value;
+  u8 u8Nested;
+
+  (void)sd_temp_get((int32_t*)&s32Temperature);
+
+  au8Tlm[0] = 0;
+  au8Tlm[1] = 0;
+  u32Value = (u32)(s32Temperature * 64);
+  au8Tlm[2] = (u8)(u32Value >> 8);
+  au8Tlm[3] = (u8)u32Value;
+  u32Value = G_sBLEBeaconStats.u32Rotations;
+  au8Tlm[4] = (u8)(u32Value >> 24);
+  au8Tlm[5] = (u8)(u32Value >> 16);
+  au8Tlm[6] = (u8)(u32Value >> 8);
+  au8Tlm[7] = (u8)u32Value;
+  u32Value = G_u32SystemTime1ms / 100;
+  au8Tlm[8] = (u8)(u32Value >> 24);
+  au8Tlm[9] = (u8)(u32Value >> 16);
+  au8Tlm[10] = (u8)(u32Value >> 8);
+  au8Tlm[11] = (u8)u32Value;
+
+  /* The ISR may be handing this frame to the stack */
+  (void)SystemEnterCriticalSection(&u8Nested);
+  memcpy(&BLEBeacon_asFrames[BLEBEACON_TLM].au8Data[BLEBeacon_u8TlmOffset + 2], au8Tlm, sizeof(au8Tlm));
+  (void)SystemExitCriticalSection(u8Nested);
+
+} /* end BLEBeaconUpdateTelemetry() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEBeaconSlotCallback(void* pvContext_)
+@brief Opens or closes the connectable slot.
+
+Promises:
+- Beaconing: switches to connectable advertising with the normal payload for U32_BLEBEACON_CONNECTABLE_SLOT_MS
+- Connectable (nothing connected): returns to beaconing
+
+*/
+static void BLEBeaconSlotCallback(void* pvContext_)
+{
+  if(bleperipheralGetConnHandle() != BLE_CONN_HANDLE_INVALID)
+  {
+    return;
+  }
+
+  if(BLEBeacon_eState == BLEBEACON_BEACONING)
+  {
+    /* Stop rotating first so the ISR does not overwrite the connectable payload */
+    BLEBeacon_eState = BLEBEACON_CONNECTABLE;
+    (void)sd_ble_gap_adv_stop();
+    (void)BLEAdvCommit();
+    if(sd_ble_gap_adv_start(&BLEBeacon_sConnectableParams) == NRF_SUCCESS)
+    {
+      G_sBLEBeaconStats.u32ConnectableSlots++;
+    }
+    SwTimerStart(&BLEBeacon_sSlotTimer, U32_BLEBEACON_CONNECTABLE_SLOT_MS);
+  }
+  else if(BLEBeacon_eState == BLEBEACON_CONNECTABLE)
+  {
+    (void)sd_ble_gap_adv_stop();
+    (void)BLEBeaconStartNonConnectable();
+  }
+
+} /* end BLEBeaconSlotCallback() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBeaconOnConnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_CONNECTED: hold the rotation until the connection ends.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BLEBeaconOnConnected(ble_evt_t* p_ble_evt)
+{
+  if(BLEBeacon_eState != BLEBEACON_OFF)
+  {
+    BLEBeacon_eState = BLEBEACON_CONNECTED;
+    SwTimerStop(&BLEBeacon_sSlotTimer);
+  }
+
+  return TRUE;
+
+} /* end BLEBeaconOnConnected() */
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
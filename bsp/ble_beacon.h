@@ -0,0 +1,114 @@
+/**********************************************************************************************************************
+File: ble_beacon.h
+
+Description:
+Header file for ble_beacon.c
+**********************************************************************************************************************/
+
+#ifndef __BLE_BEACON_H
+#define __BLE_BEACON_H
+
+#include "typedefs.h"
+#include "ble.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* Frames follow the Eddystone layout: service data for the 16-bit UUID 0xFEAA, first byte is the frame type */
+#define U16_BLEBEACON_SERVICE_UUID        (u16)0xFEAA
+#define U8_BLEBEACON_FRAME_UID            (u8)0x00
+#define U8_BLEBEACON_FRAME_URL            (u8)0x10
+#define U8_BLEBEACON_FRAME_TLM            (u8)0x20
+
+#define S8_BLEBEACON_TX_POWER_0M          (s8)-20      /* Calibrated RSSI at 0m for the default 0dBm TX power */
+#define BLEBEACON_UID_NAMESPACE           {0x45, 0x6E, 0x67, 0x65, 0x6E, 0x75, 0x69, 0x63, 0x73, 0x00}  /* "Engenuics" */
+#define U8_BLEBEACON_URL_SCHEME           (u8)0x03     /* "https://" */
+#define BLEBEACON_URL_TEXT                "engenuics"
+#define U8_BLEBEACON_URL_SUFFIX           (u8)0x07     /* ".com" */
+
+#define U16_BLEBEACON_INTERVAL            (u16)BLE_GAP_ADV_NONCON_INTERVAL_MIN  /* 100ms, 0.625ms units */
+#define U8_BLEBEACON_ROTATION_GUARD_PCT   (u8)50       /* Radio events sooner than this % of the interval are not ours */
+#define U32_BLEBEACON_TLM_PERIOD_MS       (u32)1000    /* Telemetry frame refresh */
+
+/* Connectable slot: every PERIOD the beacon advertises the normal connectable payload for SLOT (0 PERIOD disables) */
+#define U32_BLEBEACON_CONNECTABLE_PERIOD_MS  (u32)10000
+#define U32_BLEBEACON_CONNECTABLE_SLOT_MS    (u32)1000
+
+#define U8_BLEBEACON_SCHEDULE_LENGTH      (u8)4        /* Advertising events in one rotation */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum BLEBeaconFrameType
+@brief Precomputed beacon payloads. */
+typedef enum
+{
+  BLEBEACON_UID = 0,                      /*!< @brief Namespace + instance (device address) identity */
+  BLEBEACON_URL,                          /*!< @brief Compressed URL */
+  BLEBEACON_TLM,                          /*!< @brief Uptime, advertising count and temperature */
+  BLEBEACON_FRAMES                        /*!< @brief Number of frames; must stay last */
+} BLEBeaconFrameType;
+
+/*!
+@enum BLEBeaconStateType
+@brief What the advertiser is doing while beacon mode is enabled. */
+typedef enum
+{
+  BLEBEACON_OFF = 0,                      /*!< @brief Beacon mode disabled; bleperipheral advertises as before */
+  BLEBEACON_BEACONING,                    /*!< @brief Non-connectable, rotating frames */
+  BLEBEACON_CONNECTABLE,                  /*!< @brief Connectable slot with the normal payload */
+  BLEBEACON_CONNECTED                     /*!< @brief A central connected during the slot */
+} BLEBeaconStateType;
+
+/*!
+@struct BLEBeaconStatsType
+@brief Beacon activity.
+*/
+typedef struct
+{
+  u32 u32Rotations;                       /*!< @brief Payload switches (one per beacon advertising event) */
+  u32 u32RadioEvents;                     /*!< @brief Radio notifications, including ANT and too-early ones */
+  u32 u32SetErrors;                       /*!< @brief Payloads the stack refused */
+  u32 u32InvalidFrames;                   /*!< @brief Built frames that failed BLEAdvValidate() */
+  u32 u32ConnectableSlots;                /*!< @brief Connectable slots opened */
+  u32 au32FramesSent[BLEBEACON_FRAMES];   /*!< @brief Rotations to each frame */
+} BLEBeaconStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEBeaconEnable(bool bEnable_);
+bool BLEBeaconIsEnabled(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEBeaconInitialize(void);
+bool BLEBeaconResume(void);
+void BLEBeaconRadioHandler(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BLEBeaconBuildFrames(void);
+static bool BLEBeaconStartNonConnectable(void);
+static void BLEBeaconUpdateTelemetry(void* pvContext_);
+static void BLEBeaconSlotCallback(void* pvContext_);
+static bool BLEBeaconOnConnected(ble_evt_t* p_ble_evt);
+
+
+#endif /* __BLE_BEACON_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,471 @@
+/**********************************************************************************************************************
+File: ble_bond.c
+
+Description:
+Bond store: keeps the keys and CCCD values (system attributes) of the bonded central in flash so a returning
+central can encrypt and receive notifications without pairing again or rewriting its CCCDs.
+
+One central is remembered; bonding with another replaces it.  Records (BLEBondRecordType) are appended to the bond
+page at U32_FLASH_BOND_PAGE and the last whole one is current, so an update never erases the only copy.  When the
+page is full it is erased and the current record is written to the first slot.  The record is written when bonding
+completes and again at disconnect if the CCCD values changed.
+
+On reconnect the central asks for the LTK by diversifier (BLE_GAP_EVT_SEC_INFO_REQUEST).  Once the link is
+encrypted the stored system attributes are handed back to the stack and BPEngenuics re-reads its CCCDs, so
+notifications can start straight away.  The time from connect to the first notification sent is kept for returning
+and new centrals in G_sBLEBondStats.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BLEBondStatsType G_sBLEBondStats;                      /* Bond store activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BLEBond_" and be declared as static.
+***********************************************************************************************************************/
+static BLEBondRecordType BLEBond_sRecord;              /* Current bond */
+static BLEBondRecordType BLEBond_sWriteBuffer;         /* Copy being written; flash reads it until the callback */
+static bool BLEBond_bBonded;                           /* BLEBond_sRecord holds a bond */
+static u8 BLEBond_u8NextSlot;                          /* First erased slot, or U8_BLEBOND_SLOTS when full */
+static bool BLEBond_bSaving;                           /* A write is queued */
+static bool BLEBond_bSaveAgain;                        /* The record changed while it was being written */
+
+static ble_gap_addr_t BLEBond_sConnectAddress;         /* Peer address from the connected event */
+static bool BLEBond_bLinkBonded;                       /* This connection belongs to the stored bond */
+static bool BLEBond_bRestored;                         /* ... and its keys came from flash */
+static bool BLEBond_bAwaitingFirstTx;                  /* First notification of this connection not sent yet */
+static u64 BLEBond_u64ConnectUs;                       /* When this connection started */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBondIsBonded(void)
+@brief Reports whether a central is bonded.
+
+Promises:
+- Returns TRUE if keys are stored
+
+*/
+bool BLEBondIsBonded(void)
+{
+  return BLEBond_bBonded;
+
+} /* end BLEBondIsBonded() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBondErase(void)
+@brief Forgets the bonded central.  It will have to pair again.
+
+Promises:
+- Returns TRUE if the bond page erase was queued
+- Returns FALSE if a save is still in progress
+
+*/
+bool BLEBondErase(void)
+{
+  if(BLEBond_bSaving)
+  {
+    return FALSE;
+  }
+
+  BLEBond_bBonded = FALSE;
+  BLEBond_bLinkBonded = FALSE;
+  memset(&BLEBond_sRecord, 0, sizeof(BLEBond_sRecord));
+
+  BLEBond_u8NextSlot = 0;
+  G_sBLEBondStats.u32PageErases++;
+  return FlashErasePage(U32_FLASH_BOND_PAGE, NULL, NULL);
+
+} /* end BLEBondErase() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEBondInitialize(void)
+@brief Loads the current bond from flash and registers the security and connection handlers.
+
+Requires:
+- FlashInitialize() and BLEIntegrationInitialize() have run
+
+Promises:
+- BLEBond_sRecord holds the last whole record, if any
+- Returns TRUE if every handler was registered
+
+*/
+bool BLEBondInitialize(void)
+{
+  const BLEBondRecordType* psSlot = (const BLEBondRecordType*)U32_FLASH_BOND_PAGE;
+  bool bResult = TRUE;
+
+  memset(&G_sBLEBondStats, 0, sizeof(G_sBLEBondStats));
+  BLEBond_bBonded = FALSE;
+  BLEBond_u8NextSlot = U8_BLEBOND_SLOTS;
+
+  /* Slots fill in order: stop at the first erased one.  A slot cut short by a reset has no commit word. */
+  for(u8 i = 0; i < U8_BLEBOND_SLOTS; i++, psSlot++)
+  {
+    if(psSlot->u32Magic == U32_FLASH_ERASED_WORD)
+    {
+      BLEBond_u8NextSlot = i;
+      break;
+    }
+
+    if( (psSlot->u32Magic == U32_BLEBOND_MAGIC) && (psSlot->u32Commit == U32_BLEBOND_COMMIT) )
+    {
+      BLEBond_sRecord = *psSlot;
+      BLEBond_bBonded = TRUE;
+    }
+  }
+
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONNECTED, BLEBondOnConnected);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_DISCONNECTED, BLEBondOnDisconnected);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_SEC_INFO_REQUEST, BLEBondOnSecInfoRequest);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_AUTH_STATUS, BLEBondOnAuthStatus);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONN_SEC_UPDATE, BLEBondOnConnSecUpdate);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GATTS_EVT_SYS_ATTR_MISSING, BLEBondOnSysAttrMissing);
+  bResult &= BLEIntegrationRegisterHandler(BLE_EVT_TX_COMPLETE, BLEBondOnTxComplete);
+
+  return bResult;
+
+} /* end BLEBondInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondSave(void)
+@brief Appends the current record to the bond page, erasing it first if it is full.
+
+Promises:
+- Returns TRUE if the write was queued, or will be once the write in progress finishes
+
+*/
+static bool BLEBondSave(void)
+{
+  u32* pu32Slot;
+
+  if(BLEBond_bSaving)
+  {
+    BLEBond_bSaveAgain = TRUE;
+    return TRUE;
+  }
+
+  BLEBond_sWriteBuffer = BLEBond_sRecord;
+  BLEBond_sWriteBuffer.u32Magic = U32_BLEBOND_MAGIC;
+  BLEBond_sWriteBuffer.u32Commit = U32_BLEBOND_COMMIT;
+
+  if(BLEBond_u8NextSlot >= U8_BLEBOND_SLOTS)
+  {
+    if(!FlashErasePage(U32_FLASH_BOND_PAGE, NULL, NULL))
+    {
+      G_sBLEBondStats.u32Errors++;
+      return FALSE;
+    }
+
+    BLEBond_u8NextSlot = 0;
+    G_sBLEBondStats.u32PageErases++;
+  }
+
+  /* Queued behind the erase, if there was one */
+  pu32Slot = (u32*)((BLEBondRecordType*)U32_FLASH_BOND_PAGE + BLEBond_u8NextSlot);
+  if(!FlashWrite(pu32Slot, (const u32*)&BLEBond_sWriteBuffer, sizeof(BLEBondRecordType) / sizeof(u32),
+                 BLEBondSaveDone, NULL))
+  {
+    G_sBLEBondStats.u32Errors++;
+    return FALSE;
+  }
+
+  BLEBond_u8NextSlot++;
+  BLEBond_bSaving = TRUE;
+  return TRUE;
+
+} /* end BLEBondSave() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEBondSaveDone(bool bSuccess_, void* pvContext_)
+@brief Flash callback for BLEBondSave().
+
+Promises:
+- Starts another save if the record changed in the meantime
+
+*/
+static void BLEBondSaveDone(bool bSuccess_, void* pvContext_)
+{
+  BLEBond_bSaving = FALSE;
+
+  if(bSuccess_)
+  {
+    G_sBLEBondStats.u32Saves++;
+  }
+  else
+  {
+    G_sBLEBondStats.u32Errors++;
+  }
+
+  if(BLEBond_bSaveAgain)
+  {
+    BLEBond_bSaveAgain = FALSE;
+    (void)BLEBondSave();
+  }
+
+} /* end BLEBondSaveDone() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnConnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_CONNECTED: starts timing the connection and remembers the peer address.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BLEBondOnConnected(ble_evt_t* p_ble_evt)
+{
+  BLEBond_u64ConnectUs = TimebaseGetUs();
+  BLEBond_sConnectAddress = p_ble_evt->evt.gap_evt.params.connected.peer_addr;
+  BLEBond_bLinkBonded = FALSE;
+  BLEBond_bRestored = FALSE;
+  BLEBond_bAwaitingFirstTx = TRUE;
+  return TRUE;
+
+} /* end BLEBondOnConnected() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnDisconnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_DISCONNECTED: saves the bonded central's CCCD values if they changed.
+
+Promises:
+- Returns TRUE unless the system attributes could not be read
+
+*/
+static bool BLEBondOnDisconnected(ble_evt_t* p_ble_evt)
+{
+  u8 au8SysAttr[U8_BLEBOND_SYS_ATTR_SIZE];
+  u16 u16Length = sizeof(au8SysAttr);
+  bool bResult = TRUE;
+
+  if(BLEBond_bLinkBonded)
+  {
+    if(sd_ble_gatts_sys_attr_get(p_ble_evt->evt.gap_evt.conn_handle, au8SysAttr, &u16Length) == NRF_SUCCESS)
+    {
+      if( (u16Length != BLEBond_sRecord.u16SysAttrLength) ||
+          (memcmp(au8SysAttr, BLEBond_sRecord.au8SysAttr, u16Length) != 0) )
+      {
+        BLEBond_sRecord.u16SysAttrLength = u16Length;
+        memcpy(BLEBond_sRecord.au8SysAttr, au8SysAttr, u16Length);
+        bResult = BLEBondSave();
+      }
+    }
+    else
+    {
+      G_sBLEBondStats.u32Errors++;
+      bResult = FALSE;
+    }
+  }
+
+  BLEBond_bLinkBonded = FALSE;
+  BLEBond_bRestored = FALSE;
+  BLEBond_bAwaitingFirstTx = FALSE;
+  return bResult;
+
+} /* end BLEBondOnDisconnected() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnSecInfoRequest(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_SEC_INFO_REQUEST: a central wants to encrypt with keys from an earlier bond.
+
+Promises:
+- Replies with the stored LTK if the diversifier matches the bond, otherwise with no keys (the central pairs again)
+- Returns TRUE if the reply was accepted
+
+*/
+static bool BLEBondOnSecInfoRequest(ble_evt_t* p_ble_evt)
+{
+  ble_gap_evt_sec_info_request_t* psRequest = &p_ble_evt->evt.gap_evt.params.sec_info_request;
+  ble_gap_enc_info_t* psEncInfo = NULL;
+  u32 u32Result;
+
+  if(BLEBond_bBonded && psRequest->enc_info && (psRequest->div == BLEBond_sRecord.sEncInfo.div))
+  {
+    psEncInfo = &BLEBond_sRecord.sEncInfo;
+    BLEBond_bLinkBonded = TRUE;
+    BLEBond_bRestored = TRUE;
+    G_sBLEBondStats.u32Restores++;
+  }
+  else
+  {
+    G_sBLEBondStats.u32UnknownPeers++;
+  }
+
+  u32Result = sd_ble_gap_sec_info_reply(p_ble_evt->evt.gap_evt.conn_handle, psEncInfo, NULL);
+  if(u32Result != NRF_SUCCESS)
+  {
+    G_sBLEBondStats.u32Errors++;
+  }
+
+  return (u32Result == NRF_SUCCESS);
+
+} /* end BLEBondOnSecInfoRequest() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnAuthStatus(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_AUTH_STATUS: pairing finished.  If we distributed an LTK this is a new bond; store it.
+
+Promises:
+- A new bond replaces the stored one, with no CCCD values yet
+- Returns TRUE unless the save could not be queued
+
+*/
+static bool BLEBondOnAuthStatus(ble_evt_t* p_ble_evt)
+{
+  ble_gap_evt_auth_status_t* psStatus = &p_ble_evt->evt.gap_evt.params.auth_status;
+
+  if( (psStatus->auth_status != BLE_GAP_SEC_STATUS_SUCCESS) || !psStatus->periph_kex.ltk )
+  {
+    return TRUE;
+  }
+
+  memset(&BLEBond_sRecord, 0, sizeof(BLEBond_sRecord));
+  BLEBond_sRecord.sEncInfo = psStatus->periph_keys.enc_info;
+  BLEBond_sRecord.sPeerAddress = psStatus->central_kex.address ? psStatus->central_keys.id_info : BLEBond_sConnectAddress;
+
+  BLEBond_bBonded = TRUE;
+  BLEBond_bLinkBonded = TRUE;
+  G_sBLEBondStats.u32Bonds++;
+
+  return BLEBondSave();
+
+} /* end BLEBondOnAuthStatus() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnConnSecUpdate(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_CONN_SEC_UPDATE: the link is encrypted.  A returning central gets its CCCD values back now rather
+than on its first attribute access.
+
+Promises:
+- Stored system attributes are set and BPEngenuics picks up the restored CCCDs
+- Returns TRUE unless the stack refused the system attributes
+
+*/
+static bool BLEBondOnConnSecUpdate(ble_evt_t* p_ble_evt)
+{
+  if( !BLEBond_bRestored || (BLEBond_sRecord.u16SysAttrLength == 0) )
+  {
+    return TRUE;
+  }
+
+  if(sd_ble_gatts_sys_attr_set(p_ble_evt->evt.gap_evt.conn_handle, BLEBond_sRecord.au8SysAttr,
+                               BLEBond_sRecord.u16SysAttrLength) != NRF_SUCCESS)
+  {
+    G_sBLEBondStats.u32Errors++;
+    return FALSE;
+  }
+
+  BPEngenuicsRefreshCccds();
+  return TRUE;
+
+} /* end BLEBondOnConnSecUpdate() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnSysAttrMissing(ble_evt_t* p_ble_evt)
+@brief BLE_GATTS_EVT_SYS_ATTR_MISSING: the stack needs CCCD values before it can go on.
+
+Promises:
+- Sets the stored values for a restored central, otherwise starts with every CCCD off
+- Returns TRUE if the system attributes were set
+
+*/
+static bool BLEBondOnSysAttrMissing(ble_evt_t* p_ble_evt)
+{
+  const u8* pu8SysAttr = NULL;
+  u16 u16Length = 0;
+
+  if(BLEBond_bRestored && (BLEBond_sRecord.u16SysAttrLength != 0))
+  {
+    pu8SysAttr = BLEBond_sRecord.au8SysAttr;
+    u16Length = BLEBond_sRecord.u16SysAttrLength;
+  }
+
+  if(sd_ble_gatts_sys_attr_set(p_ble_evt->evt.gatts_evt.conn_handle, pu8SysAttr, u16Length) != NRF_SUCCESS)
+  {
+    G_sBLEBondStats.u32Errors++;
+    return FALSE;
+  }
+
+  if(pu8SysAttr != NULL)
+  {
+    BPEngenuicsRefreshCccds();
+  }
+
+  return TRUE;
+
+} /* end BLEBondOnSysAttrMissing() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEBondOnTxComplete(ble_evt_t* p_ble_evt)
+@brief BLE_EVT_TX_COMPLETE: the first one of a connection ends the connect-to-notification measurement.
+
+Promises:
+- Returns TRUE
+
+*/
+static bool BLEBondOnTxComplete(ble_evt_t* p_ble_evt)
+{
+  u32 u32ElapsedUs;
+
+  if(BLEBond_bAwaitingFirstTx)
+  {
+    BLEBond_bAwaitingFirstTx = FALSE;
+    u32ElapsedUs = (u32)(TimebaseGetUs() - BLEBond_u64ConnectUs);
+    if(BLEBond_bRestored)
+    {
+      G_sBLEBondStats.u32ReturningConnectToNotifyUs = u32ElapsedUs;
+    }
+    else
+    {
+      G_sBLEBondStats.u32NewConnectToNotifyUs = u32ElapsedUs;
+    }
+  }
+
+  return TRUE;
+
+} /* end BLEBondOnTxComplete() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,94 @@
+/**********************************************************************************************************************
+File: ble_bond.h
+
+Description:
+Header file for ble_bond.c
+**********************************************************************************************************************/
+
+#ifndef __BLE_BOND_H
+#define __BLE_BOND_H
+
+#include "typedefs.h"
+#include "ble.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U32_BLEBOND_MAGIC              (u32)0x424F4E44  /* "BOND": slot in use */
+#define U32_BLEBOND_COMMIT             (u32)0x0000A55A  /* Last word of a record; written last, so the record is whole */
+#define U8_BLEBOND_SYS_ATTR_SIZE       (u8)32       /* CCCD values and CRC; 6 bytes per CCCD plus 2 */
+
+#define U8_BLEBOND_SLOTS               (u8)(U32_FLASH_PAGE_SIZE / sizeof(BLEBondRecordType))
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@struct BLEBondRecordType
+@brief The bonded peer as stored in flash.  Records are appended to the bond page; the last whole one is current.
+*/
+typedef struct
+{
+  u32 u32Magic;                           /*!< @brief U32_BLEBOND_MAGIC */
+  ble_gap_enc_info_t sEncInfo;            /*!< @brief LTK and diversifier we distributed */
+  ble_gap_addr_t sPeerAddress;            /*!< @brief Central's identity (or connection) address */
+  u16 u16SysAttrLength;                   /*!< @brief Bytes used in au8SysAttr; 0 until the first disconnect */
+  u8 au8SysAttr[U8_BLEBOND_SYS_ATTR_SIZE];   /*!< @brief sd_ble_gatts_sys_attr_get() image */
+  u32 u32Commit;                          /*!< @brief U32_BLEBOND_COMMIT */
+} BLEBondRecordType;
+
+/*!
+@struct BLEBondStatsType
+@brief Bond store activity and reconnect timing.  Compare the two notify times to see what restoring saves.
+*/
+typedef struct
+{
+  u32 u32Bonds;                           /*!< @brief New bonds stored */
+  u32 u32Restores;                        /*!< @brief Reconnects that found their keys */
+  u32 u32UnknownPeers;                    /*!< @brief Security info requests with no matching bond */
+  u32 u32Saves;                           /*!< @brief Records written */
+  u32 u32PageErases;                      /*!< @brief Bond page full and erased */
+  u32 u32Errors;                          /*!< @brief Flash or SoftDevice calls that failed */
+  u32 u32ReturningConnectToNotifyUs;      /*!< @brief Last bonded reconnect: connect to first notification sent */
+  u32 u32NewConnectToNotifyUs;            /*!< @brief Last unbonded connection: connect to first notification sent */
+} BLEBondStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEBondIsBonded(void);
+bool BLEBondErase(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEBondInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static bool BLEBondSave(void);
+static void BLEBondSaveDone(bool bSuccess_, void* pvContext_);
+static bool BLEBondOnConnected(ble_evt_t* p_ble_evt);
+static bool BLEBondOnDisconnected(ble_evt_t* p_ble_evt);
+static bool BLEBondOnSecInfoRequest(ble_evt_t* p_ble_evt);
+static bool BLEBondOnAuthStatus(ble_evt_t* p_ble_evt);
+static bool BLEBondOnConnSecUpdate(ble_evt_t* p_ble_evt);
+static bool BLEBondOnSysAttrMissing(ble_evt_t* p_ble_evt);
+static bool BLEBondOnTxComplete(ble_evt_t* p_ble_evt);
+
+
+#endif /* __BLE_BOND_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
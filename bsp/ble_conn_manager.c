@@ -0,0 +1,337 @@
+/**********************************************************************************************************************
+File: ble_conn_manager.c
+
+Description:
+Adaptive connection parameter manager for the peripheral link.
+
+The PPCP in bleperipheral.h asks for long intervals, which is right while nothing is happening but makes every
+POV update or log transfer wait up to a second on the radio.  This module asks the central for the FAST profile
+whenever data flows (BLEConnMgrActivity()) or the client enables the Engenuics service (EVENT_TOPIC_BLE_STATUS),
+and drops back to the IDLE profile after U32_BLECONNMGR_IDLE_MS of silence.
+
+Like the SDK's ble_conn_params, a request is only retried a few times: the central may answer with parameters
+outside the requested range or not answer at all.  Each outcome is counted in G_sBLEConnMgrStats next to the
+requested and achieved parameters.
+
+Everything runs in the main loop from BLE event handlers and one software timer that is only armed while there is
+a deadline to meet.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+BLEConnMgrStatsType G_sBLEConnMgrStats;                /* Requested versus achieved parameters */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "BLEConnMgr_" and be declared as static.
+***********************************************************************************************************************/
+static const ble_gap_conn_params_t BLEConnMgr_asProfiles[BLECONNMGR_PROFILES] =
+{
+  /* min_conn_interval, max_conn_interval, slave_latency, conn_sup_timeout */
+  {U16_BLECONNMGR_FAST_MIN_INTERVAL, U16_BLECONNMGR_FAST_MAX_INTERVAL,
+   U16_BLECONNMGR_FAST_LATENCY, U16_BLECONNMGR_FAST_SUP_TIMEOUT},
+  {MIN_CONN_INTERVAL, MAX_CONN_INTERVAL, SLAVE_LATENCY, CONN_SUP_TIMEOUT}
+};
+
+static SwTimerType BLEConnMgr_sTimer;                  /* Next idle or retry deadline */
+static u32 BLEConnMgr_u32LastActivityMs;               /* Time of the last BLEConnMgrActivity() */
+static u32 BLEConnMgr_u32NextRequestMs;                /* Earliest next request, or the response deadline */
+static bool BLEConnMgr_bPending;                       /* Request sent, BLE_GAP_EVT_CONN_PARAM_UPDATE not yet seen */
+static u8 BLEConnMgr_u8Retries;                        /* Requests made for the current target */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void BLEConnMgrActivity(void)
+@brief Notes that data is flowing.  Cheap enough to call for every message.
+
+Promises:
+- The FAST profile is wanted for the next U32_BLECONNMGR_IDLE_MS
+- If the link is not already heading for FAST, a request is made now (subject to the retry limits)
+
+*/
+void BLEConnMgrActivity(void)
+{
+  BLEConnMgr_u32LastActivityMs = G_u32SystemTime1ms;
+
+  /* Already FAST: the idle deadline is re-armed when the timer runs */
+  if(G_sBLEConnMgrStats.u8Target != BLECONNMGR_FAST)
+  {
+    BLEConnMgrEvaluate();
+  }
+
+} /* end BLEConnMgrActivity() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool BLEConnMgrInitialize(void)
+@brief Registers for the GAP events that drive the manager.
+
+Requires:
+- BLEIntegrationInitialize(), EventBusInitialize() and SwTimerInitialize() have run
+
+Promises:
+- Returns TRUE if all handlers were registered
+
+*/
+bool BLEConnMgrInitialize(void)
+{
+  bool bResult = TRUE;
+
+  memset(&G_sBLEConnMgrStats, 0, sizeof(G_sBLEConnMgrStats));
+  G_sBLEConnMgrStats.u8Target = BLECONNMGR_PROFILES;
+  G_sBLEConnMgrStats.u8Requested = BLECONNMGR_PROFILES;
+
+  BLEConnMgr_bPending = FALSE;
+  SwTimerCreate(&BLEConnMgr_sTimer, SWTIMER_ONE_SHOT, BLEConnMgrTimerCallback, NULL);
+
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONNECTED, BLEConnMgrOnConnected);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_DISCONNECTED, BLEConnMgrOnDisconnected);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONN_PARAM_UPDATE, BLEConnMgrOnUpdate);
+  bResult &= EventBusSubscribe(EVENT_TOPIC_BLE_STATUS, BLEConnMgrOnStatus);
+
+  return bResult;
+
+} /* end BLEConnMgrInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEConnMgrEvaluate(void)
+@brief Chooses the wanted profile, sends a request if one is due and arms the timer for the next deadline.
+*/
+static void BLEConnMgrEvaluate(void)
+{
+  u32 u32Now = G_u32SystemTime1ms;
+  u32 u32Quiet = u32Now - BLEConnMgr_u32LastActivityMs;
+  u32 u32WaitMs = 0;
+  s32 s32DueMs;
+  BLEConnMgrProfileType eTarget = BLECONNMGR_IDLE;
+  u32 u32Result;
+
+  if(bleperipheralGetConnHandle() == BLE_CONN_HANDLE_INVALID)
+  {
+    SwTimerStop(&BLEConnMgr_sTimer);
+    return;
+  }
+
+  if(u32Quiet < U32_BLECONNMGR_IDLE_MS)
+  {
+    eTarget = BLECONNMGR_FAST;
+    u32WaitMs = U32_BLECONNMGR_IDLE_MS - u32Quiet;
+  }
+
+  if(eTarget != G_sBLEConnMgrStats.u8Target)
+  {
+    G_sBLEConnMgrStats.u8Target = (u8)eTarget;
+    BLEConnMgr_u8Retries = 0;
+  }
+
+  if( !BLEConnMgrIsAchieved(eTarget) &&
+      (BLEConnMgr_bPending || (BLEConnMgr_u8Retries < U8_BLECONNMGR_MAX_RETRIES)) )
+  {
+    s32DueMs = (s32)(BLEConnMgr_u32NextRequestMs - u32Now);
+    if(s32DueMs <= 0)
+    {
+      if(BLEConnMgr_bPending)
+      {
+        /* The central never answered */
+        BLEConnMgr_bPending = FALSE;
+        G_sBLEConnMgrStats.u32Timeouts++;
+        BLEConnMgr_u32NextRequestMs = u32Now + U32_BLECONNMGR_RETRY_MS;
+      }
+      else
+      {
+        u32Result = sd_ble_gap_conn_param_update(bleperipheralGetConnHandle(), &BLEConnMgr_asProfiles[eTarget]);
+        if(u32Result == NRF_SUCCESS)
+        {
+          BLEConnMgr_bPending = TRUE;
+          BLEConnMgr_u8Retries++;
+          G_sBLEConnMgrStats.u8Requested = (u8)eTarget;
+          G_sBLEConnMgrStats.u32Requests++;
+          BLEConnMgr_u32NextRequestMs = u32Now + U32_BLECONNMGR_RESPONSE_MS;
+        }
+        else
+        {
+          G_sBLEConnMgrStats.u32Busy++;
+          BLEConnMgr_u32NextRequestMs = u32Now + U32_BLECONNMGR_RETRY_MS;
+        }
+      }
+
+      s32DueMs = (s32)(BLEConnMgr_u32NextRequestMs - u32Now);
+    }
+
+    if( (u32WaitMs == 0) || ((u32)s32DueMs < u32WaitMs) )
+    {
+      u32WaitMs = (u32)s32DueMs;
+    }
+  }
+
+  if(u32WaitMs != 0)
+  {
+    SwTimerStart(&BLEConnMgr_sTimer, u32WaitMs);
+  }
+  else
+  {
+    SwTimerStop(&BLEConnMgr_sTimer);
+  }
+
+} /* end BLEConnMgrEvaluate() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEConnMgrTimerCallback(void* pvContext_)
+@brief An idle, retry or response deadline has passed.
+*/
+static void BLEConnMgrTimerCallback(void* pvContext_)
+{
+  BLEConnMgrEvaluate();
+
+} /* end BLEConnMgrTimerCallback() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEConnMgrIsAchieved(BLEConnMgrProfileType eProfile_)
+@brief TRUE if the current connection interval is inside the profile's range.
+*/
+static bool BLEConnMgrIsAchieved(BLEConnMgrProfileType eProfile_)
+{
+  return (G_sBLEConnMgrStats.u16Interval >= BLEConnMgr_asProfiles[eProfile_].min_conn_interval) &&
+         (G_sBLEConnMgrStats.u16Interval <= BLEConnMgr_asProfiles[eProfile_].max_conn_interval);
+
+} /* end BLEConnMgrIsAchieved() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEConnMgrSetAchieved(const ble_gap_conn_params_t* psParams_)
+@brief Records the parameters the link is actually using.
+*/
+static void BLEConnMgrSetAchieved(const ble_gap_conn_params_t* psParams_)
+{
+  G_sBLEConnMgrStats.u16Interval   = psParams_->max_conn_interval;
+  G_sBLEConnMgrStats.u16Latency    = psParams_->slave_latency;
+  G_sBLEConnMgrStats.u16SupTimeout = psParams_->conn_sup_timeout;
+
+} /* end BLEConnMgrSetAchieved() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEConnMgrOnConnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_CONNECTED: start in FAST for service discovery after the first-request delay.
+*/
+static bool BLEConnMgrOnConnected(ble_evt_t* p_ble_evt)
+{
+  BLEConnMgrSetAchieved(&p_ble_evt->evt.gap_evt.params.connected.conn_params);
+
+  BLEConnMgr_bPending = FALSE;
+  BLEConnMgr_u8Retries = 0;
+  BLEConnMgr_u32LastActivityMs = G_u32SystemTime1ms;
+  BLEConnMgr_u32NextRequestMs = G_u32SystemTime1ms + U32_BLECONNMGR_FIRST_DELAY_MS;
+  G_sBLEConnMgrStats.u8Target = BLECONNMGR_PROFILES;
+  BLEConnMgrEvaluate();
+
+  return TRUE;
+
+} /* end BLEConnMgrOnConnected() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEConnMgrOnDisconnected(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_DISCONNECTED: stop until the next connection.
+*/
+static bool BLEConnMgrOnDisconnected(ble_evt_t* p_ble_evt)
+{
+  BLEConnMgr_bPending = FALSE;
+  G_sBLEConnMgrStats.u8Target = BLECONNMGR_PROFILES;
+  SwTimerStop(&BLEConnMgr_sTimer);
+
+  return TRUE;
+
+} /* end BLEConnMgrOnDisconnected() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool BLEConnMgrOnUpdate(ble_evt_t* p_ble_evt)
+@brief BLE_GAP_EVT_CONN_PARAM_UPDATE: score the answer to our request and decide what to do next.
+
+The central may also change parameters on its own; that only updates the achieved values.
+*/
+static bool BLEConnMgrOnUpdate(ble_evt_t* p_ble_evt)
+{
+  BLEConnMgrSetAchieved(&p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params);
+
+  if(BLEConnMgr_bPending)
+  {
+    BLEConnMgr_bPending = FALSE;
+    if(BLEConnMgrIsAchieved((BLEConnMgrProfileType)G_sBLEConnMgrStats.u8Requested))
+    {
+      G_sBLEConnMgrStats.u32Accepted++;
+      BLEConnMgr_u8Retries = 0;
+    }
+    else
+    {
+      G_sBLEConnMgrStats.u32Rejected++;
+      if(BLEConnMgr_u8Retries >= U8_BLECONNMGR_MAX_RETRIES)
+      {
+        G_sBLEConnMgrStats.u32GaveUp++;
+      }
+    }
+
+    BLEConnMgr_u32NextRequestMs = G_u32SystemTime1ms + U32_BLECONNMGR_RETRY_MS;
+  }
+
+  BLEConnMgrEvaluate();
+  return TRUE;
+
+} /* end BLEConnMgrOnUpdate() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void BLEConnMgrOnStatus(const EventMessageType* psMessage_)
+@brief EVENT_TOPIC_BLE_STATUS: a client that has just enabled the service is about to exchange data, so go FAST.
+*/
+static void BLEConnMgrOnStatus(const EventMessageType* psMessage_)
+{
+  u32 u32Status;
+
+  memcpy(&u32Status, psMessage_->au8Payload, sizeof(u32Status));
+  if(u32Status & _BPENGENUICS_SERVICE_ENABLED)
+  {
+    BLEConnMgrActivity();
+  }
+
+} /* end BLEConnMgrOnStatus() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,100 @@
+/**********************************************************************************************************************
+File: ble_conn_manager.h
+
+Description:
+Header file for ble_conn_manager.c
+**********************************************************************************************************************/
+
+#ifndef __BLE_CONN_MANAGER_H
+#define __BLE_CONN_MANAGER_H
+
+#include "typedefs.h"
+#include "event_bus.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+/* FAST profile: 7.5ms - 30ms, no latency (intervals in 1.25ms units, timeout in 10ms units) */
+#define U16_BLECONNMGR_FAST_MIN_INTERVAL      (u16)6
+#define U16_BLECONNMGR_FAST_MAX_INTERVAL      (u16)24
+#define U16_BLECONNMGR_FAST_LATENCY           (u16)0
+#define U16_BLECONNMGR_FAST_SUP_TIMEOUT       (u16)400
+
+/* IDLE profile is the PPCP set in bleperipheral.h */
+
+#define U32_BLECONNMGR_IDLE_MS                (u32)5000    /* No activity for this long drops to the IDLE profile */
+#define U32_BLECONNMGR_FIRST_DELAY_MS         (u32)5000    /* Let the central finish discovery first */
+#define U32_BLECONNMGR_RETRY_MS               (u32)5000    /* Wait after a rejection or busy stack */
+#define U32_BLECONNMGR_RESPONSE_MS            (u32)30000   /* No CONN_PARAM_UPDATE by now counts as rejected */
+#define U8_BLECONNMGR_MAX_RETRIES             (u8)3        /* Requests per profile before giving up until it changes */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum BLEConnMgrProfileType
+@brief Connection parameter sets the manager moves between. */
+typedef enum
+{
+  BLECONNMGR_FAST = 0,                    /*!< @brief Short interval while data flows */
+  BLECONNMGR_IDLE,                        /*!< @brief Long interval with slave latency */
+  BLECONNMGR_PROFILES                     /*!< @brief Number of profiles; also "none"; must stay last */
+} BLEConnMgrProfileType;
+
+/*!
+@struct BLEConnMgrStatsType
+@brief Requested versus achieved connection parameters.
+*/
+typedef struct
+{
+  u8  u8Target;                           /*!< @brief BLEConnMgrProfileType currently wanted */
+  u8  u8Requested;                        /*!< @brief Profile of the last request sent */
+  u16 u16Interval;                        /*!< @brief Achieved connection interval (1.25ms units) */
+  u16 u16Latency;                         /*!< @brief Achieved slave latency */
+  u16 u16SupTimeout;                      /*!< @brief Achieved supervision timeout (10ms units) */
+  u32 u32Requests;                        /*!< @brief Update requests accepted by the stack */
+  u32 u32Accepted;                        /*!< @brief Updates that landed inside the requested range */
+  u32 u32Rejected;                        /*!< @brief Updates outside the requested range */
+  u32 u32Timeouts;                        /*!< @brief Requests with no answer within U32_BLECONNMGR_RESPONSE_MS */
+  u32 u32Busy;                            /*!< @brief Requests refused by the stack */
+  u32 u32GaveUp;                          /*!< @brief Profiles abandoned after U8_BLECONNMGR_MAX_RETRIES */
+} BLEConnMgrStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void BLEConnMgrActivity(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEConnMgrInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void BLEConnMgrEvaluate(void);
+static void BLEConnMgrTimerCallback(void* pvContext_);
+static bool BLEConnMgrIsAchieved(BLEConnMgrProfileType eProfile_);
+static void BLEConnMgrSetAchieved(const ble_gap_conn_params_t* psParams_);
+static bool BLEConnMgrOnConnected(ble_evt_t* p_ble_evt);
+static bool BLEConnMgrOnDisconnected(ble_evt_t* p_ble_evt);
+static bool BLEConnMgrOnUpdate(ble_evt_t* p_ble_evt);
+static void BLEConnMgrOnStatus(const EventMessageType* psMessage_);
+
+
+
+#endif /* __BLE_CONN_MANAGER_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -3,6 +3,13 @@ File: ble_integration.c
 
 Description:
 This is a ble_integration .c file new source code
+
+BLE events are pulled from the SoftDevice into one word-aligned buffer sized for the largest event the stack can
+deliver, and handed in place to the handlers registered for that event ID with BLEIntegrationRegisterHandler().
+
+GATT services also register the range of attribute handles they own with BLEIntegrationRegisterService().  Events
+about one attribute (writes, authorization requests, confirmations) go straight to the owning service through a
+table indexed by handle, so adding services does not add work per event.
 **********************************************************************************************************************/
 
 #include "configuration.h"
@@ -13,6 +20,7 @@ All Global variable names shall start with "G_"
 ***********************************************************************************************************************/
 /* New variables */
 volatile u32 G_u32BLEIntegrationFlags;                 /* Global state flags */
+BleIntegrationStatsType G_sBLEIntegrationStats;        /* BLE event pump statistics */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -27,12 +35,19 @@ Global variable definitions with scope limited to this local application.
 Variable names shall start with "SocInt_" and be declared as static.
 ***********************************************************************************************************************/
 //static u32 bleintegration_u32Timeout;                                            /* Timeout counter used across states */
-static u8 au8EventBuffer[100];      // TODO: Determine exact value             /* Single BLE buffer used for incoming BLE messages */
+static u32 BLEInt_au32EventBuffer[U16_BLEINT_EVENT_BUFFER_WORDS];          /* Single BLE buffer used for incoming BLE messages */
 
-/*--------------------------------------------------------------------------------------------------------------------*/
-/* Private Function Declarations.                                                                                                   */
-/*--------------------------------------------------------------------------------------------------------------------*/
-static ble_evt_t* BLEIntegration_get_buffer(void);
+static u8 BLEInt_au8FirstHandler[U8_BLEINT_EVENT_IDS];                     /* First handler entry for each event ID */
+static BleEventHandlerType BLEInt_apfnHandlers[U8_BLEINT_MAX_HANDLERS];    /* Registered handlers */
+static u8 BLEInt_au8NextHandler[U8_BLEINT_MAX_HANDLERS];                   /* Next entry for the same event ID */
+static u8 BLEInt_u8HandlerCount;                                           /* Entries used in BLEInt_apfnHandlers */
+
+static BleEventHandlerType BLEInt_apfnServices[U8_BLEINT_MAX_SERVICES];     /* Registered service handlers */
+static u8 BLEInt_u8ServiceCount;                                           /* Entries used in BLEInt_apfnServices */
+static u8 BLEInt_au8HandleOwner[U16_BLEINT_MAX_ATTR_HANDLE + 1];           /* Service index per attribute handle */
+
+static u32 BLEInt_u32RateSecond;                                           /* G_u32SystemTime1s being counted */
+static u32 BLEInt_u32RateCount;                                            /* Events pulled so far in that second */
 
 /**********************************************************************************************************************
 Function Definitions
@@ -41,11 +56,114 @@ Function Definitions
 /* Public functions                                                                                                   */
 /*--------------------------------------------------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BLEIntegrationRegisterHandler
+
+Description:
+Adds a handler for one BLE event ID.  Several handlers may register for the same ID; they are called in
+registration order.
+
+Requires:
+  - BLEIntegrationInitialize() has run
+  - u16EventId_ is a common, GAP or GATTS event ID
+
+Promises:
+  - Returns TRUE if pfHandler_ will be called for every u16EventId_ event
+  - Returns FALSE if the ID is not dispatched or the handler table is full
+*/
+bool BLEIntegrationRegisterHandler(u16 u16EventId_, BleEventHandlerType pfHandler_)
+{
+  u8 u8Index = BLEIntegrationEventIndex(u16EventId_);
+  u8* pu8Link;
+
+  if( (u8Index == U8_BLEINT_NO_HANDLER) || (pfHandler_ == NULL) ||
+      (BLEInt_u8HandlerCount == U8_BLEINT_MAX_HANDLERS) )
+  {
+    return FALSE;
+  }
+
+  /* Append to the end of this ID's chain */
+  pu8Link = &BLEInt_au8FirstHandler[u8Index];
+  while(*pu8Link != U8_BLEINT_NO_HANDLER)
+  {
+    pu8Link = &BLEInt_au8NextHandler[*pu8Link];
+  }
+
+  BLEInt_apfnHandlers[BLEInt_u8HandlerCount] = pfHandler_;
+  BLEInt_au8NextHandler[BLEInt_u8HandlerCount] = U8_BLEINT_NO_HANDLER;
+  *pu8Link = BLEInt_u8HandlerCount;
+  BLEInt_u8HandlerCount++;
+
+  return TRUE;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BLEIntegrationRegisterService
+
+Description:
+Claims a range of attribute handles for a GATT service.  Attribute events for any handle in the range are passed
+to pfHandler_; the service then decides which of its characteristics the event is for.
+
+Requires:
+  - BLEIntegrationInitialize() has run
+  - The service and its characteristics have been added, so the handles are known
+
+Promises:
+  - Returns TRUE if the range now belongs to pfHandler_
+  - Returns FALSE if the range is invalid, overlaps another service or the registry is full
+*/
+bool BLEIntegrationRegisterService(u16 u16FirstHandle_, u16 u16LastHandle_, BleEventHandlerType pfHandler_)
+{
+  if( (pfHandler_ == NULL) || (u16FirstHandle_ == BLE_GATT_HANDLE_INVALID) ||
+      (u16FirstHandle_ > u16LastHandle_) || (u16LastHandle_ > U16_BLEINT_MAX_ATTR_HANDLE) ||
+      (BLEInt_u8ServiceCount == U8_BLEINT_MAX_SERVICES) )
+  {
+    return FALSE;
+  }
+
+  for(u16 i = u16FirstHandle_; i <= u16LastHandle_; i++)
+  {
+    if(BLEInt_au8HandleOwner[i] != U8_BLEINT_NO_SERVICE)
+    {
+      return FALSE;
+    }
+  }
+
+  memset(&BLEInt_au8HandleOwner[u16FirstHandle_], BLEInt_u8ServiceCount, u16LastHandle_ - u16FirstHandle_ + 1);
+  BLEInt_apfnServices[BLEInt_u8ServiceCount] = pfHandler_;
+  BLEInt_u8ServiceCount++;
+
+  return TRUE;
+}
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected functions                                                                                                */
 /*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BLEIntegrationInitialize
+
+Description:
+Empties the dispatch table.
+
+Requires:
+  - Called before any module registers a BLE event handler
+
+Promises:
+  - No handlers or services are registered and statistics are cleared
+*/
 bool BLEIntegrationInitialize(void)
 {
+  memset(BLEInt_au8FirstHandler, U8_BLEINT_NO_HANDLER, sizeof(BLEInt_au8FirstHandler));
+  memset(BLEInt_au8HandleOwner, U8_BLEINT_NO_SERVICE, sizeof(BLEInt_au8HandleOwner));
+  BLEInt_u8ServiceCount = 0;
+  memset(&G_sBLEIntegrationStats, 0, sizeof(G_sBLEIntegrationStats));
+  BLEInt_u8HandlerCount = 0;
+  BLEInt_u32RateSecond = G_u32SystemTime1s;
+  BLEInt_u32RateCount = 0;
+
   return true;
 }
 
@@ -63,14 +181,52 @@ Promises:
 */
 void BLEIntegrationHandler(void)
 {
+    u8 u8Entry;
+    u16 u16AttrHandle;
+
     // Fetch message.
     ble_evt_t* ble_evt = BLEIntegration_get_buffer();
       
     // Check if message was successfully fetched.
     while (ble_evt)
     {
-      // Dispatch to all BLE specific handlers.
-      bleperipheralEventHandler(ble_evt);
+      // Dispatch to every handler registered for this event ID.
+      u8Entry = BLEIntegrationEventIndex(ble_evt->header.evt_id);
+      if (u8Entry != U8_BLEINT_NO_HANDLER)
+      {
+        u8Entry = BLEInt_au8FirstHandler[u8Entry];
+      }
+
+      // Events about one attribute also go to the service that owns it.
+      u16AttrHandle = BLEIntegrationEventAttrHandle(ble_evt);
+      if (u16AttrHandle != BLE_GATT_HANDLE_INVALID)
+      {
+        if ((u16AttrHandle <= U16_BLEINT_MAX_ATTR_HANDLE) &&
+            (BLEInt_au8HandleOwner[u16AttrHandle] != U8_BLEINT_NO_SERVICE))
+        {
+          if (!BLEInt_apfnServices[BLEInt_au8HandleOwner[u16AttrHandle]](ble_evt))
+          {
+            G_sBLEIntegrationStats.u32HandlerErrors++;
+          }
+        }
+        else
+        {
+          G_sBLEIntegrationStats.u32UnownedHandles++;
+        }
+      }
+      else if (u8Entry == U8_BLEINT_NO_HANDLER)
+      {
+        G_sBLEIntegrationStats.u32Unhandled++;
+      }
+
+      while (u8Entry != U8_BLEINT_NO_HANDLER)
+      {
+        if (!BLEInt_apfnHandlers[u8Entry](ble_evt))
+        {
+          G_sBLEIntegrationStats.u32HandlerErrors++;
+        }
+        u8Entry = BLEInt_au8NextHandler[u8Entry];
+      }
       
       // Check if another message is pending.
       ble_evt = BLEIntegration_get_buffer();
@@ -92,26 +248,137 @@ Requires:
 
 Promises:
   - Returns NULL if no ble_message is availble.
-  - Copies the ble_message to au8EventBuffer if message is available and returns pointer to 
+  - Copies the ble_message to BLEInt_au32EventBuffer if message is available and returns pointer to 
     the buffer.
+  - Failures are counted rather than treated as "no event".  An event too long for the buffer stays queued in the
+    SoftDevice, so it is counted with its length in u32MaxEventLength and the pump stops until the next SD event.
 */
 static ble_evt_t* BLEIntegration_get_buffer(void)
 {
-   u16 u16EventLength = sizeof(au8EventBuffer);
+   u16 u16EventLength = sizeof(BLEInt_au32EventBuffer);
    u32 u32ErrorCode;
 
-   u32ErrorCode = sd_ble_evt_get(au8EventBuffer, &u16EventLength);
+   u32ErrorCode = sd_ble_evt_get((u8*)BLEInt_au32EventBuffer, &u16EventLength);
    if (u32ErrorCode == NRF_ERROR_NOT_FOUND)
    {
       return NULL;
    }
+
+   if (u32ErrorCode == NRF_SUCCESS || u32ErrorCode == NRF_ERROR_DATA_SIZE)
+   {
+     if (u16EventLength > G_sBLEIntegrationStats.u32MaxEventLength)
+     {
+       G_sBLEIntegrationStats.u32MaxEventLength = u16EventLength;
+     }
+   }
+
+   if (u32ErrorCode == NRF_ERROR_DATA_SIZE)
+   {
+     G_sBLEIntegrationStats.u32Oversized++;
+     return NULL;
+   }
    else if (u32ErrorCode != NRF_SUCCESS)
    {
+     G_sBLEIntegrationStats.u32Dropped++;
      return NULL;
    }
+
+   G_sBLEIntegrationStats.u32Events++;
+   BLEIntegrationUpdateRate();
    
-   return (ble_evt_t*) au8EventBuffer;
+   return (ble_evt_t*) BLEInt_au32EventBuffer;
+
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BLEIntegrationEventIndex
+
+Description:
+Maps a BLE event ID to its row in the dispatch table.
+
+Promises:
+  - Returns the row for common, GAP and GATTS event IDs
+  - Returns U8_BLEINT_NO_HANDLER for any other ID
+*/
+static u8 BLEIntegrationEventIndex(u16 u16EventId_)
+{
+  if (u16EventId_ <= BLE_GAP_EVT_LAST)
+  {
+    return (u8)u16EventId_;
+  }
+
+  if ( (u16EventId_ >= BLE_GATTS_EVT_BASE) && (u16EventId_ <= BLE_GATTS_EVT_LAST) )
+  {
+    return (u8)(U8_BLEINT_GATTS_INDEX + (u16EventId_ - BLE_GATTS_EVT_BASE));
+  }
+
+  return U8_BLEINT_NO_HANDLER;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BLEIntegrationEventAttrHandle
+
+Description:
+Finds the attribute an event is about.
+
+Promises:
+  - Returns the attribute handle of GATTS write, authorization and confirmation events
+  - Returns BLE_GATT_HANDLE_INVALID for every other event
+*/
+static u16 BLEIntegrationEventAttrHandle(ble_evt_t* p_ble_evt)
+{
+  ble_gatts_evt_t* psGattsEvt = &p_ble_evt->evt.gatts_evt;
+
+  switch (p_ble_evt->header.evt_id)
+  {
+    case BLE_GATTS_EVT_WRITE:
+      return psGattsEvt->params.write.handle;
+
+    case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+      if (psGattsEvt->params.authorize_request.type == BLE_GATTS_AUTHORIZE_TYPE_READ)
+      {
+        return psGattsEvt->params.authorize_request.request.read.handle;
+      }
+      return psGattsEvt->params.authorize_request.request.write.handle;
+
+    case BLE_GATTS_EVT_HVC:
+      return psGattsEvt->params.hvc.handle;
+
+    default:
+      return BLE_GATT_HANDLE_INVALID;
+  }
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BLEIntegrationUpdateRate
+
+Description:
+Counts one event toward the events/second figure.  The count for a second is published when the first event of a
+later second arrives; a gap of more than a second with no events means the last second had none.
+
+Promises:
+  - G_sBLEIntegrationStats.u32EventsPerSecond holds the count for the last complete second with traffic
+*/
+static void BLEIntegrationUpdateRate(void)
+{
+  u32 u32Now = G_u32SystemTime1s;
+
+  if (u32Now != BLEInt_u32RateSecond)
+  {
+    G_sBLEIntegrationStats.u32EventsPerSecond = ((u32Now - BLEInt_u32RateSecond) == 1) ? BLEInt_u32RateCount : 0;
+    if (G_sBLEIntegrationStats.u32EventsPerSecond > G_sBLEIntegrationStats.u32MaxEventsPerSecond)
+    {
+      G_sBLEIntegrationStats.u32MaxEventsPerSecond = G_sBLEIntegrationStats.u32EventsPerSecond;
+    }
+
+    BLEInt_u32RateSecond = u32Now;
+    BLEInt_u32RateCount = 0;
+  }
 
+  BLEInt_u32RateCount++;
 }
 
 
@@ -8,15 +8,54 @@ Header file for ble_integration.c
 #ifndef __BLEINT_H
 #define __BLEINT_H
 
+#include "typedefs.h"
+#include "ble.h"
+#include "ble_gatt.h"
+
 /**********************************************************************************************************************
 Type Definitions
 **********************************************************************************************************************/
+/* Handler for one BLE event ID.  Return FALSE if an SD call made while handling the event failed. */
+typedef bool(*BleEventHandlerType)(ble_evt_t* p_ble_evt);
+
+/*!
+@struct BleIntegrationStatsType
+@brief BLE event pump statistics.
+*/
+typedef struct
+{
+  u32 u32Events;                          /*!< @brief Events pulled from the SoftDevice */
+  u32 u32Unhandled;                       /*!< @brief Events with no registered handler */
+  u32 u32HandlerErrors;                   /*!< @brief Handlers that returned FALSE */
+  u32 u32Oversized;                       /*!< @brief Events dropped because they did not fit the buffer */
+  u32 u32Dropped;                         /*!< @brief sd_ble_evt_get() failures other than "no event" */
+  u32 u32MaxEventLength;                  /*!< @brief Longest event seen in bytes */
+  u32 u32EventsPerSecond;                 /*!< @brief Events pulled during the last complete second */
+  u32 u32MaxEventsPerSecond;              /*!< @brief Highest u32EventsPerSecond seen */
+  u32 u32UnownedHandles;                  /*!< @brief Attribute events for a handle no service claimed */
+} BleIntegrationStatsType;
 
 
 /**********************************************************************************************************************
 Constants / Definitions
 **********************************************************************************************************************/
 #define BLEINT_INIT (u32)0x00
+
+/* Event buffer: the largest event is a GATTS write carrying a full ATT MTU of data after the fixed ble_evt_t */
+#define U16_BLEINT_EVENT_BUFFER_SIZE    (u16)(sizeof(ble_evt_t) + GATT_MTU_SIZE_DEFAULT)
+#define U16_BLEINT_EVENT_BUFFER_WORDS   (u16)((U16_BLEINT_EVENT_BUFFER_SIZE + sizeof(u32) - 1) / sizeof(u32))
+
+/* Dispatch table: common and GAP event IDs are contiguous from 0; GATTS IDs are packed in after them.
+A peripheral with no GATT client or L2CAP channels never sees the other ranges. */
+#define U8_BLEINT_GATTS_INDEX           (u8)(BLE_GAP_EVT_LAST + 1)
+#define U8_BLEINT_EVENT_IDS             (u8)(U8_BLEINT_GATTS_INDEX + (BLE_GATTS_EVT_LAST - BLE_GATTS_EVT_BASE + 1))
+#define U8_BLEINT_MAX_HANDLERS          (u8)24            /* Registrations across all event IDs */
+#define U8_BLEINT_NO_HANDLER            (u8)0xFF
+
+/* Service registry: attribute handle -> owning service, one byte per handle */
+#define U8_BLEINT_MAX_SERVICES          (u8)4
+#define U16_BLEINT_MAX_ATTR_HANDLE      (u16)31           /* Highest attribute handle a service may claim */
+#define U8_BLEINT_NO_SERVICE            (u8)0xFF
 /*
     31 [0] 
     30 [0] 
@@ -67,6 +106,8 @@ Function Declarations
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Public functions                                                                                                   */
 /*--------------------------------------------------------------------------------------------------------------------*/
+bool BLEIntegrationRegisterHandler(u16 u16EventId_, BleEventHandlerType pfHandler_);
+bool BLEIntegrationRegisterService(u16 u16FirstHandle_, u16 u16LastHandle_, BleEventHandlerType pfHandler_);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -79,6 +120,10 @@ void BLEIntegrationHandler(void);
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private functions                                                                                                  */
 /*--------------------------------------------------------------------------------------------------------------------*/
+static ble_evt_t* BLEIntegration_get_buffer(void);
+static u8 BLEIntegrationEventIndex(u16 u16EventId_);
+static void BLEIntegrationUpdateRate(void);
+static u16 BLEIntegrationEventAttrHandle(ble_evt_t* p_ble_evt);
 
 
 
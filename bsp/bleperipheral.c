@@ -27,7 +27,6 @@ Global variable definitions with scope limited to this local application.
 Variable names shall start with "SocInt_" and be declared as static.
 ***********************************************************************************************************************/
 //static u32 bleperipheral_u32Timeout;                      /* Timeout counter used across states */
-static ble_gap_adv_params_t             m_adv_params;                                /**< Parameters to be passed to the stack when starting advertising. */
 static ble_gap_sec_params_t             m_sec_params;                                /**< Security requirements for this application. */
 static uint16_t                         m_conn_handle = BLE_CONN_HANDLE_INVALID;     /**< Handle of the current connection. */
 
@@ -62,89 +61,83 @@ bool bleperipheralInitialize(void)
   // Set up all the base services for the peripheral mode.
   bResult |= bleperipheral_gap_params_init();
   bResult |= bleperipheral_advertising_init();
+  bResult |= bleperipheral_events_init();
+  bResult |= BLEBondInitialize();
   bResult |= bleperipheral_services_init();
+  bResult |= BLEConnMgrInitialize();
+  bResult |= BLEBeaconInitialize();
   bleperipheral_sec_params_init();
+#ifdef BLEBEACON_ENABLED
+  bResult |= BLEBeaconEnable(TRUE);
+#else
   bResult |= bleperipheral_advertising_start();
+#endif /* BLEBEACON_ENABLED */
   
   return bResult;
 }
 
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: blePeripheralEventHandler(ble_evt*)
+Function: bool bleperipheralIsConnectedandEnabled(void)
 
 Description:
-The Event handler which handles the various GATT and GAP events received from the SoftDevice once BLE Services have been activated.
+Reports whether a central is connected.  Whether it has also enabled a service is up to that service to track.
 
 Requires:
-  - ble_evt_t*: Pointer to the single buffer holding the current ble_evt_t from the SoftDevice.
+  - None
 
 Promises:
-  - Decodes the ble_evt_t and handles message accordingly.
-  - Returns TRUE if ble_evt_t decoded and action taken.
-  - Returns FALSE if ble_evt_t decoded and action failed.
+  - Returns TRUE while the connection handle is valid, FALSE otherwise.
 */
-bool bleperipheralEventHandler(ble_evt_t* p_ble_evt)
+bool bleperipheralIsConnectedandEnabled(void)
 {
-    u32 u32ErrorCode = NRF_SUCCESS;
-    
-    switch (p_ble_evt->header.evt_id)
-    {
-      case BLE_GAP_EVT_CONNECTED:
-        m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
-        BPEngenuicsOnConnect(p_ble_evt);
-        break;
-
-      case BLE_GAP_EVT_DISCONNECTED:
-        m_conn_handle = BLE_CONN_HANDLE_INVALID;
-        BPEngenuicsOnDisconnect();
-        bleperipheral_advertising_start();
-        break;
-
-      case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
-        u32ErrorCode = sd_ble_gap_sec_params_reply(m_conn_handle,
-                                               BLE_GAP_SEC_STATUS_SUCCESS,
-                                               &m_sec_params);
-        break;
-
-      case BLE_GAP_EVT_TIMEOUT:
-        break;
-
-      case BLE_GATTS_EVT_SYS_ATTR_MISSING:
-        u32ErrorCode = sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0);
-        break;
-          
-      case BLE_GATTS_EVT_WRITE:
-        BPEngenuicsOnWrite(p_ble_evt);
-        break;
-
-      default:
-        // No implementation needed.
-        break;
-    }
+   // Check if connected and service enabled on BLE.
+   return (m_conn_handle != BLE_CONN_HANDLE_INVALID);
+}
 
-    return (u32ErrorCode == NRF_SUCCESS);
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: bleperipheralGetConnHandle
+
+Description:
+Returns the handle of the current connection.  This is the only copy of the connection handle; services and other
+BLE modules read it here instead of tracking connect and disconnect events themselves.
+
+Requires:
+  - None
+
+Promises:
+  - Returns the connection handle, or BLE_CONN_HANDLE_INVALID when not connected.
+*/
+u16 bleperipheralGetConnHandle(void)
+{
+   return m_conn_handle;
 }
 
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: bool bleperipheralIsConnectedandEnabled(void)
+Function: bleperipheralGetDeviceName
 
 Description:
-The Event handler which handles the various GATT and GAP events received from the SoftDevice once BLE Services have been activated.
+Returns the GAP device name: the stored KVSTORE_KEY_DEVICE_NAME setting if there is one, otherwise DEVICE_NAME.
 
 Requires:
-  - ble_evt_t*: Pointer to the single buffer holding the current ble_evt_t from the SoftDevice.
+  - pu8Name_ has room for u8Size_ bytes
 
 Promises:
-  - Decodes the ble_evt_t and handles message accordingly.
-  - Returns TRUE if ble_evt_t decoded and action taken.
-  - Returns FALSE if ble_evt_t decoded and action failed.
+  - Copies the name (not terminated) to pu8Name_ and returns its length.
 */
-bool bleperipheralIsConnectedandEnabled(void)
+u8 bleperipheralGetDeviceName(u8* pu8Name_, u8 u8Size_)
 {
-   // Check if connected and service enabled on BLE.
-   return (m_conn_handle != BLE_CONN_HANDLE_INVALID);
+   u8 u8Length = KVStoreGet(KVSTORE_KEY_DEVICE_NAME, pu8Name_, u8Size_);
+
+   if (u8Length == 0)
+   {
+     u8Length = MIN(sizeof(DEVICE_NAME) - 1, u8Size_);
+     memcpy(pu8Name_, DEVICE_NAME, u8Length);
+   }
+
+   return u8Length;
 }
 
 
@@ -170,10 +163,13 @@ static bool bleperipheral_gap_params_init(void)
     u32 u32ErrorCode = NRF_SUCCESS;
     ble_gap_conn_params_t   gap_conn_params;
     ble_gap_conn_sec_mode_t sec_mode;
+    u8                      au8Name[U8_KVSTORE_MAX_VALUE];
+    u8                      u8NameLength;
 
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
 
-    u32ErrorCode |= sd_ble_gap_device_name_set(&sec_mode, DEVICE_NAME, strlen(DEVICE_NAME));
+    u8NameLength = bleperipheralGetDeviceName(au8Name, sizeof(au8Name));
+    u32ErrorCode |= sd_ble_gap_device_name_set(&sec_mode, au8Name, u8NameLength);
     u32ErrorCode |= sd_ble_gap_appearance_set(BLEPERIPHERAL_DEVICE_APPEARANCE);
 
     memset(&gap_conn_params, 0, sizeof(gap_conn_params));
@@ -191,10 +187,11 @@ static bool bleperipheral_gap_params_init(void)
 Function: bleperipheral_advertising_init
 
 Description:
-Initializes the advertising parameters for the device.
+Initializes the advertising data for the device.  The payload itself is built and cached by
+ble_advertising so dynamic fields can be updated without encoding it again.
 
 Requires:
-  - None
+  - GAP device name and appearance are set
 
 Promises:
   - Returns TRUE if advertising params are successfully completed.
@@ -202,38 +199,12 @@ Promises:
 */
 static bool bleperipheral_advertising_init(void)
 {
-    u32 u32ErrorCode = NRF_SUCCESS;
-    ble_advdata_t advdata;
-    u8 u8Flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    bool bResult;
 
-    ble_uuid_t adv_uuids[] =
-    {
-      {BLE_UUID_HEART_RATE_SERVICE,         BLE_UUID_TYPE_BLE},
-      {BLE_UUID_DEVICE_INFORMATION_SERVICE, BLE_UUID_TYPE_BLE}
-    };
-
-    // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance      = true;
-    advdata.flags.size              = sizeof(u8Flags);
-    advdata.flags.p_data            = &u8Flags;
-    advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    advdata.uuids_complete.p_uuids  = adv_uuids;
-
-    u32ErrorCode |= ble_advdata_set(&advdata, NULL);
-
-    // Initialise advertising parameters (used when starting advertising)
-    memset(&m_adv_params, 0, sizeof(m_adv_params));
-
-    m_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
-    m_adv_params.p_peer_addr = NULL;
-    m_adv_params.fp          = BLE_GAP_ADV_FP_ANY;
-    m_adv_params.interval    = APP_ADV_INTERVAL;
-    m_adv_params.timeout     = APP_ADV_TIMEOUT_IN_SECONDS;
+    // Build and set advertising data; the interval comes from the advertising policy (see ble_advertising.c)
+    bResult = BLEAdvInitialize();
     
-    return u32ErrorCode == NRF_SUCCESS;
+    return bResult;
     
 }
 
@@ -258,6 +229,20 @@ static bool bleperipheral_services_init(void)
   {
     return false;
   }
+
+  // Message framing, bulk upload, event log retrieval and the ANT device table on top of the BPEngenuics
+  // characteristics.
+  BPFrameInitialize();
+  BPBulkInitialize();
+  if ( !BPLogInitialize() )
+  {
+    return false;
+  }
+
+  if ( !BPScanInitialize() )
+  {
+    return false;
+  }
   
   return true;
   
@@ -268,7 +253,7 @@ static bool bleperipheral_services_init(void)
 Function: bleperipheral_advertising_start
 
 Description:
-Start Advertising
+Start Advertising under the current advertising policy.  While beacon mode is enabled it owns advertising, so beaconing is resumed instead.
 
 Requires:
   - None
@@ -279,10 +264,13 @@ Promises:
 */
 static bool bleperipheral_advertising_start(void)
 {
-    u32 u32ErrorCode;
+    if (BLEBeaconIsEnabled())
+    {
+      return BLEBeaconResume();
+    }
 
-    u32ErrorCode = sd_ble_gap_adv_start(&m_adv_params);
-    return (u32ErrorCode == NRF_SUCCESS);
+    // Boot and disconnect both start at the fastest step of the advertising policy.
+    return BLEAdvStart();
 }
 
 
@@ -310,6 +298,95 @@ static void bleperipheral_sec_params_init(void)
 }
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: bleperipheral_events_init
+
+Description:
+Registers the GAP event handlers with the BLE event pump.  Security info and system attributes are handled by the
+bond store (ble_bond.c).  Called before the services are added so
+the connection handle is already up to date when the services' own connect/disconnect handlers run.
+
+Requires:
+  - BLEIntegrationInitialize() has run
+
+Promises:
+  - Returns TRUE if every handler is registered.
+  - Returns FALSE if the dispatch table is full.
+*/
+static bool bleperipheral_events_init(void)
+{
+  bool bResult = true;
+
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_CONNECTED, bleperipheral_on_connected);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_DISCONNECTED, bleperipheral_on_disconnected);
+  bResult &= BLEIntegrationRegisterHandler(BLE_GAP_EVT_SEC_PARAMS_REQUEST, bleperipheral_on_sec_params_request);
+
+  return bResult;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: bleperipheral_on_connected
+
+Description:
+BLE_GAP_EVT_CONNECTED handler.  Saves the connection handle and logs the connection.
+
+Requires:
+  - p_ble_evt: The current event from the BLE event pump.
+
+Promises:
+  - Returns TRUE.
+*/
+static bool bleperipheral_on_connected(ble_evt_t* p_ble_evt)
+{
+    m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    EventLogWrite(EVENTLOG_CONNECT, 0, p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval);
+    return true;
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: bleperipheral_on_disconnected
+
+Description:
+BLE_GAP_EVT_DISCONNECTED handler.  Clears the connection, logs the reason and restarts advertising.
+
+Requires:
+  - p_ble_evt: The current event from the BLE event pump.
+
+Promises:
+  - Returns TRUE if advertising restarted.
+*/
+static bool bleperipheral_on_disconnected(ble_evt_t* p_ble_evt)
+{
+    m_conn_handle = BLE_CONN_HANDLE_INVALID;
+    EventLogWrite(EVENTLOG_DISCONNECT, p_ble_evt->evt.gap_evt.params.disconnected.reason, 0);
+    return bleperipheral_advertising_start();
+}
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: bleperipheral_on_sec_params_request
+
+Description:
+BLE_GAP_EVT_SEC_PARAMS_REQUEST handler.  Replies with the application's security parameters.
+
+Requires:
+  - p_ble_evt: The current event from the BLE event pump.
+
+Promises:
+  - Returns TRUE if the reply was accepted.
+*/
+static bool bleperipheral_on_sec_params_request(ble_evt_t* p_ble_evt)
+{
+    u32 u32ErrorCode;
+
+    u32ErrorCode = sd_ble_gap_sec_params_reply(m_conn_handle,
+                                               BLE_GAP_SEC_STATUS_SUCCESS,
+                                               &m_sec_params);
+    return (u32ErrorCode == NRF_SUCCESS);
+}
+
 
 
 
@@ -62,19 +62,19 @@ Constants / Definitions
 */
 
 
-#define DEVICE_NAME                     "BLETT4660"                                  /**< Name of device. Will be included in the advertising data. */
+#define DEVICE_NAME                     "BLETT4660"                                  /**< Default name of device (KVSTORE_KEY_DEVICE_NAME overrides it). Will be included in the advertising data. */
 #define MANUFACTURER_NAME               "Engenuics"                                  /**< Manufacturer. Will be passed to Device Information Service. */
 #define BLEPERIPHERAL_DEVICE_APPEARANCE BLE_APPEARANCE_HID_GAMEPAD                   // Advertise as a HID Gamepad device.
 
-#define APP_ADV_INTERVAL                40                                           /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
+#define APP_ADV_INTERVAL                40                                           /**< Fastest advertising interval (in units of 0.625 ms. This value corresponds to 25 ms); slower steps come from the ble_advertising policy. */
 #define APP_ADV_TIMEOUT_IN_SECONDS      0                                            /**< The advertising timeout in units of seconds. */
 
 #define SECOND_1_25_MS_UNITS            800                                          /**< Definition of 1 second, when 1 unit is 1.25 ms. */
 #define SECOND_10_MS_UNITS              100                                          /**< Definition of 1 second, when 1 unit is 10 ms. */
 #define MIN_CONN_INTERVAL               (SECOND_1_25_MS_UNITS / 2)                   /**< Minimum acceptable connection interval (0.5 seconds), Connection interval uses 1.25 ms units. */
 #define MAX_CONN_INTERVAL               (SECOND_1_25_MS_UNITS)                       /**< Maximum acceptable connection interval (1 second), Connection interval uses 1.25 ms units. */
-#define SLAVE_LATENCY                   0                                            /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                (4 * SECOND_10_MS_UNITS)                     /**< Connection supervisory timeout (4 seconds), Supervision Timeout uses 10 ms units. */
+#define SLAVE_LATENCY                   2                                            /**< Slave latency while idle; ble_conn_manager requests 0 when data flows. */
+#define CONN_SUP_TIMEOUT                (8 * SECOND_10_MS_UNITS)                     /**< Connection supervisory timeout (8 seconds, > 2 x (1 + SLAVE_LATENCY) x MAX_CONN_INTERVAL), Supervision Timeout uses 10 ms units. */
 
 #define SEC_PARAM_TIMEOUT               30                                           /**< Timeout for Pairing Request or Security Request (in seconds). */
 #define SEC_PARAM_BOND                  1                                            /**< Perform bonding. */
@@ -99,8 +99,9 @@ Function Declarations
 /* Protected functions                                                                                                */
 /*--------------------------------------------------------------------------------------------------------------------*/
 bool bleperipheralInitialize(void);
-bool bleperipheralEventHandler(ble_evt_t* evt);
 bool bleperipheralIsConnectedandEnabled(void);
+u8 bleperipheralGetDeviceName(u8* pu8Name_, u8 u8Size_);
+u16 bleperipheralGetConnHandle(void);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -111,6 +112,10 @@ static bool bleperipheral_advertising_init(void);
 static bool bleperipheral_services_init(void);
 static bool bleperipheral_advertising_start(void);
 static void bleperipheral_sec_params_init(void);
+static bool bleperipheral_events_init(void);
+static bool bleperipheral_on_connected(ble_evt_t* p_ble_evt);
+static bool bleperipheral_on_disconnected(ble_evt_t* p_ble_evt);
+static bool bleperipheral_on_sec_params_request(ble_evt_t* p_ble_evt);
 
 
 #endif /* __ANTINT_H */
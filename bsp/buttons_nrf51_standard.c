@@ -9,7 +9,7 @@ start and end of the action.
 
 ------------------------------------------------------------------------------------------------------------------------
 GLOBALS
-- NONE
+- volatile u32 G_u32ButtonMissedEdges
 
 CONSTANTS
 - U32_DEBOUNCE_TIME
@@ -28,6 +28,7 @@ PROTECTED FUNCTIONS
 - void ButtonInitialize(void)
 - void ButtonRunActiveState(void)
 - void ButtonStartDebounce(u32 u32BitPosition_, PortOffsetType ePort_)
+- void ButtonDebounceEdge(u8 u8Button_, u32 u32TimeStamp_)
 
 
 ***********************************************************************************************************************/
@@ -39,6 +40,7 @@ Global variable definitions with scope across entire project.
 All Global variable names shall start with "G_<type>Button"
 ***********************************************************************************************************************/
 /* New variables */
+volatile u32 G_u32ButtonMissedEdges;                   /*!< @brief Edges the work queue had no room for */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -57,6 +59,7 @@ Variable names shall start with "Button_<type>" and be declared as static.
 static fnCode_type Button_pfnStateMachine;                  /* The Button application state machine function pointer */
 
 static ButtonStatusType Button_asStatus[U8_TOTAL_BUTTONS];  /*!< @brief Individual status parameters for buttons */
+static volatile u8 Button_u8MissedMask;                     /*!< @brief Bit per button with an edge still to debounce */
 
 #if 0
 static ButtonStateType Button_aeCurrentState[TOTAL_BUTTONS];/* Current pressed state of button */
@@ -233,6 +236,7 @@ void ButtonInitialize(void)
     Button_asStatus[i].eCurrentState = RELEASED;
     Button_asStatus[i].eNewState     = RELEASED;
     Button_asStatus[i].u32TimeStamp  = 0;
+    SwTimerCreate(&Button_asStatus[i].sDebounceTimer, SWTIMER_ONE_SHOT, NULL, NULL);
 
     /* Event configuration for toggle events */
     nrf_gpiote_event_config(G_asBspButtonConfigurations[i].eChannelNumber, 
@@ -247,6 +251,7 @@ void ButtonInitialize(void)
   }
   
   /* Init complete: set function pointer */
+  WatchdogRegisterTask(WATCHDOG_TASK_BUTTON, U32_WATCHDOG_TASK_PERIOD_MS);
   Button_pfnStateMachine = ButtonSM_Idle;
   
  } /* end ButtonInitialize() */
@@ -268,6 +273,8 @@ Promises:
 */
 void ButtonRunActiveState(void)
 {
+  WatchdogCheckIn(WATCHDOG_TASK_BUTTON);
+  ButtonResync();
   Button_pfnStateMachine();
 
 } /* end ButtonRunActiveState */
@@ -277,7 +284,7 @@ void ButtonRunActiveState(void)
 /*!----------------------------------------------------------------------------------------------------------------------
 @fn void ButtonStartDebounce(GpioeChannelType eEventChannel_)
 
-@brief Called only from ISR: sets the "debounce active" flag and debounce start time  
+@brief Called only from ISR: hands the button edge to the main loop to start debouncing  
 
 Requires:
 - Only the GPIOE ISR should call this function
@@ -286,13 +293,15 @@ Requires:
 therefore should start debouncing
 
 Promises:
-- If the indicated button is found in G_asBspButtonConfigurations, then the
-corresponding interrupt is disabled and debounce information is set in Button_asStatus
+- The channel event is cleared
+- If the indicated button is found in G_asBspButtonConfigurations, the corresponding interrupt is
+disabled until the debounce completes and a WORK_ITEM_BUTTON_EDGE is posted.  If the work queue
+is full the edge is counted in G_u32ButtonMissedEdges and left for ButtonResync() instead.
 
 */
 void ButtonStartDebounce(GpioeChannelType eEventChannel_)
 {
-  u8 u8Button = 0;
+  u8 u8Button = NOBUTTON;
   
   /* Parse through to find the button */
   for(u8 i = 0; i < U8_TOTAL_BUTTONS; i++)
@@ -304,24 +313,100 @@ void ButtonStartDebounce(GpioeChannelType eEventChannel_)
     }
   }
   
-  /* If the button has been found, disable the interrupt and update debounce status */
+  NRF_GPIOTE->EVENTS_IN[eEventChannel_] = 0;   
+
+  /* If the button has been found, disable the interrupt and pass it to the main loop */
   if(u8Button != NOBUTTON)
   {
     NRF_GPIOTE->INTENCLR = G_asBspButtonConfigurations[u8Button].u32GpioeChannelBit;
-    NRF_GPIOTE->EVENTS_IN[G_asBspButtonConfigurations[u8Button].eChannelNumber] = 0;   
-
-    Button_asStatus[u8Button].bDebounceActive = TRUE;
-    Button_asStatus[u8Button].u32DebounceTimeStart = G_u32SystemTime1ms;
+    if( !WorkQueuePost(WORK_ITEM_BUTTON_EDGE, u8Button, 0, 0) )
+    {
+      Button_u8MissedMask |= (u8)(1 << u8Button);
+      G_u32ButtonMissedEdges++;
+    }
   }
   
 } /* end ButtonStartDebounce() */
 
 
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void ButtonDebounceEdge(u8 u8Button_, u32 u32TimeStamp_)
+
+@brief Main loop side of a button edge: sets the "debounce active" flag and starts the debounce timer  
+
+Requires:
+- Called only from WorkQueueDispatch()
+
+@param u8Button_ is the button index posted by ButtonStartDebounce()
+@param u32TimeStamp_ is the system time of the edge
+
+Promises:
+- Debounce information is set in Button_asStatus and the debounce timer runs for
+the rest of U32_BUTTON_DEBOUNCE_TIME measured from the edge
+
+*/
+void ButtonDebounceEdge(u8 u8Button_, u32 u32TimeStamp_)
+{
+  u32 u32Elapsed;
+  
+  if(u8Button_ >= U8_TOTAL_BUTTONS)
+  {
+    return;
+  }
+  
+  Button_asStatus[u8Button_].bDebounceActive = TRUE;
+  Button_asStatus[u8Button_].u32DebounceTimeStart = u32TimeStamp_;
+
+  u32Elapsed = G_u32SystemTime1ms - u32TimeStamp_;
+  SwTimerStart(&Button_asStatus[u8Button_].sDebounceTimer, 
+               (u32Elapsed < U32_BUTTON_DEBOUNCE_TIME) ? (U32_BUTTON_DEBOUNCE_TIME - u32Elapsed) : 0);
+  
+} /* end ButtonDebounceEdge() */
+
+
 
 /*------------------------------------------------------------------------------------------------------------------*/
 /*! @privatesection */                                                                                            
 /*--------------------------------------------------------------------------------------------------------------------*/
 
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void ButtonResync(void)
+
+@brief Debounces buttons whose edge ButtonStartDebounce() could not post.
+
+The edge time is lost, so the debounce runs from now.  When it ends the pin is read as usual,
+so the button state catches up with whatever happened while the queue was full.
+
+Promises:
+- Every button in Button_u8MissedMask is debouncing and its bit is cleared
+
+*/
+static void ButtonResync(void)
+{
+  u8 u8Missed;
+  u8 u8Nested;
+
+  if(Button_u8MissedMask == 0)
+  {
+    return;
+  }
+
+  (void)SystemEnterCriticalSection(&u8Nested);
+  u8Missed = Button_u8MissedMask;
+  Button_u8MissedMask = 0;
+  (void)SystemExitCriticalSection(u8Nested);
+
+  for(u8 i = 0; i < U8_TOTAL_BUTTONS; i++)
+  {
+    if(u8Missed & (1 << i))
+    {
+      ButtonDebounceEdge(i, G_u32SystemTime1ms);
+    }
+  }
+
+} /* end ButtonResync() */
+
+
 
 /***********************************************************************************************************************
 State Machine Function Definitions
@@ -381,7 +466,7 @@ static void ButtonSM_ButtonActive(void)
       Button_pfnStateMachine = ButtonSM_ButtonActive;
       
       /* Check if debounce period is over */
-      if( IsTimeUp(&Button_asStatus[i].u32DebounceTimeStart, U32_BUTTON_DEBOUNCE_TIME) )
+      if( SwTimerCheckExpired(&Button_asStatus[i].sDebounceTimer) )
       {
         /* Read the pin state and invert for ACTIVE_LOW */
         u32Input = NRF_GPIO->IN;
@@ -410,6 +495,7 @@ static void ButtonSM_ButtonActive(void)
           {
             Button_asStatus[i].bNewPressFlag = TRUE;
             Button_asStatus[i].u32TimeStamp  = G_u32SystemTime1ms;
+            EventBusPublish(EVENT_TOPIC_BUTTON, &i, sizeof(i));
           }
         }
 
@@ -417,7 +503,7 @@ static void ButtonSM_ButtonActive(void)
         Button_asStatus[i].bDebounceActive = FALSE;
         NRF_GPIOTE->INTENSET = G_asBspButtonConfigurations[i].u32GpioeChannelBit;
         
-      } /* end if( IsTimeUp...) */
+      } /* end if( SwTimerCheckExpired...) */
     } /* end if(Button_asStatus[i].bDebounceActive) */
   } /* end for (u8 i = 0; i < U8_TOTAL_BUTTONS; i++) */
   
@@ -24,12 +24,13 @@ typedef enum {RELEASED, PRESSED} ButtonStateType;
 */
 typedef struct 
 {
-  bool bDebounceActive;                   /*!< @brief TRUE by ISR if a button interrupt occurs */
+  bool bDebounceActive;                   /*!< @brief TRUE while the button is debouncing after an interrupt */
   bool bNewPressFlag;                     /*!< @brief TRUE if the press has not been acknowledged */
   ButtonStateType eCurrentState;          /*!< @brief Current state of the button */
   ButtonStateType eNewState;              /*!< @brief New state of the button */
-  u32 u32DebounceTimeStart;               /*!< @brief System time loaded by ISR when button interrupt occurs */
+  u32 u32DebounceTimeStart;               /*!< @brief System time when the button interrupt occurred */
   u32 u32TimeStamp;                       /*!< @brief System time when the button was pressed */
+  SwTimerType sDebounceTimer;             /*!< @brief Debounce timeout */
 }ButtonStatusType;
 
 
@@ -59,12 +60,14 @@ void ButtonInitialize(void);
 void ButtonRunActiveState(void);
 u8 ButtonGetActiveColumn(void);
 void ButtonStartDebounce(GpioeChannelType eEventChannel_);
+void ButtonDebounceEdge(u8 u8Button_, u32 u32TimeStamp_);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private functions                                                                                                  */
 /*--------------------------------------------------------------------------------------------------------------------*/
 static void ButtonRotateColumns(void);
+static void ButtonResync(void);
 
 /***********************************************************************************************************************
 State Machine Declarations
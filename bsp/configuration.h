@@ -22,6 +22,9 @@ Runtime Switches
 ***********************************************************************************************************************/
 #define SOFTDEVICE_ENABLED  
 #define INTERRUPTS_ENABLED  
+#define TIMEBASE_SUBTICK_ENABLED            /* TIMER1 adds us resolution to the RTC timebase (keeps HFCLK running) */
+#define BPENGENUICS_VLOC_USER               /* BPEngenuics characteristic values live in application RAM (VLOC_USER) */
+//#define BLEBEACON_ENABLED                 /* Start as a rotating non-connectable beacon with a connectable slot */
 
 
 /**********************************************************************************************************************
@@ -59,9 +62,20 @@ Includes
 #include "ant_parameters.h"
 #include "ant_error.h"
 #include "soc_integration.h"
+#include "radio_sched.h"
+#include "flash.h"
+#include "kv_store.h"
+#include "event_log.h"
 #include "ant_integration.h"
+#include "ant_beacon.h"
+#include "ant_burst.h"
+#include "ant_scan.h"
 #include "ble_integration.h"
 #include "bleperipheral.h"
+#include "ble_conn_manager.h"
+#include "ble_advertising.h"
+#include "ble_beacon.h"
+#include "ble_bond.h"
 #include "ble.h"
 #include "ble_gap.h"
 #include "ble_gatts.h"
@@ -69,11 +83,21 @@ Includes
 #include "ble_advdata.h"
 #include "ble_srv_common.h"
 #include "bleperipheral_engenuics.h"
+#include "bleperipheral_frames.h"
+#include "bleperipheral_bulk.h"
+#include "ble_racp.h"
+#include "bleperipheral_log.h"
+#include "bleperipheral_scan.h"
 
 
 
 /* nRF51422 implementation headers */
 #include "interrupts.h"
+#include "timebase.h"
+#include "watchdog.h"
+#include "work_queue.h"
+#include "event_bus.h"
+#include "sw_timers.h"
 #include "main.h"
 #include "typedefs.h"
 #include "utilities.h"
@@ -0,0 +1,227 @@
+/**********************************************************************************************************************
+File: event_bus.c
+
+Description:
+Publish / subscribe event bus between application modules.
+
+Topics are fixed at compile time (EventTopicType).  Modules register handlers for the topics they need during
+their Initialize() functions.  EventBusPublish() copies the payload once into a preallocated message slot and
+EventBusRunActiveState() later hands that same slot to every subscriber in publish order, so one producer can fan
+out to several consumers without further copies and without producers knowing who listens.
+
+The bus is a main-loop service: publish and subscribe only from the main loop (including from protocol event
+handlers and bus handlers, which run there).  ISRs should post to the work queue instead.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+EventBusStatsType G_sEventBusStats;                    /* Event bus statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "EventBus_" and be declared as static.
+***********************************************************************************************************************/
+static EventHandlerType EventBus_aapfnSubscribers[EVENT_TOPICS][U8_EVENTBUS_MAX_SUBSCRIBERS]; /* Handlers by topic */
+static EventMessageType EventBus_asSlots[U8_EVENTBUS_SLOTS];  /* Message slots used as a FIFO */
+static u8 EventBus_u8Head;                                    /* Next free slot */
+static u8 EventBus_u8Tail;                                    /* Next slot to deliver */
+static u8 EventBus_u8Pending;                                 /* Slots in use */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool EventBusSubscribe(EventTopicType eTopic_, EventHandlerType pfHandler_)
+@brief Registers a handler for a topic.
+
+Requires:
+- EventBusInitialize() has run
+@param eTopic_ is the topic to receive
+@param pfHandler_ is called from EventBusRunActiveState() with each message on eTopic_
+
+Promises:
+- Returns TRUE if the handler was added (or was already registered)
+- Returns FALSE if the topic already has U8_EVENTBUS_MAX_SUBSCRIBERS handlers
+
+*/
+bool EventBusSubscribe(EventTopicType eTopic_, EventHandlerType pfHandler_)
+{
+  if( (eTopic_ >= EVENT_TOPICS) || (pfHandler_ == NULL) )
+  {
+    return FALSE;
+  }
+
+  for(u8 i = 0; i < U8_EVENTBUS_MAX_SUBSCRIBERS; i++)
+  {
+    if(EventBus_aapfnSubscribers[eTopic_][i] == pfHandler_)
+    {
+      return TRUE;
+    }
+
+    if(EventBus_aapfnSubscribers[eTopic_][i] == NULL)
+    {
+      EventBus_aapfnSubscribers[eTopic_][i] = pfHandler_;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+
+} /* end EventBusSubscribe() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool EventBusPublish(EventTopicType eTopic_, const u8* pu8Payload_, u8 u8Length_)
+@brief Publishes a message for delivery on the next EventBusRunActiveState().
+
+Requires:
+- Called from the main loop
+@param pu8Payload_ points to u8Length_ bytes (may be NULL if u8Length_ is 0)
+@param u8Length_ is at most U8_EVENTBUS_MAX_PAYLOAD
+
+Promises:
+- Returns TRUE and copies the payload into a free slot; nothing is copied if the topic has no subscribers
+- Returns FALSE and counts a drop if there is no free slot or the payload is too long
+
+*/
+bool EventBusPublish(EventTopicType eTopic_, const u8* pu8Payload_, u8 u8Length_)
+{
+  EventMessageType* psSlot;
+
+  if( (eTopic_ >= EVENT_TOPICS) || (u8Length_ > U8_EVENTBUS_MAX_PAYLOAD) )
+  {
+    G_sEventBusStats.u32Dropped++;
+    return FALSE;
+  }
+
+  /* Nobody listening: nothing to do, and no slot is needed */
+  if(EventBus_aapfnSubscribers[eTopic_][0] == NULL)
+  {
+    return TRUE;
+  }
+
+  if(EventBus_u8Pending == U8_EVENTBUS_SLOTS)
+  {
+    G_sEventBusStats.u32Dropped++;
+    return FALSE;
+  }
+
+  psSlot = &EventBus_asSlots[EventBus_u8Head];
+  psSlot->u8Topic  = (u8)eTopic_;
+  psSlot->u8Length = u8Length_;
+  psSlot->u32PublishTimeUs = (u32)TimebaseGetUs();
+  if(u8Length_ != 0)
+  {
+    memcpy(psSlot->au8Payload, pu8Payload_, u8Length_);
+  }
+  psSlot->au8Payload[u8Length_] = 0;
+
+  EventBus_u8Head = (u8)((EventBus_u8Head + 1) & U8_EVENTBUS_SLOT_MASK);
+  EventBus_u8Pending++;
+
+  G_sEventBusStats.u32Published++;
+  if(EventBus_u8Pending > G_sEventBusStats.u32MaxPending)
+  {
+    G_sEventBusStats.u32MaxPending = EventBus_u8Pending;
+  }
+
+  return TRUE;
+
+} /* end EventBusPublish() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void EventBusInitialize(void)
+@brief Clears all subscriptions and message slots.
+
+Requires:
+- Called before any module subscribes
+
+Promises:
+- Bus is empty with no subscribers
+
+*/
+void EventBusInitialize(void)
+{
+  memset(EventBus_aapfnSubscribers, 0, sizeof(EventBus_aapfnSubscribers));
+  memset(&G_sEventBusStats, 0, sizeof(G_sEventBusStats));
+  EventBus_u8Head = 0;
+  EventBus_u8Tail = 0;
+  EventBus_u8Pending = 0;
+
+} /* end EventBusInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void EventBusRunActiveState(void)
+@brief Delivers pending messages in publish order.  Called once per pass of the main loop.
+
+A slot is released only after all of its handlers return, so handlers may publish.  Messages published by
+handlers are delivered in the same pass.
+
+Promises:
+- Every pending message has been passed to each subscriber of its topic
+
+*/
+void EventBusRunActiveState(void)
+{
+  EventMessageType* psSlot;
+  EventHandlerType* ppfHandlers;
+
+  while(EventBus_u8Pending != 0)
+  {
+    psSlot = &EventBus_asSlots[EventBus_u8Tail];
+    ppfHandlers = EventBus_aapfnSubscribers[psSlot->u8Topic];
+
+    G_sEventBusStats.u32LastLatencyUs = (u32)TimebaseGetUs() - psSlot->u32PublishTimeUs;
+    if(G_sEventBusStats.u32LastLatencyUs > G_sEventBusStats.u32MaxLatencyUs)
+    {
+      G_sEventBusStats.u32MaxLatencyUs = G_sEventBusStats.u32LastLatencyUs;
+    }
+
+    for(u8 i = 0; (i < U8_EVENTBUS_MAX_SUBSCRIBERS) && (ppfHandlers[i] != NULL); i++)
+    {
+      ppfHandlers[i](psSlot);
+      G_sEventBusStats.u32Delivered++;
+    }
+
+    EventBus_u8Tail = (u8)((EventBus_u8Tail + 1) & U8_EVENTBUS_SLOT_MASK);
+    EventBus_u8Pending--;
+  }
+
+} /* end EventBusRunActiveState() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
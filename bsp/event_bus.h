@@ -0,0 +1,93 @@
+/**********************************************************************************************************************
+File: event_bus.h
+
+Description:
+Header file for event_bus.c
+**********************************************************************************************************************/
+
+#ifndef __EVENT_BUS_H
+#define __EVENT_BUS_H
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U8_EVENTBUS_MAX_PAYLOAD         (u8)20            /* Largest message; matches BPENGENUICS_MAX_CHAR_LEN */
+#define U8_EVENTBUS_SLOTS               (u8)4             /* Message slots; must be a power of 2 */
+#define U8_EVENTBUS_SLOT_MASK           (u8)(U8_EVENTBUS_SLOTS - 1)
+#define U8_EVENTBUS_MAX_SUBSCRIBERS     (u8)2             /* Handlers per topic */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum EventTopicType
+@brief Compile-time topic IDs.  The payload format of each topic is fixed by its producer. */
+typedef enum
+{
+  EVENT_TOPIC_BLE_RX = 0,                 /*!< @brief Bytes written by the client to the Engenuics RX characteristic */
+  EVENT_TOPIC_BLE_STATUS,                 /*!< @brief u32 G_u32BPEngenuicsFlags after a connection or CCCD change */
+  EVENT_TOPIC_ANT_RX,                     /*!< @brief [channel][MESG_xxx_ID][8 data bytes] of an ANT data message */
+  EVENT_TOPIC_BUTTON,                     /*!< @brief u8 index of a newly pressed button */
+  EVENT_TOPICS                            /*!< @brief Number of topics; must stay last */
+} EventTopicType;
+
+/*!
+@struct EventMessageType
+@brief One published message.  Subscribers get a pointer to the bus slot; copy out anything needed later.
+*/
+typedef struct
+{
+  u8 u8Topic;                             /*!< @brief EventTopicType */
+  u8 u8Length;                            /*!< @brief Payload bytes */
+  u32 u32PublishTimeUs;                   /*!< @brief Low word of TimebaseGetUs() at publish */
+  u8 au8Payload[U8_EVENTBUS_MAX_PAYLOAD + 1]; /*!< @brief Payload; always followed by a 0 so text can be used in place */
+} EventMessageType;
+
+typedef void(*EventHandlerType)(const EventMessageType* psMessage_);
+
+/*!
+@struct EventBusStatsType
+@brief Event bus statistics.
+*/
+typedef struct
+{
+  u32 u32Published;                       /*!< @brief Messages accepted */
+  u32 u32Delivered;                       /*!< @brief Handler calls made */
+  u32 u32Dropped;                         /*!< @brief Messages refused: no free slot or payload too long */
+  u32 u32MaxPending;                      /*!< @brief Most slots in use at once */
+  u32 u32MaxLatencyUs;                    /*!< @brief Longest publish-to-first-delivery time */
+  u32 u32LastLatencyUs;                   /*!< @brief Publish-to-first-delivery time of the last message */
+} EventBusStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool EventBusSubscribe(EventTopicType eTopic_, EventHandlerType pfHandler_);
+bool EventBusPublish(EventTopicType eTopic_, const u8* pu8Payload_, u8 u8Length_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void EventBusInitialize(void);
+void EventBusRunActiveState(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
+
+#endif /* __EVENT_BUS_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,541 @@
+/**********************************************************************************************************************
+File: event_log.c
+
+Description:
+Circular event log in flash: compact binary records of what a unit did in the field (resets, watchdog overruns,
+brown-outs, connections).
+
+Records are 8 bytes (EventLogRecordType) and numbered from the first ever written.  They fill a ring of
+U8_FLASH_LOG_PAGES pages; each page starts with a header holding the index of its first record, so a record's
+index is never stored and any index is found with one header compare per page.  Starting a new page erases the
+oldest one, so the log always holds the latest (U8_FLASH_LOG_PAGES - 1) to U8_FLASH_LOG_PAGES pages of records.
+
+EventLogWrite() only stages the record in RAM.  The batch is written with one flash write when it fills, when
+U32_EVENTLOG_FLUSH_DELAY_MS have passed since its first record, or at once for a brown-out warning.  A batch is
+never split across pages, so a flush is one write (plus an erase and a header write when it starts a page).
+
+A record cut short by a reset reads back with an erased type byte and is skipped by EventLogRead().
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+EventLogStatsType G_sEventLogStats;                    /* Log activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+extern WatchdogRecordType G_sWatchdogLastFault;        /*!< @brief From watchdog.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "EventLog_" and be declared as static.
+***********************************************************************************************************************/
+static EventLogStateType EventLog_eState;              /* Flash work in progress */
+static u8 EventLog_u8ActivePage;                       /* Page of the ring being appended to */
+static u16 EventLog_u16Slot;                           /* Next free record slot in the active page */
+static u32 EventLog_u32NextIndex;                      /* Index the next record written to flash gets */
+static u32 EventLog_u32FirstIndex;                     /* Oldest index still stored */
+
+static EventLogRecordType EventLog_asStage[U8_EVENTLOG_STAGE_RECORDS]; /* Records waiting to be written */
+static u8 EventLog_u8Staged;                           /* Records in the batch */
+static u8 EventLog_u8Writing;                          /* Records at the start of the batch being written */
+static SwTimerType EventLog_sFlushTimer;               /* Writes a part-filled batch */
+
+static u32 EventLog_au32Header[U8_EVENTLOG_HEADER_WORDS]; /* Header of the page being started */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool EventLogWrite(EventLogEventType eType_, u8 u8Arg_, u16 u16Value_)
+@brief Adds a record stamped with the current uptime.  It is readable at once and reaches flash with the next flush.
+
+Requires:
+- Called from the main loop
+
+Promises:
+- Returns TRUE if the record was staged
+- Returns FALSE for a bad type, or if the batch is full (counted in u32Dropped)
+
+*/
+bool EventLogWrite(EventLogEventType eType_, u8 u8Arg_, u16 u16Value_)
+{
+  EventLogRecordType* psRecord;
+
+  if( (eType_ == EVENTLOG_NONE) || (eType_ >= EVENTLOG_EVENTS) )
+  {
+    return FALSE;
+  }
+
+  if(EventLog_u8Staged == U8_EVENTLOG_STAGE_RECORDS)
+  {
+    G_sEventLogStats.u32Dropped++;
+    EventLogStartFlush();
+    return FALSE;
+  }
+
+  psRecord = &EventLog_asStage[EventLog_u8Staged];
+  psRecord->u32TimeS = G_u32SystemTime1s;
+  psRecord->u8Type   = (u8)eType_;
+  psRecord->u8Arg    = u8Arg_;
+  psRecord->u16Value = u16Value_;
+  EventLog_u8Staged++;
+  G_sEventLogStats.u32Records++;
+
+  if(EventLog_u8Staged == U8_EVENTLOG_STAGE_RECORDS)
+  {
+    EventLogStartFlush();
+  }
+  else if(!SwTimerIsRunning(&EventLog_sFlushTimer))
+  {
+    SwTimerStart(&EventLog_sFlushTimer, U32_EVENTLOG_FLUSH_DELAY_MS);
+  }
+
+  return TRUE;
+
+} /* end EventLogWrite() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool EventLogFlush(void)
+@brief Starts writing the staged records now.
+
+Promises:
+- Returns TRUE if nothing is staged or a write is under way
+
+*/
+bool EventLogFlush(void)
+{
+  SwTimerStop(&EventLog_sFlushTimer);
+  EventLogStartFlush();
+
+  return (EventLog_u8Staged == 0) || (EventLog_eState != EVENTLOG_IDLE);
+
+} /* end EventLogFlush() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool EventLogRead(u32 u32Index_, EventLogRecordType* psRecord_)
+@brief Copies out the record with index u32Index_, from flash or from the RAM batch.
+
+Promises:
+- Returns TRUE and fills psRecord_ if the record is stored and whole
+- Returns FALSE if the index is outside EventLogFirstIndex() .. EventLogEndIndex() - 1 or the record was cut short
+
+*/
+bool EventLogRead(u32 u32Index_, EventLogRecordType* psRecord_)
+{
+  const u32* pu32Page;
+
+  if( (u32Index_ < EventLog_u32FirstIndex) || (u32Index_ >= EventLogEndIndex()) )
+  {
+    return FALSE;
+  }
+
+  if(u32Index_ >= EventLog_u32NextIndex)
+  {
+    *psRecord_ = EventLog_asStage[u32Index_ - EventLog_u32NextIndex];
+    return TRUE;
+  }
+
+  for(u8 i = 0; i < U8_FLASH_LOG_PAGES; i++)
+  {
+    pu32Page = EventLogPage(i);
+    if( (pu32Page[0] == U32_EVENTLOG_PAGE_MAGIC) && (u32Index_ >= pu32Page[1]) &&
+        (u32Index_ - pu32Page[1] < U16_EVENTLOG_PAGE_RECORDS) )
+    {
+      memcpy(psRecord_, &pu32Page[U8_EVENTLOG_HEADER_WORDS + (u32Index_ - pu32Page[1]) * U8_EVENTLOG_RECORD_WORDS],
+             sizeof(EventLogRecordType));
+      return (psRecord_->u8Type != 0xFF);
+    }
+  }
+
+  return FALSE;
+
+} /* end EventLogRead() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u32 EventLogFirstIndex(void)
+@brief Index of the oldest record still stored.
+*/
+u32 EventLogFirstIndex(void)
+{
+  return EventLog_u32FirstIndex;
+
+} /* end EventLogFirstIndex() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u32 EventLogEndIndex(void)
+@brief One past the index of the newest record (staged records included).
+*/
+u32 EventLogEndIndex(void)
+{
+  return EventLog_u32NextIndex + EventLog_u8Staged;
+
+} /* end EventLogEndIndex() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool EventLogErase(void)
+@brief Erases every stored record.  Numbering carries on from the newest record.
+
+Requires:
+- Called from the main loop
+
+Promises:
+- Returns TRUE if the erase started; staged records are kept and written afterwards
+- Returns FALSE if a flash write is in progress
+
+*/
+bool EventLogErase(void)
+{
+  if(EventLog_eState != EVENTLOG_IDLE)
+  {
+    return FALSE;
+  }
+
+  EventLog_eState = EVENTLOG_ERASING;
+  EventLog_u32FirstIndex = EventLog_u32NextIndex;
+  EventLogEraseStep(TRUE, (void*)0);
+
+  return TRUE;
+
+} /* end EventLogErase() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void EventLogInitialize(void)
+@brief Finds the end of the log and records this start-up.
+
+Requires:
+- WatchdogInitialize(), SwTimerInitialize() and FlashInitialize() have run
+
+Promises:
+- Records already in flash are readable
+- An EVENTLOG_RESET record is staged, preceded by an EVENTLOG_TASK_OVERRUN if a starved task caused the reset
+- The power-fail comparator is armed (with a SoftDevice) so a brown-out warning is logged
+
+*/
+void EventLogInitialize(void)
+{
+  memset(&G_sEventLogStats, 0, sizeof(G_sEventLogStats));
+  EventLog_eState = EVENTLOG_IDLE;
+  EventLog_u8Staged = 0;
+  EventLog_u8Writing = 0;
+  SwTimerCreate(&EventLog_sFlushTimer, SWTIMER_ONE_SHOT, EventLogFlushTimer, NULL);
+
+  EventLogReplay();
+
+  if(G_sWatchdogLastFault.u8Cause == WATCHDOG_CAUSE_TASK_STARVED)
+  {
+    (void)EventLogWrite(EVENTLOG_TASK_OVERRUN, G_sWatchdogLastFault.u8Task,
+                        (G_sWatchdogLastFault.u32OverdueMs > 0xFFFF) ? 0xFFFF : (u16)G_sWatchdogLastFault.u32OverdueMs);
+  }
+  (void)EventLogWrite(EVENTLOG_RESET, G_sWatchdogLastFault.u8Cause, (u16)WatchdogGetResetReason());
+
+#ifdef SOFTDEVICE_ENABLED
+  (void)sd_power_pof_threshold_set(NRF_POWER_THRESHOLD_V23);
+  (void)sd_power_pof_enable(1);
+#endif
+
+} /* end EventLogInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void EventLogOnSocEvent(u32 u32Event_)
+@brief Handles a SoC event from SocIntegrationHandler().
+
+Promises:
+- A power-fail warning is logged and the batch written at once, while there may still be enough supply to do it
+- Other events are ignored
+
+*/
+void EventLogOnSocEvent(u32 u32Event_)
+{
+  if(u32Event_ == NRF_EVT_POWER_FAILURE_WARNING)
+  {
+    (void)EventLogWrite(EVENTLOG_BROWNOUT, 0, 0);
+    (void)EventLogFlush();
+  }
+
+} /* end EventLogOnSocEvent() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u32* EventLogPage(u8 u8Page_)
+@brief Address of page u8Page_ of the ring.
+*/
+static u32* EventLogPage(u8 u8Page_)
+{
+  return (u32*)(U32_FLASH_LOG_FIRST_PAGE + (u32)u8Page_ * U32_FLASH_PAGE_SIZE);
+
+} /* end EventLogPage() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogReplay(void)
+@brief Finds the page with the newest records and the first free slot in it.
+
+Promises:
+- EventLog_u32FirstIndex and EventLog_u32NextIndex cover the records stored
+- With nothing stored, the last page counts as full so the first flush starts the ring at page 0
+
+*/
+static void EventLogReplay(void)
+{
+  const u32* pu32Page;
+  const u32* pu32Record;
+  bool bFound = FALSE;
+
+  EventLog_u32FirstIndex = 0;
+  EventLog_u32NextIndex = 0;
+
+  for(u8 i = 0; i < U8_FLASH_LOG_PAGES; i++)
+  {
+    pu32Page = EventLogPage(i);
+    if( (pu32Page[0] != U32_EVENTLOG_PAGE_MAGIC) || (pu32Page[1] == U32_FLASH_ERASED_WORD) )
+    {
+      continue;
+    }
+
+    if(!bFound || (pu32Page[1] > EventLog_u32NextIndex))
+    {
+      EventLog_u8ActivePage = i;
+      EventLog_u32NextIndex = pu32Page[1];
+    }
+    if(!bFound || (pu32Page[1] < EventLog_u32FirstIndex))
+    {
+      EventLog_u32FirstIndex = pu32Page[1];
+    }
+    bFound = TRUE;
+  }
+
+  if(!bFound)
+  {
+    EventLog_u8ActivePage = U8_FLASH_LOG_PAGES - 1;
+    EventLog_u16Slot = U16_EVENTLOG_PAGE_RECORDS;
+    return;
+  }
+
+  /* A slot is free only if both words are erased; a record cut short still takes its slot */
+  pu32Page = EventLogPage(EventLog_u8ActivePage);
+  for(EventLog_u16Slot = 0; EventLog_u16Slot < U16_EVENTLOG_PAGE_RECORDS; EventLog_u16Slot++)
+  {
+    pu32Record = &pu32Page[U8_EVENTLOG_HEADER_WORDS + EventLog_u16Slot * U8_EVENTLOG_RECORD_WORDS];
+    if( (pu32Record[0] == U32_FLASH_ERASED_WORD) && (pu32Record[1] == U32_FLASH_ERASED_WORD) )
+    {
+      break;
+    }
+  }
+  EventLog_u32NextIndex += EventLog_u16Slot;
+
+} /* end EventLogReplay() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogStartFlush(void)
+@brief Writes as much of the batch as fits in the active page, or starts the next page first if it is full.
+*/
+static void EventLogStartFlush(void)
+{
+  u8 u8Page;
+  const u32* pu32Page;
+
+  if( (EventLog_eState != EVENTLOG_IDLE) || (EventLog_u8Staged == 0) )
+  {
+    return;
+  }
+
+  if(EventLog_u16Slot == U16_EVENTLOG_PAGE_RECORDS)
+  {
+    /* The page about to be erased holds the oldest records */
+    u8Page = (EventLog_u8ActivePage + 1) % U8_FLASH_LOG_PAGES;
+    pu32Page = EventLogPage(u8Page);
+    if( (pu32Page[0] == U32_EVENTLOG_PAGE_MAGIC) && (pu32Page[1] + U16_EVENTLOG_PAGE_RECORDS > EventLog_u32FirstIndex) )
+    {
+      EventLog_u32FirstIndex = pu32Page[1] + U16_EVENTLOG_PAGE_RECORDS;
+    }
+
+    EventLog_eState = EVENTLOG_STARTING_PAGE;
+    if(!FlashErasePage((u32)pu32Page, EventLogPageErased, NULL))
+    {
+      G_sEventLogStats.u32Errors++;
+      EventLog_eState = EVENTLOG_IDLE;
+      SwTimerStart(&EventLog_sFlushTimer, U32_EVENTLOG_FLUSH_DELAY_MS);
+    }
+    return;
+  }
+
+  EventLog_u8Writing = EventLog_u8Staged;
+  if(EventLog_u8Writing > (U16_EVENTLOG_PAGE_RECORDS - EventLog_u16Slot))
+  {
+    EventLog_u8Writing = (u8)(U16_EVENTLOG_PAGE_RECORDS - EventLog_u16Slot);
+  }
+
+  EventLog_eState = EVENTLOG_WRITING;
+  if(!FlashWrite(&EventLogPage(EventLog_u8ActivePage)[U8_EVENTLOG_HEADER_WORDS +
+                                                      EventLog_u16Slot * U8_EVENTLOG_RECORD_WORDS],
+                 (const u32*)EventLog_asStage, EventLog_u8Writing * U8_EVENTLOG_RECORD_WORDS,
+                 EventLogWriteDone, NULL))
+  {
+    G_sEventLogStats.u32Errors++;
+    EventLog_eState = EVENTLOG_IDLE;
+    SwTimerStart(&EventLog_sFlushTimer, U32_EVENTLOG_FLUSH_DELAY_MS);
+  }
+
+} /* end EventLogStartFlush() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogWriteDone(bool bSuccess_, void* pvContext_)
+@brief Flash callback: the written records leave the batch and any that follow go next.
+
+A failed write may have left part of a record behind, so its slots are given up either way; the records stay in
+the batch and are written again to the following slots after the flush delay.
+*/
+static void EventLogWriteDone(bool bSuccess_, void* pvContext_)
+{
+  EventLog_eState = EVENTLOG_IDLE;
+  EventLog_u16Slot += EventLog_u8Writing;
+  EventLog_u32NextIndex += EventLog_u8Writing;
+
+  if(!bSuccess_)
+  {
+    G_sEventLogStats.u32Errors++;
+    EventLog_u8Writing = 0;
+    SwTimerStart(&EventLog_sFlushTimer, U32_EVENTLOG_FLUSH_DELAY_MS);
+    return;
+  }
+
+  EventLog_u8Staged -= EventLog_u8Writing;
+  memmove(EventLog_asStage, &EventLog_asStage[EventLog_u8Writing], EventLog_u8Staged * sizeof(EventLogRecordType));
+  EventLog_u8Writing = 0;
+  G_sEventLogStats.u32Flushes++;
+
+  /* Records that did not fit in the page go to the next one now */
+  EventLogStartFlush();
+
+} /* end EventLogWriteDone() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogPageErased(bool bSuccess_, void* pvContext_)
+@brief Flash callback: the next page is blank, so give it its header.
+*/
+static void EventLogPageErased(bool bSuccess_, void* pvContext_)
+{
+  u8 u8Page = (EventLog_u8ActivePage + 1) % U8_FLASH_LOG_PAGES;
+
+  EventLog_au32Header[0] = U32_EVENTLOG_PAGE_MAGIC;
+  EventLog_au32Header[1] = EventLog_u32NextIndex;
+  if( !bSuccess_ ||
+      !FlashWrite(EventLogPage(u8Page), EventLog_au32Header, U8_EVENTLOG_HEADER_WORDS, EventLogPageStarted, NULL) )
+  {
+    G_sEventLogStats.u32Errors++;
+    EventLog_eState = EVENTLOG_IDLE;
+    SwTimerStart(&EventLog_sFlushTimer, U32_EVENTLOG_FLUSH_DELAY_MS);
+  }
+
+} /* end EventLogPageErased() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogPageStarted(bool bSuccess_, void* pvContext_)
+@brief Flash callback: the new page has its header and becomes the active page.
+*/
+static void EventLogPageStarted(bool bSuccess_, void* pvContext_)
+{
+  EventLog_eState = EVENTLOG_IDLE;
+
+  /* A damaged header is erased again on the next try */
+  if(!bSuccess_)
+  {
+    G_sEventLogStats.u32Errors++;
+    SwTimerStart(&EventLog_sFlushTimer, U32_EVENTLOG_FLUSH_DELAY_MS);
+    return;
+  }
+
+  EventLog_u8ActivePage = (EventLog_u8ActivePage + 1) % U8_FLASH_LOG_PAGES;
+  EventLog_u16Slot = 0;
+  G_sEventLogStats.u32Pages++;
+
+  EventLogStartFlush();
+
+} /* end EventLogPageStarted() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogEraseStep(bool bSuccess_, void* pvContext_)
+@brief Flash callback chain for EventLogErase(): pvContext_ is the next page to erase.
+
+Promises:
+- After the last page the ring restarts at page 0 with the next flush
+
+*/
+static void EventLogEraseStep(bool bSuccess_, void* pvContext_)
+{
+  u8 u8Page = (u8)(u32)pvContext_;
+
+  if(!bSuccess_)
+  {
+    G_sEventLogStats.u32Errors++;
+  }
+
+  if(u8Page < U8_FLASH_LOG_PAGES)
+  {
+    if(FlashErasePage((u32)EventLogPage(u8Page), EventLogEraseStep, (void*)(u32)(u8Page + 1)))
+    {
+      return;
+    }
+    G_sEventLogStats.u32Errors++;
+  }
+
+  /* Done, or the flash queue refused: a page left behind is erased again when the ring reaches it */
+  EventLog_u8ActivePage = U8_FLASH_LOG_PAGES - 1;
+  EventLog_u16Slot = U16_EVENTLOG_PAGE_RECORDS;
+  EventLog_eState = EVENTLOG_IDLE;
+  EventLogStartFlush();
+
+} /* end EventLogEraseStep() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void EventLogFlushTimer(void* pvContext_)
+@brief A part-filled batch has waited long enough.
+*/
+static void EventLogFlushTimer(void* pvContext_)
+{
+  EventLogStartFlush();
+
+} /* end EventLogFlushTimer() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,119 @@
+/**********************************************************************************************************************
+File: event_log.h
+
+Description:
+Header file for event_log.c
+**********************************************************************************************************************/
+
+#ifndef __EVENT_LOG_H
+#define __EVENT_LOG_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U32_EVENTLOG_PAGE_MAGIC        (u32)0x474F4C45  /* "ELOG": first word of a page in use */
+#define U8_EVENTLOG_HEADER_WORDS       (u8)2            /* Magic, index of the page's first record */
+#define U8_EVENTLOG_RECORD_WORDS       (u8)(sizeof(EventLogRecordType) / sizeof(u32))
+#define U16_EVENTLOG_PAGE_RECORDS      (u16)((U32_FLASH_PAGE_WORDS - U8_EVENTLOG_HEADER_WORDS) / U8_EVENTLOG_RECORD_WORDS)
+
+#define U8_EVENTLOG_STAGE_RECORDS      (u8)8            /* Records held in RAM and written together */
+#define U32_EVENTLOG_FLUSH_DELAY_MS    (u32)30000       /* A part-filled batch is written this long after its first record */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum EventLogEventType
+@brief Record types.  Stored by number, so add new types at the end; 0xFF is an unwritten (erased) record. */
+typedef enum
+{
+  EVENTLOG_NONE = 0,                      /*!< @brief Not a record */
+  EVENTLOG_RESET,                         /*!< @brief Start-up: arg WatchdogCauseType, value RESETREAS (0 = power-on) */
+  EVENTLOG_TASK_OVERRUN,                  /*!< @brief Watchdog reset by a starved task: arg task, value ms overdue */
+  EVENTLOG_BROWNOUT,                      /*!< @brief Supply fell below the power-fail threshold */
+  EVENTLOG_CONNECT,                       /*!< @brief BLE connection: value connection interval (1.25ms units) */
+  EVENTLOG_DISCONNECT,                    /*!< @brief BLE disconnect: arg HCI reason */
+  EVENTLOG_EVENTS                         /*!< @brief Number of types; must stay last */
+} EventLogEventType;
+
+/*!
+@struct EventLogRecordType
+@brief One log record as stored in flash.  Its index is the page's first index plus its slot.
+*/
+typedef struct
+{
+  u32 u32TimeS;                           /*!< @brief G_u32SystemTime1s (seconds since the last reset) */
+  u8  u8Type;                             /*!< @brief EventLogEventType */
+  u8  u8Arg;                              /*!< @brief Type-specific */
+  u16 u16Value;                           /*!< @brief Type-specific */
+} EventLogRecordType;
+
+/*!
+@enum EventLogStateType
+@brief What the log is doing in flash. */
+typedef enum
+{
+  EVENTLOG_IDLE = 0,                      /*!< @brief Nothing in progress */
+  EVENTLOG_WRITING,                       /*!< @brief Batch being appended to the active page */
+  EVENTLOG_STARTING_PAGE,                 /*!< @brief Next page being erased and given its header */
+  EVENTLOG_ERASING                        /*!< @brief Every page being erased */
+} EventLogStateType;
+
+/*!
+@struct EventLogStatsType
+@brief Log activity.
+*/
+typedef struct
+{
+  u32 u32Records;                         /*!< @brief Records accepted */
+  u32 u32Dropped;                         /*!< @brief Records refused because the RAM batch was full */
+  u32 u32Flushes;                         /*!< @brief Batches written */
+  u32 u32Pages;                           /*!< @brief Pages started (each one drops the oldest page once the ring is full) */
+  u32 u32Errors;                          /*!< @brief Flash operations that failed or were refused */
+} EventLogStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool EventLogWrite(EventLogEventType eType_, u8 u8Arg_, u16 u16Value_);
+bool EventLogFlush(void);
+bool EventLogRead(u32 u32Index_, EventLogRecordType* psRecord_);
+u32 EventLogFirstIndex(void);
+u32 EventLogEndIndex(void);
+bool EventLogErase(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void EventLogInitialize(void);
+void EventLogOnSocEvent(u32 u32Event_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static u32* EventLogPage(u8 u8Page_);
+static void EventLogReplay(void);
+static void EventLogStartFlush(void);
+static void EventLogWriteDone(bool bSuccess_, void* pvContext_);
+static void EventLogPageErased(bool bSuccess_, void* pvContext_);
+static void EventLogPageStarted(bool bSuccess_, void* pvContext_);
+static void EventLogEraseStep(bool bSuccess_, void* pvContext_);
+static void EventLogFlushTimer(void* pvContext_);
+
+
+#endif /* __EVENT_LOG_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,363 @@
+/**********************************************************************************************************************
+File: flash.c
+
+Description:
+Flash writes and page erases through the SoftDevice.
+
+While the SoftDevice is enabled the NVMC may only be used through sd_flash_write() and sd_flash_page_erase().  Both
+return at once and finish later, when the SoftDevice finds time between radio events, with an
+NRF_EVT_FLASH_OPERATION_SUCCESS or _ERROR SoC event.  Only one operation may be in progress, so callers queue
+operations here and are called back from the main loop when theirs completes.  Operations run in the order they
+were queued, so an erase followed by a write to the same page needs no waiting in between.
+
+SoC events are drained by SocIntegrationHandler(), which passes the flash ones to FlashOnSocEvent().  An
+operation the SoftDevice timed out (too much radio activity) is retried U8_FLASH_RETRIES times.  A page erase
+stalls the CPU for about 22ms, so it is only handed to the SoftDevice when radio_sched.c finds a gap that long
+(or it has waited U32_RADIOSCHED_MAX_WAIT_MS); writes are short and start at once.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+FlashStatsType G_sFlashStats;                          /* Flash activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "Flash_" and be declared as static.
+***********************************************************************************************************************/
+static FlashOperationType Flash_asQueue[U8_FLASH_QUEUE_SIZE]; /* Operations in order; the head is in progress */
+static u8 Flash_u8Head;                                /* Oldest operation */
+static u8 Flash_u8Count;                               /* Operations queued, including the one in progress */
+static bool Flash_bInProgress;                         /* The head has been handed to the SoftDevice */
+static u8 Flash_u8Retries;                             /* Retries left for the head */
+static u64 Flash_u64QueuedUs;                          /* When the head was handed to the SoftDevice */
+static bool Flash_bWaitingForGap;                      /* The head is an erase waiting in radio_sched */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool FlashWrite(u32* pu32Destination_, const u32* pu32Source_, u16 u16Words_,
+                    FlashCallbackType pfCallback_, void* pvContext_)
+@brief Queues a write of u16Words_ words to erased flash.
+
+Requires:
+- Called from the main loop
+- pu32Source_ stays unchanged until pfCallback_ runs
+
+Promises:
+- Returns TRUE if the write was queued; pfCallback_ (if not NULL) later reports the result
+- Returns FALSE if the queue is full or the request is outside one page
+
+*/
+bool FlashWrite(u32* pu32Destination_, const u32* pu32Source_, u16 u16Words_,
+                FlashCallbackType pfCallback_, void* pvContext_)
+{
+  FlashOperationType sOperation;
+
+  if( (u16Words_ == 0) || (u16Words_ > U32_FLASH_PAGE_WORDS) )
+  {
+    G_sFlashStats.u32Errors++;
+    return FALSE;
+  }
+
+  sOperation.eKind           = FLASH_OP_WRITE;
+  sOperation.pu32Destination = pu32Destination_;
+  sOperation.pu32Source      = pu32Source_;
+  sOperation.u16Words        = u16Words_;
+  sOperation.pfCallback      = pfCallback_;
+  sOperation.pvContext       = pvContext_;
+
+  return FlashQueue(&sOperation);
+
+} /* end FlashWrite() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool FlashErasePage(u32 u32PageAddress_, FlashCallbackType pfCallback_, void* pvContext_)
+@brief Queues the erase of the page starting at u32PageAddress_.
+
+Requires:
+- Called from the main loop
+
+Promises:
+- Returns TRUE if the erase was queued; pfCallback_ (if not NULL) later reports the result
+- Returns FALSE if the queue is full or the address is not the start of a page
+
+*/
+bool FlashErasePage(u32 u32PageAddress_, FlashCallbackType pfCallback_, void* pvContext_)
+{
+  FlashOperationType sOperation;
+
+  if( (u32PageAddress_ % U32_FLASH_PAGE_SIZE) != 0 )
+  {
+    G_sFlashStats.u32Errors++;
+    return FALSE;
+  }
+
+  sOperation.eKind           = FLASH_OP_ERASE;
+  sOperation.pu32Destination = (u32*)u32PageAddress_;
+  sOperation.pu32Source      = NULL;
+  sOperation.u16Words        = 0;
+  sOperation.pfCallback      = pfCallback_;
+  sOperation.pvContext       = pvContext_;
+
+  return FlashQueue(&sOperation);
+
+} /* end FlashErasePage() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool FlashIsBusy(void)
+@brief Reports whether any operation is queued or in progress.
+
+Promises:
+- Returns TRUE until the last queued operation completes
+
+*/
+bool FlashIsBusy(void)
+{
+  return (Flash_u8Count != 0);
+
+} /* end FlashIsBusy() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void FlashInitialize(void)
+@brief Empties the queue.
+
+Promises:
+- No operations are queued; stats are cleared
+
+*/
+void FlashInitialize(void)
+{
+  memset(&G_sFlashStats, 0, sizeof(G_sFlashStats));
+  Flash_u8Head = 0;
+  Flash_u8Count = 0;
+  Flash_bInProgress = FALSE;
+  Flash_bWaitingForGap = FALSE;
+
+} /* end FlashInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void FlashOnSocEvent(u32 u32Event_)
+@brief Handles a SoC event from SocIntegrationHandler().
+
+Promises:
+- A flash result completes or retries the operation in progress and starts the next one
+- Other events are ignored
+
+*/
+void FlashOnSocEvent(u32 u32Event_)
+{
+  if(!Flash_bInProgress)
+  {
+    return;
+  }
+
+  if(u32Event_ == NRF_EVT_FLASH_OPERATION_SUCCESS)
+  {
+    FlashComplete(TRUE);
+  }
+  else if(u32Event_ == NRF_EVT_FLASH_OPERATION_ERROR)
+  {
+    if(Flash_u8Retries != 0)
+    {
+      Flash_u8Retries--;
+      G_sFlashStats.u32Retries++;
+      Flash_bInProgress = FALSE;
+      FlashStart();
+    }
+    else
+    {
+      FlashComplete(FALSE);
+    }
+  }
+
+} /* end FlashOnSocEvent() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool FlashQueue(const FlashOperationType* psOperation_)
+@brief Adds an operation to the queue and starts it if nothing else is in progress.
+
+Promises:
+- Returns TRUE if queued; FALSE and counts an error if the queue is full
+
+*/
+static bool FlashQueue(const FlashOperationType* psOperation_)
+{
+  if(Flash_u8Count == U8_FLASH_QUEUE_SIZE)
+  {
+    G_sFlashStats.u32Errors++;
+    return FALSE;
+  }
+
+  Flash_asQueue[(Flash_u8Head + Flash_u8Count) % U8_FLASH_QUEUE_SIZE] = *psOperation_;
+  Flash_u8Count++;
+  if(Flash_u8Count > G_sFlashStats.u8MaxQueued)
+  {
+    G_sFlashStats.u8MaxQueued = Flash_u8Count;
+  }
+
+  if(Flash_u8Count == 1)
+  {
+    FlashBegin();
+  }
+
+  return TRUE;
+
+} /* end FlashQueue() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void FlashBegin(void)
+@brief Starts a new head of the queue: writes at once, erases in the next radio gap that can take the stall.
+
+Promises:
+- The head is started, or deferred with Flash_bWaitingForGap set
+
+*/
+static void FlashBegin(void)
+{
+  Flash_u8Retries = U8_FLASH_RETRIES;
+
+  if(Flash_asQueue[Flash_u8Head].eKind == FLASH_OP_ERASE)
+  {
+    Flash_bWaitingForGap = TRUE;
+    if(RadioSchedSubmit(RADIOSCHED_FLASH_ERASE, FlashStartInGap, NULL))
+    {
+      return;
+    }
+    Flash_bWaitingForGap = FALSE;
+  }
+
+  Flash_u64QueuedUs = TimebaseGetUs();
+  FlashStart();
+
+} /* end FlashBegin() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void FlashStartInGap(void* pvContext_)
+@brief radio_sched job: the radio leaves room for the deferred erase at the head of the queue.
+*/
+static void FlashStartInGap(void* pvContext_)
+{
+  Flash_bWaitingForGap = FALSE;
+  Flash_u64QueuedUs = TimebaseGetUs();
+  FlashStart();
+
+} /* end FlashStartInGap() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void FlashStart(void)
+@brief Hands the operation at the head of the queue to the SoftDevice.
+
+Promises:
+- Flash_bInProgress is set if the SoftDevice accepted it; otherwise the operation fails at once
+
+*/
+static void FlashStart(void)
+{
+  FlashOperationType* psOperation = &Flash_asQueue[Flash_u8Head];
+  u32 u32Result;
+
+  if(psOperation->eKind == FLASH_OP_ERASE)
+  {
+    u32Result = sd_flash_page_erase((u32)psOperation->pu32Destination / U32_FLASH_PAGE_SIZE);
+  }
+  else
+  {
+    u32Result = sd_flash_write((uint32_t*)psOperation->pu32Destination, (const uint32_t*)psOperation->pu32Source,
+                               psOperation->u16Words);
+  }
+
+  if(u32Result == NRF_SUCCESS)
+  {
+    Flash_bInProgress = TRUE;
+  }
+  else
+  {
+    FlashComplete(FALSE);
+  }
+
+} /* end FlashStart() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void FlashComplete(bool bSuccess_)
+@brief Finishes the operation at the head of the queue and starts the next one.
+
+Promises:
+- The operation's callback has run and it is removed from the queue
+
+*/
+static void FlashComplete(bool bSuccess_)
+{
+  FlashOperationType sOperation = Flash_asQueue[Flash_u8Head];
+
+  Flash_bInProgress = FALSE;
+  Flash_u8Head = (Flash_u8Head + 1) % U8_FLASH_QUEUE_SIZE;
+  Flash_u8Count--;
+
+  if(!bSuccess_)
+  {
+    G_sFlashStats.u32Errors++;
+  }
+  else if(sOperation.eKind == FLASH_OP_ERASE)
+  {
+    G_sFlashStats.u32Erases++;
+  }
+  else
+  {
+    G_sFlashStats.u32Writes++;
+  }
+  G_sFlashStats.u32LastOperationUs = (u32)(TimebaseGetUs() - Flash_u64QueuedUs);
+
+  /* The callback may queue more, so start the next one only after it has run */
+  if(sOperation.pfCallback != NULL)
+  {
+    sOperation.pfCallback(bSuccess_, sOperation.pvContext);
+  }
+
+  if( (Flash_u8Count != 0) && !Flash_bInProgress && !Flash_bWaitingForGap )
+  {
+    FlashBegin();
+  }
+
+} /* end FlashComplete() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
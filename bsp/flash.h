@@ -0,0 +1,109 @@
+/**********************************************************************************************************************
+File: flash.h
+
+Description:
+Header file for flash.c
+**********************************************************************************************************************/
+
+#ifndef __FLASH_H
+#define __FLASH_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U32_FLASH_PAGE_SIZE            (u32)1024    /* nRF51422 QFAA code page */
+#define U32_FLASH_PAGE_WORDS           (u32)(U32_FLASH_PAGE_SIZE / sizeof(u32))
+#define U32_FLASH_ERASED_WORD          (u32)0xFFFFFFFF
+
+/* Data pages at the top of the application flash; nRF51422_QFAA.icf ends the ROM region below them */
+#define U32_FLASH_LOG_FIRST_PAGE       (u32)0x0003DC00  /* Event log ring */
+#define U8_FLASH_LOG_PAGES             (u8)4
+#define U32_FLASH_KV_FIRST_PAGE        (u32)0x0003EC00  /* Key/value store ring */
+#define U8_FLASH_KV_PAGES              (u8)4
+#define U32_FLASH_BOND_PAGE            (u32)0x0003FC00
+
+#define U8_FLASH_QUEUE_SIZE            (u8)4        /* Operations waiting for the SoftDevice */
+#define U8_FLASH_RETRIES               (u8)3        /* Attempts after the SoftDevice times out an operation */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+typedef void(*FlashCallbackType)(bool bSuccess_, void* pvContext_);
+
+/*!
+@enum FlashOperationKindType
+@brief What a queued flash operation does. */
+typedef enum
+{
+  FLASH_OP_WRITE = 0,                     /*!< @brief Write words to erased flash */
+  FLASH_OP_ERASE                          /*!< @brief Erase one page */
+} FlashOperationKindType;
+
+/*!
+@struct FlashOperationType
+@brief One queued flash operation.  The source words must stay unchanged until the callback runs.
+*/
+typedef struct
+{
+  FlashOperationKindType eKind;           /*!< @brief Write or erase */
+  u32* pu32Destination;                   /*!< @brief First word to write, or the page to erase */
+  const u32* pu32Source;                  /*!< @brief Words to write */
+  u16 u16Words;                           /*!< @brief Number of words to write */
+  FlashCallbackType pfCallback;           /*!< @brief Called from the main loop when done; may be NULL */
+  void* pvContext;                        /*!< @brief Passed back to pfCallback */
+} FlashOperationType;
+
+/*!
+@struct FlashStatsType
+@brief Flash activity.
+*/
+typedef struct
+{
+  u32 u32Writes;                          /*!< @brief Write operations completed */
+  u32 u32Erases;                          /*!< @brief Page erases completed */
+  u32 u32Retries;                         /*!< @brief Operations restarted after a SoftDevice timeout */
+  u32 u32Errors;                          /*!< @brief Operations that failed or were refused */
+  u32 u32LastOperationUs;                 /*!< @brief Time from the SoftDevice starting the last operation to its result */
+  u8  u8MaxQueued;                        /*!< @brief High-water mark of the queue */
+} FlashStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool FlashWrite(u32* pu32Destination_, const u32* pu32Source_, u16 u16Words_,
+                FlashCallbackType pfCallback_, void* pvContext_);
+bool FlashErasePage(u32 u32PageAddress_, FlashCallbackType pfCallback_, void* pvContext_);
+bool FlashIsBusy(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void FlashInitialize(void);
+void FlashOnSocEvent(u32 u32Event_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static bool FlashQueue(const FlashOperationType* psOperation_);
+static void FlashBegin(void);
+static void FlashStartInGap(void* pvContext_);
+static void FlashStart(void);
+static void FlashComplete(bool bSuccess_);
+
+
+#endif /* __FLASH_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -161,27 +161,36 @@ Requires:
 @PARAM G_u32SystemTime1s  globally available and should only bit written by this ISR
 
 Promises:
-- G_u32SystemTime1ms is updated; G_u32SystemTime1s incremented every 1000 ticks
+- G_u32SystemTime1ms and G_u32SystemTime1s are updated from the RTC1 COUNTER (see timebase.c)
+- COMPARE1 flags the software timer wheel for service (see sw_timers.c)
 
 */
 void RTC1_IRQHandler(void)
 {
-  /* Clear the Tick Event */
-  NRF_RTC1->EVENTS_TICK = 0;
-  
-  /* Update global counters */
-  G_u32SystemTime1ms++;
-  if ((G_u32SystemTime1ms % 1000) == 0)
-  {
-    G_u32SystemTime1s++;
-    
-    /* Optional heartbeat */
-    //LedToggle(RED7);
-  }
+  TimebaseRtcHandler();
+  SwTimerRtcHandler();
 
 } /* end RTC1_IRQHandler() */
 
 
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WDT_IRQHandler(void)
+@brief Watchdog TIMEOUT: the reset follows two 32kHz cycles later.
+
+Requires:
+- Enabled in WatchDogSetup()
+
+Promises:
+- The watchdog fault record is written (see watchdog.c)
+
+*/
+void WDT_IRQHandler(void)
+{
+  WatchdogTimeoutHandler();
+
+} /* end WDT_IRQHandler() */
+
+
 /*!----------------------------------------------------------------------------------------------------------------------
 @fn void SD_EVT_IRQHandler(void)
 @brief ISR to process soft device events.
@@ -190,19 +199,37 @@ Requires:
 - enabled via sd_nvic_XXX
 
 Promises:
-- Sets global system flags indicating that BLE and ANT events are pending.
+- Posts a WORK_ITEM_SD_EVENT indicating that BLE and/or ANT events are pending.
 It is possible that either ANT or BLE events OR ANT & BLE events are pending.
 The application shall handle all the cases. 
 
 */
 void SD_EVT_IRQHandler(void)
 {
-  /* Set Flag that ANT and BLE Events pending. */
-  G_u32SystemFlags |= (_SYSTEM_PROTOCOL_EVENT); 
+  /* One queued item covers any number of pending ANT and BLE events */
+  WorkQueuePostCoalesced(WORK_ITEM_SD_EVENT);
   
 } /* end SD_EVT_IRQHandler() */
 
 
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SWI1_IRQHandler(void)
+@brief Radio notification (RADIO_NOTIFICATION_IRQHandler): the radio is about to start or has just gone inactive.
+
+Requires:
+- Enabled via sd_nvic_XXX by RadioSchedInitialize() at NRF_APP_PRIORITY_LOW
+
+Promises:
+- Radio timing is learned and deferred work woken (see radio_sched.c), which also rotates beacon frames
+
+*/
+void SWI1_IRQHandler(void)
+{
+  RadioSchedRadioHandler();
+
+} /* end SWI1_IRQHandler() */
+
+
 /*!----------------------------------------------------------------------------------------------------------------------
 @fn ISR void GPIOTE_IRQHandler(void)
 
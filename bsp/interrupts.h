@@ -80,7 +80,9 @@ void HardFault_Handler(u32 u32ProgramCounter_, u32 u32LinkRegister_);
 void RTC1_IRQHandler(void);
 
 void SD_EVT_IRQHandler(void);
+void SWI1_IRQHandler(void);
 void GPIOTE_IRQHandler(void);
+void WDT_IRQHandler(void);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,645 @@
+/**********************************************************************************************************************
+File: kv_store.c
+
+Description:
+Key/value store for settings that must survive a reset.
+
+Values are kept as records ([key][length][CRC16] header word, then the value padded to a word) appended to the
+active page of a ring of U8_FLASH_KV_PAGES flash pages; the last record for a key is its value.  A lookup table in
+RAM holds where each key's record is, so KVStoreGet() is a table read and a copy.
+
+KVStoreSet() only stages the record in a RAM batch.  The batch is appended to the page with one flash write when it
+is full or U32_KVSTORE_FLUSH_DELAY_MS after the last set, so a burst of settings written over BLE costs one short
+write instead of one per setting, and a setting written again before the flush just replaces its staged copy.  A
+set with the value already stored is skipped.
+
+When the batch does not fit in the active page, the live records are copied to the next page of the ring, its
+header (with the next sequence number) is written last and only then is the old page erased.  A reset part way
+through leaves the old page current.  Moving round the ring spreads the erases evenly over all the pages, and no
+erase is ever needed to write a setting.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+KVStoreStatsType G_sKVStoreStats;                      /* Store activity */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "KVStore_" and be declared as static.
+***********************************************************************************************************************/
+static KVStoreStateType KVStore_eState;                /* Flash work in progress */
+static u16 KVStore_au16Location[KVSTORE_KEYS];         /* Byte offset of each key's record in the active page */
+static u16 KVStore_au16FlashLocation[KVSTORE_KEYS];    /* Offset of each key's last record in flash, even if staged */
+static u8 KVStore_u8ActivePage;                        /* Page of the ring being appended to */
+static u16 KVStore_u16WriteOffset;                     /* First free byte in the active page */
+
+static u32 KVStore_au32Batch[U8_KVSTORE_BATCH_WORDS];  /* Records waiting to be written */
+static u8 KVStore_u8BatchWords;                        /* Words used in the batch */
+static u8 KVStore_u8FlushWords;                        /* Words at the start of the batch being written */
+static SwTimerType KVStore_sFlushTimer;                /* Flush after a quiet period */
+
+static u8 KVStore_u8CompactPage;                       /* Page live records are being copied to */
+static u8 KVStore_u8CompactKey;                        /* Last key copied */
+static u16 KVStore_u16CompactOffset;                   /* First free byte in the new page */
+static u16 KVStore_au16CompactLocation[KVSTORE_KEYS];  /* Where each copied record went */
+static u32 KVStore_au32Copy[U8_KVSTORE_RECORD_MAX_WORDS]; /* Record being copied */
+static u32 KVStore_u32PageHeader;                      /* New page header being written */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool KVStoreSet(KVStoreKeyType eKey_, const void* pvValue_, u8 u8Length_)
+@brief Stores a value.  It is readable at once and reaches flash with the next flush.
+
+Requires:
+- Called from the main loop
+
+Promises:
+- Returns TRUE if the value is stored or was already stored
+- Returns FALSE for a bad key or length, or if the batch is full (a flush is started; try again later)
+
+*/
+bool KVStoreSet(KVStoreKeyType eKey_, const void* pvValue_, u8 u8Length_)
+{
+  const u32* pu32Record;
+  u16 u16Location;
+  u32* pu32Slot;
+  u8 u8Words = 1 + (u8Length_ + 3) / 4;
+
+  if( (eKey_ == KVSTORE_KEY_NONE) || (eKey_ >= KVSTORE_KEYS) || (u8Length_ == 0) ||
+      (u8Length_ > U8_KVSTORE_MAX_VALUE) )
+  {
+    return FALSE;
+  }
+
+  /* Writing the same value again costs nothing */
+  pu32Record = KVStoreRecord(eKey_);
+  if( (pu32Record != NULL) && (((*pu32Record >> 8) & 0xFF) == u8Length_) &&
+      (memcmp(pu32Record + 1, pvValue_, u8Length_) == 0) )
+  {
+    G_sKVStoreStats.u32Unchanged++;
+    return TRUE;
+  }
+
+  /* A record of the same size still waiting in the batch (and not being written) is replaced in place */
+  u16Location = KVStore_au16Location[eKey_];
+  if( (pu32Record != NULL) && (u16Location & U16_KVSTORE_STAGED) &&
+      ((u16Location & ~U16_KVSTORE_STAGED) / 4 >= KVStore_u8FlushWords) &&
+      ((u32)((((*pu32Record >> 8) & 0xFF) + 3) / 4) == (u32)((u8Length_ + 3) / 4)) )
+  {
+    pu32Slot = (u32*)pu32Record;
+    G_sKVStoreStats.u32Coalesced++;
+  }
+  else
+  {
+    if(KVStore_u8BatchWords + u8Words > U8_KVSTORE_BATCH_WORDS)
+    {
+      G_sKVStoreStats.u32Busy++;
+      KVStoreStartFlush();
+      return FALSE;
+    }
+
+    pu32Slot = &KVStore_au32Batch[KVStore_u8BatchWords];
+    KVStore_au16Location[eKey_] = U16_KVSTORE_STAGED | (KVStore_u8BatchWords * 4);
+    KVStore_u8BatchWords += u8Words;
+  }
+
+  pu32Slot[u8Words - 1] = 0;
+  memcpy(pu32Slot + 1, pvValue_, u8Length_);
+  pu32Slot[0] = (u32)eKey_ | ((u32)u8Length_ << 8) |
+                ((u32)KVStoreRecordCrc((u8)eKey_, u8Length_, (const u8*)(pu32Slot + 1)) << 16);
+  G_sKVStoreStats.u32Sets++;
+
+  if(KVStore_u8BatchWords == U8_KVSTORE_BATCH_WORDS)
+  {
+    KVStoreStartFlush();
+  }
+  else
+  {
+    SwTimerStart(&KVStore_sFlushTimer, U32_KVSTORE_FLUSH_DELAY_MS);
+  }
+
+  return TRUE;
+
+} /* end KVStoreSet() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u8 KVStoreGet(KVStoreKeyType eKey_, void* pvValue_, u8 u8Size_)
+@brief Reads a value.
+
+Promises:
+- Copies up to u8Size_ bytes of the value to pvValue_ and returns the number copied
+- Returns 0 if the key has no value
+
+*/
+u8 KVStoreGet(KVStoreKeyType eKey_, void* pvValue_, u8 u8Size_)
+{
+  const u32* pu32Record;
+  u8 u8Length;
+
+  if(eKey_ >= KVSTORE_KEYS)
+  {
+    return 0;
+  }
+
+  pu32Record = KVStoreRecord(eKey_);
+  if(pu32Record == NULL)
+  {
+    return 0;
+  }
+
+  u8Length = (u8)((*pu32Record >> 8) & 0xFF);
+  if(u8Length > u8Size_)
+  {
+    u8Length = u8Size_;
+  }
+
+  memcpy(pvValue_, pu32Record + 1, u8Length);
+  return u8Length;
+
+} /* end KVStoreGet() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool KVStoreFlush(void)
+@brief Writes the batch now instead of waiting for the quiet period.
+
+Promises:
+- Returns TRUE if nothing is waiting or the flash work has started
+
+*/
+bool KVStoreFlush(void)
+{
+  KVStoreStartFlush();
+  return ( (KVStore_u8BatchWords == 0) || (KVStore_eState != KVSTORE_IDLE) );
+
+} /* end KVStoreFlush() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void KVStoreInitialize(void)
+@brief Finds the active page and rebuilds the lookup table from its records.
+
+Requires:
+- FlashInitialize() and SwTimerInitialize() have run
+
+Promises:
+- Every stored value can be read
+- BPFRAME_TYPE_SETTING frames ([key][value]) are stored
+
+*/
+void KVStoreInitialize(void)
+{
+  memset(&G_sKVStoreStats, 0, sizeof(G_sKVStoreStats));
+  KVStore_eState = KVSTORE_IDLE;
+  KVStore_u8BatchWords = 0;
+  KVStore_u8FlushWords = 0;
+
+  KVStoreReplay();
+  G_sKVStoreStats.u16FreeBytes = U32_FLASH_PAGE_SIZE - KVStore_u16WriteOffset;
+
+  SwTimerCreate(&KVStore_sFlushTimer, SWTIMER_ONE_SHOT, KVStoreFlushTimer, NULL);
+  (void)BPFrameRegisterHandler(BPFRAME_TYPE_SETTING, KVStoreOnSettingFrame);
+
+} /* end KVStoreInitialize() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u32* KVStorePage(u8 u8Page_)
+@brief Returns the first word of a page of the ring.
+*/
+static u32* KVStorePage(u8 u8Page_)
+{
+  return (u32*)(U32_FLASH_KV_FIRST_PAGE + (u32)u8Page_ * U32_FLASH_PAGE_SIZE);
+
+} /* end KVStorePage() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static const u32* KVStoreRecord(KVStoreKeyType eKey_)
+@brief Returns the header word of a key's current record, in the batch or in flash, or NULL if it has none.
+*/
+static const u32* KVStoreRecord(KVStoreKeyType eKey_)
+{
+  u16 u16Location = KVStore_au16Location[eKey_];
+
+  if(u16Location == U16_KVSTORE_NO_VALUE)
+  {
+    return NULL;
+  }
+
+  if(u16Location & U16_KVSTORE_STAGED)
+  {
+    return &KVStore_au32Batch[(u16Location & ~U16_KVSTORE_STAGED) / 4];
+  }
+
+  return KVStorePage(KVStore_u8ActivePage) + u16Location / 4;
+
+} /* end KVStoreRecord() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u16 KVStoreRecordCrc(u8 u8Key_, u8 u8Length_, const u8* pu8Value_)
+@brief CRC16 over a record's key, length and value.
+*/
+static u16 KVStoreRecordCrc(u8 u8Key_, u8 u8Length_, const u8* pu8Value_)
+{
+  u16 u16Crc;
+
+  u16Crc = Crc16Compute(&u8Key_, 1, U16_CRC16_INIT);
+  u16Crc = Crc16Compute(&u8Length_, 1, u16Crc);
+  return Crc16Compute(pu8Value_, u8Length_, u16Crc);
+
+} /* end KVStoreRecordCrc() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreReplay(void)
+@brief Picks the page with the newest header and indexes its records.
+
+Promises:
+- KVStore_au16Location holds the last good record of each key
+- KVStore_u16WriteOffset is the first erased word, or the end of the page if the page ends in a damaged record
+  (the next flush then compacts to a clean page)
+
+*/
+static void KVStoreReplay(void)
+{
+  const u32* pu32Page;
+  u32 u32Header;
+  u16 u16Offset;
+  u8 u8Key;
+  u8 u8Length;
+  bool bFound = FALSE;
+
+  memset(KVStore_au16Location, 0xFF, sizeof(KVStore_au16Location));
+  memset(KVStore_au16FlashLocation, 0xFF, sizeof(KVStore_au16FlashLocation));
+
+  for(u8 i = 0; i < U8_FLASH_KV_PAGES; i++)
+  {
+    u32Header = *KVStorePage(i);
+    if( ((u32Header & 0xFFFF) == U16_KVSTORE_PAGE_MAGIC) &&
+        (!bFound || ((s16)((u16)(u32Header >> 16) - G_sKVStoreStats.u16Sequence) > 0)) )
+    {
+      KVStore_u8ActivePage = i;
+      G_sKVStoreStats.u16Sequence = (u16)(u32Header >> 16);
+      bFound = TRUE;
+    }
+  }
+
+  /* Nothing stored yet: treat page 0 as full so the first flush starts the ring on a clean page */
+  if(!bFound)
+  {
+    KVStore_u8ActivePage = 0;
+    G_sKVStoreStats.u16Sequence = 0;
+    KVStore_u16WriteOffset = U32_FLASH_PAGE_SIZE;
+    return;
+  }
+
+  pu32Page = KVStorePage(KVStore_u8ActivePage);
+  u16Offset = sizeof(u32);
+  while(u16Offset < U32_FLASH_PAGE_SIZE)
+  {
+    u32Header = pu32Page[u16Offset / 4];
+    if(u32Header == U32_FLASH_ERASED_WORD)
+    {
+      break;
+    }
+
+    u8Key = (u8)(u32Header & 0xFF);
+    u8Length = (u8)((u32Header >> 8) & 0xFF);
+    if( (u8Length == 0) || (u8Length > U8_KVSTORE_MAX_VALUE) ||
+        (u16Offset + sizeof(u32) + u8Length > U32_FLASH_PAGE_SIZE) ||
+        ((u16)(u32Header >> 16) != KVStoreRecordCrc(u8Key, u8Length, (const u8*)&pu32Page[u16Offset / 4 + 1])) )
+    {
+      /* Cut short by a reset: nothing from here on can be trusted or written over */
+      u16Offset = U32_FLASH_PAGE_SIZE;
+      break;
+    }
+
+    /* Keys this firmware does not know are dropped at the next compaction */
+    if( (u8Key != KVSTORE_KEY_NONE) && (u8Key < KVSTORE_KEYS) )
+    {
+      KVStore_au16Location[u8Key] = u16Offset;
+      KVStore_au16FlashLocation[u8Key] = u16Offset;
+    }
+
+    u16Offset += (1 + (u8Length + 3) / 4) * sizeof(u32);
+  }
+
+  KVStore_u16WriteOffset = u16Offset;
+
+} /* end KVStoreReplay() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreStartFlush(void)
+@brief Appends the batch to the active page, or compacts to the next page first if it does not fit.
+
+Promises:
+- Does nothing if the batch is empty or flash work is already in progress
+
+*/
+static void KVStoreStartFlush(void)
+{
+  u32* pu32Target;
+  u16 u16Word;
+
+  if( (KVStore_eState != KVSTORE_IDLE) || (KVStore_u8BatchWords == 0) )
+  {
+    return;
+  }
+
+  SwTimerStop(&KVStore_sFlushTimer);
+
+  if(KVStore_u16WriteOffset + KVStore_u8BatchWords * sizeof(u32) > U32_FLASH_PAGE_SIZE)
+  {
+    KVStore_eState = KVSTORE_COMPACTING;
+    KVStore_u8CompactPage = (KVStore_u8ActivePage + 1) % U8_FLASH_KV_PAGES;
+    KVStore_u8CompactKey = KVSTORE_KEY_NONE;
+    KVStore_u16CompactOffset = sizeof(u32);
+    memset(KVStore_au16CompactLocation, 0xFF, sizeof(KVStore_au16CompactLocation));
+
+    /* The next page is normally still erased from the last time round the ring */
+    pu32Target = KVStorePage(KVStore_u8CompactPage);
+    for(u16Word = 0; u16Word < U32_FLASH_PAGE_WORDS; u16Word++)
+    {
+      if(pu32Target[u16Word] != U32_FLASH_ERASED_WORD)
+      {
+        break;
+      }
+    }
+
+    if(u16Word == U32_FLASH_PAGE_WORDS)
+    {
+      KVStoreCompactStep(TRUE, NULL);
+    }
+    else if(!FlashErasePage((u32)pu32Target, KVStoreCompactStep, NULL))
+    {
+      KVStoreCompactStep(FALSE, NULL);
+    }
+    return;
+  }
+
+  KVStore_u8FlushWords = KVStore_u8BatchWords;
+  if(!FlashWrite(KVStorePage(KVStore_u8ActivePage) + KVStore_u16WriteOffset / 4, KVStore_au32Batch,
+                 KVStore_u8FlushWords, KVStoreFlushDone, NULL))
+  {
+    KVStore_u8FlushWords = 0;
+    G_sKVStoreStats.u32Errors++;
+    SwTimerStart(&KVStore_sFlushTimer, U32_KVSTORE_FLUSH_DELAY_MS);
+    return;
+  }
+
+  KVStore_eState = KVSTORE_FLUSHING;
+
+} /* end KVStoreStartFlush() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreFlushDone(bool bSuccess_, void* pvContext_)
+@brief Flash callback for a batch write.
+
+Promises:
+- Written records are looked up in flash; anything staged meanwhile moves to the start of the batch
+- After a failure the batch is kept and the next flush compacts to a clean page
+
+*/
+static void KVStoreFlushDone(bool bSuccess_, void* pvContext_)
+{
+  u16 u16FlushBytes = KVStore_u8FlushWords * sizeof(u32);
+  u16 u16Location;
+
+  KVStore_eState = KVSTORE_IDLE;
+
+  if(!bSuccess_)
+  {
+    /* The page may now hold part of the batch */
+    G_sKVStoreStats.u32Errors++;
+    KVStore_u16WriteOffset = U32_FLASH_PAGE_SIZE;
+  }
+  else
+  {
+    for(u8 i = 0; i < KVSTORE_KEYS; i++)
+    {
+      u16Location = KVStore_au16Location[i];
+      if( (u16Location != U16_KVSTORE_NO_VALUE) && (u16Location & U16_KVSTORE_STAGED) )
+      {
+        u16Location &= ~U16_KVSTORE_STAGED;
+        if(u16Location < u16FlushBytes)
+        {
+          KVStore_au16Location[i] = KVStore_u16WriteOffset + u16Location;
+          KVStore_au16FlashLocation[i] = KVStore_au16Location[i];
+        }
+        else
+        {
+          KVStore_au16Location[i] = U16_KVSTORE_STAGED | (u16Location - u16FlushBytes);
+        }
+      }
+    }
+
+    memmove(KVStore_au32Batch, &KVStore_au32Batch[KVStore_u8FlushWords],
+            (KVStore_u8BatchWords - KVStore_u8FlushWords) * sizeof(u32));
+    KVStore_u8BatchWords -= KVStore_u8FlushWords;
+    KVStore_u16WriteOffset += u16FlushBytes;
+
+    G_sKVStoreStats.u32Flushes++;
+    G_sKVStoreStats.u32FlushedBytes += u16FlushBytes;
+  }
+
+  KVStore_u8FlushWords = 0;
+  G_sKVStoreStats.u16FreeBytes = U32_FLASH_PAGE_SIZE - KVStore_u16WriteOffset;
+
+  if(KVStore_u8BatchWords != 0)
+  {
+    SwTimerStart(&KVStore_sFlushTimer, U32_KVSTORE_FLUSH_DELAY_MS);
+  }
+
+} /* end KVStoreFlushDone() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreCompactStep(bool bSuccess_, void* pvContext_)
+@brief Copies the next live record from the active page to the new page.  Chained through the flash callback.
+
+A key whose newer value is still in the batch has its flash record copied as well, so the new page holds every key
+even if the flush after the compaction never happens; the staged value follows with that flush.
+
+Promises:
+- Writes the new page header once every record is copied
+- Gives up on a flash failure; the active page is untouched and the flush is retried later
+
+*/
+static void KVStoreCompactStep(bool bSuccess_, void* pvContext_)
+{
+  const u32* pu32Record;
+  u16 u16Location;
+  u8 u8Words;
+
+  if(!bSuccess_)
+  {
+    G_sKVStoreStats.u32Errors++;
+    KVStore_eState = KVSTORE_IDLE;
+    SwTimerStart(&KVStore_sFlushTimer, U32_KVSTORE_FLUSH_DELAY_MS);
+    return;
+  }
+
+  for(KVStore_u8CompactKey++; KVStore_u8CompactKey < KVSTORE_KEYS; KVStore_u8CompactKey++)
+  {
+    u16Location = KVStore_au16FlashLocation[KVStore_u8CompactKey];
+    if(u16Location != U16_KVSTORE_NO_VALUE)
+    {
+      pu32Record = KVStorePage(KVStore_u8ActivePage) + u16Location / 4;
+      u8Words = 1 + (((*pu32Record >> 8) & 0xFF) + 3) / 4;
+      memcpy(KVStore_au32Copy, pu32Record, u8Words * sizeof(u32));
+
+      KVStore_au16CompactLocation[KVStore_u8CompactKey] = KVStore_u16CompactOffset;
+      if(!FlashWrite(KVStorePage(KVStore_u8CompactPage) + KVStore_u16CompactOffset / 4, KVStore_au32Copy, u8Words,
+                     KVStoreCompactStep, NULL))
+      {
+        KVStoreCompactStep(FALSE, NULL);
+        return;
+      }
+
+      KVStore_u16CompactOffset += u8Words * sizeof(u32);
+      return;
+    }
+  }
+
+  /* Header last: until it is written the old page is still the newest */
+  KVStore_u32PageHeader = U16_KVSTORE_PAGE_MAGIC | ((u32)(u16)(G_sKVStoreStats.u16Sequence + 1) << 16);
+  if(!FlashWrite(KVStorePage(KVStore_u8CompactPage), &KVStore_u32PageHeader, 1, KVStoreCompactDone, NULL))
+  {
+    KVStoreCompactStep(FALSE, NULL);
+  }
+
+} /* end KVStoreCompactStep() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreCompactDone(bool bSuccess_, void* pvContext_)
+@brief Flash callback for the new page header: switches to the new page, erases the old one and flushes.
+*/
+static void KVStoreCompactDone(bool bSuccess_, void* pvContext_)
+{
+  u8 u8OldPage = KVStore_u8ActivePage;
+  u16 u16Location;
+
+  if(!bSuccess_)
+  {
+    KVStoreCompactStep(FALSE, NULL);
+    return;
+  }
+
+  /* Staged keys keep pointing at the batch; only their flash copy moved */
+  for(u8 i = 0; i < KVSTORE_KEYS; i++)
+  {
+    KVStore_au16FlashLocation[i] = KVStore_au16CompactLocation[i];
+    u16Location = KVStore_au16Location[i];
+    if( (u16Location != U16_KVSTORE_NO_VALUE) && !(u16Location & U16_KVSTORE_STAGED) )
+    {
+      KVStore_au16Location[i] = KVStore_au16CompactLocation[i];
+    }
+  }
+
+  KVStore_u8ActivePage = KVStore_u8CompactPage;
+  KVStore_u16WriteOffset = KVStore_u16CompactOffset;
+  G_sKVStoreStats.u16Sequence++;
+  G_sKVStoreStats.u32Compactions++;
+  G_sKVStoreStats.u16FreeBytes = U32_FLASH_PAGE_SIZE - KVStore_u16WriteOffset;
+
+  /* If this fails the old page just loses to the newer sequence number */
+  (void)FlashErasePage((u32)KVStorePage(u8OldPage), NULL, NULL);
+
+  KVStore_eState = KVSTORE_IDLE;
+  KVStoreStartFlush();
+
+} /* end KVStoreCompactDone() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreFlushTimer(void* pvContext_)
+@brief No sets for U32_KVSTORE_FLUSH_DELAY_MS: write the batch.
+*/
+static void KVStoreFlushTimer(void* pvContext_)
+{
+  KVStoreStartFlush();
+
+} /* end KVStoreFlushTimer() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void KVStoreOnSettingFrame(u8* pu8Data_, u8 u8Length_)
+@brief BPFRAME_TYPE_SETTING receiver: [key][value] from the BLE client.  Keys with a run-time setter go through it
+so they take effect at once (the setter stores them); the rest take effect at the next reset unless the owning
+module reads the key again sooner.
+*/
+static void KVStoreOnSettingFrame(u8* pu8Data_, u8 u8Length_)
+{
+  if(u8Length_ < 2)
+  {
+    return;
+  }
+
+  switch(pu8Data_[0])
+  {
+    case KVSTORE_KEY_ADV_POLICY:
+    {
+      if(u8Length_ == 2)
+      {
+        (void)BLEAdvSetPolicy((BLEAdvPolicyType)pu8Data_[1]);
+      }
+      break;
+    }
+
+    case KVSTORE_KEY_ANT_PERIOD:
+    {
+      if(u8Length_ == (1 + sizeof(u16)))
+      {
+        (void)AntBeaconSetPeriod(pu8Data_[1] | (pu8Data_[2] << 8));
+      }
+      break;
+    }
+
+    default:
+    {
+      (void)KVStoreSet((KVStoreKeyType)pu8Data_[0], &pu8Data_[1], u8Length_ - 1);
+      break;
+    }
+  } /* end switch */
+
+} /* end KVStoreOnSettingFrame() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,113 @@
+/**********************************************************************************************************************
+File: kv_store.h
+
+Description:
+Header file for kv_store.c
+**********************************************************************************************************************/
+
+#ifndef __KV_STORE_H
+#define __KV_STORE_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U16_KVSTORE_PAGE_MAGIC         (u16)0x4B56  /* "KV": low half of a page header; the high half is its sequence */
+#define U8_KVSTORE_MAX_VALUE           (u8)32       /* Largest value in bytes */
+#define U8_KVSTORE_RECORD_MAX_WORDS    (u8)(1 + (U8_KVSTORE_MAX_VALUE + 3) / 4)
+
+#define U8_KVSTORE_BATCH_WORDS         (u8)16       /* Writes batched per flash write; >= U8_KVSTORE_RECORD_MAX_WORDS */
+#define U32_KVSTORE_FLUSH_DELAY_MS     (u32)2000    /* Flush this long after the last write */
+
+#define U16_KVSTORE_NO_VALUE           (u16)0xFFFF  /* Key has no record */
+#define U16_KVSTORE_STAGED             (u16)0x8000  /* Record is in the batch; the rest is its byte offset there */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum KVStoreKeyType
+@brief Stored settings.  Values are kept by key number, so add new keys at the end. */
+typedef enum
+{
+  KVSTORE_KEY_NONE = 0,                   /*!< @brief Not a key */
+  KVSTORE_KEY_DEVICE_NAME,                /*!< @brief GAP device name (text, no terminator) */
+  KVSTORE_KEY_ADV_POLICY,                 /*!< @brief BLEAdvPolicyType (1 byte) */
+  KVSTORE_KEY_POV_TIMING_MS,              /*!< @brief POV sweep time (u16) */
+  KVSTORE_KEY_POV_MESSAGE,                /*!< @brief POV start-up text (no terminator) */
+  KVSTORE_KEY_POV_COLOR,                  /*!< @brief POV red, green, blue LedRateType (1 byte each) */
+  KVSTORE_KEY_ANT_PERIOD,                 /*!< @brief ANT beacon message period in 1/32768s (u16) */
+  KVSTORE_KEY_ANT_SCAN,                   /*!< @brief ANT scan collector on (1 byte, 0 = off; default on) */
+  KVSTORE_KEYS                            /*!< @brief Number of keys; must stay last */
+} KVStoreKeyType;
+
+/*!
+@enum KVStoreStateType
+@brief What the store is doing in flash. */
+typedef enum
+{
+  KVSTORE_IDLE = 0,                       /*!< @brief Nothing in progress */
+  KVSTORE_FLUSHING,                       /*!< @brief Batch being appended to the active page */
+  KVSTORE_COMPACTING                      /*!< @brief Live records being copied to the next page */
+} KVStoreStateType;
+
+/*!
+@struct KVStoreStatsType
+@brief Store activity.  Sets per flush is the batching ratio; compactions spread evenly over the ring of pages.
+*/
+typedef struct
+{
+  u32 u32Sets;                            /*!< @brief KVStoreSet() calls accepted */
+  u32 u32Unchanged;                       /*!< @brief Sets skipped because the value was already stored */
+  u32 u32Coalesced;                       /*!< @brief Sets that replaced a value still waiting in the batch */
+  u32 u32Busy;                            /*!< @brief Sets refused because the batch was full */
+  u32 u32Flushes;                         /*!< @brief Batches written */
+  u32 u32FlushedBytes;                    /*!< @brief Bytes written by flushes */
+  u32 u32Compactions;                     /*!< @brief Moves to the next page */
+  u32 u32Errors;                          /*!< @brief Flash operations that failed */
+  u16 u16Sequence;                        /*!< @brief Active page sequence (total compactions over the device life) */
+  u16 u16FreeBytes;                       /*!< @brief Room left in the active page */
+} KVStoreStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool KVStoreSet(KVStoreKeyType eKey_, const void* pvValue_, u8 u8Length_);
+u8 KVStoreGet(KVStoreKeyType eKey_, void* pvValue_, u8 u8Size_);
+bool KVStoreFlush(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void KVStoreInitialize(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static u32* KVStorePage(u8 u8Page_);
+static const u32* KVStoreRecord(KVStoreKeyType eKey_);
+static u16 KVStoreRecordCrc(u8 u8Key_, u8 u8Length_, const u8* pu8Value_);
+static void KVStoreReplay(void);
+static void KVStoreStartFlush(void);
+static void KVStoreFlushDone(bool bSuccess_, void* pvContext_);
+static void KVStoreCompactStep(bool bSuccess_, void* pvContext_);
+static void KVStoreCompactDone(bool bSuccess_, void* pvContext_);
+static void KVStoreFlushTimer(void* pvContext_);
+static void KVStoreOnSettingFrame(u8* pu8Data_, u8 u8Length_);
+
+
+#endif /* __KV_STORE_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -73,7 +73,7 @@ Global variable definitions with scope limited to this local application.
 Variable names shall start with "Led_" and be declared as static.
 ***********************************************************************************************************************/
 static fnCode_type Led_StateMachine;                   /*!< @brief The state machine function pointer */
-static u32 Led_u32Timer;                               /*!< @brief Timeout counter used across states */
+static SwTimerType Led_sTimer;                         /*!< @brief Timeout timer used across states */
 
 static LedControlType Led_asControl[U8_TOTAL_LEDS];    /*!< @brief Holds individual control parameters for LEDs */
 
@@ -351,8 +351,12 @@ void LedInitialize(void)
 
   /* Static Display of all colors */
   LedRainbow();
-  Led_u32Timer = G_u32SystemTime1ms; 
-  while( !IsTimeUp(&Led_u32Timer, 500) );
+  SwTimerCreate(&Led_sTimer, SWTIMER_ONE_SHOT, NULL, NULL);
+  SwTimerStart(&Led_sTimer, 500);
+  while( !SwTimerCheckExpired(&Led_sTimer) )
+  {
+    SwTimerRunActiveState();
+  }
   LedAllOff();
 
   
@@ -705,6 +709,7 @@ void LedInitialize(void)
   LedOff(GRN0);
 #endif
   
+  WatchdogRegisterTask(WATCHDOG_TASK_LED, U32_WATCHDOG_TASK_PERIOD_MS);
   Led_StateMachine = LedSM_Idle;  
   
 } /* end LedInitialize() */
@@ -727,6 +732,7 @@ Promises:
 */
 void LedRunActiveState(void)
 {
+  WatchdogCheckIn(WATCHDOG_TASK_LED);
   Led_StateMachine();
 
 } /* end LedRunActiveState */
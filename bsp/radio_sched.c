@@ -0,0 +1,375 @@
+/**********************************************************************************************************************
+File: radio_sched.c
+
+Description:
+Radio-aware scheduling of heavy main-loop work (flash erases, POV re-rendering, bulk upload parsing).
+
+The SoftDevice runs BLE and ANT radio events at a high priority and a long CPU burst or flash stall that overlaps one
+either delays the application or makes the SoftDevice give up (a flash operation times out).  Radio notifications
+(SWI1) are configured for both edges: an "active" notice U32_RADIOSCHED_DISTANCE_US before each radio event and an
+"inactive" one as soon as it ends.  From these the ISR learns how long events last and how long the radio stays off
+afterwards.  The gap estimate drops at once to any shorter gap seen and creeps back up slowly, so it follows the
+tightest schedule currently running (a BLE connection and an ANT channel interleave).
+
+Work that can wait is submitted with RadioSchedSubmit().  If nothing is queued and the radio is quiet or the current
+gap has room, the job runs at once.  Otherwise it is deferred: each inactive notification posts a coalesced
+WORK_ITEM_RADIO_IDLE and the main loop runs every job whose cost (RadioSched_au32CostUs) fits in what is left of the
+predicted gap.  A job never waits more than U32_RADIOSCHED_MAX_WAIT_MS; a check timer runs overdue jobs and jobs
+submitted while the radio has gone quiet.
+
+The notification ISR also drives beacon frame rotation (BLEBeaconRadioHandler() on each inactive edge).  Without a
+SoftDevice no notification ever arrives, the radio counts as quiet and every job runs on submission.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+RadioSchedStatsType G_sRadioSchedStats;                /* Radio timing and deferred work */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "RadioSched_" and be declared as static.
+***********************************************************************************************************************/
+/* Time each source needs without the radio: page erase stall (nRF51 max), font rendering, sink copy */
+static const u32 RadioSched_au32CostUs[RADIOSCHED_SOURCES] = {22300, 1500, 1000};
+
+static RadioSchedJobEntryType RadioSched_asJobs[U8_RADIOSCHED_JOBS]; /* Deferred jobs, oldest first */
+static volatile u8 RadioSched_u8Jobs;                  /* Entries used; read by the ISR */
+
+static volatile bool RadioSched_bActive;               /* Between an active notice and the inactive edge (ISR) */
+static volatile bool RadioSched_bLearned;              /* At least one whole radio event seen (ISR) */
+static volatile u32 RadioSched_u32NoticeUs;            /* Low word of TimebaseGetUs() at the last active notice (ISR) */
+static volatile u32 RadioSched_u32InactiveUs;          /* Low word of TimebaseGetUs() at the last inactive edge (ISR) */
+
+static SwTimerType RadioSched_sCheckTimer;             /* Runs while jobs wait */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool RadioSchedSubmit(RadioSchedSourceType eSource_, RadioSchedJobType pfJob_, void* pvContext_)
+@brief Runs pfJob_ now if the radio leaves room for it, otherwise in the next radio gap that does.
+
+Requires:
+- Called from the main loop
+- pfJob_ may run before this returns
+
+Promises:
+- Returns TRUE if the job ran or was deferred; it runs within U32_RADIOSCHED_MAX_WAIT_MS
+- Returns FALSE if every slot is taken; the caller should do the work itself
+
+*/
+bool RadioSchedSubmit(RadioSchedSourceType eSource_, RadioSchedJobType pfJob_, void* pvContext_)
+{
+  RadioSchedJobEntryType* psJob;
+  u64 u64NowUs = TimebaseGetUs();
+
+  /* Jobs already waiting go first */
+  if( (RadioSched_u8Jobs == 0) && (RadioSchedIsQuiet(u64NowUs) || RadioSchedFits(eSource_, u64NowUs)) )
+  {
+    G_sRadioSchedStats.u32RanAtOnce++;
+    pfJob_(pvContext_);
+    return TRUE;
+  }
+
+  if(RadioSched_u8Jobs == U8_RADIOSCHED_JOBS)
+  {
+    G_sRadioSchedStats.u32Refused++;
+    return FALSE;
+  }
+
+  psJob = &RadioSched_asJobs[RadioSched_u8Jobs];
+  psJob->eSource        = eSource_;
+  psJob->pfJob          = pfJob_;
+  psJob->pvContext      = pvContext_;
+  psJob->u64SubmittedUs = u64NowUs;
+  RadioSched_u8Jobs++;
+
+  if(!SwTimerIsRunning(&RadioSched_sCheckTimer))
+  {
+    SwTimerStart(&RadioSched_sCheckTimer, U32_RADIOSCHED_CHECK_MS);
+  }
+
+  return TRUE;
+
+} /* end RadioSchedSubmit() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void RadioSchedInitialize(void)
+@brief Clears the learned timing and turns on radio notifications for both edges.
+
+Requires:
+- The SoftDevice is enabled (if SOFTDEVICE_ENABLED)
+- SwTimerInitialize() has run
+
+Promises:
+- No jobs are queued; stats are cleared
+- SWI1 fires U32_RADIOSCHED_DISTANCE_US before and right after every radio event.  If the SoftDevice refuses, no
+  timing is learned and every job runs on submission
+
+*/
+void RadioSchedInitialize(void)
+{
+  memset(&G_sRadioSchedStats, 0, sizeof(G_sRadioSchedStats));
+  RadioSched_u8Jobs = 0;
+  RadioSched_bActive = FALSE;
+  RadioSched_bLearned = FALSE;
+
+  SwTimerCreate(&RadioSched_sCheckTimer, SWTIMER_PERIODIC, RadioSchedCheckTimer, NULL);
+
+#ifdef SOFTDEVICE_ENABLED
+  (void)sd_nvic_SetPriority(RADIO_NOTIFICATION_IRQn, NRF_APP_PRIORITY_LOW);
+  (void)sd_nvic_EnableIRQ(RADIO_NOTIFICATION_IRQn);
+  (void)sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH, NRF_RADIO_NOTIFICATION_DISTANCE_800US);
+#endif
+
+} /* end RadioSchedInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void RadioSchedRadioHandler(void)
+@brief Radio notification: learns the event and gap lengths and wakes deferred work when the radio goes inactive.
+
+The notifications alternate, so the edge is tracked by toggling (as the SDK's ble_radio_notification does).
+
+Requires:
+- Called only from RADIO_NOTIFICATION_IRQHandler() at NRF_APP_PRIORITY_LOW (a work queue producer)
+
+Promises:
+- Active notice: the gap that just ended updates G_sRadioSchedStats.u32GapUs
+- Inactive edge: the event length updates G_sRadioSchedStats.u32ActiveUs, a WORK_ITEM_RADIO_IDLE is posted if jobs
+  wait and the beacon gets its rotation call
+
+*/
+void RadioSchedRadioHandler(void)
+{
+  u32 u32NowUs = (u32)TimebaseGetUs();
+  u32 u32Sample;
+
+  RadioSched_bActive = !RadioSched_bActive;
+
+  if(RadioSched_bActive)
+  {
+    if(RadioSched_bLearned)
+    {
+      /* Shorter gaps are taken at once, longer ones only slowly, so the estimate stays on the safe side */
+      u32Sample = u32NowUs - RadioSched_u32InactiveUs;
+      if(u32Sample < G_sRadioSchedStats.u32GapUs)
+      {
+        G_sRadioSchedStats.u32GapUs = u32Sample;
+      }
+      else
+      {
+        G_sRadioSchedStats.u32GapUs += (u32Sample - G_sRadioSchedStats.u32GapUs) >> U8_RADIOSCHED_FILTER_SHIFT;
+      }
+    }
+
+    RadioSched_u32NoticeUs = u32NowUs;
+    return;
+  }
+
+  /* The radio has just gone inactive */
+  G_sRadioSchedStats.u32RadioEvents++;
+  u32Sample = u32NowUs - RadioSched_u32NoticeUs;
+  if(!RadioSched_bLearned)
+  {
+    G_sRadioSchedStats.u32ActiveUs = u32Sample;
+    G_sRadioSchedStats.u32GapUs = U32_RADIOSCHED_MAX_WAIT_MS * 1000;
+    RadioSched_bLearned = TRUE;
+  }
+  else
+  {
+    G_sRadioSchedStats.u32ActiveUs = G_sRadioSchedStats.u32ActiveUs -
+                                     (G_sRadioSchedStats.u32ActiveUs >> U8_RADIOSCHED_FILTER_SHIFT) +
+                                     (u32Sample >> U8_RADIOSCHED_FILTER_SHIFT);
+  }
+  RadioSched_u32InactiveUs = u32NowUs;
+
+  if(RadioSched_u8Jobs != 0)
+  {
+    WorkQueuePostCoalesced(WORK_ITEM_RADIO_IDLE);
+  }
+
+  BLEBeaconRadioHandler();
+
+} /* end RadioSchedRadioHandler() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void RadioSchedOnRadioIdle(void)
+@brief Runs the deferred jobs that fit in the gap that has just started.
+
+Requires:
+- Called only from WorkQueueDispatch() (WORK_ITEM_RADIO_IDLE) or WorkQueueResync()
+
+Promises:
+- Every waiting job that fits, is overdue, or finds the radio quiet has run
+
+*/
+void RadioSchedOnRadioIdle(void)
+{
+  RadioSchedRunDue();
+
+} /* end RadioSchedOnRadioIdle() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool RadioSchedIsQuiet(u64 u64NowUs_)
+@brief Reports whether the radio has no schedule to work around.
+
+Promises:
+- Returns TRUE if no radio event has been seen yet, or the radio has been off for more than twice the longest wait
+  (nothing is running that the learned gap describes)
+
+*/
+static bool RadioSchedIsQuiet(u64 u64NowUs_)
+{
+  if(!RadioSched_bLearned)
+  {
+    return TRUE;
+  }
+
+  return ( !RadioSched_bActive &&
+           (((u32)u64NowUs_ - RadioSched_u32InactiveUs) > (2 * U32_RADIOSCHED_MAX_WAIT_MS * 1000)) );
+
+} /* end RadioSchedIsQuiet() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static bool RadioSchedFits(RadioSchedSourceType eSource_, u64 u64NowUs_)
+@brief Reports whether a job from eSource_ would finish before the next predicted radio event.
+
+Promises:
+- Returns TRUE if the radio is off and the rest of the learned gap covers the job's cost plus the margin
+
+*/
+static bool RadioSchedFits(RadioSchedSourceType eSource_, u64 u64NowUs_)
+{
+  u32 u32ElapsedUs;
+
+  if(!RadioSched_bLearned || RadioSched_bActive)
+  {
+    return FALSE;
+  }
+
+  u32ElapsedUs = (u32)u64NowUs_ - RadioSched_u32InactiveUs;
+  return ( (u32ElapsedUs + RadioSched_au32CostUs[eSource_] + U32_RADIOSCHED_MARGIN_US) <=
+           G_sRadioSchedStats.u32GapUs );
+
+} /* end RadioSchedFits() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void RadioSchedRun(u8 u8Index_, bool bOverdue_)
+@brief Removes job u8Index_ from the queue, records how long it waited and runs it.
+
+Promises:
+- Later jobs move down one slot; the job may submit new ones
+
+*/
+static void RadioSchedRun(u8 u8Index_, bool bOverdue_)
+{
+  RadioSchedJobEntryType sJob = RadioSched_asJobs[u8Index_];
+  u32 u32WaitUs = (u32)(TimebaseGetUs() - sJob.u64SubmittedUs);
+
+  for(u8 i = u8Index_ + 1; i < RadioSched_u8Jobs; i++)
+  {
+    RadioSched_asJobs[i - 1] = RadioSched_asJobs[i];
+  }
+  RadioSched_u8Jobs--;
+
+  G_sRadioSchedStats.au32Deferred[sJob.eSource]++;
+  if(bOverdue_)
+  {
+    G_sRadioSchedStats.au32Overdue[sJob.eSource]++;
+  }
+  G_sRadioSchedStats.au32LastWaitUs[sJob.eSource] = u32WaitUs;
+  G_sRadioSchedStats.au32TotalWaitMs[sJob.eSource] += u32WaitUs / 1000;
+  if(u32WaitUs > G_sRadioSchedStats.au32MaxWaitUs[sJob.eSource])
+  {
+    G_sRadioSchedStats.au32MaxWaitUs[sJob.eSource] = u32WaitUs;
+  }
+
+  sJob.pfJob(sJob.pvContext);
+
+} /* end RadioSchedRun() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void RadioSchedRunDue(void)
+@brief Runs, oldest first, every job that is overdue or fits now.
+
+Promises:
+- The check timer is stopped once no job waits
+
+*/
+static void RadioSchedRunDue(void)
+{
+  u64 u64NowUs = TimebaseGetUs();
+  bool bOverdue;
+  u8 u8Index = 0;
+
+  while(u8Index < RadioSched_u8Jobs)
+  {
+    bOverdue = ((u64NowUs - RadioSched_asJobs[u8Index].u64SubmittedUs) >= (U32_RADIOSCHED_MAX_WAIT_MS * 1000));
+    if( bOverdue || RadioSchedIsQuiet(u64NowUs) || RadioSchedFits(RadioSched_asJobs[u8Index].eSource, u64NowUs) )
+    {
+      /* The job has left the slot at u8Index; the next one has moved into it */
+      RadioSchedRun(u8Index, bOverdue);
+      u64NowUs = TimebaseGetUs();
+    }
+    else
+    {
+      u8Index++;
+    }
+  }
+
+  if(RadioSched_u8Jobs == 0)
+  {
+    SwTimerStop(&RadioSched_sCheckTimer);
+  }
+
+} /* end RadioSchedRunDue() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void RadioSchedCheckTimer(void* pvContext_)
+@brief Periodic check while jobs wait: catches overdue jobs and a radio that has gone quiet.
+*/
+static void RadioSchedCheckTimer(void* pvContext_)
+{
+  RadioSchedRunDue();
+
+} /* end RadioSchedCheckTimer() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
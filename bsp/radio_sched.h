@@ -0,0 +1,106 @@
+/**********************************************************************************************************************
+File: radio_sched.h
+
+Description:
+Header file for radio_sched.c
+**********************************************************************************************************************/
+
+#ifndef __RADIO_SCHED_H
+#define __RADIO_SCHED_H
+
+#include "typedefs.h"
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U8_RADIOSCHED_JOBS             (u8)4        /* Deferred jobs waiting for a gap */
+#define U32_RADIOSCHED_MAX_WAIT_MS     (u32)100     /* A job runs after this long even if no gap was big enough */
+#define U32_RADIOSCHED_CHECK_MS        (u32)10      /* Poll for overdue jobs and a quiet radio while jobs wait */
+#define U32_RADIOSCHED_MARGIN_US       (u32)300     /* Kept free between a job's end and the predicted radio start */
+#define U8_RADIOSCHED_FILTER_SHIFT     (u8)3        /* Learned times move 1/8 of the way to each new sample */
+
+/* The active notification comes this long before the radio starts (NRF_RADIO_NOTIFICATION_DISTANCE_800US) */
+#define U32_RADIOSCHED_DISTANCE_US     (u32)800
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+typedef void(*RadioSchedJobType)(void* pvContext_);
+
+/*!
+@enum RadioSchedSourceType
+@brief Work that waits for the radio.  Each source has a CPU (or flash stall) cost in RadioSched_au32CostUs. */
+typedef enum
+{
+  RADIOSCHED_FLASH_ERASE = 0,             /*!< @brief Flash page erase; the CPU stalls while it runs */
+  RADIOSCHED_POV_RENDER,                  /*!< @brief POV message re-rendered into the screen bitmap */
+  RADIOSCHED_BULK_DONE,                   /*!< @brief Bulk upload handed to its sink for parsing */
+  RADIOSCHED_SOURCES                      /*!< @brief Number of sources; must stay last */
+} RadioSchedSourceType;
+
+/*!
+@struct RadioSchedJobEntryType
+@brief One deferred job.
+*/
+typedef struct
+{
+  RadioSchedSourceType eSource;           /*!< @brief Who submitted it */
+  RadioSchedJobType pfJob;                /*!< @brief Called from the main loop in a radio gap */
+  void* pvContext;                        /*!< @brief Passed back to pfJob */
+  u64 u64SubmittedUs;                     /*!< @brief TimebaseGetUs() at submission */
+} RadioSchedJobEntryType;
+
+/*!
+@struct RadioSchedStatsType
+@brief What the radio is doing and how long work waited for it.  Wait times are per source, in us.
+*/
+typedef struct
+{
+  u32 u32RadioEvents;                     /*!< @brief Radio inactive notifications (ISR) */
+  u32 u32ActiveUs;                        /*!< @brief Learned radio event length, including the notice (ISR) */
+  u32 u32GapUs;                           /*!< @brief Learned time from the radio going inactive to the next notice (ISR) */
+  u32 u32RanAtOnce;                       /*!< @brief Jobs run on submission because the radio was quiet */
+  u32 u32Refused;                         /*!< @brief Submissions refused because every slot was taken */
+  u32 au32Deferred[RADIOSCHED_SOURCES];   /*!< @brief Jobs that waited for a gap */
+  u32 au32Overdue[RADIOSCHED_SOURCES];    /*!< @brief Deferred jobs run at U32_RADIOSCHED_MAX_WAIT_MS without a gap */
+  u32 au32LastWaitUs[RADIOSCHED_SOURCES]; /*!< @brief Wait of the last deferred job */
+  u32 au32MaxWaitUs[RADIOSCHED_SOURCES];  /*!< @brief Longest wait */
+  u32 au32TotalWaitMs[RADIOSCHED_SOURCES];/*!< @brief Sum of waits; divide by au32Deferred for the average */
+} RadioSchedStatsType;
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool RadioSchedSubmit(RadioSchedSourceType eSource_, RadioSchedJobType pfJob_, void* pvContext_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void RadioSchedInitialize(void);
+void RadioSchedRadioHandler(void);
+void RadioSchedOnRadioIdle(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static bool RadioSchedIsQuiet(u64 u64NowUs_);
+static bool RadioSchedFits(RadioSchedSourceType eSource_, u64 u64NowUs_);
+static void RadioSchedRun(u8 u8Index_, bool bOverdue_);
+static void RadioSchedRunDue(void);
+static void RadioSchedCheckTimer(void* pvContext_);
+
+
+#endif /* __RADIO_SCHED_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
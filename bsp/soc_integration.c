@@ -69,8 +69,9 @@ bool SocIntegrationInitialize(void)
 Function: SocIntegrationHandler
 
 Description:
-This is the global event checker for Protocol Events. It is called continuously from main(). It checks if the 
-_SYSTEM_PROTOCOL_EVENT is set. If so, it calls the dispatchers for the protocol event handlers.
+This is the global handler for Protocol Events. It is called from the work queue for each WORK_ITEM_SD_EVENT and
+calls the dispatchers for the protocol event handlers, which drain every pending event.  SoC events (flash
+operation results, power-fail warnings) are drained here and passed to the flash driver and the event log.
 
 Requires:
   - SoftDevice is enabled
@@ -79,18 +80,19 @@ Requires:
 
 Promises:
   - Proper dispatching of Protocol events to its handlers
-  - Clears the _SYSTEM_PROTOCOL_EVENT system flag
 */
 void SocIntegrationHandler(void)
 {
-  // Check if pending event.
-  if (G_u32SystemFlags & _SYSTEM_PROTOCOL_EVENT)
+  uint32_t u32SocEvent;
+
+  while (sd_evt_get(&u32SocEvent) == NRF_SUCCESS)
   {
-    // Clear pending event and process protocol events.
-    G_u32SystemFlags &= ~_SYSTEM_PROTOCOL_EVENT;
-    ANTIntegrationHandler();
-    BLEIntegrationHandler();
+    FlashOnSocEvent(u32SocEvent);
+    EventLogOnSocEvent(u32SocEvent);
   }
+
+  ANTIntegrationHandler();
+  BLEIntegrationHandler();
 }
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -106,12 +108,16 @@ Requires:
 - NONE
 
 Promises:
-- Halts the system.
-- Provides the PC counter, Line Num and the FileName in the SoftDevice Code that caused the assertion.
+- Saves the PC counter and Line Num in the SoftDevice Code that caused the assertion in the watchdog
+  retained record, then resets the system so the unit recovers immediately.
 
 */
 void SocSoftdeviceAssertCallback(uint32_t ulPC, uint16_t usLineNum, const uint8_t *pucFileName)
 {
+  WatchdogRecordAssert(ulPC, usLineNum);
+  NVIC_SystemReset();
+  
+  /* Not reached; the WDT backs up the reset request */
   while (1);
   
 } /* end SocSoftdeviceAssertCallback() */
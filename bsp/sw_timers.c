@@ -0,0 +1,571 @@
+/**********************************************************************************************************************
+File: sw_timers.c
+
+Description:
+Software timer service shared by all modules.
+
+Timers live in a hierarchical timing wheel of U8_SWTIMER_LEVELS levels with 8 slots each (1ms, 8ms, 64ms and
+512ms per slot).  Each slot is an intrusive list with a back-link, so starting and stopping a timer are O(1) and no
+memory is allocated: the client owns its SwTimerType.  An 8-bit occupancy byte per level lets the service find
+the nearest expiry quickly; that time is loaded into RTC1 COMPARE1 so the wheel is only serviced when something is
+actually due.  The compare interrupt only posts a work item; all wheel processing is in the main loop.
+
+Timers are main-loop objects: start, stop and check them only from the main loop (not from ISRs).  On expiry a
+timer latches bExpired (read with SwTimerCheckExpired()) and calls its callback, if it has one.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+SwTimerStatsType G_sSwTimerStats;                      /* Timer service statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "SwTimer_" and be declared as static.
+***********************************************************************************************************************/
+static SwTimerType* SwTimer_apsSlots[U8_SWTIMER_TOTAL_SLOTS];  /* Slot list heads, level-major */
+static u8 SwTimer_au8Occupied[U8_SWTIMER_LEVELS];              /* Bit n set if slot n of the level is not empty */
+static u32 SwTimer_u32Current;                                 /* Last ms that has been processed */
+static u32 SwTimer_u32NextEventMs;                             /* System time of the next wheel event */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SwTimerCreate(SwTimerType* psTimer_, SwTimerModeType eMode_, SwTimerCallbackType pfCallback_, void* pvContext_)
+@brief Prepares a client-owned timer.  The timer is not started.
+
+Requires:
+@param psTimer_ points to timer memory that stays valid while the timer runs
+@param eMode_ is SWTIMER_ONE_SHOT or SWTIMER_PERIODIC
+@param pfCallback_ is called on expiry, or NULL for a flag-only timer
+@param pvContext_ is passed back to pfCallback_
+
+Promises:
+- *psTimer_ is initialized and stopped
+
+*/
+void SwTimerCreate(SwTimerType* psTimer_, SwTimerModeType eMode_, SwTimerCallbackType pfCallback_, void* pvContext_)
+{
+  psTimer_->psNext      = NULL;
+  psTimer_->ppsPrevNext = NULL;
+  psTimer_->u32Expiry   = 0;
+  psTimer_->u32Period   = 0;
+  psTimer_->pfCallback  = pfCallback_;
+  psTimer_->pvContext   = pvContext_;
+  psTimer_->eMode       = eMode_;
+  psTimer_->u8Slot      = U8_SWTIMER_SLOT_NONE;
+  psTimer_->bExpired    = FALSE;
+
+} /* end SwTimerCreate() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SwTimerStart(SwTimerType* psTimer_, u32 u32TimeoutMs_)
+@brief (Re)starts a timer.  A periodic timer uses u32TimeoutMs_ as its period.
+
+Requires:
+- SwTimerCreate() has been called on psTimer_
+- Called from the main loop
+@param u32TimeoutMs_ is the time until expiry in ms (0 expires on the next ms)
+
+Promises:
+- psTimer_ is running and its expired flag is cleared
+- RTC1 COMPARE1 is moved earlier if this is now the nearest expiry
+
+*/
+void SwTimerStart(SwTimerType* psTimer_, u32 u32TimeoutMs_)
+{
+  if(psTimer_->ppsPrevNext != NULL)
+  {
+    SwTimerUnlink(psTimer_);
+  }
+  else
+  {
+    /* An empty wheel may be far behind the system time: catch it up for free */
+    if(G_sSwTimerStats.u32ActiveTimers == 0)
+    {
+      SwTimer_u32Current = G_u32SystemTime1ms;
+    }
+
+    G_sSwTimerStats.u32ActiveTimers++;
+    if(G_sSwTimerStats.u32ActiveTimers > G_sSwTimerStats.u32MaxActiveTimers)
+    {
+      G_sSwTimerStats.u32MaxActiveTimers = G_sSwTimerStats.u32ActiveTimers;
+    }
+  }
+
+  psTimer_->u32Period = u32TimeoutMs_;
+  psTimer_->u32Expiry = G_u32SystemTime1ms + u32TimeoutMs_;
+  psTimer_->bExpired  = FALSE;
+  SwTimerInsert(psTimer_);
+
+  SwTimerScheduleWake();
+
+} /* end SwTimerStart() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SwTimerStop(SwTimerType* psTimer_)
+@brief Cancels a timer.  Safe to call on a timer that is not running, including from a timer callback.
+
+Requires:
+- Called from the main loop
+
+Promises:
+- psTimer_ is removed from the wheel and its expired flag is cleared
+
+*/
+void SwTimerStop(SwTimerType* psTimer_)
+{
+  if(psTimer_->ppsPrevNext != NULL)
+  {
+    SwTimerUnlink(psTimer_);
+    G_sSwTimerStats.u32ActiveTimers--;
+  }
+
+  psTimer_->bExpired = FALSE;
+
+} /* end SwTimerStop() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool SwTimerIsRunning(SwTimerType* psTimer_)
+@brief Reports if a timer is in the wheel.
+
+Promises:
+- Returns TRUE if psTimer_ is running
+
+*/
+bool SwTimerIsRunning(SwTimerType* psTimer_)
+{
+  return (psTimer_->ppsPrevNext != NULL);
+
+} /* end SwTimerIsRunning() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool SwTimerCheckExpired(SwTimerType* psTimer_)
+@brief Latching check for flag-based timers.
+
+Returns TRUE once for each expiry (a periodic timer that expired several times between checks reports once).
+
+Promises:
+- Returns TRUE and clears the flag if psTimer_ expired since the last check
+
+*/
+bool SwTimerCheckExpired(SwTimerType* psTimer_)
+{
+  if(psTimer_->bExpired)
+  {
+    psTimer_->bExpired = FALSE;
+    return TRUE;
+  }
+
+  return FALSE;
+
+} /* end SwTimerCheckExpired() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SwTimerInitialize(void)
+@brief Empties the wheel.
+
+Requires:
+- SysTickSetup() has run
+- Called before any driver or application creates a timer
+
+Promises:
+- All slots are empty and COMPARE1 is disabled until a timer is started
+
+*/
+void SwTimerInitialize(void)
+{
+  for(u8 i = 0; i < U8_SWTIMER_TOTAL_SLOTS; i++)
+  {
+    SwTimer_apsSlots[i] = NULL;
+  }
+
+  for(u8 i = 0; i < U8_SWTIMER_LEVELS; i++)
+  {
+    SwTimer_au8Occupied[i] = 0;
+  }
+
+  memset(&G_sSwTimerStats, 0, sizeof(G_sSwTimerStats));
+  SwTimer_u32Current = G_u32SystemTime1ms;
+  SwTimer_u32NextEventMs = SwTimer_u32Current;
+  NRF_RTC1->INTENCLR = (1 << RTC_INTENSET_COMPARE1_Pos);
+
+} /* end SwTimerInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SwTimerRunActiveState(void)
+@brief Processes the wheel up to G_u32SystemTime1ms if its next event is due.
+
+Called every pass of the main loop and for each RTC1 COMPARE1 work item; returns after one compare when nothing is
+due, so it may also be polled during initialization.
+
+Requires:
+- SwTimerInitialize() has run
+
+Promises:
+- Every timer with an expiry at or before G_u32SystemTime1ms has expired: flag latched and callback run
+- Periodic timers are re-filed for their next period
+- COMPARE1 is loaded for the next nearest expiry
+
+*/
+void SwTimerRunActiveState(void)
+{
+  u32 u32Now;
+  u32 u32BlockEnd;
+  u32 u32StartUs;
+  u32 u32ElapsedUs;
+
+  if( (G_sSwTimerStats.u32ActiveTimers == 0) ||
+      ((G_u32SystemTime1ms - SwTimer_u32NextEventMs) >= U32_SWTIMER_HALF_RANGE) )
+  {
+    return;
+  }
+
+  u32StartUs = (u32)TimebaseGetUs();
+  u32Now = G_u32SystemTime1ms;
+
+  while(SwTimer_u32Current != u32Now)
+  {
+    /* With nothing on level 0, jump to the end of the current level-0 block (or straight to now) */
+    if(SwTimer_au8Occupied[0] == 0)
+    {
+      u32BlockEnd = SwTimer_u32Current | U32_SWTIMER_SLOT_MASK;
+      if( (u32Now - SwTimer_u32Current) <= (u32BlockEnd - SwTimer_u32Current) )
+      {
+        SwTimer_u32Current = u32Now;
+        break;
+      }
+
+      SwTimer_u32Current = u32BlockEnd;
+    }
+
+    SwTimerTick();
+  }
+
+  SwTimerScheduleWake();
+
+  u32ElapsedUs = (u32)TimebaseGetUs() - u32StartUs;
+  if(u32ElapsedUs > G_sSwTimerStats.u32MaxServiceUs)
+  {
+    G_sSwTimerStats.u32MaxServiceUs = u32ElapsedUs;
+  }
+
+} /* end SwTimerRunActiveState() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void SwTimerRtcHandler(void)
+@brief Services RTC1 COMPARE1 for the timer wheel.
+
+Called only from RTC1_IRQHandler() after TimebaseRtcHandler() so the system time is already current.
+
+Promises:
+- Posts a coalesced WORK_ITEM_TIMER_COMPARE so the main loop services the wheel
+
+*/
+void SwTimerRtcHandler(void)
+{
+  if(NRF_RTC1->EVENTS_COMPARE[1])
+  {
+    NRF_RTC1->EVENTS_COMPARE[1] = 0;
+    WorkQueuePostCoalesced(WORK_ITEM_TIMER_COMPARE);
+  }
+
+} /* end SwTimerRtcHandler() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerLink(SwTimerType* psTimer_, u8 u8Slot_)
+@brief Pushes a timer on the front of a slot list.
+*/
+static void SwTimerLink(SwTimerType* psTimer_, u8 u8Slot_)
+{
+  SwTimerType** ppsHead = &SwTimer_apsSlots[u8Slot_];
+
+  psTimer_->psNext = *ppsHead;
+  if(psTimer_->psNext != NULL)
+  {
+    psTimer_->psNext->ppsPrevNext = &psTimer_->psNext;
+  }
+
+  *ppsHead = psTimer_;
+  psTimer_->ppsPrevNext = ppsHead;
+  psTimer_->u8Slot = u8Slot_;
+  SwTimer_au8Occupied[u8Slot_ >> U8_SWTIMER_SLOT_BITS] |= (1UL << (u8Slot_ & U32_SWTIMER_SLOT_MASK));
+
+} /* end SwTimerLink() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerUnlink(SwTimerType* psTimer_)
+@brief Removes a timer from whichever list it is on (a wheel slot or a detached list being processed).
+*/
+static void SwTimerUnlink(SwTimerType* psTimer_)
+{
+  *psTimer_->ppsPrevNext = psTimer_->psNext;
+  if(psTimer_->psNext != NULL)
+  {
+    psTimer_->psNext->ppsPrevNext = psTimer_->ppsPrevNext;
+  }
+
+  /* Clearing the occupancy bit of an empty slot is always correct, even for detached timers */
+  if( (psTimer_->u8Slot != U8_SWTIMER_SLOT_NONE) && (SwTimer_apsSlots[psTimer_->u8Slot] == NULL) )
+  {
+    SwTimer_au8Occupied[psTimer_->u8Slot >> U8_SWTIMER_SLOT_BITS] &= ~(1UL << (psTimer_->u8Slot & U32_SWTIMER_SLOT_MASK));
+  }
+
+  psTimer_->psNext = NULL;
+  psTimer_->ppsPrevNext = NULL;
+  psTimer_->u8Slot = U8_SWTIMER_SLOT_NONE;
+
+} /* end SwTimerUnlink() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerDetachSlot(u8 u8Slot_, SwTimerType** ppsList_)
+@brief Moves a whole slot list to a local list head so callbacks may safely stop or restart any timer on it.
+*/
+static void SwTimerDetachSlot(u8 u8Slot_, SwTimerType** ppsList_)
+{
+  *ppsList_ = SwTimer_apsSlots[u8Slot_];
+  SwTimer_apsSlots[u8Slot_] = NULL;
+  SwTimer_au8Occupied[u8Slot_ >> U8_SWTIMER_SLOT_BITS] &= ~(1UL << (u8Slot_ & U32_SWTIMER_SLOT_MASK));
+
+  if(*ppsList_ != NULL)
+  {
+    (*ppsList_)->ppsPrevNext = ppsList_;
+  }
+
+} /* end SwTimerDetachSlot() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerInsert(SwTimerType* psTimer_)
+@brief Files a timer in the slot for its expiry relative to the last processed ms.
+
+Level n holds timers due in [8^n, 8^(n+1)) ms.  Overdue timers go in the next ms; timers beyond the wheel range
+are parked at the far end of the top level and re-filed when that slot cascades.
+*/
+static void SwTimerInsert(SwTimerType* psTimer_)
+{
+  u32 u32Expiry = psTimer_->u32Expiry;
+  u32 u32Delta;
+  u8 u8Level = 0;
+  u8 u8Slot;
+
+  u32Delta = u32Expiry - SwTimer_u32Current;
+  if( (u32Delta == 0) || (u32Delta >= U32_SWTIMER_HALF_RANGE) )
+  {
+    u32Delta  = 1;
+    u32Expiry = SwTimer_u32Current + 1;
+  }
+  else if(u32Delta > U32_SWTIMER_MAX_DELTA)
+  {
+    u32Delta  = U32_SWTIMER_MAX_DELTA;
+    u32Expiry = SwTimer_u32Current + U32_SWTIMER_MAX_DELTA;
+  }
+
+  while( (u8Level < (U8_SWTIMER_LEVELS - 1)) &&
+         (u32Delta >= (1UL << (U8_SWTIMER_SLOT_BITS * (u8Level + 1)))) )
+  {
+    u8Level++;
+  }
+
+  u8Slot = (u8)((u32Expiry >> (U8_SWTIMER_SLOT_BITS * u8Level)) & U32_SWTIMER_SLOT_MASK);
+  SwTimerLink(psTimer_, (u8)((u8Level << U8_SWTIMER_SLOT_BITS) + u8Slot));
+
+} /* end SwTimerInsert() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerCascade(u8 u8Level_)
+@brief Re-files every timer in the current slot of a higher level into the lower levels.
+*/
+static void SwTimerCascade(u8 u8Level_)
+{
+  SwTimerType* psList;
+  SwTimerType* psTimer;
+  u8 u8Index = (u8)((SwTimer_u32Current >> (U8_SWTIMER_SLOT_BITS * u8Level_)) & U32_SWTIMER_SLOT_MASK);
+
+  SwTimerDetachSlot((u8)((u8Level_ << U8_SWTIMER_SLOT_BITS) + u8Index), &psList);
+  while(psList != NULL)
+  {
+    psTimer = psList;
+    SwTimerUnlink(psTimer);
+    SwTimerInsert(psTimer);
+    G_sSwTimerStats.u32Cascades++;
+  }
+
+} /* end SwTimerCascade() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerTick(void)
+@brief Advances the wheel by 1ms: cascades at block boundaries, then expires the level-0 slot.
+*/
+static void SwTimerTick(void)
+{
+  SwTimerType* psList;
+  SwTimerType* psTimer;
+
+  SwTimer_u32Current++;
+
+  /* Entering a new level-0 block: pull the matching slot down from each level that also rolled over */
+  if( (SwTimer_u32Current & U32_SWTIMER_SLOT_MASK) == 0 )
+  {
+    for(u8 u8Level = 1; u8Level < U8_SWTIMER_LEVELS; u8Level++)
+    {
+      SwTimerCascade(u8Level);
+      if( ((SwTimer_u32Current >> (U8_SWTIMER_SLOT_BITS * u8Level)) & U32_SWTIMER_SLOT_MASK) != 0 )
+      {
+        break;
+      }
+    }
+  }
+
+  SwTimerDetachSlot((u8)(SwTimer_u32Current & U32_SWTIMER_SLOT_MASK), &psList);
+  while(psList != NULL)
+  {
+    psTimer = psList;
+    SwTimerUnlink(psTimer);
+    G_sSwTimerStats.u32Expirations++;
+
+    if( (psTimer->eMode == SWTIMER_PERIODIC) && (psTimer->u32Period != 0) )
+    {
+      psTimer->u32Expiry += psTimer->u32Period;
+      SwTimerInsert(psTimer);
+    }
+    else
+    {
+      G_sSwTimerStats.u32ActiveTimers--;
+    }
+
+    psTimer->bExpired = TRUE;
+    if(psTimer->pfCallback != NULL)
+    {
+      psTimer->pfCallback(psTimer->pvContext);
+    }
+  }
+
+} /* end SwTimerTick() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u32 SwTimerNextEventDelta(void)
+@brief Finds the ms from SwTimer_u32Current to the next thing the wheel must do.
+
+For level 0 that is an exact expiry; for higher levels it is the cascade of the nearest occupied slot.
+*/
+static u32 SwTimerNextEventDelta(void)
+{
+  u32 u32Best = U32_SWTIMER_MAX_DELTA;
+  u32 u32Candidate;
+  u32 u32Shift;
+  u32 u32Index;
+
+  for(u8 u8Level = 0; u8Level < U8_SWTIMER_LEVELS; u8Level++)
+  {
+    if(SwTimer_au8Occupied[u8Level] == 0)
+    {
+      continue;
+    }
+
+    u32Shift = U8_SWTIMER_SLOT_BITS * u8Level;
+    u32Index = (SwTimer_u32Current >> u32Shift) & U32_SWTIMER_SLOT_MASK;
+    for(u32 i = 1; i <= U8_SWTIMER_SLOTS_PER_LEVEL; i++)
+    {
+      if(SwTimer_au8Occupied[u8Level] & (1UL << ((u32Index + i) & U32_SWTIMER_SLOT_MASK)))
+      {
+        u32Candidate = (((SwTimer_u32Current >> u32Shift) + i) << u32Shift) - SwTimer_u32Current;
+        if(u32Candidate < u32Best)
+        {
+          u32Best = u32Candidate;
+        }
+        break;
+      }
+    }
+  }
+
+  return u32Best;
+
+} /* end SwTimerNextEventDelta() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void SwTimerScheduleWake(void)
+@brief Records the nearest wheel event and loads RTC1 COMPARE1 to wake the CPU for it.
+*/
+static void SwTimerScheduleWake(void)
+{
+  u32 u32WakeMs;
+  u32 u32Lag;
+
+  if(G_sSwTimerStats.u32ActiveTimers == 0)
+  {
+    NRF_RTC1->INTENCLR = (1 << RTC_INTENSET_COMPARE1_Pos);
+    return;
+  }
+
+  u32WakeMs = SwTimerNextEventDelta();
+  SwTimer_u32NextEventMs = SwTimer_u32Current + u32WakeMs;
+
+  /* Already late: the next SwTimerRunActiveState() call will process it */
+  u32Lag = G_u32SystemTime1ms - SwTimer_u32Current;
+  if(u32WakeMs <= u32Lag)
+  {
+    return;
+  }
+
+  u32WakeMs -= u32Lag;
+  if(u32WakeMs > U32_SWTIMER_MAX_WAKE_MS)
+  {
+    u32WakeMs = U32_SWTIMER_MAX_WAKE_MS;
+  }
+
+  /* Round up to whole RTC counts so the compare lands after the ms tick it waits for */
+  NRF_RTC1->CC[1] = ( NRF_RTC1->COUNTER +
+                      (((u32WakeMs * U32_SWTIMER_RTC_COUNTS_NUM) + U32_SWTIMER_RTC_COUNTS_DEN - 1) / U32_SWTIMER_RTC_COUNTS_DEN) )
+                    & U32_RTC_COUNTER_MASK;
+  NRF_RTC1->INTENSET = (1 << RTC_INTENSET_COMPARE1_Pos);
+
+} /* end SwTimerScheduleWake() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,113 @@
+/**********************************************************************************************************************
+File: sw_timers.h
+
+Description:
+Header file for sw_timers.c
+**********************************************************************************************************************/
+
+#ifndef __SW_TIMERS_H
+#define __SW_TIMERS_H
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum SwTimerModeType
+@brief One-shot timers stop after expiring; periodic timers reload with their period. */
+typedef enum {SWTIMER_ONE_SHOT = 0, SWTIMER_PERIODIC} SwTimerModeType;
+
+typedef void(*SwTimerCallbackType)(void* pvContext_);
+
+/*!
+@struct SwTimerType
+@brief One software timer.  Owned by the client module (usually a static) and linked into the wheel while running.
+*/
+typedef struct SwTimerStruct
+{
+  struct SwTimerStruct*  psNext;          /*!< @brief Next timer in the same wheel slot */
+  struct SwTimerStruct** ppsPrevNext;     /*!< @brief The link pointing at this timer; NULL when not running */
+  u32 u32Expiry;                          /*!< @brief G_u32SystemTime1ms value when the timer expires */
+  u32 u32Period;                          /*!< @brief Reload value in ms for periodic timers */
+  SwTimerCallbackType pfCallback;         /*!< @brief Called from the main loop on expiry; NULL for flag-only timers */
+  void* pvContext;                        /*!< @brief Passed back to pfCallback */
+  SwTimerModeType eMode;                  /*!< @brief One-shot or periodic */
+  u8 u8Slot;                              /*!< @brief Wheel slot index while running */
+  bool bExpired;                          /*!< @brief Latched on expiry; cleared by SwTimerCheckExpired() */
+} SwTimerType;
+
+/*!
+@struct SwTimerStatsType
+@brief Run-time statistics for the timer service.
+*/
+typedef struct
+{
+  u32 u32ActiveTimers;                    /*!< @brief Timers currently in the wheel */
+  u32 u32MaxActiveTimers;                 /*!< @brief High-water mark of u32ActiveTimers */
+  u32 u32Expirations;                     /*!< @brief Total expiries processed */
+  u32 u32Cascades;                        /*!< @brief Timers moved down a level */
+  u32 u32MaxServiceUs;                    /*!< @brief Longest SwTimerRunActiveState() pass */
+} SwTimerStatsType;
+
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U8_SWTIMER_LEVELS               (u8)4             /* Wheel levels */
+#define U8_SWTIMER_SLOT_BITS            (u8)3             /* log2 of slots per level */
+#define U8_SWTIMER_SLOTS_PER_LEVEL      (u8)(1 << U8_SWTIMER_SLOT_BITS)
+#define U32_SWTIMER_SLOT_MASK           (u32)(U8_SWTIMER_SLOTS_PER_LEVEL - 1)
+#define U8_SWTIMER_TOTAL_SLOTS          (u8)(U8_SWTIMER_LEVELS * U8_SWTIMER_SLOTS_PER_LEVEL)
+#define U8_SWTIMER_SLOT_NONE            (u8)0xFF
+
+/* Timeouts beyond the top level (~4 seconds) are parked in the top level and re-filed when it cascades */
+#define U32_SWTIMER_MAX_DELTA           (u32)((1UL << (U8_SWTIMER_SLOT_BITS * U8_SWTIMER_LEVELS)) - 1)
+#define U32_SWTIMER_HALF_RANGE          (u32)0x80000000   /* Expiry deltas above this are in the past */
+
+/* RTC1 COMPARE1 wakes the wheel; keep requests inside half the 24-bit COUNTER range */
+#define U32_SWTIMER_MAX_WAKE_MS         (u32)250000
+#define U32_SWTIMER_RTC_COUNTS_NUM      (u32)4096         /* ms -> RTC counts is 4096 / 125 */
+#define U32_SWTIMER_RTC_COUNTS_DEN      (u32)125
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void SwTimerCreate(SwTimerType* psTimer_, SwTimerModeType eMode_, SwTimerCallbackType pfCallback_, void* pvContext_);
+void SwTimerStart(SwTimerType* psTimer_, u32 u32TimeoutMs_);
+void SwTimerStop(SwTimerType* psTimer_);
+bool SwTimerIsRunning(SwTimerType* psTimer_);
+bool SwTimerCheckExpired(SwTimerType* psTimer_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void SwTimerInitialize(void);
+void SwTimerRunActiveState(void);
+void SwTimerRtcHandler(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void SwTimerLink(SwTimerType* psTimer_, u8 u8Slot_);
+static void SwTimerUnlink(SwTimerType* psTimer_);
+static void SwTimerDetachSlot(u8 u8Slot_, SwTimerType** ppsList_);
+static void SwTimerInsert(SwTimerType* psTimer_);
+static void SwTimerCascade(u8 u8Level_);
+static void SwTimerTick(void);
+static u32 SwTimerNextEventDelta(void);
+static void SwTimerScheduleWake(void);
+
+
+
+#endif /* __SW_TIMERS_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
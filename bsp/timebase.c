@@ -0,0 +1,296 @@
+/**********************************************************************************************************************
+File: timebase.c
+
+Description:
+System timebase derived from the RTC1 COUNTER.
+
+RTC1 runs unprescaled at 32.768kHz.  The 1ms system tick comes from COMPARE0, which is moved forward by 32 or 33
+counts using a fractional accumulator (0.768 count per ms) so that every 1000 ticks span exactly 32768 counts and
+G_u32SystemTime1ms / G_u32SystemTime1s do not drift against the LFCLK.  OVRFLW extends the 24-bit COUNTER so a
+64-bit monotonic timestamp can be read at any time.  With TIMEBASE_SUBTICK_ENABLED, TIMER1 is cleared on every RTC
+count through PPI and supplies the microseconds inside the current 30.5us RTC count.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "Timebase_" and be declared as static.
+***********************************************************************************************************************/
+static volatile u32 Timebase_u32Overflows;             /* Number of 24-bit COUNTER overflows (every 512s) */
+static u32 Timebase_u32NextCompare;                    /* COUNTER value at which the next ms starts */
+static u16 Timebase_u16Fraction;                       /* Accumulated fractional RTC counts in 1/1000 counts */
+static u16 Timebase_u16MsInSecond;                     /* ms ticks since G_u32SystemTime1s last incremented */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u64 TimebaseGetTicks(void)
+@brief Returns the number of 32.768kHz RTC counts since SysTickSetup().
+
+Safe to call from the main loop or from any application ISR.
+
+Requires:
+- SysTickSetup() has run
+
+Promises:
+- Returns the 64-bit extended RTC1 COUNTER
+
+*/
+u64 TimebaseGetTicks(void)
+{
+  u32 u32SubTickUs;
+
+  return TimebaseSample(&u32SubTickUs);
+
+} /* end TimebaseGetTicks() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u64 TimebaseGetUs(void)
+@brief Returns a monotonic microsecond timestamp.
+
+The RTC provides the base value and TIMER1 (if TIMEBASE_SUBTICK_ENABLED) fills in the microseconds within the
+current RTC count.  Use this for any interval measurement instead of counting loop iterations or ms ticks.
+
+Requires:
+- SysTickSetup() has run
+
+Promises:
+- Returns microseconds since SysTickSetup(); never goes backwards
+
+*/
+u64 TimebaseGetUs(void)
+{
+  u64 u64Ticks;
+  u64 u64Us;
+  u32 u32SubTickUs = 0;
+  u32 u32TickLengthUs;
+
+  u64Ticks = TimebaseSample(&u32SubTickUs);
+  u64Us = (u64Ticks * U32_TIMEBASE_US_NUMERATOR) >> U8_TIMEBASE_US_SHIFT;
+
+  /* Keep the sub-tick part inside the current RTC count so the result stays monotonic */
+  u32TickLengthUs = (u32)((((u64Ticks + 1) * U32_TIMEBASE_US_NUMERATOR) >> U8_TIMEBASE_US_SHIFT) - u64Us);
+  if(u32SubTickUs >= u32TickLengthUs)
+  {
+    u32SubTickUs = u32TickLengthUs - 1;
+  }
+
+  return (u64Us + u32SubTickUs);
+
+} /* end TimebaseGetUs() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u32 TimebaseInitialize(void)
+@brief Loads the first 1ms compare value and sets up the sub-tick TIMER.
+
+Requires:
+- Called from SysTickSetup() after RTC1 is cleared and before it is started
+
+Promises:
+- RTC1 CC[0] is loaded for the first ms
+- TIMER1 is running at 1MHz and cleared by every RTC1 TICK event (if TIMEBASE_SUBTICK_ENABLED)
+- Returns NRF_SUCCESS or the error of the failing SD call
+
+*/
+u32 TimebaseInitialize(void)
+{
+  u32 u32Result = NRF_SUCCESS;
+
+  Timebase_u32Overflows = 0;
+  Timebase_u16Fraction = 0;
+  Timebase_u16MsInSecond = 0;
+  Timebase_u32NextCompare = 0;
+
+  /* First ms starts at 32.768 counts: advance without touching the global time */
+  Timebase_u16Fraction += U16_TIMEBASE_FRACTION_PER_MS;
+  Timebase_u32NextCompare = U16_TIMEBASE_COUNTS_PER_MS;
+  NRF_RTC1->CC[0] = Timebase_u32NextCompare;
+
+#ifdef TIMEBASE_SUBTICK_ENABLED
+  NRF_TIMER1->TASKS_STOP  = 1;
+  NRF_TIMER1->MODE        = (TIMER_MODE_MODE_Timer << TIMER_MODE_MODE_Pos);
+  NRF_TIMER1->BITMODE     = (TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos);
+  NRF_TIMER1->PRESCALER   = U32_TIMEBASE_TIMER_PRESCALER;
+  NRF_TIMER1->TASKS_CLEAR = 1;
+
+#ifdef SOFTDEVICE_ENABLED
+  u32Result |= sd_ppi_channel_assign(U8_TIMEBASE_PPI_CHANNEL, &NRF_RTC1->EVENTS_TICK, &NRF_TIMER1->TASKS_CLEAR);
+  u32Result |= sd_ppi_channel_enable_set(1 << U8_TIMEBASE_PPI_CHANNEL);
+#else
+  NRF_PPI->CH[U8_TIMEBASE_PPI_CHANNEL].EEP = (u32)&NRF_RTC1->EVENTS_TICK;
+  NRF_PPI->CH[U8_TIMEBASE_PPI_CHANNEL].TEP = (u32)&NRF_TIMER1->TASKS_CLEAR;
+  NRF_PPI->CHENSET = (1 << U8_TIMEBASE_PPI_CHANNEL);
+#endif /* SOFTDEVICE_ENABLED */
+
+  NRF_TIMER1->TASKS_START = 1;
+#endif /* TIMEBASE_SUBTICK_ENABLED */
+
+  return u32Result;
+
+} /* end TimebaseInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void TimebaseRtcHandler(void)
+@brief Services RTC1 OVRFLW and COMPARE0 events.
+
+Called only from RTC1_IRQHandler().  If the ISR was held off by the SoftDevice for more than 1ms, every ms whose
+start count has already passed is counted so G_u32SystemTime1ms catches up with the COUNTER.
+
+Requires:
+- TimebaseInitialize() has run
+
+Promises:
+- Timebase_u32Overflows counts COUNTER overflows
+- G_u32SystemTime1ms and G_u32SystemTime1s are brought up to date with RTC1 COUNTER
+- CC[0] is loaded with the start of the next ms, at least two counts ahead of COUNTER
+
+*/
+void TimebaseRtcHandler(void)
+{
+  u32 u32Counter;
+
+  if(NRF_RTC1->EVENTS_OVRFLW)
+  {
+    NRF_RTC1->EVENTS_OVRFLW = 0;
+    Timebase_u32Overflows++;
+  }
+
+  if(NRF_RTC1->EVENTS_COMPARE[0])
+  {
+    NRF_RTC1->EVENTS_COMPARE[0] = 0;
+
+    /* Count every ms whose start is at or before COUNTER + guard */
+    u32Counter = NRF_RTC1->COUNTER;
+    while( ((u32Counter + U32_RTC_CC_GUARD - Timebase_u32NextCompare) & U32_RTC_COUNTER_MASK) < U32_RTC_COUNTER_HALF_RANGE )
+    {
+      TimebaseAdvanceMs();
+      u32Counter = NRF_RTC1->COUNTER;
+    }
+
+    NRF_RTC1->CC[0] = Timebase_u32NextCompare;
+  }
+
+} /* end TimebaseRtcHandler() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u64 TimebaseSample(u32* pu32SubTickUs_)
+@brief Takes a consistent snapshot of the overflow count, COUNTER and TIMER1.
+
+A pending (not yet serviced) OVRFLW event is accounted for so the result is correct even when called from an ISR
+that has blocked RTC1_IRQHandler.
+
+Requires:
+@param pu32SubTickUs_ receives the TIMER1 value (us since the last RTC count) if TIMEBASE_SUBTICK_ENABLED
+
+Promises:
+- Returns the 64-bit extended COUNTER
+
+*/
+static u64 TimebaseSample(u32* pu32SubTickUs_)
+{
+  u32 u32Overflows;
+  u32 u32Pending;
+  u32 u32Counter;
+
+  *pu32SubTickUs_ = 0;
+
+  do
+  {
+    u32Overflows = Timebase_u32Overflows;
+    u32Pending   = NRF_RTC1->EVENTS_OVRFLW;
+    u32Counter   = NRF_RTC1->COUNTER;
+#ifdef TIMEBASE_SUBTICK_ENABLED
+    NRF_TIMER1->TASKS_CAPTURE[0] = 1;
+    *pu32SubTickUs_ = NRF_TIMER1->CC[0];
+#endif
+  } while( (u32Counter   != NRF_RTC1->COUNTER)       ||
+           (u32Pending   != NRF_RTC1->EVENTS_OVRFLW) ||
+           (u32Overflows != Timebase_u32Overflows) );
+
+  if(u32Pending)
+  {
+    u32Overflows++;
+  }
+
+  return ( ((u64)u32Overflows << U32_RTC_COUNTER_BITS) | u32Counter );
+
+} /* end TimebaseSample() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void TimebaseAdvanceMs(void)
+@brief Counts one ms and moves the compare point by 32 or 33 counts.
+
+768 of every 1000 ms are 33 counts long and the rest are 32, so 1000 ms are exactly 32768 counts.
+
+Requires:
+- Called only from TimebaseRtcHandler()
+
+Promises:
+- G_u32SystemTime1ms incremented; G_u32SystemTime1s incremented every 1000 ms
+- Timebase_u32NextCompare holds the start of the following ms
+
+*/
+static void TimebaseAdvanceMs(void)
+{
+  u32 u32Step = U16_TIMEBASE_COUNTS_PER_MS;
+
+  G_u32SystemTime1ms++;
+  Timebase_u16MsInSecond++;
+  if(Timebase_u16MsInSecond == U16_TIMEBASE_MS_PER_SECOND)
+  {
+    Timebase_u16MsInSecond = 0;
+    G_u32SystemTime1s++;
+  }
+
+  Timebase_u16Fraction += U16_TIMEBASE_FRACTION_PER_MS;
+  if(Timebase_u16Fraction >= U16_TIMEBASE_FRACTION_ONE)
+  {
+    Timebase_u16Fraction -= U16_TIMEBASE_FRACTION_ONE;
+    u32Step++;
+  }
+
+  Timebase_u32NextCompare = (Timebase_u32NextCompare + u32Step) & U32_RTC_COUNTER_MASK;
+
+} /* end TimebaseAdvanceMs() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
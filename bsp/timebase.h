@@ -0,0 +1,68 @@
+/**********************************************************************************************************************
+File: timebase.h
+
+Description:
+Header file for timebase.c
+**********************************************************************************************************************/
+
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U32_RTC_COUNTER_MASK            (u32)0x00FFFFFF   /* RTC COUNTER is 24 bits wide */
+#define U32_RTC_COUNTER_HALF_RANGE      (u32)0x00800000   /* Compare distances below this are "in the past" */
+#define U32_RTC_COUNTER_BITS            (u8)24            /* Shift to place the overflow count above COUNTER */
+#define U32_RTC_CC_GUARD                (u32)1            /* CC must be at least COUNTER + 2 to be sure to fire */
+
+#define U16_TIMEBASE_COUNTS_PER_MS      (u16)32           /* Whole RTC counts in 1ms at 32768Hz */
+#define U16_TIMEBASE_FRACTION_PER_MS    (u16)768          /* Remaining 0.768 count per ms in 1/1000 counts */
+#define U16_TIMEBASE_FRACTION_ONE       (u16)1000         /* One whole RTC count in 1/1000 counts */
+#define U16_TIMEBASE_MS_PER_SECOND      (u16)1000
+
+/* 1 RTC count = 1000000 / 32768 us = 15625 / 512 us */
+#define U32_TIMEBASE_US_NUMERATOR       (u32)15625
+#define U8_TIMEBASE_US_SHIFT            (u8)9
+
+#define U8_TIMEBASE_PPI_CHANNEL         (u8)0             /* PPI channel RTC1 TICK -> TIMER1 CLEAR */
+#define U32_TIMEBASE_TIMER_PRESCALER    (u32)4            /* 16MHz / 2^4 = 1MHz TIMER1 count */
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+u64 TimebaseGetTicks(void);
+u64 TimebaseGetUs(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+u32 TimebaseInitialize(void);
+void TimebaseRtcHandler(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static u64 TimebaseSample(u32* pu32SubTickUs_);
+static void TimebaseAdvanceMs(void);
+
+
+
+#endif /* __TIMEBASE_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -59,15 +59,8 @@ bool IsTimeUp(u32 *pu32SavedTick_, u32 u32Period_)
 {
   u32 u32TimeElapsed;
   
-  /* Check to see if the timer in question has rolled */
-  if(G_u32SystemTime1ms >= *pu32SavedTick_)
-  {
-    u32TimeElapsed = G_u32SystemTime1ms - *pu32SavedTick_;
-  }
-  else
-  {
-    u32TimeElapsed = (0xFFFFFFFF - *pu32SavedTick_) + G_u32SystemTime1ms;
-  }
+  /* Unsigned subtraction is correct across the 32-bit roll-over */
+  u32TimeElapsed = G_u32SystemTime1ms - *pu32SavedTick_;
 
   /* Now determine if time is up */
   if(u32TimeElapsed < u32Period_)
@@ -315,6 +308,37 @@ bool SearchString(u8* pu8TargetString_, u8* pu8MatchString_)
 } /* end SearchString */
 
 
+/*-----------------------------------------------------------------------------/
+Function: Crc16Compute
+
+Description:
+CRC-16-CCITT (polynomial 0x1021, initial value 0xFFFF) of a block, matching crc16_compute() in the SDK's
+app_common/crc16.h so a client can check the same value.  Long data can be fed in pieces by passing the result
+of the previous call as u16Crc_.
+
+Requires:
+  - pu8Data_ points to u32Size_ bytes
+  - u16Crc_ is U16_CRC16_INIT for the first block, or the previous result
+ 
+Promises:
+  - Returns the CRC including this block
+*/
+u16 Crc16Compute(const u8* pu8Data_, u32 u32Size_, u16 u16Crc_)
+{
+  for(u32 i = 0; i < u32Size_; i++)
+  {
+    u16Crc_  = (u16)((u16Crc_ >> 8) | (u16Crc_ << 8));
+    u16Crc_ ^= pu8Data_[i];
+    u16Crc_ ^= (u16)((u16Crc_ & 0xFF) >> 4);
+    u16Crc_ ^= (u16)((u16Crc_ << 8) << 4);
+    u16Crc_ ^= (u16)(((u16Crc_ & 0xFF) << 4) << 1);
+  }
+
+  return(u16Crc_);
+
+} /* end Crc16Compute */
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected Functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
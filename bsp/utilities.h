@@ -24,6 +24,8 @@ Constants / Definitions
 #define RESET_TARGET_TIMER      (u8)0x1       /* Switch for IsTimeUp to reset the reference timer */
 #define NO_RESET_TARGET_TIMER   (u8)0x0       /* Switch for IsTimeUp to not reset the reference timer */
 
+#define U16_CRC16_INIT          (u16)0xFFFF   /* Crc16Compute starting value */
+
 #define MESSAGE_OK              "OK\r\n"
 #define MESSAGE_OK_SIZE         (u8)(sizeof(MESSAGE_OK) - 1)
 
@@ -53,6 +55,7 @@ u8 HexToASCIICharUpper(u8 u8Char_);
 u8 HexToASCIICharLower(u8 u8Char_);
 u8 NumberToAscii(u32 u32Number_, u8* pu8AsciiString_);
 bool SearchString(u8* pu8TargetString_, u8* pu8MatchString_);
+u16 Crc16Compute(const u8* pu8Data_, u32 u32Size_, u16 u16Crc_);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,312 @@
+/**********************************************************************************************************************
+File: watchdog.c
+
+Description:
+Watchdog feeding with per-task check-in and missed-deadline attribution.
+
+WatchDogSetup() starts the WDT.  Each super loop task registers a check-in period and calls WatchdogCheckIn() every
+time it runs.  WatchdogRunActiveState() feeds the dog only while every registered task is within its period; once a
+task starves, feeding stops, the task is written to a record in no-init RAM and the WDT resets the system.  If the
+main loop blocks completely, the WDT TIMEOUT interrupt writes the record instead, naming the last task to check in.
+A SoftDevice assert is recorded the same way before an immediate reset.
+
+On the next boot WatchdogInitialize() validates the record against RESETREAS and publishes it in
+G_sWatchdogLastFault.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+WatchdogRecordType G_sWatchdogLastFault;               /* Record left by the previous reset (u8Cause NONE if none) */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "Watchdog_" and be declared as static.
+***********************************************************************************************************************/
+static __no_init WatchdogRecordType Watchdog_sRetained;        /* Survives WDT and soft resets */
+
+static u32 Watchdog_au32PeriodMs[WATCHDOG_TASKS];              /* Check-in period per task; 0 = not monitored */
+static u32 Watchdog_au32LastCheckIn[WATCHDOG_TASKS];           /* G_u32SystemTime1ms of each task's last check-in */
+static volatile u8 Watchdog_u8LastTask;                        /* Most recent task to check in */
+static bool Watchdog_bStarved;                                 /* Feeding has stopped */
+static u32 Watchdog_u32ResetReason;                            /* RESETREAS read at start-up */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WatchdogRegisterTask(WatchdogTaskType eTask_, u32 u32PeriodMs_)
+@brief Declares how often a task promises to check in.
+
+Requires:
+- WatchdogInitialize() has run
+@param u32PeriodMs_ is the longest allowed gap between check-ins; must be well below U32_WATCHDOG_TIMEOUT_MS
+
+Promises:
+- eTask_ is monitored from now on, starting as freshly checked in
+
+*/
+void WatchdogRegisterTask(WatchdogTaskType eTask_, u32 u32PeriodMs_)
+{
+  if(eTask_ < WATCHDOG_TASKS)
+  {
+    Watchdog_au32LastCheckIn[eTask_] = G_u32SystemTime1ms;
+    Watchdog_au32PeriodMs[eTask_] = u32PeriodMs_;
+  }
+
+} /* end WatchdogRegisterTask() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WatchdogCheckIn(WatchdogTaskType eTask_)
+@brief Marks a task as alive.  Call at the start of the task's RunActiveState().
+
+Promises:
+- The task's deadline restarts and it becomes the "last task" for attribution
+
+*/
+void WatchdogCheckIn(WatchdogTaskType eTask_)
+{
+  if(eTask_ < WATCHDOG_TASKS)
+  {
+    Watchdog_au32LastCheckIn[eTask_] = G_u32SystemTime1ms;
+    Watchdog_u8LastTask = (u8)eTask_;
+  }
+
+} /* end WatchdogCheckIn() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WatchdogRecordAssert(u32 u32Pc_, u32 u32Line_)
+@brief Saves SoftDevice assert information for the next boot.
+
+Requires:
+- Called from SocSoftdeviceAssertCallback() just before the reset
+
+Promises:
+- Retained record holds WATCHDOG_CAUSE_SD_ASSERT with the PC and line
+
+*/
+void WatchdogRecordAssert(u32 u32Pc_, u32 u32Line_)
+{
+  Watchdog_sRetained.u32AssertPc = u32Pc_;
+  Watchdog_sRetained.u32AssertLine = u32Line_;
+  WatchdogRecordWrite(WATCHDOG_CAUSE_SD_ASSERT, WATCHDOG_TASKS, 0);
+
+} /* end WatchdogRecordAssert() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn u32 WatchdogGetResetReason(void)
+@brief Reports why this boot happened.
+
+Requires:
+- WatchdogInitialize() has run
+
+Promises:
+- Returns the RESETREAS bits read at start-up; 0 means power-on (including a brown-out)
+
+*/
+u32 WatchdogGetResetReason(void)
+{
+  return Watchdog_u32ResetReason;
+
+} /* end WatchdogGetResetReason() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WatchdogInitialize(void)
+@brief Reports the previous fault record and clears the task table.
+
+Requires:
+- SoftDevice is enabled; WatchDogSetup() has run
+- Called before any task registers
+
+Promises:
+- G_sWatchdogLastFault holds a valid record from the previous run, or u8Cause = WATCHDOG_CAUSE_NONE
+- RESETREAS is cleared so the next boot sees only its own reset reason
+- The retained record is invalidated but keeps its reset count until power-on
+
+*/
+void WatchdogInitialize(void)
+{
+  u32 u32ResetReason = 0;
+  bool bValid;
+  u8 u8ResetCount = 0;
+
+#ifdef SOFTDEVICE_ENABLED
+  sd_power_reset_reason_get(&u32ResetReason);
+  sd_power_reset_reason_clr(u32ResetReason);
+#else
+  u32ResetReason = NRF_POWER->RESETREAS;
+  NRF_POWER->RESETREAS = u32ResetReason;
+#endif /* SOFTDEVICE_ENABLED */
+  Watchdog_u32ResetReason = u32ResetReason;
+
+  /* A record only means something if the reset that followed it was a dog or soft reset */
+  bValid = (Watchdog_sRetained.u32Magic == U32_WATCHDOG_RECORD_MAGIC) &&
+           (Watchdog_sRetained.u32Check == WatchdogRecordChecksum(&Watchdog_sRetained));
+
+  memset(&G_sWatchdogLastFault, 0, sizeof(G_sWatchdogLastFault));
+  if(bValid && (u32ResetReason & (POWER_RESETREAS_DOG_Msk | POWER_RESETREAS_SREQ_Msk)))
+  {
+    G_sWatchdogLastFault = Watchdog_sRetained;
+    G_sWatchdogLastFault.u32ResetReason = u32ResetReason;
+  }
+
+  /* The reset count survives until a power-on or pin reset */
+  if(bValid && !(u32ResetReason & POWER_RESETREAS_RESETPIN_Msk))
+  {
+    u8ResetCount = Watchdog_sRetained.u8ResetCount;
+  }
+
+  memset(&Watchdog_sRetained, 0, sizeof(Watchdog_sRetained));
+  Watchdog_sRetained.u8ResetCount = u8ResetCount;
+
+  for(u8 i = 0; i < WATCHDOG_TASKS; i++)
+  {
+    Watchdog_au32PeriodMs[i] = 0;
+    Watchdog_au32LastCheckIn[i] = 0;
+  }
+
+  Watchdog_u8LastTask = WATCHDOG_TASKS;
+  Watchdog_bStarved = FALSE;
+
+} /* end WatchdogInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WatchdogRunActiveState(void)
+@brief Feeds the WDT if every registered task has checked in on time.  Called once per pass of the main loop.
+
+Promises:
+- WDT reloaded while all tasks are live
+- The first task found overdue is recorded and feeding stops for good
+
+*/
+void WatchdogRunActiveState(void)
+{
+  u32 u32Late;
+
+  if(Watchdog_bStarved)
+  {
+    return;
+  }
+
+  for(u8 i = 0; i < WATCHDOG_TASKS; i++)
+  {
+    if(Watchdog_au32PeriodMs[i] != 0)
+    {
+      u32Late = G_u32SystemTime1ms - Watchdog_au32LastCheckIn[i];
+      if(u32Late > Watchdog_au32PeriodMs[i])
+      {
+        Watchdog_bStarved = TRUE;
+        WatchdogRecordWrite(WATCHDOG_CAUSE_TASK_STARVED, i, u32Late - Watchdog_au32PeriodMs[i]);
+        return;
+      }
+    }
+  }
+
+  NRF_WDT->RR[0] = WDT_RR_RR_Reload;
+
+} /* end WatchdogRunActiveState() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WatchdogTimeoutHandler(void)
+@brief Last-moment record from the WDT TIMEOUT interrupt.
+
+Only two 32kHz cycles remain before the reset, so this does nothing but write the record.
+
+Requires:
+- Called only from WDT_IRQHandler()
+
+Promises:
+- If no task was already recorded, records WATCHDOG_CAUSE_TIMEOUT naming the last task to check in
+
+*/
+void WatchdogTimeoutHandler(void)
+{
+  NRF_WDT->EVENTS_TIMEOUT = 0;
+
+  if(!Watchdog_bStarved)
+  {
+    WatchdogRecordWrite(WATCHDOG_CAUSE_TIMEOUT, WATCHDOG_TASKS, 0);
+  }
+
+} /* end WatchdogTimeoutHandler() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static u32 WatchdogRecordChecksum(WatchdogRecordType* psRecord_)
+@brief XOR of every word of the record except u32Check.
+*/
+static u32 WatchdogRecordChecksum(WatchdogRecordType* psRecord_)
+{
+  u32* pu32Word = (u32*)psRecord_;
+  u32 u32Check = 0;
+
+  for(u8 i = 0; i < ((sizeof(WatchdogRecordType) / sizeof(u32)) - 1); i++)
+  {
+    u32Check ^= pu32Word[i];
+  }
+
+  return ~u32Check;
+
+} /* end WatchdogRecordChecksum() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void WatchdogRecordWrite(WatchdogCauseType eCause_, u8 u8Task_, u32 u32OverdueMs_)
+@brief Fills in and seals the retained record.
+*/
+static void WatchdogRecordWrite(WatchdogCauseType eCause_, u8 u8Task_, u32 u32OverdueMs_)
+{
+  Watchdog_sRetained.u32Magic        = U32_WATCHDOG_RECORD_MAGIC;
+  Watchdog_sRetained.u8Cause         = (u8)eCause_;
+  Watchdog_sRetained.u8Task          = u8Task_;
+  Watchdog_sRetained.u8LastTask      = Watchdog_u8LastTask;
+  Watchdog_sRetained.u32OverdueMs    = u32OverdueMs_;
+  Watchdog_sRetained.u32SystemTime1s = G_u32SystemTime1s;
+  Watchdog_sRetained.u32ResetReason  = 0;
+  if(Watchdog_sRetained.u8ResetCount != 0xFF)
+  {
+    Watchdog_sRetained.u8ResetCount++;
+  }
+
+  Watchdog_sRetained.u32Check = WatchdogRecordChecksum(&Watchdog_sRetained);
+
+} /* end WatchdogRecordWrite() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,101 @@
+/**********************************************************************************************************************
+File: watchdog.h
+
+Description:
+Header file for watchdog.c
+**********************************************************************************************************************/
+
+#ifndef __WATCHDOG_H
+#define __WATCHDOG_H
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum WatchdogTaskType
+@brief Super loop tasks that check in with the watchdog. */
+typedef enum
+{
+  WATCHDOG_TASK_WORK_QUEUE = 0,           /*!< @brief WorkQueueRunActiveState(): protocol and ISR work */
+  WATCHDOG_TASK_LED,                      /*!< @brief LedRunActiveState() */
+  WATCHDOG_TASK_BUTTON,                   /*!< @brief ButtonRunActiveState() */
+  WATCHDOG_TASK_POV,                      /*!< @brief PovRunActiveState() */
+  WATCHDOG_TASK_USER_APP1,                /*!< @brief UserApp1RunActiveState() */
+  WATCHDOG_TASKS                          /*!< @brief Number of tasks; also "no task"; must stay last */
+} WatchdogTaskType;
+
+/*!
+@enum WatchdogCauseType
+@brief Why the retained record was written. */
+typedef enum
+{
+  WATCHDOG_CAUSE_NONE = 0,                /*!< @brief No record */
+  WATCHDOG_CAUSE_TASK_STARVED,            /*!< @brief A task missed its check-in period; feeding stopped */
+  WATCHDOG_CAUSE_TIMEOUT,                 /*!< @brief The WDT fired without a starved task seen (main loop blocked) */
+  WATCHDOG_CAUSE_SD_ASSERT                /*!< @brief SoftDevice assert; reset requested by the application */
+} WatchdogCauseType;
+
+/*!
+@struct WatchdogRecordType
+@brief Fault record kept in no-init RAM across the reset.
+*/
+typedef struct
+{
+  u32 u32Magic;                           /*!< @brief U32_WATCHDOG_RECORD_MAGIC when the record is valid */
+  u8  u8Cause;                            /*!< @brief WatchdogCauseType */
+  u8  u8Task;                             /*!< @brief Starved task, or WATCHDOG_TASKS if not known */
+  u8  u8LastTask;                         /*!< @brief Last task to check in: the one running if the loop blocked */
+  u8  u8ResetCount;                       /*!< @brief Recorded resets since the last power-on (saturates) */
+  u32 u32OverdueMs;                       /*!< @brief How far past its period u8Task was */
+  u32 u32SystemTime1s;                    /*!< @brief Uptime when the record was written */
+  u32 u32AssertPc;                        /*!< @brief SoftDevice assert program counter */
+  u32 u32AssertLine;                      /*!< @brief SoftDevice assert line number */
+  u32 u32ResetReason;                     /*!< @brief RESETREAS read on the following boot */
+  u32 u32Check;                           /*!< @brief XOR of the words above */
+} WatchdogRecordType;
+
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U32_WATCHDOG_TIMEOUT_MS         (u32)5000         /* WDT period; the main loop normally runs every 1ms */
+#define U32_WATCHDOG_CRV                (u32)((U32_WATCHDOG_TIMEOUT_MS * 32768UL) / 1000 - 1)
+#define U32_WATCHDOG_TASK_PERIOD_MS     (u32)1000         /* Default check-in period for super loop tasks */
+#define U32_WATCHDOG_RECORD_MAGIC       (u32)0x57444F47   /* "WDOG" */
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void WatchdogRegisterTask(WatchdogTaskType eTask_, u32 u32PeriodMs_);
+void WatchdogCheckIn(WatchdogTaskType eTask_);
+void WatchdogRecordAssert(u32 u32Pc_, u32 u32Line_);
+u32 WatchdogGetResetReason(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void WatchdogInitialize(void);
+void WatchdogRunActiveState(void);
+void WatchdogTimeoutHandler(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static u32 WatchdogRecordChecksum(WatchdogRecordType* psRecord_);
+static void WatchdogRecordWrite(WatchdogCauseType eCause_, u8 u8Task_, u32 u32OverdueMs_);
+
+
+
+#endif /* __WATCHDOG_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,290 @@
+/**********************************************************************************************************************
+File: work_queue.c
+
+Description:
+Deferred work queue from interrupt handlers to the main loop.
+
+ISRs post small typed work items (with payload and time stamp) into a single-producer / single-consumer ring and
+the main loop drains them in order with WorkQueueRunActiveState().  The producer only writes WorkQueue_u8Head and
+the consumer only writes WorkQueue_u8Tail, so neither side needs a critical region or a read-modify-write on a
+shared word.
+
+Single producer: every ISR that posts must run at NRF_APP_PRIORITY_LOW (RTC1, GPIOTE, SD_EVT and SWI1 do) so posts can
+never preempt each other.  Do not post from the main loop or from a higher priority interrupt.
+
+Sources that only need "at least one pending" (SoftDevice events, timer compares) use WorkQueuePostCoalesced() so a
+burst of interrupts takes one ring entry.  If the ring overflows, the main loop runs every coalesced handler once
+so nothing is left waiting on an interrupt that already happened.
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/***********************************************************************************************************************
+Global variable definitions with scope across entire project.
+All Global variable names shall start with "G_"
+***********************************************************************************************************************/
+/* New variables */
+WorkQueueStatsType G_sWorkQueueStats;                  /* Work queue statistics */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Existing variables (defined in other files -- should all contain the "extern" keyword) */
+extern volatile u32 G_u32SystemTime1ms;                /*!< @brief From main.c */
+extern volatile u32 G_u32SystemTime1s;                 /*!< @brief From main.c */
+extern volatile u32 G_u32SystemFlags;                  /*!< @brief From main.c */
+
+
+/***********************************************************************************************************************
+Global variable definitions with scope limited to this local application.
+Variable names shall start with "WorkQueue_" and be declared as static.
+***********************************************************************************************************************/
+static WorkItemType WorkQueue_asItems[U8_WORKQUEUE_SIZE];    /* The ring */
+static volatile u8 WorkQueue_u8Head;                         /* Next free entry; written only by ISRs */
+static volatile u8 WorkQueue_u8Tail;                         /* Next entry to run; written only by the main loop */
+
+static volatile u8 WorkQueue_au8Posted[WORK_ITEM_TYPES];     /* Coalesced sequence queued; written only by ISRs */
+static volatile u8 WorkQueue_au8Handled[WORK_ITEM_TYPES];    /* Coalesced sequence taken; written only by main */
+static u32 WorkQueue_u32OverflowsSeen;                       /* G_sWorkQueueStats.u32Overflows at the last resync */
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool WorkQueuePost(WorkItemIdType eType_, u8 u8Param_, u16 u16Param_, u32 u32Data_)
+@brief Queues a work item for the main loop.  ISR use only.
+
+Requires:
+- Called from an NRF_APP_PRIORITY_LOW ISR (see the single producer note above)
+@param eType_ selects the handler in WorkQueueDispatch()
+@param u8Param_, u16Param_ and u32Data_ are passed through unchanged
+
+Promises:
+- Returns TRUE and queues the item stamped with G_u32SystemTime1ms
+- Returns FALSE and counts an overflow if the ring is full
+
+*/
+bool WorkQueuePost(WorkItemIdType eType_, u8 u8Param_, u16 u16Param_, u32 u32Data_)
+{
+  u8 u8Head = WorkQueue_u8Head;
+  u8 u8Next = (u8)((u8Head + 1) & U8_WORKQUEUE_MASK);
+  WorkItemType* psItem;
+
+  if(u8Next == WorkQueue_u8Tail)
+  {
+    G_sWorkQueueStats.u32Overflows++;
+    return FALSE;
+  }
+
+  psItem = &WorkQueue_asItems[u8Head];
+  psItem->u8Type       = (u8)eType_;
+  psItem->u8Param      = u8Param_;
+  psItem->u16Param     = u16Param_;
+  psItem->u32Data      = u32Data_;
+  psItem->u32TimeStamp = G_u32SystemTime1ms;
+
+  /* The item must be complete before the consumer can see the new head */
+  __DMB();
+  WorkQueue_u8Head = u8Next;
+  G_sWorkQueueStats.u32Posted++;
+
+  return TRUE;
+
+} /* end WorkQueuePost() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn bool WorkQueuePostCoalesced(WorkItemIdType eType_)
+@brief Queues eType_ unless one is already waiting in the ring.  ISR use only.
+
+The handler for a coalesced type must process everything that is pending when it runs.
+
+Requires:
+- As WorkQueuePost()
+
+Promises:
+- Returns TRUE if an item of eType_ is queued (new or already waiting)
+- Returns FALSE if the ring was full
+
+*/
+bool WorkQueuePostCoalesced(WorkItemIdType eType_)
+{
+  u8 u8Sequence = WorkQueue_au8Posted[eType_];
+
+  if(u8Sequence != WorkQueue_au8Handled[eType_])
+  {
+    return TRUE;
+  }
+
+  u8Sequence++;
+  if(!WorkQueuePost(eType_, u8Sequence, 0, 0))
+  {
+    return FALSE;
+  }
+
+  WorkQueue_au8Posted[eType_] = u8Sequence;
+  return TRUE;
+
+} /* end WorkQueuePostCoalesced() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WorkQueueInitialize(void)
+@brief Empties the ring.
+
+Requires:
+- WatchdogInitialize() has run
+- Called before any posting interrupt is enabled
+
+Promises:
+- Ring, coalescing sequences and statistics are reset
+
+*/
+void WorkQueueInitialize(void)
+{
+  WorkQueue_u8Head = 0;
+  WorkQueue_u8Tail = 0;
+  WorkQueue_u32OverflowsSeen = 0;
+
+  for(u8 i = 0; i < WORK_ITEM_TYPES; i++)
+  {
+    WorkQueue_au8Posted[i]  = 0;
+    WorkQueue_au8Handled[i] = 0;
+  }
+
+  memset(&G_sWorkQueueStats, 0, sizeof(G_sWorkQueueStats));
+  WatchdogRegisterTask(WATCHDOG_TASK_WORK_QUEUE, U32_WATCHDOG_TASK_PERIOD_MS);
+
+} /* end WorkQueueInitialize() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn void WorkQueueRunActiveState(void)
+@brief Drains the ring in order.  Called once per pass of the main loop.
+
+Items posted while draining are run in the same pass.
+
+Requires:
+- WorkQueueInitialize() has run
+
+Promises:
+- Every queued item has been dispatched
+- After an overflow, all coalesced handlers have been run once
+
+*/
+void WorkQueueRunActiveState(void)
+{
+  WorkItemType sItem;
+  u8 u8Tail = WorkQueue_u8Tail;
+  u8 u8Depth;
+
+  WatchdogCheckIn(WATCHDOG_TASK_WORK_QUEUE);
+  u8Depth = (u8)((WorkQueue_u8Head - u8Tail) & U8_WORKQUEUE_MASK);
+  if(u8Depth > G_sWorkQueueStats.u32MaxDepth)
+  {
+    G_sWorkQueueStats.u32MaxDepth = u8Depth;
+  }
+
+  while(u8Tail != WorkQueue_u8Head)
+  {
+    /* Copy the item out before handing the entry back to the producer */
+    __DMB();
+    sItem = WorkQueue_asItems[u8Tail];
+    __DMB();
+    u8Tail = (u8)((u8Tail + 1) & U8_WORKQUEUE_MASK);
+    WorkQueue_u8Tail = u8Tail;
+
+    WorkQueueDispatch(&sItem);
+    G_sWorkQueueStats.u32Dispatched++;
+  }
+
+  if(G_sWorkQueueStats.u32Overflows != WorkQueue_u32OverflowsSeen)
+  {
+    WorkQueue_u32OverflowsSeen = G_sWorkQueueStats.u32Overflows;
+    WorkQueueResync();
+  }
+
+} /* end WorkQueueRunActiveState() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void WorkQueueDispatch(WorkItemType* psItem_)
+@brief Runs the main-loop handler for one work item.
+
+Coalesced types record their sequence as handled before the handler runs, so an interrupt that arrives during the
+handler queues a fresh item.
+*/
+static void WorkQueueDispatch(WorkItemType* psItem_)
+{
+  switch(psItem_->u8Type)
+  {
+    case WORK_ITEM_SD_EVENT:
+    {
+      WorkQueue_au8Handled[WORK_ITEM_SD_EVENT] = psItem_->u8Param;
+      SocIntegrationHandler();
+      break;
+    }
+
+    case WORK_ITEM_BUTTON_EDGE:
+    {
+      ButtonDebounceEdge(psItem_->u8Param, psItem_->u32TimeStamp);
+      break;
+    }
+
+    case WORK_ITEM_TIMER_COMPARE:
+    {
+      WorkQueue_au8Handled[WORK_ITEM_TIMER_COMPARE] = psItem_->u8Param;
+      SwTimerRunActiveState();
+      break;
+    }
+
+    case WORK_ITEM_RADIO_IDLE:
+    {
+      WorkQueue_au8Handled[WORK_ITEM_RADIO_IDLE] = psItem_->u8Param;
+      RadioSchedOnRadioIdle();
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  } /* end switch(psItem_->u8Type) */
+
+} /* end WorkQueueDispatch() */
+
+
+/*!----------------------------------------------------------------------------------------------------------------------
+@fn static void WorkQueueResync(void)
+@brief Runs every coalesced handler after items were dropped.
+
+A dropped coalesced post is retried by the next interrupt of that type, but there may never be one, so run the
+handlers now.  Dropped button edges leave the button interrupt enabled (see ButtonStartDebounce()).
+*/
+static void WorkQueueResync(void)
+{
+  SocIntegrationHandler();
+  SwTimerRunActiveState();
+  RadioSchedOnRadioIdle();
+
+} /* end WorkQueueResync() */
+
+
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/
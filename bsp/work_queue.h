@@ -0,0 +1,91 @@
+/**********************************************************************************************************************
+File: work_queue.h
+
+Description:
+Header file for work_queue.c
+**********************************************************************************************************************/
+
+#ifndef __WORK_QUEUE_H
+#define __WORK_QUEUE_H
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/*!
+@enum WorkItemIdType
+@brief Work item types.  Add new ISR sources here and to WorkQueueDispatch(). */
+typedef enum
+{
+  WORK_ITEM_NONE = 0,
+  WORK_ITEM_SD_EVENT,                     /*!< @brief SoftDevice event(s) pending (SD_EVT_IRQn) */
+  WORK_ITEM_BUTTON_EDGE,                  /*!< @brief u8Param = button index; edge time in u32TimeStamp */
+  WORK_ITEM_TIMER_COMPARE,                /*!< @brief RTC1 COMPARE1: software timers are due */
+  WORK_ITEM_RADIO_IDLE,                   /*!< @brief Radio notification: a radio event has just ended */
+  WORK_ITEM_TYPES                         /*!< @brief Number of types; must stay last */
+} WorkItemIdType;
+
+/*!
+@struct WorkItemType
+@brief One unit of deferred work passed from an ISR to the main loop.
+*/
+typedef struct
+{
+  u8  u8Type;                             /*!< @brief WorkItemIdType */
+  u8  u8Param;                            /*!< @brief Small source-specific argument */
+  u16 u16Param;                           /*!< @brief Source-specific argument */
+  u32 u32Data;                            /*!< @brief Source-specific payload */
+  u32 u32TimeStamp;                       /*!< @brief G_u32SystemTime1ms when the item was posted */
+} WorkItemType;
+
+/*!
+@struct WorkQueueStatsType
+@brief Work queue statistics.  Each field has a single writer (ISR or main loop).
+*/
+typedef struct
+{
+  u32 u32Posted;                          /*!< @brief Items queued (ISR) */
+  u32 u32Overflows;                       /*!< @brief Items dropped because the ring was full (ISR) */
+  u32 u32Dispatched;                      /*!< @brief Items handled (main) */
+  u32 u32MaxDepth;                        /*!< @brief Deepest ring seen by the main loop (main) */
+} WorkQueueStatsType;
+
+
+/**********************************************************************************************************************
+Constants / Definitions
+**********************************************************************************************************************/
+#define U8_WORKQUEUE_SIZE               (u8)8             /* Ring entries; must be a power of 2 */
+#define U8_WORKQUEUE_MASK               (u8)(U8_WORKQUEUE_SIZE - 1)
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Public functions                                                                                                   */
+/*--------------------------------------------------------------------------------------------------------------------*/
+bool WorkQueuePost(WorkItemIdType eType_, u8 u8Param_, u16 u16Param_, u32 u32Data_);
+bool WorkQueuePostCoalesced(WorkItemIdType eType_);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Protected functions                                                                                                */
+/*--------------------------------------------------------------------------------------------------------------------*/
+void WorkQueueInitialize(void);
+void WorkQueueRunActiveState(void);
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions                                                                                                  */
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void WorkQueueDispatch(WorkItemType* psItem_);
+static void WorkQueueResync(void);
+
+
+
+#endif /* __WORK_QUEUE_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File                                                                                                        */
+/*--------------------------------------------------------------------------------------------------------------------*/